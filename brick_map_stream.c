@@ -0,0 +1,377 @@
+// Streaming test of the sparse brick map ("sdf_brick_map.h"): no OpenGL needed.
+// A camera flies in a straight line over a random world (SdfScene_SetRandom(...), walked through its SdfBvh) that is much
+// bigger than the residency budget of the brick map: every frame, the surface bricks around the camera are baked (and the
+// least recently used ones evicted), the steps of the brick map are checked against the exact map() at random points, and
+// the frame is rendered by the CPU renderer with and without the brick map (the images should match: it only changes how
+// castRay() steps far from the surfaces), counting the map() calls per pixel.
+// "-e <count>" edits the world in front of the camera every frame (moves a primitive, or makes it carve its neighbor with
+// a subtraction): only the bricks the edits can reach are evaluated and baked again (SdfBrickMap_InvalidateSceneChanges(...)),
+// and the steps are checked around the edits too. At the end the brick map is compared with one created from scratch.
+// It exits with 1 if a step is ever unsafe, if the resident bricks exceed the budget, or if a brick is stale after the edits.
+// "-m" prints the memory-vs-quality table of several brick sizes instead (every surface brick resident).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+
+#define CPU_SCHEDULER_IMPLEMENTATION
+#define CPU_RENDERER_IMPLEMENTATION
+#include "cpu_renderer.h"
+
+#define SDF_SCENE_IMPLEMENTATION
+#include "sdf_scene.h"
+#define SDF_BVH_IMPLEMENTATION
+#include "sdf_bvh.h"
+#define SDF_BAKE_IMPLEMENTATION
+#include "sdf_bake.h"
+#define SDF_BRICK_MAP_IMPLEMENTATION
+#include "sdf_brick_map.h"
+
+#define NUM_CHECKED_POINTS (4096)   // random points (within the radius) where the steps are checked, every frame
+
+typedef struct {
+    int width,height;
+    int num_frames;
+    int num_threads;            // of the bakes (the renders are single-threaded, to count the map() calls)
+    int num_objects;            // of the random world
+    float brick_size;
+    int budget_kb;              // of the atlas (16-bit floats)
+    float radius;               // around the camera
+    int max_bakes;              // per frame (0 = no limit)
+    float flight_length;        // of the straight flight (0 = the size of the world minus 2 units)
+    int edits;                  // per frame
+    int table;                  // memory-vs-quality table instead of the flight
+} StreamArgs;
+
+static void PrintUsage(const char* exe) {
+    printf("Usage: %s [options]\n",exe);
+    printf("  -w <width>      (default: 160)\n");
+    printf("  -h <height>     (default: 90)\n");
+    printf("  -f <frames>     number of frames of the flight (default: 30)\n");
+    printf("  -t <threads>    threads of the bakes, 0 = all the hardware threads (default: 0)\n");
+    printf("  -n <count>      primitives of the random world (default: 20000, about 50x50 units)\n");
+    printf("  -b <size>       brick size (default: 0.35)\n");
+    printf("  -B <KB>         budget of the atlas (default: 4096)\n");
+    printf("  -r <radius>     the surface bricks closer than radius to the camera are made resident (default: 6)\n");
+    printf("  -k <bakes>      max bakes per frame, 0 = no limit (default: 0)\n");
+    printf("  -l <length>     length of the flight (default: the size of the world minus 2)\n");
+    printf("  -e <count>      edits of the world per frame, in front of the camera (default: 0)\n");
+    printf("  -m              memory-vs-quality table of several brick sizes (first frame of the flight, no budget)\n");
+}
+
+static int ParseArgs(StreamArgs* a,int argc,char* argv[]) {
+    int i;
+    a->width = 160;a->height = 90;
+    a->num_frames = 30;
+    a->num_threads = 0;
+    a->num_objects = 20000;
+    a->brick_size = 0.35f;
+    a->budget_kb = 4096;
+    a->radius = 6.f;
+    a->max_bakes = 0;
+    a->flight_length = 0.f;
+    a->edits = 0;
+    a->table = 0;
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (strcmp(arg,"-m")==0) {a->table = 1;continue;}
+        if (strcmp(arg,"--help")==0) return 0;
+        if (!val || arg[0]!='-' || arg[1]=='\0' || arg[2]!='\0') {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        switch (arg[1]) {
+        case 'w': a->width = atoi(val);break;
+        case 'h': a->height = atoi(val);break;
+        case 'f': a->num_frames = atoi(val);break;
+        case 't': a->num_threads = atoi(val);break;
+        case 'n': a->num_objects = atoi(val);break;
+        case 'b': a->brick_size = (float)atof(val);break;
+        case 'B': a->budget_kb = atoi(val);break;
+        case 'r': a->radius = (float)atof(val);break;
+        case 'k': a->max_bakes = atoi(val);break;
+        case 'l': a->flight_length = (float)atof(val);break;
+        case 'e': a->edits = atoi(val);break;
+        default: fprintf(stderr,"Invalid argument: %s\n",arg);return 0;
+        }
+        ++i;
+    }
+    if (a->width<=0 || a->height<=0 || a->num_frames<=0 || a->num_threads<0 || a->num_objects<2 ||
+        !(a->brick_size>0.f) || a->budget_kb<=0 || !(a->radius>0.f) || a->max_bakes<0 || a->flight_length<0.f || a->edits<0) {
+        fprintf(stderr,"Invalid argument values\n");
+        return 0;
+    }
+    return 1;
+}
+
+static float MapWorld(const float* pos,void* userData) {return CpuRenderer_Map((const CpuRenderer*)userData,vec3(pos[0],pos[1],pos[2]),NULL);}
+
+// The camera of frame i: 1.2 units above the ground, looking 3 units ahead
+static vec3_t GetCameraPosition(const StreamArgs* a,float length,int i) {
+    const float x = -0.5f*length+length*(a->num_frames>1 ? (float)i/(float)(a->num_frames-1) : 0.f);
+    return vec3(x,1.2f,0.25f*x);
+}
+static void SetCamera(CpuRenderer* r,const StreamArgs* a,vec3_t pos) {
+    mat4_t m = m4_identity();
+    m4_set_translation(&m,pos);
+    m4_look_at_YX(&m,vec3(pos.x+3.f,0.f,pos.z+0.75f),0.f,0.f);
+    CpuRenderer_SetUniforms(r,a->width,a->height,0.f,&m,NULL);
+}
+
+#define STREAM_RANDOM(state) (*(state) = *(state)*1664525u+1013904223u,(float)(*(state)>>8)*(1.f/16777216.f))    // in [0,1)
+
+// Edits the primitive closest to a random point 1 to 4 units in front of pos: moves it, or (odd edits) makes it a small sphere that carves
+// the previous primitive. Returns its position after the edit
+static vec3_t EditWorld(SdfScene* s,vec3_t pos,int editIndex,unsigned* state) {
+    const float x = pos.x+1.f+3.f*STREAM_RANDOM(state),z = pos.z+0.25f*(x-pos.x)+2.f*STREAM_RANDOM(state)-1.f;
+    SdfPrimitive* p;
+    int i,k = s->num_primitives-1;
+    float closest = 1.0e30f;
+    for (i=2;i<s->num_primitives;i++) {
+        // The closest one to (x,z)
+        const float dx = s->primitives[i].position[0]-x,dz = s->primitives[i].position[2]-z;
+        if (s->primitives[i].type!=SDF_PRIMITIVE_PLANE && closest>dx*dx+dz*dz) {closest = dx*dx+dz*dz;k = i;}
+    }
+    p = &s->primitives[k];
+    if (editIndex&1) {
+        const SdfPrimitive* prev = &s->primitives[k-1];
+        if (prev->type!=SDF_PRIMITIVE_PLANE) {
+            p->type = SDF_PRIMITIVE_SPHERE;p->op = SDF_OP_SUBTRACT;p->params[0] = 0.15f;
+            p->position[0] = prev->position[0]+0.2f*STREAM_RANDOM(state)-0.1f;
+            p->position[1] = prev->position[1]+0.1f;
+            p->position[2] = prev->position[2]+0.2f*STREAM_RANDOM(state)-0.1f;
+        }
+    }
+    else {
+        p->position[0]+=STREAM_RANDOM(state)-0.5f;
+        p->position[2]+=STREAM_RANDOM(state)-0.5f;
+    }
+    ++s->revision;
+    return vec3(p->position[0],p->position[1],p->position[2]);
+}
+
+static double GetPsnr(const CpuFramebuffer* a,const CpuFramebuffer* b,double* maxError) {
+    const int n = a->width*a->height*3;
+    double mse = 0.0;
+    int i;
+    *maxError = 0.0;
+    for (i=0;i<n;i++) {
+        const double d = fabs((double)a->color[i]-(double)b->color[i]);
+        mse+=d*d;
+        if (*maxError<d) *maxError = d;
+    }
+    mse/=n;
+    return mse>0.0 ? 10.0*log10(1.0/mse) : 999.0;
+}
+
+// Renders fb with the counters (scalar, single-threaded): returns the map() calls per pixel
+static double RenderCounted(CpuRenderer* r,CpuFramebuffer* fb,const SdfBrickMap* brickMap) {
+    CpuRendererCounters c;
+    memset(&c,0,sizeof(c));
+    r->counters = &c;
+    CpuRenderer_SetBrickMap(r,brickMap);
+    CpuRenderer_RenderFrame(r,fb);
+    r->counters = NULL;
+    return (double)c.map_calls/((double)fb->width*(double)fb->height);
+}
+
+// The steps at random points within radius of pos must stay the error bound away from the surfaces
+static int CheckSteps(const SdfBrickMap* m,const CpuRenderer* r,vec3_t pos,float radius,unsigned* state) {
+    const float e = SdfBrickMap_GetErrorBound(m);
+    int i,violations = 0;
+    for (i=0;i<NUM_CHECKED_POINTS;i++) {
+        float p[3],step;
+        p[0] = pos.x+radius*(2.f*STREAM_RANDOM(state)-1.f);
+        p[1] = 1.6f*STREAM_RANDOM(state);
+        p[2] = pos.z+radius*(2.f*STREAM_RANDOM(state)-1.f);
+        step = SdfBrickMap_GetStep(m,p);
+        if (step>0.f && MapWorld(p,(void*)r)-step<0.99f*e) ++violations;
+    }
+    return violations;
+}
+
+// The center distances after the edits must not be bigger than the ones of a brick map created from scratch (smaller
+// ones are safe, e.g. the ones of bricks out of reach of the BVH culling of an edit). Returns the number of stale bricks
+static int CompareWithNewBrickMap(const SdfBrickMap* m,CpuRenderer* r,CpuScheduler* scheduler,const float* bmin,const float* bmax,double* createMs) {
+    const float e = SdfBrickMap_GetErrorBound(m);
+    SdfBrickMap n;
+    unsigned long long startNs;
+    int i,stale = 0,surface = 0;
+    SdfBrickMap_Init(&n);
+    startNs = CpuScheduler_GetTimeNs();
+    if (!SdfBrickMap_Create(&n,bmin,bmax,m->brick_size,SDF_BRICK_SAMPLES*2,&MapWorld,r,scheduler)) {fprintf(stderr,"Out of memory\n");return -1;}
+    *createMs = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6;
+    for (i=0;i<n.num_bricks;i++) {
+        if (m->center_distances[i]>n.center_distances[i]+0.1f*e) ++stale;
+        if ((m->brick_flags[i]^n.brick_flags[i])&SDF_BRICK_FLAG_SURFACE) ++surface;
+    }
+    printf("Compared with a new brick map: %d stale bricks, %d different surface flags (%d and %d surface bricks)\n",stale,surface,
+           m->num_surface_bricks,n.num_surface_bricks);
+    SdfBrickMap_Destroy(&n);
+    return stale;
+}
+
+static int PrintTable(const StreamArgs* a,CpuRenderer* r,CpuScheduler* scheduler,const float* bmin,const float* bmax) {
+    static const float brickSizes[] = {0.1f,0.175f,0.35f,0.7f,1.4f};
+    const int numBrickSizes = (int)(sizeof(brickSizes)/sizeof(brickSizes[0]));
+    CpuFramebuffer exact,fb;
+    SdfBrickMap m;
+    vec3_t pos;
+    double exactCalls;
+    int i;
+    if (!CpuFramebuffer_Create(&exact,a->width,a->height) || !CpuFramebuffer_Create(&fb,a->width,a->height)) {fprintf(stderr,"Out of memory\n");return 1;}
+    SdfBrickMap_Init(&m);
+    pos = GetCameraPosition(a,a->flight_length,0);
+    SetCamera(r,a,pos);
+    exactCalls = RenderCounted(r,&exact,NULL);
+    printf("Exact map(): %.1f map()/pixel\n",exactCalls);
+    printf("%6s %7s %9s %9s %10s %10s %10s %7s %8s %9s %12s %8s\n","Brick","Voxel","Bricks","Surface","Sparse KB","Index KB","Dense KB",
+           "Dense/","Error","Bake ms","map()/pixel","PSNR");
+    for (i=0;i<numBrickSizes;i++) {
+        size_t atlasBytes,indirectionBytes,denseBytes;
+        double calls,psnr,maxError;
+        unsigned long long startNs;
+        // Classify once to know how many surface bricks there are, then make all of them resident
+        if (!SdfBrickMap_Create(&m,bmin,bmax,brickSizes[i],1,&MapWorld,r,scheduler) ||
+            !SdfBrickMap_Create(&m,bmin,bmax,brickSizes[i],(size_t)m.num_surface_bricks*SDF_BRICK_SAMPLES*2,&MapWorld,r,scheduler)) {
+            fprintf(stderr,"Out of memory\n");break;
+        }
+        startNs = CpuScheduler_GetTimeNs();
+        {
+            const float p[3] = {0.f,0.f,0.f};
+            SdfBrickMap_Update(&m,p,1.0e6f,0,&MapWorld,r,scheduler);
+        }
+        SdfBrickMap_GetMemoryUsage(&m,&atlasBytes,&indirectionBytes);
+        denseBytes = SdfBrickMap_GetDenseMemoryUsage(&m);
+        calls = RenderCounted(r,&fb,&m);
+        psnr = GetPsnr(&exact,&fb,&maxError);
+        printf("%6.3f %7.4f %9d %9d %10.1f %10.1f %10.1f %6.1fx %8.4f %9.1f %12.1f %8.1f\n",m.brick_size,m.brick_size/(SDF_BRICK_SIZE-1),
+               m.num_bricks,m.num_surface_bricks,atlasBytes/1024.0,indirectionBytes/1024.0,denseBytes/1024.0,
+               (double)denseBytes/(double)(atlasBytes+indirectionBytes),SdfBrickMap_GetErrorBound(&m),
+               (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6,calls,psnr);
+    }
+    SdfBrickMap_Destroy(&m);
+    CpuFramebuffer_Destroy(&fb);
+    CpuFramebuffer_Destroy(&exact);
+    return 0;
+}
+
+int main(int argc,char* argv[]) {
+    StreamArgs args;
+    CpuRenderer r;
+    SdfScene scene;
+    SdfBvh bvh;
+    SdfScene before;            // the world before the edits of the frame
+    SdfBrickMap m;
+    CpuFramebuffer exact,fb;
+    CpuScheduler* scheduler = NULL;
+    float bmin[3],bmax[3];
+    double sumBrickCalls = 0.0,sumExactCalls = 0.0,minPsnr = 999.0,sumBakeMs = 0.0,createMs,sumEditMs = 0.0,maxEditMs = 0.0;
+    int i,j,totalBaked = 0,totalEvicted = 0,totalViolations = 0,maxResident = 0,result = 0,totalDirty = 0,totalRebaked = 0,stale = 0;
+    unsigned state = 1u,editState = 7u;
+    unsigned long long startNs;
+    size_t atlasBytes,indirectionBytes;
+
+    if (!ParseArgs(&args,argc,argv)) {PrintUsage(argv[0]);return 1;}
+    SdfScene_Init(&scene);
+    SdfScene_Init(&before);
+    SdfBvh_Init(&bvh);
+    SdfBrickMap_Init(&m);
+    if (!SdfScene_SetRandom(&scene,args.num_objects,1)) {fprintf(stderr,"Out of memory\n");return 1;}
+    for (i=0;i<scene.num_primitives;i++) {
+        // The distance of the ellipsoids is an underestimate, and the BVH culls it (or not) depending on the distance of
+        // the other objects: map() wouldn't be 1-Lipschitz, so the steps couldn't be checked against it
+        SdfPrimitive* p = &scene.primitives[i];
+        if (p->type==SDF_PRIMITIVE_ELLIPSOID) {p->type = SDF_PRIMITIVE_SPHERE;p->params[0] = p->params[2];}
+    }
+    if (!SdfBvh_Build(&bvh,&scene)) {fprintf(stderr,"Out of memory\n");return 1;}
+    SdfBake_GetSceneBounds(&scene,0.5f,bmin,bmax);
+    if (bmax[1]<1.6f) bmax[1] = 1.6f;  // the camera flies above the objects: up to the top of the bounding volume of castRay()
+    if (args.flight_length<=0.f) args.flight_length = (bmax[0]-bmin[0])-2.f;
+    scheduler = CpuScheduler_Create(args.num_threads);
+
+    CpuRenderer_Init(&r);
+    CpuRenderer_SetScene(&r,&scene);
+    CpuRenderer_SetSceneBvh(&r,&bvh);
+    r.settings.isa = CPU_RENDERER_ISA_SCALAR;
+    CpuRenderer_SetProjectionUniforms(&r,0.075f,20.f,45.f,(float)args.width/(float)args.height);
+    printf("World: %d primitives, %.1fx%.1fx%.1f units\n",scene.num_primitives,bmax[0]-bmin[0],bmax[1]-bmin[1],bmax[2]-bmin[2]);
+    if (args.table) {
+        result = PrintTable(&args,&r,scheduler,bmin,bmax);
+        CpuScheduler_Destroy(scheduler);
+        SdfBvh_Destroy(&bvh);
+        SdfScene_Destroy(&scene);
+        return result;
+    }
+
+    startNs = CpuScheduler_GetTimeNs();
+    if (!SdfBrickMap_Create(&m,bmin,bmax,args.brick_size,(size_t)args.budget_kb*1024,&MapWorld,&r,scheduler) ||
+        !CpuFramebuffer_Create(&exact,args.width,args.height) || !CpuFramebuffer_Create(&fb,args.width,args.height)) {
+        fprintf(stderr,"Out of memory\n");return 1;
+    }
+    createMs = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6;
+    SdfBrickMap_GetMemoryUsage(&m,&atlasBytes,&indirectionBytes);
+    printf("Brick map: %dx%dx%d bricks of %.3f, %d surface bricks (%.1f KB), budget: %d slots (%.1f KB of atlas + %.1f KB of indirection), created in %.1f ms\n",
+           m.resolution[0],m.resolution[1],m.resolution[2],m.brick_size,m.num_surface_bricks,
+           (double)m.num_surface_bricks*SDF_BRICK_SAMPLES*2/1024.0,m.num_slots,atlasBytes/1024.0,indirectionBytes/1024.0,createMs);
+    printf("Flight: %.1f units in %d frames, radius %.1f, %dx%d, %d bake threads, %d edits per frame\n",args.flight_length,args.num_frames,
+           args.radius,args.width,args.height,CpuScheduler_GetNumThreads(scheduler),args.edits);
+    printf("%5s %9s %9s %7s %7s %7s %7s %9s %7s %7s %8s %9s %9s %8s %7s\n","Frame","Requested","Resident","Baked","Evicted","Missed","Unsafe",
+           "Bake ms","Dirty","Rebaked","Edit ms","map()/px","exact","PSNR","Max err");
+    for (i=0;i<args.num_frames;i++) {
+        const vec3_t pos = GetCameraPosition(&args,args.flight_length,i);
+        float p[3];
+        double brickCalls,exactCalls,psnr,maxError,editMs = 0.0;
+        int violations,dirty = 0,rebaked = 0;
+        p[0] = pos.x;p[1] = pos.y;p[2] = pos.z;
+        SdfBrickMap_Update(&m,p,args.radius,args.max_bakes,&MapWorld,&r,scheduler);
+        violations = CheckSteps(&m,&r,pos,args.radius,&state);
+        for (j=0;j<args.edits;j++) {
+            // A live edit: the bricks it can reach are evaluated again before the frame is rendered
+            vec3_t editPos;
+            if (!SdfScene_Copy(&before,&scene)) {fprintf(stderr,"Out of memory\n");return 1;}
+            editPos = EditWorld(&scene,pos,i*args.edits+j,&editState);
+            if (!SdfBvh_Build(&bvh,&scene)) {fprintf(stderr,"Out of memory\n");return 1;}
+            if (SdfBrickMap_InvalidateSceneChanges(&m,&before,&scene,&MapWorld,&r,scheduler)<0) {fprintf(stderr,"The edit can't be bounded\n");return 1;}
+            dirty+=m.edit_stats.dirty;rebaked+=m.edit_stats.rebaked;editMs+=m.edit_stats.ms;
+            if (maxEditMs<m.edit_stats.ms) maxEditMs = m.edit_stats.ms;
+            violations+=CheckSteps(&m,&r,editPos,1.5f,&state);
+        }
+        SdfBrickMap_ClearChanges(&m);   // (no textures to upload)
+        SetCamera(&r,&args,pos);
+        brickCalls = RenderCounted(&r,&fb,&m);
+        exactCalls = RenderCounted(&r,&exact,NULL);
+        psnr = GetPsnr(&exact,&fb,&maxError);
+        printf("%5d %9d %9d %7d %7d %7d %7d %9.1f %7d %7d %8.2f %9.1f %9.1f %8.1f %7.4f\n",i,m.stats.requested,m.num_resident,m.stats.baked,
+               m.stats.evicted,m.stats.missed,violations,m.stats.bake_ms,dirty,rebaked,editMs,brickCalls,exactCalls,psnr,maxError);
+        totalBaked+=m.stats.baked;totalEvicted+=m.stats.evicted;totalViolations+=violations;sumBakeMs+=m.stats.bake_ms;
+        totalDirty+=dirty;totalRebaked+=rebaked;sumEditMs+=editMs;
+        if (maxResident<m.num_resident) maxResident = m.num_resident;
+        sumBrickCalls+=brickCalls;sumExactCalls+=exactCalls;
+        if (minPsnr>psnr) minPsnr = psnr;
+    }
+    printf("Total: %d bakes (%.1f ms), %d evictions, max %d resident bricks (%.1f%% of the surface bricks), %d unsafe steps\n",
+           totalBaked,sumBakeMs,totalEvicted,maxResident,100.0*maxResident/(m.num_surface_bricks>0 ? m.num_surface_bricks : 1),totalViolations);
+    printf("map()/pixel: %.1f with the brick map, %.1f without (%.2fx), min PSNR %.1f dB\n",sumBrickCalls/args.num_frames,
+           sumExactCalls/args.num_frames,sumExactCalls/(sumBrickCalls>0.0 ? sumBrickCalls : 1.0),minPsnr);
+    if (args.edits>0) {
+        const int numEdits = args.num_frames*args.edits;
+        printf("Edits: %d, %.1f dirty and %.1f baked again per edit, %.2f ms per edit (max %.2f ms, 16.7 ms at 60 Hz)\n",numEdits,
+               (double)totalDirty/numEdits,(double)totalRebaked/numEdits,sumEditMs/numEdits,maxEditMs);
+        stale = CompareWithNewBrickMap(&m,&r,scheduler,bmin,bmax,&createMs);
+        printf("A new brick map: %.1f ms (and every resident brick baked again)\n",createMs);
+    }
+    if (totalViolations>0 || maxResident>m.num_slots || stale!=0) {printf("FAILED\n");result = 1;}
+    else printf("OK\n");
+
+    CpuScheduler_Destroy(scheduler);
+    CpuFramebuffer_Destroy(&fb);
+    CpuFramebuffer_Destroy(&exact);
+    SdfBrickMap_Destroy(&m);
+    SdfBvh_Destroy(&bvh);
+    SdfScene_Destroy(&before);
+    SdfScene_Destroy(&scene);
+    return result;
+}
@@ -0,0 +1,195 @@
+#ifndef CAMERA_PATH_H_
+#define CAMERA_PATH_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only camera/light script for reproducible fly-throughs
+ * (used by the offline renderer and by the benchmark mode of the demo).
+ * A path is a list of keys (time, camera position, camera target, light direction):
+ * positions and targets are interpolated with Catmull-Rom splines and the light direction linearly.
+ * The camera matrix is built exactly like in main.c (m4_set_translation(...) + m4_look_at_YX(...)).
+*/
+
+/* FILE FORMAT (CameraPath_Load(...)):
+ * One key per line, sorted by time (in seconds):
+ * time   posX posY posZ   targetX targetY targetZ   [lightX lightY lightZ]
+ * The light direction is optional (when missing the one of the previous key is used).
+ * Empty lines and lines starting with '#' or "//" are skipped.
+*/
+
+/* USAGE:
+ * #include "math_3d.h" (with MATH_3D_IMPLEMENTATION defined in one of your .c files), then
+ * define CAMERA_PATH_IMPLEMENTATION in one of your .c files before the inclusion of this file.
+ *
+ * CameraPath path;mat4_t cameraMatrix;vec3_t lightDirection;
+ * CameraPath_Init(&path);
+ * if (CameraPath_Load(&path,"fly.path")!=0) CameraPath_SetDefault(&path);
+ * CameraPath_Evaluate(&path,time,&cameraMatrix,&lightDirection);
+ * CameraPath_Destroy(&path);
+*/
+
+#ifndef MATH_3D_HEADER
+#include "math_3d.h"
+#endif //MATH_3D_HEADER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float time;
+    vec3_t position;
+    vec3_t target;
+    vec3_t light_direction;     // normalized
+} CameraPathKey;
+
+typedef struct {
+    CameraPathKey* keys;
+    int num_keys,capacity;
+} CameraPath;
+
+void CameraPath_Init(CameraPath* p);                            // empty path (CameraPath_Evaluate(...) returns the start camera of the demo)
+void CameraPath_SetDefault(CameraPath* p);                      // replaces the keys with a built-in fly-through around the scene (it starts from the start camera of the demo)
+void CameraPath_Destroy(CameraPath* p);
+void CameraPath_Clear(CameraPath* p);
+int  CameraPath_AddKey(CameraPath* p,float time,vec3_t position,vec3_t target,vec3_t lightDirection);  // returns 0 on failure (out of memory)
+int  CameraPath_Load(CameraPath* p,const char* filePath);       // returns 0 on success, -1 on failure (the path is cleared first)
+int  CameraPath_Save(const CameraPath* p,const char* filePath); // returns 0 on success, -1 on failure
+float CameraPath_GetDuration(const CameraPath* p);              // time of the last key
+void CameraPath_Evaluate(const CameraPath* p,float time,mat4_t* cameraMatrixOut,vec3_t* lightDirectionOut);  // both outputs can be NULL
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CAMERA_PATH_H_
+
+#ifdef CAMERA_PATH_IMPLEMENTATION
+#ifndef CAMERA_PATH_IMPLEMENTATION_GUARD
+#define CAMERA_PATH_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void CameraPath_Init(CameraPath* p) {
+    p->keys = NULL;
+    p->num_keys = p->capacity = 0;
+}
+void CameraPath_Destroy(CameraPath* p) {
+    if (p->keys) free(p->keys);
+    CameraPath_Init(p);
+}
+void CameraPath_Clear(CameraPath* p) {p->num_keys = 0;}
+int CameraPath_AddKey(CameraPath* p,float time,vec3_t position,vec3_t target,vec3_t lightDirection) {
+    CameraPathKey* k;
+    if (p->num_keys==p->capacity) {
+        const int capacity = p->capacity>0 ? p->capacity*2 : 16;
+        CameraPathKey* keys = (CameraPathKey*) realloc(p->keys,capacity*sizeof(CameraPathKey));
+        if (!keys) return 0;
+        p->keys = keys;p->capacity = capacity;
+    }
+    k = &p->keys[p->num_keys++];
+    k->time = time;k->position = position;k->target = target;
+    k->light_direction = v3_norm(lightDirection);
+    return 1;
+}
+void CameraPath_SetDefault(CameraPath* p) {
+    // An orbit around the scene (same target as the demo) that dives closer to the objects half way
+    const vec3_t target = vec3(0.f,-0.4f,0.f);
+    const vec3_t light = vec3(-0.4f,0.7f,-0.6f);
+    const int numKeys = 9;
+    int i;
+    CameraPath_Clear(p);
+    for (i=0;i<numKeys;i++) {
+        const float a = (float)i*(float)(2.0*M_PI)/(float)(numKeys-1);
+        const float radius = 3.75f - 1.25f*sin(a*0.5f);
+        const float height = 1.25f - 0.45f*sin(a*0.5f);
+        CameraPath_AddKey(p,(float)i*1.25f,vec3(radius*sin(a),height,radius*cos(a)),target,light);
+    }
+}
+int CameraPath_Load(CameraPath* p,const char* filePath) {
+    FILE* f = fopen(filePath, "rt");
+    char buf[512];
+    vec3_t light = vec3(-0.4f,0.7f,-0.6f);
+    if (!f) return -1;
+    CameraPath_Clear(p);
+    while (fgets(buf,sizeof(buf),f)) {
+        float t;vec3_t pos,tgt,lig;int n;
+        if (buf[0]=='#' || (buf[0]=='/' && buf[1]=='/')) continue;
+        n = sscanf(buf,"%f %f %f %f %f %f %f %f %f %f",&t,&pos.x,&pos.y,&pos.z,&tgt.x,&tgt.y,&tgt.z,&lig.x,&lig.y,&lig.z);
+        if (n<=0) continue;
+        if (n<7 || (n>7 && n<10)) {fprintf(stderr,"CameraPath_Load(\"%s\"): invalid line: %s",filePath,buf);fclose(f);CameraPath_Clear(p);return -1;}
+        if (n==10) light = lig;
+        if (p->num_keys>0 && t<p->keys[p->num_keys-1].time) {fprintf(stderr,"CameraPath_Load(\"%s\"): keys must be sorted by time\n",filePath);fclose(f);CameraPath_Clear(p);return -1;}
+        if (!CameraPath_AddKey(p,t,pos,tgt,light)) {fclose(f);CameraPath_Clear(p);return -1;}
+    }
+    fclose(f);
+    return p->num_keys>0 ? 0 : -1;
+}
+int CameraPath_Save(const CameraPath* p,const char* filePath) {
+    FILE* f = fopen(filePath, "wt");
+    int i;
+    if (!f) return -1;
+    fprintf(f,"# time   posX posY posZ   targetX targetY targetZ   lightX lightY lightZ\n");
+    for (i=0;i<p->num_keys;i++) {
+        const CameraPathKey* k = &p->keys[i];
+        fprintf(f,"%.4f   %.4f %.4f %.4f   %.4f %.4f %.4f   %.4f %.4f %.4f\n",k->time,
+                k->position.x,k->position.y,k->position.z,k->target.x,k->target.y,k->target.z,
+                k->light_direction.x,k->light_direction.y,k->light_direction.z);
+    }
+    fclose(f);
+    return 0;
+}
+float CameraPath_GetDuration(const CameraPath* p) {return p->num_keys>0 ? p->keys[p->num_keys-1].time : 0.f;}
+
+static vec3_t CameraPath_CatmullRom(vec3_t p0,vec3_t p1,vec3_t p2,vec3_t p3,float t) {
+    const float t2 = t*t, t3 = t2*t;
+    const float w0 = -0.5f*t3 + t2 - 0.5f*t;
+    const float w1 =  1.5f*t3 - 2.5f*t2 + 1.f;
+    const float w2 = -1.5f*t3 + 2.f*t2 + 0.5f*t;
+    const float w3 =  0.5f*t3 - 0.5f*t2;
+    return v3_add(v3_add(v3_muls(p0,w0),v3_muls(p1,w1)),v3_add(v3_muls(p2,w2),v3_muls(p3,w3)));
+}
+void CameraPath_Evaluate(const CameraPath* p,float time,mat4_t* cameraMatrixOut,vec3_t* lightDirectionOut) {
+    vec3_t pos = vec3(0.0f, 1.25f, 3.75f), tgt = vec3(0.f,-0.4f,0.f), lig = v3_norm(vec3(-0.4f, 0.7f, -0.6f));   // start camera of the demo
+    if (p->num_keys==1 || (p->num_keys>1 && time<=p->keys[0].time)) {
+        pos = p->keys[0].position;tgt = p->keys[0].target;lig = p->keys[0].light_direction;
+    }
+    else if (p->num_keys>1 && time>=p->keys[p->num_keys-1].time) {
+        const CameraPathKey* k = &p->keys[p->num_keys-1];
+        pos = k->position;tgt = k->target;lig = k->light_direction;
+    }
+    else if (p->num_keys>1) {
+        const CameraPathKey *k0,*k1,*k2,*k3;
+        float dt,t;
+        int i = 0;
+        while (i+2<p->num_keys && p->keys[i+1].time<=time) ++i;
+        k1 = &p->keys[i];k2 = &p->keys[i+1];
+        k0 = i>0 ? &p->keys[i-1] : k1;
+        k3 = i+2<p->num_keys ? &p->keys[i+2] : k2;
+        dt = k2->time-k1->time;
+        t = dt>0.f ? (time-k1->time)/dt : 1.f;
+        pos = CameraPath_CatmullRom(k0->position,k1->position,k2->position,k3->position,t);
+        tgt = CameraPath_CatmullRom(k0->target,k1->target,k2->target,k3->target,t);
+        lig = v3_norm(v3_lerp(k1->light_direction,k2->light_direction,t));
+    }
+    if (cameraMatrixOut) {
+        *cameraMatrixOut = m4_identity();
+        m4_set_translation(cameraMatrixOut,pos);
+        m4_look_at_YX(cameraMatrixOut,tgt,0.f,0.f);
+    }
+    if (lightDirectionOut) *lightDirectionOut = lig;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CAMERA_PATH_IMPLEMENTATION_GUARD
+#endif //CAMERA_PATH_IMPLEMENTATION
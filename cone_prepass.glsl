@@ -0,0 +1,56 @@
+// Cone pre-pass (included by "signed_distance_shapes.glsl" when CONE_PREPASS or USE_CONE_PREPASS is defined).
+// CONE_PREPASS: main() marches one cone per tile of iConePrepassInfo.x pixels (one fragment of a viewport that many times
+// smaller), from the camera through the corners of the tile: it contains the rays of all its pixels. The cone is empty
+// up to t+s if the distance d at t along its axis covers its cross sections up to t+s: s+(t+s)*tan(angle) <= d. It stops
+// when the steps get shorter than the radius of the cone, and writes the distance it has reached.
+// USE_CONE_PREPASS: castRay() starts from the distance of the tile of the pixel (coneStart) instead of the near plane.
+// The distance is packed in two 8-bit channels (see packDistance(...)).
+
+uniform vec4 iConePrepassInfo;      // .x = tile size (pixels) .yz = 1/pre-pass texture size (texels)
+
+#ifdef USE_CONE_PREPASS
+uniform sampler2D iConePrepass;     // RGBA8 texture, one texel per tile, nearest filtering
+
+float coneStart = 0.0;              // set by main() before render(...)
+
+// The distance of the tile of fragCoord (the rows are bottom-up, like gl_FragCoord)
+float conePrepassStart( in vec2 fragCoord )
+{
+    return unpackDistance( texture2D( iConePrepass, (floor( fragCoord/iConePrepassInfo.x )+0.5)*iConePrepassInfo.yz ).xy );
+}
+#endif //USE_CONE_PREPASS
+
+#ifdef CONE_PREPASS
+void main()
+{
+    float tileSize = iConePrepassInfo.x;
+    // half-angle: its sine is at most the half diagonal of the tile on the near plane over the near plane
+    vec2 halfTile = iProjectionData2.xy*tileSize/iResolution.xy;
+    float sinAngle = min( length( halfTile )*iProjectionData2.z, 0.99 );
+    float cosAngle = sqrt( 1.0-sinAngle*sinAngle );
+    float tanAngle = sinAngle/cosAngle;
+
+    // axis (through the center of the tile): the same as the rays of main() in "signed_distance_shapes.glsl"
+    vec2 p = iProjectionData2.xy * (2.0 * gl_FragCoord.xy*tileSize / iResolution.xy - 1.0);
+    vec3 rdu = normalize( vec3(p.xy,iProjectionData.x));
+    vec3 rd = vec3(
+        iCameraMatrix[0][0]*rdu.x + iCameraMatrix[1][0]*rdu.y + iCameraMatrix[2][0]*rdu.z,
+        iCameraMatrix[0][1]*rdu.x + iCameraMatrix[1][1]*rdu.y + iCameraMatrix[2][1]*rdu.z,
+        iCameraMatrix[0][2]*rdu.x + iCameraMatrix[1][2]*rdu.y + iCameraMatrix[2][2]*rdu.z
+        );
+    vec3 ro = vec3(iCameraMatrix[3][0],iCameraMatrix[3][1],iCameraMatrix[3][2]);
+
+    float tmax = iProjectionData.y;
+    float t = iProjectionData.x*cosAngle;   // (the near plane along the rays at the border of the cone)
+    for( int i=0; i<RAYCAST_ITERATIONS; i++ )
+    {
+        float radius = t*tanAngle;
+        float stepLength = (map( ro+rd*t ).x-radius)/(1.0+tanAngle);
+        if( stepLength<radius ) break;
+        t += stepLength;
+        if( t>tmax ) { t = tmax; break; }
+    }
+
+    gl_FragColor = packDistance( t );
+}
+#endif //CONE_PREPASS
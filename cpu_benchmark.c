@@ -0,0 +1,611 @@
+// Benchmark of the CPU reference renderer ("cpu_renderer.h"): no OpenGL needed.
+// It renders the default scene of the demo (same camera and light as main.c) with every instruction set
+// supported by the CPU (see CpuRendererIsa) and reports the primary rays per second of each of them.
+// The scene can be the built-in map(), the same scene interpreted as data (SdfScene), walked through a bounding
+// volume hierarchy (SdfBvh) or a uniform grid (SdfGrid), or compiled by the scene compiler ("sdf_scene_compiled.h"):
+// "-s all" compares them (and the build times of the BVH and of the grid).
+// "-n <count>" replaces the data scene with a random one (SdfScene_SetRandom(...)), and "-c" counts the map() work per pixel.
+// "-r <omega>" compares the over-relaxed sphere tracing (CpuRendererSettings::raycast_over_relaxation) with the plain one:
+// castRay() steps per ray, time per frame and PSNR against a reference frame (plain, with NUM_REFERENCE_ITERATIONS steps
+// and a REFERENCE_PRECISION_SCALE times smaller RAYCAST_PRECISION: with the same one, its hits would be exactly the ones of
+// the plain marcher wherever that one converges, and the error of the over-relaxed one would be only the difference).
+// "-p <tile>" compares the frames without and with the cone pre-pass (CpuConePrepass) of tiles of tile*tile pixels:
+// castRay() and cone steps per pixel, time per frame (pre-pass included) and PSNR between the two.
+// "-T <fraction>" compares the frames of the built-in fly-through (CameraPath_SetDefault(...) at 60 fps, like the benchmark mode
+// of the demo) without and with the temporal depth reuse (CpuTemporalDepth): castRay() steps per pixel, rays starting from the
+// near plane, time per frame and the average PSNR between the two.
+// "-d" compares the forward frames with the deferred ones (CpuGBuffer: a visibility pass, then a shading pass): time of
+// each pass, time per frame and PSNR between the two (one sample per pixel: AA is ignored). The deferred frames are also
+// rendered with the ambient occlusion and the soft shadows at half and quarter resolution (CpuGBuffer_SetOcclusionDivisor(...)):
+// time of the low-resolution pass, time saved against the full resolution, PSNR against the forward and the full resolution
+// frames, and the fraction of the pixels whose terms couldn't be upsampled (no sample on the same surface).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+
+#define CPU_SCHEDULER_IMPLEMENTATION
+#define CPU_RENDERER_IMPLEMENTATION
+#include "cpu_renderer.h"
+
+#define SDF_SCENE_IMPLEMENTATION
+#include "sdf_scene.h"
+#define SDF_BVH_IMPLEMENTATION
+#include "sdf_bvh.h"
+#define SDF_GRID_IMPLEMENTATION
+#include "sdf_grid.h"
+#define CAMERA_PATH_IMPLEMENTATION
+#include "camera_path.h"
+
+#define NUM_MEASURED_BUILDS (5)     // the build times of the BVH and of the grid are averaged over NUM_MEASURED_BUILDS builds
+#define NUM_REFERENCE_ITERATIONS (2048) // castRay() steps of the reference frame of "-r"...
+#define REFERENCE_PRECISION_SCALE (0.1f) // ...and its RAYCAST_PRECISION scale
+#define FLY_THROUGH_TIME_STEP (1.f/60.f)    // time between the frames of "-T"
+
+typedef struct {
+    int width,height;
+    int num_frames;
+    int num_warmup_frames;
+    int num_threads;        // 0 = all the hardware threads, 1 = single-threaded (no thread pool)
+    int isa;                // CPU_RENDERER_ISA_AUTO = all the supported ones
+    int original_quality;   // CpuRendererSettings_InitOriginal(...) instead of CpuRendererSettings_Init(...)
+    int aa;
+    int scene;              // BenchmarkScene (or -1 = all of them)
+    const char* scene_file; // for BENCHMARK_SCENE_DATA, BENCHMARK_SCENE_BVH and BENCHMARK_SCENE_GRID (NULL = SdfScene_SetDefault(...))
+    int num_random_primitives;  // >0 = SdfScene_SetRandom(...) instead of scene_file
+    int count;              // counts the map() work per pixel instead of measuring the time
+    float over_relaxation;  // >1 = compares the over-relaxed sphere tracing (omega) with the plain one instead
+    int cone_prepass_tile;  // >0 = compares the frames without and with the cone pre-pass (tiles of this size) instead
+    float temporal_depth;   // >0 = compares the fly-through without and with the temporal depth reuse (this fraction) instead
+    int deferred;           // compares the forward frames with the deferred ones (CpuGBuffer) instead
+} BenchmarkArgs;
+
+typedef enum {
+    BENCHMARK_SCENE_BUILT_IN = 0,   // the hand-written map()
+    BENCHMARK_SCENE_DATA,           // SdfScene interpreter (CpuRenderer_SetScene(...))
+    BENCHMARK_SCENE_BVH,            // the same SdfScene walked through its SdfBvh (CpuRenderer_SetSceneBvh(...))
+    BENCHMARK_SCENE_GRID,           // the same SdfScene through its SdfGrid (CpuRenderer_SetSceneGrid(...))
+    BENCHMARK_SCENE_COMPILED,       // the map() generated by the scene compiler (CpuRenderer::compiled_scene)
+    BENCHMARK_SCENE_COUNT
+} BenchmarkScene;
+static const char* const BenchmarkSceneNames[BENCHMARK_SCENE_COUNT] = {"built-in","data","bvh","grid","compiled"};
+
+static void PrintUsage(const char* exe) {
+    printf("Usage: %s [options]\n",exe);
+    printf("  -w <width>      (default: 640)\n");
+    printf("  -h <height>     (default: 360)\n");
+    printf("  -f <frames>     number of measured frames per instruction set (default: 10)\n");
+    printf("  -W <frames>     number of warmup frames per instruction set (default: 1)\n");
+    printf("  -t <threads>    0 = all the hardware threads (default: 1)\n");
+    printf("  -i <isa>        sse4.1, avx2, avx512 (default: all the supported ones; scalar is always measured as baseline)\n");
+    printf("  -q              original quality settings (USE_CUSTOM_SETTINGS not defined in the shader)\n");
+    printf("  -a <aa>         AA (AA*AA rays per pixel, default: 1)\n");
+    printf("  -s <scene>      built-in (default), data (interpreted SdfScene), bvh (SdfScene with a bounding volume hierarchy),\n");
+    printf("                  grid (SdfScene with a uniform grid), compiled (\"sdf_scene_compiled.h\") or all\n");
+    printf("  -l <file>       scene file of the data, bvh and grid scenes (default: the scene of the demo)\n");
+    printf("  -n <count>      random data, bvh and grid scene of count primitives (instead of -l)\n");
+    printf("  -c              counts the map() calls, primitive evaluations and BVH node visits per pixel (one scalar\n");
+    printf("                  single-threaded frame per scene) instead of measuring the time (default scenes: data, bvh and grid)\n");
+    printf("  -r <omega>      compares the over-relaxed sphere tracing (omega in (1,2), e.g. 1.2) with the plain one: castRay()\n");
+    printf("                  steps per ray, ms/frame (-i instruction set) and PSNR against a converged frame\n");
+    printf("  -p <tile>       compares the frames without and with the cone pre-pass of tiles of tile*tile pixels (e.g. 8 or 16):\n");
+    printf("                  castRay() and cone steps per pixel, ms/frame (-i instruction set) and PSNR between the two\n");
+    printf("  -T <fraction>   compares the frames (-f) of the built-in fly-through without and with the temporal depth reuse\n");
+    printf("                  (the rays start from fraction times the reprojected distance, e.g. 0.9): castRay() steps per pixel,\n");
+    printf("                  rays from the near plane per pixel, ms/frame (-i instruction set) and average PSNR between the two\n");
+    printf("  -d              compares the forward frames with the deferred ones (G-buffer, then shading; AA 1): ms of the\n");
+    printf("                  visibility and of the shading pass, ms/frame (-i instruction set) and PSNR between the two;\n");
+    printf("                  then with AO and soft shadows at 1/2 and 1/4 resolution (bilateral upsampling): ms of that pass,\n");
+    printf("                  saving and PSNR against the full resolution, pixels that fall back to the full resolution terms\n");
+}
+
+static int ParseArgs(BenchmarkArgs* a,int argc,char* argv[]) {
+    int i,sceneGiven = 0;
+    a->width = 640;a->height = 360;
+    a->num_frames = 10;a->num_warmup_frames = 1;
+    a->num_threads = 1;
+    a->isa = CPU_RENDERER_ISA_AUTO;
+    a->original_quality = 0;
+    a->aa = 1;
+    a->scene = BENCHMARK_SCENE_BUILT_IN;
+    a->scene_file = NULL;
+    a->num_random_primitives = 0;
+    a->count = 0;
+    a->over_relaxation = 0.f;
+    a->cone_prepass_tile = 0;
+    a->temporal_depth = 0.f;
+    a->deferred = 0;
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (strcmp(arg,"-q")==0) {a->original_quality = 1;continue;}
+        if (strcmp(arg,"-c")==0) {a->count = 1;continue;}
+        if (strcmp(arg,"-d")==0) {a->deferred = 1;continue;}
+        if (strcmp(arg,"--help")==0) return 0;
+        if (!val || arg[0]!='-' || arg[1]=='\0' || arg[2]!='\0') {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        switch (arg[1]) {
+        case 'w': a->width = atoi(val);break;
+        case 'h': a->height = atoi(val);break;
+        case 'f': a->num_frames = atoi(val);break;
+        case 'W': a->num_warmup_frames = atoi(val);break;
+        case 't': a->num_threads = atoi(val);break;
+        case 'a': a->aa = atoi(val);break;
+        case 'l': a->scene_file = val;break;
+        case 'n': a->num_random_primitives = atoi(val);break;
+        case 'r': a->over_relaxation = (float) atof(val);break;
+        case 'p': a->cone_prepass_tile = atoi(val);break;
+        case 'T': a->temporal_depth = (float) atof(val);break;
+        case 's': {
+            int scene;
+            for (scene=0;scene<BENCHMARK_SCENE_COUNT;scene++) {
+                if (strcmp(val,BenchmarkSceneNames[scene])==0) break;
+            }
+            if (scene==BENCHMARK_SCENE_COUNT && strcmp(val,"all")!=0) {fprintf(stderr,"Unknown scene: %s\n",val);return 0;}
+            a->scene = scene<BENCHMARK_SCENE_COUNT ? scene : -1;
+            sceneGiven = 1;
+        }
+        break;
+        case 'i': {
+            int isa;
+            for (isa=CPU_RENDERER_ISA_SCALAR;isa<CPU_RENDERER_ISA_COUNT;isa++) {
+                if (strcmp(val,CpuRenderer_GetIsaName(isa))==0) break;
+            }
+            if (isa==CPU_RENDERER_ISA_COUNT) {fprintf(stderr,"Unknown instruction set: %s\n",val);return 0;}
+            a->isa = isa;
+        }
+        break;
+        default: fprintf(stderr,"Invalid argument: %s\n",arg);return 0;
+        }
+        ++i;
+    }
+    if (a->width<=0 || a->height<=0 || a->num_frames<=0 || a->num_warmup_frames<0 || a->num_threads<0 || a->aa<1 || a->cone_prepass_tile<0 ||
+        (a->over_relaxation!=0.f && (a->over_relaxation<=1.f || a->over_relaxation>=2.f))) {
+        fprintf(stderr,"Invalid argument values\n");
+        return 0;
+    }
+    if (a->count) {
+        // Only the SdfScene modes count the primitives and the nodes they visit
+        if (!sceneGiven) a->scene = -1;
+        else if (a->scene==BENCHMARK_SCENE_BUILT_IN || a->scene==BENCHMARK_SCENE_COMPILED) {
+            fprintf(stderr,"The map() work of the %s scene can't be counted (-c): use -s data, bvh, grid or all\n",BenchmarkSceneNames[a->scene]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void RenderFrame(const CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler) {
+    if (scheduler) CpuRenderer_RenderFrameTiled(r,fb,scheduler,0);
+    else CpuRenderer_RenderFrame(r,fb);
+}
+
+// The scenes of BenchmarkScene (the BVH and the grid are built by main() only when they're selected)
+typedef struct {
+    SdfScene scene;
+    SdfBvh bvh;
+    SdfGrid grid;
+} BenchmarkScenes;
+
+static void SetScene(CpuRenderer* r,BenchmarkScenes* scenes,int sc) {
+    CpuRenderer_SetScene(r,sc==BENCHMARK_SCENE_DATA ? &scenes->scene : NULL);
+    CpuRenderer_SetSceneBvh(r,sc==BENCHMARK_SCENE_BVH ? &scenes->bvh : NULL);
+    CpuRenderer_SetSceneGrid(r,sc==BENCHMARK_SCENE_GRID ? &scenes->grid : NULL);
+    r->compiled_scene = (sc==BENCHMARK_SCENE_COMPILED);
+}
+
+// A mode of the benchmark ("-r", "-p", "-T", "-d", "-c") on the current scene of r. Returns 0 on failure (out of memory)
+typedef int (*BenchmarkSceneFunc)(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName);
+
+// Runs func on every scene selected by "-s", but the ones in skippedScenes (a mask of 1<<BenchmarkScene bits)
+static int ForEachScene(const BenchmarkArgs* args,CpuRenderer* r,BenchmarkScenes* scenes,CpuFramebuffer* fb,CpuScheduler* scheduler,
+                        unsigned skippedScenes,BenchmarkSceneFunc func) {
+    int sc;
+    for (sc=0;sc<BENCHMARK_SCENE_COUNT;sc++) {
+        if ((args->scene>=0 && args->scene!=sc) || (skippedScenes&(1U<<sc))) continue;
+        SetScene(r,scenes,sc);
+        if (!func(args,r,fb,scheduler,BenchmarkSceneNames[sc])) return 0;
+    }
+    return 1;
+}
+
+static double GetMse(const CpuFramebuffer* a,const CpuFramebuffer* b) {
+    const int n = a->width*a->height*3;
+    double mse = 0.0;
+    int i;
+    for (i=0;i<n;i++) {
+        const double d = (double)a->color[i]-(double)b->color[i];
+        mse+=d*d;
+    }
+    return mse/n;
+}
+static double GetPsnrFromMse(double mse) {return mse>0.0 ? 10.0*log10(1.0/mse) : 999.0;}
+static double GetPsnr(const CpuFramebuffer* a,const CpuFramebuffer* b) {return GetPsnrFromMse(GetMse(a,b));}
+
+// "-r": plain and over-relaxed sphere tracing (without and with the best candidate) of the current scene of r (the settings
+// of r are restored on exit)
+static int CompareOverRelaxation(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName) {
+    const CpuRendererSettings settings = r->settings;
+    const double numRays = (double)args->width*(double)args->height*(double)(args->aa*args->aa);
+    CpuFramebuffer reference,plain;
+    CpuRendererCounters c;
+    int pass,i;
+    if (!CpuFramebuffer_Create(&reference,args->width,args->height)) return 0;
+    if (!CpuFramebuffer_Create(&plain,args->width,args->height)) {CpuFramebuffer_Destroy(&reference);return 0;}
+    r->settings.isa = args->isa;
+    r->settings.raycast_over_relaxation = 1.f;
+    r->settings.raycast_iterations = NUM_REFERENCE_ITERATIONS;
+    r->settings.raycast_precision*= REFERENCE_PRECISION_SCALE;
+    RenderFrame(r,&reference,scheduler);
+    for (pass=0;pass<3;pass++) {
+        static const char* const names[3] = {"plain","relaxed","best"};
+        CpuFramebuffer* out = pass==0 ? &plain : fb;
+        long long startNs;
+        double msPerFrame;
+        r->settings = settings;
+        r->settings.raycast_over_relaxation = pass==0 ? 1.f : args->over_relaxation;
+        r->settings.raycast_best_candidate = (pass==2);
+        // steps: one scalar single-threaded frame (the counters are not thread-safe)
+        memset(&c,0,sizeof(c));
+        r->settings.isa = CPU_RENDERER_ISA_SCALAR;
+        r->counters = &c;
+        CpuRenderer_RenderFrame(r,out);
+        r->counters = NULL;
+        r->settings.isa = args->isa;
+        for (i=0;i<args->num_warmup_frames;i++) RenderFrame(r,out,scheduler);
+        startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<args->num_frames;i++) RenderFrame(r,out,scheduler);
+        msPerFrame = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/(double)args->num_frames;
+        printf("%-9s %-7s %5.2f %10.2f %12.2f %12.3f %10.2f",sceneName,names[pass],r->settings.raycast_over_relaxation,
+               (double)c.raycast_steps/numRays,(double)c.map_calls/numRays,msPerFrame,GetPsnr(&reference,out));
+        if (pass>0) printf(" %10.2f",GetPsnr(&plain,out));
+        printf("\n");
+    }
+    r->settings = settings;
+    CpuFramebuffer_Destroy(&plain);
+    CpuFramebuffer_Destroy(&reference);
+    return 1;
+}
+
+// "-p": the current scene of r without and with the cone pre-pass
+static int CompareConePrepass(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName) {
+    const int isa = r->settings.isa;
+    const double numPixels = (double)args->width*(double)args->height;
+    CpuConePrepass prepass;
+    CpuFramebuffer plain;
+    CpuRendererCounters c;
+    int pass,i;
+    if (!CpuConePrepass_Create(&prepass,args->width,args->height,args->cone_prepass_tile)) return 0;
+    if (!CpuFramebuffer_Create(&plain,args->width,args->height)) {CpuConePrepass_Destroy(&prepass);return 0;}
+    r->settings.isa = args->isa;
+    for (pass=0;pass<2;pass++) {
+        CpuFramebuffer* out = pass==0 ? &plain : fb;
+        long long startNs;
+        double msPerFrame;
+        CpuRenderer_SetConePrepass(r,pass==0 ? NULL : &prepass);
+        // steps: one scalar single-threaded frame (the counters are not thread-safe)
+        memset(&c,0,sizeof(c));
+        r->settings.isa = CPU_RENDERER_ISA_SCALAR;
+        r->counters = &c;
+        if (pass>0) CpuRenderer_RenderConePrepass(r,&prepass,NULL);
+        CpuRenderer_RenderFrame(r,out);
+        r->counters = NULL;
+        r->settings.isa = args->isa;
+        for (i=0;i<args->num_warmup_frames;i++) {
+            if (pass>0) CpuRenderer_RenderConePrepass(r,&prepass,scheduler);
+            RenderFrame(r,out,scheduler);
+        }
+        startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<args->num_frames;i++) {
+            if (pass>0) CpuRenderer_RenderConePrepass(r,&prepass,scheduler);
+            RenderFrame(r,out,scheduler);
+        }
+        msPerFrame = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/(double)args->num_frames;
+        printf("%-9s %5d %12.2f %12.3f %12.2f %12.3f",sceneName,pass==0 ? 0 : prepass.tile_size,(double)c.raycast_steps/numPixels,
+               (double)c.cone_prepass_steps/numPixels,(double)c.map_calls/numPixels,msPerFrame);
+        if (pass>0) printf(" %10.2f",GetPsnr(&plain,out));
+        printf("\n");
+    }
+    CpuRenderer_SetConePrepass(r,NULL);
+    r->settings.isa = isa;
+    CpuFramebuffer_Destroy(&plain);
+    CpuConePrepass_Destroy(&prepass);
+    return 1;
+}
+
+// Camera and light of frame i of the fly-through of "-T"
+static void SetFlyThroughFrame(CpuRenderer* r,const BenchmarkArgs* args,const CameraPath* path,int i,CpuTemporalDepth* d) {
+    mat4_t cameraMatrix;
+    vec3_t lightDirection;
+    CameraPath_Evaluate(path,(float)i*FLY_THROUGH_TIME_STEP,&cameraMatrix,&lightDirection);
+    CpuRenderer_SetUniforms(r,args->width,args->height,(float)i*FLY_THROUGH_TIME_STEP,&cameraMatrix,&lightDirection);
+    if (d) CpuTemporalDepth_NextFrame(d,&cameraMatrix);
+}
+
+// "-T": the fly-through of the current scene of r without and with the temporal depth reuse
+static int CompareTemporalDepth(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName) {
+    const int isa = r->settings.isa;
+    const double numPixels = (double)args->width*(double)args->height*(double)args->num_frames;
+    CameraPath path;
+    CpuTemporalDepth depth;
+    CpuFramebuffer plain;
+    CpuRendererCounters c[2];
+    double mse = 0.0;
+    int pass,i;
+    if (!CpuTemporalDepth_Create(&depth,args->width,args->height,args->temporal_depth)) return 0;
+    if (!CpuFramebuffer_Create(&plain,args->width,args->height)) {CpuTemporalDepth_Destroy(&depth);return 0;}
+    CameraPath_Init(&path);
+    CameraPath_SetDefault(&path);
+    // steps and PSNR: scalar single-threaded frames (the counters are not thread-safe), the two passes side by side
+    memset(c,0,sizeof(c));
+    r->settings.isa = CPU_RENDERER_ISA_SCALAR;
+    for (i=0;i<args->num_frames;i++) {
+        SetFlyThroughFrame(r,args,&path,i,&depth);
+        r->counters = &c[0];
+        CpuRenderer_SetTemporalDepth(r,NULL);
+        CpuRenderer_RenderFrame(r,&plain);
+        r->counters = &c[1];
+        CpuRenderer_SetTemporalDepth(r,&depth);
+        CpuRenderer_RenderFrame(r,fb);
+        mse+=GetMse(&plain,fb);
+    }
+    r->counters = NULL;
+    r->settings.isa = args->isa;
+    for (pass=0;pass<2;pass++) {
+        long long startNs;
+        double msPerFrame;
+        CpuRenderer_SetTemporalDepth(r,pass==0 ? NULL : &depth);
+        SetFlyThroughFrame(r,args,&path,0,NULL);
+        for (i=0;i<args->num_warmup_frames;i++) RenderFrame(r,fb,scheduler);
+        CpuTemporalDepth_Reset(&depth);
+        startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<args->num_frames;i++) {
+            SetFlyThroughFrame(r,args,&path,i,pass==0 ? NULL : &depth);
+            RenderFrame(r,fb,scheduler);
+        }
+        msPerFrame = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/(double)args->num_frames;
+        printf("%-9s %8.2f %12.2f %12.3f %12.2f %12.3f",sceneName,pass==0 ? 0.0 : (double)depth.fraction,(double)c[pass].raycast_steps/numPixels,
+               (double)c[pass].temporal_fallbacks/numPixels,(double)c[pass].map_calls/numPixels,msPerFrame);
+        if (pass>0) printf(" %10.2f",GetPsnrFromMse(mse/(double)args->num_frames));    // (of the average error of the frames)
+        printf("\n");
+    }
+    CpuRenderer_SetTemporalDepth(r,NULL);
+    r->settings.isa = isa;
+    CameraPath_Destroy(&path);
+    CpuFramebuffer_Destroy(&plain);
+    CpuTemporalDepth_Destroy(&depth);
+    return 1;
+}
+
+// "-d": the current scene of r rendered forward and deferred, with the occlusion terms at full resolution and at
+// 1/OcclusionDivisors[k] of it (the AA of r is restored on exit)
+static const int OcclusionDivisors[] = {1,2,4};
+#define NUM_OCCLUSION_DIVISORS ((int)(sizeof(OcclusionDivisors)/sizeof(OcclusionDivisors[0])))
+static int CompareDeferred(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName) {
+    const int isa = r->settings.isa, aa = r->settings.aa;
+    const double numPixels = (double)args->width*(double)args->height;
+    CpuGBuffer gbuffer;
+    CpuFramebuffer forward,full;
+    double msPerFrame,fullMsPerFrame = 0.0;
+    int i,k;
+    if (!CpuGBuffer_Create(&gbuffer,args->width,args->height)) return 0;
+    if (!CpuFramebuffer_Create(&forward,args->width,args->height)) {CpuGBuffer_Destroy(&gbuffer);return 0;}
+    if (!CpuFramebuffer_Create(&full,args->width,args->height)) {CpuFramebuffer_Destroy(&forward);CpuGBuffer_Destroy(&gbuffer);return 0;}
+    r->settings.isa = args->isa;
+    r->settings.aa = 1;
+    for (i=0;i<args->num_warmup_frames;i++) RenderFrame(r,&forward,scheduler);
+    {
+        const long long startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<args->num_frames;i++) RenderFrame(r,&forward,scheduler);
+        msPerFrame = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/(double)args->num_frames;
+    }
+    printf("%-9s %-11s %12s %12s %12s %12.3f\n",sceneName,"forward","","","",msPerFrame);
+    for (k=0;k<NUM_OCCLUSION_DIVISORS;k++) {
+        const int divisor = OcclusionDivisors[k];
+        CpuRendererCounters c;
+        long long startNs,gbufferNs = 0,occlusionNs = 0,shadingNs = 0;
+        char name[16];
+        if (!CpuGBuffer_SetOcclusionDivisor(&gbuffer,divisor)) {
+            CpuFramebuffer_Destroy(&full);CpuFramebuffer_Destroy(&forward);CpuGBuffer_Destroy(&gbuffer);
+            return 0;
+        }
+        for (i=0;i<args->num_warmup_frames;i++) {
+            CpuRenderer_RenderGBuffer(r,&gbuffer,scheduler,0);
+            CpuRenderer_RenderGBufferOcclusion(r,&gbuffer,scheduler,0);
+            CpuRenderer_ShadeGBuffer(r,&gbuffer,fb,scheduler,0);
+        }
+        for (i=0;i<args->num_frames;i++) {
+            startNs = CpuScheduler_GetTimeNs();
+            CpuRenderer_RenderGBuffer(r,&gbuffer,scheduler,0);
+            gbufferNs+=CpuScheduler_GetTimeNs()-startNs;
+            startNs = CpuScheduler_GetTimeNs();
+            CpuRenderer_RenderGBufferOcclusion(r,&gbuffer,scheduler,0);
+            occlusionNs+=CpuScheduler_GetTimeNs()-startNs;
+            startNs = CpuScheduler_GetTimeNs();
+            CpuRenderer_ShadeGBuffer(r,&gbuffer,fb,scheduler,0);
+            shadingNs+=CpuScheduler_GetTimeNs()-startNs;
+        }
+        msPerFrame = (double)(gbufferNs+occlusionNs+shadingNs)*1.0e-6/(double)args->num_frames;
+        if (divisor==1) {fullMsPerFrame = msPerFrame;memcpy(full.color,fb->color,sizeof(float)*3*full.width*full.height);}
+        // the pixels whose occlusion terms can't be upsampled: a scalar single-threaded frame (the counters are not thread-safe)
+        memset(&c,0,sizeof(c));
+        if (divisor>1) {
+            CpuFramebuffer counted;
+            if (CpuFramebuffer_Create(&counted,args->width,args->height)) {
+                r->settings.isa = CPU_RENDERER_ISA_SCALAR;
+                r->counters = &c;
+                CpuRenderer_ShadeGBuffer(r,&gbuffer,&counted,NULL,0);
+                r->counters = NULL;
+                r->settings.isa = args->isa;
+                CpuFramebuffer_Destroy(&counted);
+            }
+        }
+        if (divisor==1) sprintf(name,"deferred");
+        else sprintf(name,"deferred/%d",divisor);
+        printf("%-9s %-11s %12.3f %12.3f %12.3f %12.3f %8.1f%% %10.2f %10.2f %12.4f\n",sceneName,name,
+               (double)gbufferNs*1.0e-6/(double)args->num_frames,(double)occlusionNs*1.0e-6/(double)args->num_frames,
+               (double)shadingNs*1.0e-6/(double)args->num_frames,msPerFrame,
+               fullMsPerFrame>0.0 ? 100.0*(fullMsPerFrame-msPerFrame)/fullMsPerFrame : 0.0,
+               GetPsnr(&forward,fb),GetPsnr(&full,fb),(double)c.occlusion_fallbacks/numPixels);
+    }
+    r->settings.isa = isa;
+    r->settings.aa = aa;
+    CpuFramebuffer_Destroy(&full);
+    CpuFramebuffer_Destroy(&forward);
+    CpuGBuffer_Destroy(&gbuffer);
+    return 1;
+}
+
+// "-c": the map() work per pixel of the current scene of r: one scalar single-threaded frame (the counters are not thread-safe)
+static int CountMapWork(const BenchmarkArgs* args,CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,const char* sceneName) {
+    const int isa = r->settings.isa;
+    const double numPixels = (double)args->width*(double)args->height;
+    CpuRendererCounters c;
+    (void)scheduler;
+    memset(&c,0,sizeof(c));
+    r->settings.isa = CPU_RENDERER_ISA_SCALAR;
+    r->counters = &c;
+    CpuRenderer_RenderFrame(r,fb);
+    r->counters = NULL;
+    r->settings.isa = isa;
+    printf("%-9s %14.1f %18.1f %14.1f\n",sceneName,(double)c.map_calls/numPixels,
+           (double)c.primitive_evaluations/numPixels,(double)c.bvh_node_visits/numPixels);
+    return 1;
+}
+
+int main(int argc,char* argv[]) {
+    BenchmarkArgs args;
+    CpuRenderer r;
+    BenchmarkScenes scenes;
+    CpuFramebuffer fb;
+    CpuScheduler* scheduler = NULL;
+    mat4_t cameraMatrix;
+    double scalarMsPerFrame = 0.0;
+    double firstSceneMsPerFrame[CPU_RENDERER_ISA_COUNT];   // (with "-s all": the built-in map() is the reference)
+    int isa,i,sc,ok = 1;
+
+    if (!ParseArgs(&args,argc,argv)) {PrintUsage(argv[0]);return 1;}
+    SdfScene_Init(&scenes.scene);
+    SdfBvh_Init(&scenes.bvh);
+    SdfGrid_Init(&scenes.grid);
+    if (args.num_random_primitives>0) {
+        if (!SdfScene_SetRandom(&scenes.scene,args.num_random_primitives,1)) {fprintf(stderr,"Out of memory\n");return 1;}
+    }
+    else if (args.scene_file ? SdfScene_Load(&scenes.scene,args.scene_file)!=0 : !SdfScene_SetDefault(&scenes.scene)) {
+        fprintf(stderr,"Can't load the scene: %s\n",args.scene_file ? args.scene_file : "(out of memory)");
+        return 1;
+    }
+    if (args.scene<0 || args.scene==BENCHMARK_SCENE_BVH) {
+        const long long startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<NUM_MEASURED_BUILDS;i++) {
+            if (!SdfBvh_Build(&scenes.bvh,&scenes.scene)) {fprintf(stderr,"Out of memory\n");return 1;}
+        }
+        printf("BVH: %d primitives, %d objects (%d unbounded), %d nodes, built in %.3f ms\n",scenes.bvh.num_primitives,scenes.bvh.num_objects,
+               scenes.bvh.num_unbounded_objects,scenes.bvh.num_nodes,(double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/NUM_MEASURED_BUILDS);
+    }
+    if (args.scene<0 || args.scene==BENCHMARK_SCENE_GRID) {
+        const SdfGrid* grid = &scenes.grid;
+        const long long startNs = CpuScheduler_GetTimeNs();
+        for (i=0;i<NUM_MEASURED_BUILDS;i++) {
+            if (!SdfGrid_Build(&scenes.grid,&scenes.scene,0.f,0.f)) {fprintf(stderr,"Out of memory\n");return 1;}
+        }
+        printf("Grid: %d objects (%d unbounded), %dx%dx%d cells of %.3f (margin %.3f), %d entries (max %d per cell, %.1f KB), built in %.3f ms\n",
+               grid->num_objects+grid->num_unbounded_objects,grid->num_unbounded_objects,grid->resolution[0],grid->resolution[1],grid->resolution[2],
+               grid->cell_size,grid->margin,grid->num_cell_objects,grid->max_cell_objects,(double)SdfGrid_GetMemoryUsage(grid)/1024.0,
+               (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6/NUM_MEASURED_BUILDS);
+    }
+    if (!CpuFramebuffer_Create(&fb,args.width,args.height)) {fprintf(stderr,"Out of memory\n");return 1;}
+    if (args.num_threads!=1) scheduler = CpuScheduler_Create(args.num_threads);
+
+    // Same camera and light as the interactive demo (see InitGL() in main.c)
+    CpuRenderer_Init(&r);
+    if (args.original_quality) CpuRendererSettings_InitOriginal(&r.settings);
+    r.settings.aa = args.aa;
+    cameraMatrix = m4_identity();
+    m4_set_translation(&cameraMatrix,vec3(0,1.25f,3.75f));
+    m4_look_at_YX(&cameraMatrix,vec3(0,-0.4f,0),2.f,50.f);
+    CpuRenderer_SetProjectionUniforms(&r,0.075f,20.f,45.f,(float)args.width/(float)args.height);
+    CpuRenderer_SetUniforms(&r,args.width,args.height,0.f,&cameraMatrix,NULL);
+
+    if (args.over_relaxation>1.f) {
+        printf("Resolution: %dx%d AA: %d Quality: %s (%d steps per ray) ISA: %s Threads: %d Frames: %d (+%d warmup)\n",args.width,args.height,
+               args.aa,args.original_quality?"original":"custom",r.settings.raycast_iterations,CpuRenderer_GetIsaName(args.isa),
+               scheduler?CpuScheduler_GetNumThreads(scheduler):1,args.num_frames,args.num_warmup_frames);
+        printf("%-9s %-7s %5s %10s %12s %12s %10s %10s\n","Scene","Marcher","Omega","Steps/ray","map()/ray","ms/frame","PSNR ref","PSNR plain");
+        // (the grid steps are not distances: castRay() never over-relaxes them)
+        ok = ForEachScene(&args,&r,&scenes,&fb,scheduler,1U<<BENCHMARK_SCENE_GRID,&CompareOverRelaxation);
+    }
+    else if (args.cone_prepass_tile>0) {
+        printf("Resolution: %dx%d AA: %d Quality: %s (%d steps per ray) ISA: %s Threads: %d Frames: %d (+%d warmup)\n",args.width,args.height,
+               args.aa,args.original_quality?"original":"custom",r.settings.raycast_iterations,CpuRenderer_GetIsaName(args.isa),
+               scheduler?CpuScheduler_GetNumThreads(scheduler):1,args.num_frames,args.num_warmup_frames);
+        printf("%-9s %5s %12s %12s %12s %12s %10s\n","Scene","Tile","Steps/pixel","Cone/pixel","map()/pixel","ms/frame","PSNR");
+        ok = ForEachScene(&args,&r,&scenes,&fb,scheduler,0,&CompareConePrepass);
+    }
+    else if (args.temporal_depth>0.f) {
+        printf("Resolution: %dx%d AA: %d Quality: %s (%d steps per ray) ISA: %s Threads: %d Frames: %d (fly-through at %.0f fps)\n",args.width,args.height,
+               args.aa,args.original_quality?"original":"custom",r.settings.raycast_iterations,CpuRenderer_GetIsaName(args.isa),
+               scheduler?CpuScheduler_GetNumThreads(scheduler):1,args.num_frames,1.0/FLY_THROUGH_TIME_STEP);
+        printf("%-9s %8s %12s %12s %12s %12s %10s\n","Scene","Fraction","Steps/pixel","Near/pixel","map()/pixel","ms/frame","PSNR");
+        ok = ForEachScene(&args,&r,&scenes,&fb,scheduler,0,&CompareTemporalDepth);
+    }
+    else if (args.deferred) {
+        printf("Resolution: %dx%d AA: 1 Quality: %s (%d steps per ray) ISA: %s Threads: %d Frames: %d (+%d warmup)\n",args.width,args.height,
+               args.original_quality?"original":"custom",r.settings.raycast_iterations,CpuRenderer_GetIsaName(args.isa),
+               scheduler?CpuScheduler_GetNumThreads(scheduler):1,args.num_frames,args.num_warmup_frames);
+        printf("%-9s %-11s %12s %12s %12s %12s %9s %10s %10s %12s\n","Scene","Pipeline","G-buffer ms","Occlusion ms","Shading ms",
+               "ms/frame","Saving","PSNR fwd","PSNR full","Fallbacks/px");
+        ok = ForEachScene(&args,&r,&scenes,&fb,scheduler,0,&CompareDeferred);
+    }
+    else if (args.count) {
+        printf("Resolution: %dx%d AA: %d Quality: %s Primitives: %d\n",args.width,args.height,args.aa,
+               args.original_quality?"original":"custom",scenes.scene.num_primitives);
+        printf("%-9s %14s %18s %14s\n","Scene","map()/pixel","primitives/pixel","nodes/pixel");
+        // (only the SdfScene modes count the primitives and the nodes: see ParseArgs(...))
+        ok = ForEachScene(&args,&r,&scenes,&fb,scheduler,(1U<<BENCHMARK_SCENE_BUILT_IN)|(1U<<BENCHMARK_SCENE_COMPILED),&CountMapWork);
+    }
+    else {
+        printf("Resolution: %dx%d AA: %d Quality: %s Threads: %d Frames: %d (+%d warmup)\n",
+               args.width,args.height,args.aa,args.original_quality?"original":"custom",
+               scheduler?CpuScheduler_GetNumThreads(scheduler):1,args.num_frames,args.num_warmup_frames);
+        if (args.scene<0) printf("%-9s %-8s %5s %12s %12s %9s %12s\n","Scene","ISA","Lanes","ms/frame","Mrays/s","Speedup","vs built-in");
+        else printf("%-9s %-8s %5s %12s %12s %9s\n","Scene","ISA","Lanes","ms/frame","Mrays/s","Speedup");
+        for (sc=0;sc<BENCHMARK_SCENE_COUNT;sc++) {
+            if (args.scene>=0 && args.scene!=sc) continue;
+            SetScene(&r,&scenes,sc);
+            for (isa=CPU_RENDERER_ISA_SCALAR;isa<CPU_RENDERER_ISA_COUNT;isa++) {
+                const double numRays = (double)args.width*(double)args.height*(double)(args.aa*args.aa)*(double)args.num_frames;
+                long long startNs;
+                double elapsedNs,msPerFrame;
+                if (args.isa!=CPU_RENDERER_ISA_AUTO && args.isa!=isa && isa!=CPU_RENDERER_ISA_SCALAR) continue;
+                if (!CpuRenderer_IsIsaSupported(isa)) {printf("%-9s %-8s %5d %12s\n",BenchmarkSceneNames[sc],CpuRenderer_GetIsaName(isa),CpuRenderer_GetIsaPacketWidth(isa),"unsupported");continue;}
+                r.settings.isa = isa;
+                for (i=0;i<args.num_warmup_frames;i++) RenderFrame(&r,&fb,scheduler);
+                startNs = CpuScheduler_GetTimeNs();
+                for (i=0;i<args.num_frames;i++) RenderFrame(&r,&fb,scheduler);
+                elapsedNs = (double)(CpuScheduler_GetTimeNs()-startNs);
+                msPerFrame = elapsedNs*1.0e-6/(double)args.num_frames;
+                if (isa==CPU_RENDERER_ISA_SCALAR) scalarMsPerFrame = msPerFrame;
+                printf("%-9s %-8s %5d %12.3f %12.3f %8.2fx",BenchmarkSceneNames[sc],CpuRenderer_GetIsaName(isa),CpuRenderer_GetIsaPacketWidth(isa),
+                       msPerFrame,numRays*1.0e3/elapsedNs,scalarMsPerFrame/msPerFrame);
+                if (args.scene<0) {
+                    if (sc==0) firstSceneMsPerFrame[isa] = msPerFrame;
+                    printf(" %11.2fx",firstSceneMsPerFrame[isa]/msPerFrame);
+                }
+                printf("\n");
+            }
+        }
+        if (scheduler) CpuScheduler_FprintStats(scheduler,stdout);
+    }
+    if (!ok) fprintf(stderr,"Out of memory\n");
+
+    if (scheduler) CpuScheduler_Destroy(scheduler);
+    CpuFramebuffer_Destroy(&fb);
+    SdfGrid_Destroy(&scenes.grid);
+    SdfBvh_Destroy(&scenes.bvh);
+    SdfScene_Destroy(&scenes.scene);
+    return ok ? 0 : 1;
+}
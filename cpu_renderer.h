@@ -0,0 +1,1463 @@
+#ifndef CPU_RENDERER_H_
+#define CPU_RENDERER_H_
+
+/* LICENSE: The distance functions and the shading code are a port of the ones in
+ * "signed_distance_shapes.glsl" (MIT License, Copyright © 2013 Inigo Quilez).
+ * The rest is MIT license too.
+*/
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only CPU port of "signed_distance_shapes.glsl".
+ * It mirrors the shader function-for-function (map(), castRay(), softshadow(),
+ * calcNormal(), calcAO(), render() and main()), so that the very same scene can be
+ * rendered (and measured) on machines without a GPU.
+ * The quality knobs of the shader (RAYCAST_ITERATIONS, SHADOW_ITERATIONS,
+ * AMBIENT_OCCLUSION_PRECISION, AA, ...) are runtime fields of CpuRendererSettings here.
+ * Only the USE_UNIFORM_CAMERA_MATRIX and USE_UNIFORM_LIGHT_DIRECTION code paths are ported
+ * (they are the ones used by main.c).
+*/
+
+/* USAGE:
+ * #include "math_3d.h" (with MATH_3D_IMPLEMENTATION defined in one of your .c files), then
+ * define CPU_RENDERER_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ * The implementation uses "cpu_scheduler.h": define CPU_SCHEDULER_IMPLEMENTATION in one of your .c files too
+ * (and link with -lpthread on POSIX systems).
+ *
+ * CpuRenderer r;CpuFramebuffer fb;
+ * CpuRenderer_Init(&r);                                            // default settings = USE_CUSTOM_SETTINGS in the shader
+ * CpuFramebuffer_Create(&fb,width,height);
+ * CpuRenderer_SetProjectionUniforms(&r,nearPlane,farPlane,degFov,(float)width/(float)height);
+ * CpuRenderer_SetUniforms(&r,width,height,globalTime,&cameraMatrix,&light_direction);
+ * CpuRenderer_RenderFrame(&r,&fb);                                 // fb.color now holds the gamma corrected RGB output
+ * CpuFramebuffer_Destroy(&fb);
+ *
+ * Multithreaded rendering:
+ * CpuScheduler* s = CpuScheduler_Create(numThreads);               // numThreads<=0 means all the hardware threads
+ * CpuRenderer_RenderFrameTiled(&r,&fb,s,0);                        // tiles are scheduled with work-stealing (0 = default tile size)
+ * CpuScheduler_FprintStats(s,stdout);                              // optional: per-thread busy time
+ * CpuScheduler_Destroy(s);
+ *
+ * SIMD packet tracing:
+ * r.settings.isa = CPU_RENDERER_ISA_AUTO;                          // (default) best of SSE4.1/AVX2/AVX-512 detected at runtime,
+ *                                                                  // or CPU_RENDERER_ISA_SCALAR to trace one ray at a time
+ * Define CPU_RENDERER_NO_SIMD before the implementation to compile only the scalar code path
+ * (the SIMD paths need gcc or clang on x86/x86_64 and are disabled on other compilers/architectures anyway).
+ *
+ * Data-driven scenes:
+ * CpuRenderer_SetScene(&r,&scene);                                 // an SdfScene ("sdf_scene.h") instead of the built-in map(),
+ *                                                                  // like USE_SCENE_TEXTURE in the shader (NULL = built-in map())
+ * r.compiled_scene = 1;                                            // the map() generated by the scene compiler ("sdf_scene_compiled.h"),
+ *                                                                  // like USE_COMPILED_SCENE in the shader (rebuild after compiling a scene)
+ * CpuRenderer_SetSceneBvh(&r,&bvh);                                // an SdfBvh ("sdf_bvh.h") built from an SdfScene: only the objects
+ *                                                                  // closer than the distance found so far are evaluated (USE_SCENE_BVH)
+ * CpuRenderer_SetSceneGrid(&r,&grid);                              // an SdfGrid ("sdf_grid.h") built from an SdfScene: only the objects
+ *                                                                  // of the cell of every point are evaluated (USE_SCENE_GRID)
+ * CpuRenderer_SetBrickMap(&r,&brickMap);                           // an SdfBrickMap ("sdf_brick_map.h") baked from the same map(): castRay()
+ *                                                                  // steps through it far from the surfaces first (USE_SDF_BRICK_MAP)
+ *
+ * Cone pre-pass (CONE_PREPASS and USE_CONE_PREPASS in the shader):
+ * CpuConePrepass p;CpuConePrepass_Create(&p,width,height,8);      // one cone per tile of 8x8 pixels
+ * CpuRenderer_SetConePrepass(&r,&p);
+ * CpuRenderer_RenderConePrepass(&r,&p,s);                          // before every frame (after CpuRenderer_SetUniforms(...)): the rays of
+ * CpuRenderer_RenderFrame(&r,&fb);                                 // every tile start from the distance up to which its cone is empty
+ * CpuConePrepass_Destroy(&p);
+ *
+ * Temporal depth reuse (USE_TEMPORAL_DEPTH in the shader):
+ * CpuTemporalDepth d;CpuTemporalDepth_Create(&d,width,height,0.9f); // the hit distances of the last two frames
+ * CpuRenderer_SetTemporalDepth(&r,&d);
+ * CpuTemporalDepth_NextFrame(&d,&cameraMatrix);                    // before every frame: its rays start from 0.9 times the distance
+ * CpuRenderer_RenderFrame(&r,&fb);                                 // reprojected from the previous one, where it's still empty
+ * CpuTemporalDepth_Reset(&d);                                      // after a cut (or a change of the scene, projection or resolution)
+ * CpuTemporalDepth_Destroy(&d);
+ *
+ * Deferred rendering (DEFERRED_GBUFFER and DEFERRED_SHADING in the shader): one sample per pixel (settings.aa is ignored)
+ * CpuGBuffer g;CpuGBuffer_Create(&g,width,height);
+ * CpuRenderer_RenderGBuffer(&r,&g,s,0);                            // visibility pass: hit distance, material and normal of every pixel
+ * CpuRenderer_ShadeGBuffer(&r,&g,&fb,s,0);                         // shading pass: calcAO(), softshadow() and lighting (the same
+ * CpuGBuffer_Destroy(&g);                                          // output as CpuRenderer_RenderFrame(...) with AA 1)
+ * With the occlusion terms (calcAO() and softshadow()) at a lower resolution (USE_LOW_RES_OCCLUSION in the shader):
+ * CpuGBuffer_SetOcclusionDivisor(&g,2);                            // (2 = half resolution, 4 = quarter resolution, 1 = off)
+ * CpuRenderer_RenderGBuffer(&r,&g,s,0);
+ * CpuRenderer_RenderGBufferOcclusion(&r,&g,s,0);                   // one pixel of every 2x2 block
+ * CpuRenderer_ShadeGBuffer(&r,&g,&fb,s,0);                         // depth and normal-aware (bilateral) upsampling of the terms
+ *
+ * Distance queries (e.g. to bake the distance field of the scene, see "sdf_bake.h"):
+ * float d = CpuRenderer_Map(&r,pos,NULL);                          // the same map() as the renderer (thread-safe without counters)
+ *
+ * Counting the work (e.g. map() calls and primitive evaluations per pixel):
+ * CpuRendererCounters c;memset(&c,0,sizeof(c));
+ * r.counters = &c;r.settings.isa = CPU_RENDERER_ISA_SCALAR;        // only the scalar code path counts (and it's not thread-safe:
+ * CpuRenderer_RenderFrame(&r,&fb);                                 // render with a single thread)
+*/
+
+#ifndef MATH_3D_HEADER
+#include "math_3d.h"
+#endif //MATH_3D_HEADER
+#include "cpu_scheduler.h"
+#include "sdf_scene.h"
+#include "sdf_bvh.h"
+#include "sdf_grid.h"
+#include "sdf_brick_map.h"
+
+typedef enum {
+    CPU_RENDERER_ISA_AUTO = -1,     // the best instruction set supported by the CPU (detected at runtime)
+    CPU_RENDERER_ISA_SCALAR = 0,    // one ray at a time (plain C)
+    CPU_RENDERER_ISA_SSE41,         // packets of 4 rays
+    CPU_RENDERER_ISA_AVX2,          // packets of 8 rays
+    CPU_RENDERER_ISA_AVX512,        // packets of 16 rays
+    CPU_RENDERER_ISA_COUNT
+} CpuRendererIsa;
+
+#ifndef CPU_RENDERER_DEFAULT_TILE_SIZE
+#define CPU_RENDERER_DEFAULT_TILE_SIZE (16)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int raycast_iterations;             // RAYCAST_ITERATIONS
+    float raycast_precision;            // RAYCAST_PRECISION
+    float raycast_over_relaxation;      // RAYCAST_OVER_RELAXATION with RAYCAST_OVER_RELAXED (<=1 = plain sphere tracing; not with scene_grid)
+    int raycast_best_candidate;         // RAYCAST_BEST_CANDIDATE (over-relaxation only): the rays out of iterations end at the point with the smallest error
+    int shadow_iterations;              // SHADOW_ITERATIONS (0 = No shadows)
+    float shadow_hardness;              // SHADOW_HARDNESS
+    int ambient_occlusion_precision;    // AMBIENT_OCCLUSION_PRECISION (0 = No AO)
+    int enable_spe_lighting_component;  // ENABLE_SPE_LIGHTING_COMPONENT
+    int enable_dom_lighting_component;  // ENABLE_DOM_LIGHTING_COMPONENT
+    int enable_bac_lighting_component;  // ENABLE_BAC_LIGHTING_COMPONENT
+    int enable_fre_lighting_component;  // ENABLE_FRE_LIGHTING_COMPONENT
+    int reduce_num_objects;             // REDUCE_NUM_OBJECTS
+    int gamma_correction_using_sqrt;    // GAMMA_CORRECTION_USING_SQRT
+    int aa;                             // AA (AA*AA samples per pixel)
+    int isa;                            // CpuRendererIsa (not in the shader): CPU_RENDERER_ISA_AUTO by default
+} CpuRendererSettings;
+void CpuRendererSettings_Init(CpuRendererSettings* s);          // Same values as USE_CUSTOM_SETTINGS in the shader
+void CpuRendererSettings_InitOriginal(CpuRendererSettings* s);  // Same values as the shader without USE_CUSTOM_SETTINGS (original code by Inigo Quilez)
+
+int CpuRenderer_IsIsaSupported(int isa);        // by both the compiled code and the CPU (CPU_RENDERER_ISA_SCALAR is always supported)
+int CpuRenderer_GetBestIsa(void);               // never returns CPU_RENDERER_ISA_AUTO
+const char* CpuRenderer_GetIsaName(int isa);
+int CpuRenderer_GetIsaPacketWidth(int isa);     // number of rays traced together (1 for CPU_RENDERER_ISA_SCALAR)
+
+typedef struct {
+    unsigned long long map_calls;               // map() calls
+    unsigned long long raycast_steps;           // ... by castRay() (the steps of the primary rays, without the brick map ones)
+    unsigned long long cone_prepass_steps;      // ... by the cone pre-pass
+    unsigned long long temporal_fallbacks;      // rays (with a previous frame) that start from the near plane: disocclusions
+    unsigned long long occlusion_fallbacks;     // hit pixels whose low-resolution occlusion terms can't be upsampled (computed per pixel)
+    unsigned long long primitive_evaluations;   // data-driven scenes (scene, scene_bvh and scene_grid) only
+    unsigned long long bvh_node_visits;         // scene_bvh only
+} CpuRendererCounters;
+
+typedef struct {
+    int tile_size;          // pixels per side of a tile (the cone of a tile contains the rays of all its pixels)
+    int width,height;       // number of tiles (the rows are bottom-up, like gl_FragCoord)
+    float* start;           // width*height distances: every ray of a tile can start from the one of the tile
+} CpuConePrepass;
+int  CpuConePrepass_Create(CpuConePrepass* p,int frameWidth,int frameHeight,int tileSize);    // returns 0 on failure
+void CpuConePrepass_Destroy(CpuConePrepass* p);
+
+#define CPU_TEMPORAL_DEPTH_TILE (4)    // the previous frame is reprojected at tiles of CPU_TEMPORAL_DEPTH_TILE^2 pixels
+typedef struct {
+    int width,height;       // pixels (the same as the frames: the projection must not change either)
+    float fraction;         // the rays start from this fraction of the distance reprojected from the previous frame
+    float* t[2];            // width*height hit distances of the last two frames (bottom-up rows; the far plane = no hit)
+    float* tile_min;        // tiles_x*tiles_y smallest distances of t[!current] per tile (bottom-up rows)
+    int tiles_x,tiles_y;
+    mat4_t camera[2];       // camera matrices of t[0] and t[1]
+    int current;            // t[current] is written by the frame being rendered
+    int num_frames;         // frames started since the last reset (t[!current] is valid if >1)
+} CpuTemporalDepth;
+int  CpuTemporalDepth_Create(CpuTemporalDepth* d,int width,int height,float fraction);    // returns 0 on failure
+void CpuTemporalDepth_Destroy(CpuTemporalDepth* d);
+void CpuTemporalDepth_NextFrame(CpuTemporalDepth* d,const mat4_t* cameraMatrix);        // before every frame (the current one becomes the previous one)
+void CpuTemporalDepth_Reset(CpuTemporalDepth* d);                                       // the next frame has no previous one
+
+typedef struct {
+    CpuRendererSettings settings;
+
+    // Same uniforms as in "signed_distance_shapes.glsl"
+    float iResolution[2];
+    float iGlobalTime;
+    mat4_t iCameraMatrix;
+    float iProjectionData[4];   // .x = near plane .y = far plane .z = tan(fov*0.5) w = aspect ratio
+    float iProjectionData2[4];  // .x=-np*tan(fov*0.5)*ar; .y=np*tan(fov*0.5); .z=1.0/np; .w=1.0/fp-1.0/np;
+    vec3_t iLightDirection;
+
+    const SdfScene* scene;      // NULL = the built-in map() (not owned: it must outlive the renderer)
+    const SdfBvh* scene_bvh;    // NULL = scene is evaluated linearly (not owned: it has precedence over scene and scene_grid)
+    const SdfGrid* scene_grid;  // NULL = scene is evaluated linearly (not owned: it has precedence over scene)
+    int compiled_scene;         // 1 = the map() of "sdf_scene_compiled.h" (it has precedence over scene, scene_bvh and scene_grid)
+    const SdfBrickMap* brick_map;   // NULL = castRay() only steps with map() (not owned: it must be baked from the same map())
+    const CpuConePrepass* cone_prepass; // NULL = castRay() starts from the near plane (not owned: see CpuRenderer_RenderConePrepass(...))
+    CpuTemporalDepth* temporal_depth;   // NULL = no temporal reuse (not owned: the frames write their hit distances to it)
+    CpuRendererCounters* counters;  // NULL = no counting (scalar code path only, not thread-safe)
+} CpuRenderer;
+void CpuRenderer_Init(CpuRenderer* r);
+void CpuRenderer_SetScene(CpuRenderer* r,const SdfScene* scene);
+void CpuRenderer_SetSceneBvh(CpuRenderer* r,const SdfBvh* bvh);
+void CpuRenderer_SetSceneGrid(CpuRenderer* r,const SdfGrid* grid);
+void CpuRenderer_SetBrickMap(CpuRenderer* r,const SdfBrickMap* brickMap);
+void CpuRenderer_SetConePrepass(CpuRenderer* r,const CpuConePrepass* p);
+void CpuRenderer_SetTemporalDepth(CpuRenderer* r,CpuTemporalDepth* d);
+void CpuRenderer_SetProjectionUniforms(CpuRenderer* r,float nearPlane,float farPlane,float degFov,float aspectRatio);
+void CpuRenderer_SetUniforms(CpuRenderer* r,int resX,int resY,float globalTime,const mat4_t* m,const vec3_t* lig_dir);
+
+typedef struct {
+    int width,height;
+    float* color;   // width*height*3 floats in [0,1] (gamma corrected RGB). Rows are stored top-down (row 0 is the top of the image, unlike gl_FragCoord)
+} CpuFramebuffer;
+int  CpuFramebuffer_Create(CpuFramebuffer* fb,int width,int height);   // returns 0 on failure
+void CpuFramebuffer_Destroy(CpuFramebuffer* fb);
+
+typedef struct {
+    int width,height;
+    float* t;           // width*height hit distances (the far plane = no hit). Rows are stored top-down, like CpuFramebuffer
+    float* material;    // width*height materials of map() (-1 = no hit: the sky)
+    float* normal;      // width*height*3 normals (calcNormal() at the hit, 0 = no hit)
+    int occlusion_divisor;                  // 1 = the occlusion terms are computed per pixel by the shading pass (default)
+    int occlusion_width,occlusion_height;   // (width and height divided by occlusion_divisor, rounded up)
+    float* occlusion;   // occlusion_width*occlusion_height*3 occlusion terms (calcAO(), softshadow() of the light and of the reflection)
+                        // of the center pixel of every block of occlusion_divisor^2 pixels (-1 = no hit), NULL when occlusion_divisor is 1
+} CpuGBuffer;
+int  CpuGBuffer_Create(CpuGBuffer* g,int width,int height);    // returns 0 on failure
+int  CpuGBuffer_SetOcclusionDivisor(CpuGBuffer* g,int divisor);    // returns 0 on failure (and the divisor is 1 then)
+void CpuGBuffer_Destroy(CpuGBuffer* g);
+
+float CpuRenderer_Map(const CpuRenderer* r,vec3_t pos,float* material);   // The shader map(): the distance at pos (and its material, if material is not NULL)
+vec3_t CpuRenderer_RenderPixel(const CpuRenderer* r,float fragCoordX,float fragCoordY);   // The shader main(): fragCoord = pixel center (bottom-up, like gl_FragCoord)
+void CpuRenderer_RenderRows(const CpuRenderer* r,CpuFramebuffer* fb,int rowStart,int rowEnd);   // rows in [rowStart,rowEnd) (top-down)
+void CpuRenderer_RenderFrame(const CpuRenderer* r,CpuFramebuffer* fb);
+void CpuRenderer_RenderTile(const CpuRenderer* r,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd);   // pixels in [xStart,xEnd)x[yStart,yEnd) (top-down)
+void CpuRenderer_RenderFrameTiled(const CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,int tileSize); // tileSize<=0 means CPU_RENDERER_DEFAULT_TILE_SIZE
+void CpuRenderer_RenderConePrepass(const CpuRenderer* r,CpuConePrepass* p,CpuScheduler* scheduler);   // marches the cones of the current uniforms (scheduler can be NULL)
+void CpuRenderer_RenderGBufferTile(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd);   // castRay() and calcNormal() of the pixels in [xStart,xEnd)x[yStart,yEnd) (top-down)
+void CpuRenderer_ShadeGBufferTile(const CpuRenderer* r,const CpuGBuffer* g,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd);   // the rest of render() and main() from g
+void CpuRenderer_RenderGBuffer(const CpuRenderer* r,CpuGBuffer* g,CpuScheduler* scheduler,int tileSize);   // the whole G-buffer (scheduler can be NULL; tileSize<=0 means CPU_RENDERER_DEFAULT_TILE_SIZE)
+void CpuRenderer_ShadeGBuffer(const CpuRenderer* r,const CpuGBuffer* g,CpuFramebuffer* fb,CpuScheduler* scheduler,int tileSize);   // the whole frame (g and fb must have the same size)
+void CpuRenderer_RenderGBufferOcclusionTile(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd);   // the occlusion terms of g in [xStart,xEnd)x[yStart,yEnd) (of occlusion_width*occlusion_height)
+void CpuRenderer_RenderGBufferOcclusion(const CpuRenderer* r,CpuGBuffer* g,CpuScheduler* scheduler,int tileSize);   // all of them, between the two passes (nothing when occlusion_divisor is 1)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CPU_RENDERER_H_
+
+#ifdef CPU_RENDERER_IMPLEMENTATION
+#ifndef CPU_RENDERER_IMPLEMENTATION_GUARD
+#define CPU_RENDERER_IMPLEMENTATION_GUARD
+
+#include <stdlib.h> // malloc
+#include <string.h> // memset
+
+#if !defined(CPU_RENDERER_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#   define CPU_RENDERER_HAS_X86_PACKETS
+#   include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void CpuRendererSettings_Init(CpuRendererSettings* s) {
+    s->ambient_occlusion_precision = 0;
+    s->shadow_iterations = 6;
+    s->shadow_hardness = 5.0f;
+    s->raycast_iterations = 28;
+    s->raycast_precision = 0.001f;
+    s->raycast_over_relaxation = 1.0f;
+    s->raycast_best_candidate = 0;
+    s->enable_spe_lighting_component = 0;
+    s->enable_dom_lighting_component = 0;
+    s->enable_bac_lighting_component = 1;
+    s->enable_fre_lighting_component = 1;
+    s->reduce_num_objects = 1;
+    s->gamma_correction_using_sqrt = 0;
+    s->aa = 1;
+    s->isa = CPU_RENDERER_ISA_AUTO;
+}
+void CpuRendererSettings_InitOriginal(CpuRendererSettings* s) {
+    s->ambient_occlusion_precision = 5;
+    s->shadow_iterations = 16;
+    s->shadow_hardness = 8.0f;
+    s->raycast_iterations = 64;
+    s->raycast_precision = 0.0005f;
+    s->raycast_over_relaxation = 1.0f;
+    s->raycast_best_candidate = 0;
+    s->enable_spe_lighting_component = 1;
+    s->enable_dom_lighting_component = 1;
+    s->enable_bac_lighting_component = 1;
+    s->enable_fre_lighting_component = 1;
+    s->reduce_num_objects = 0;
+    s->gamma_correction_using_sqrt = 0;
+    s->aa = 1;
+    s->isa = CPU_RENDERER_ISA_AUTO;
+}
+
+void CpuRenderer_Init(CpuRenderer* r) {
+    memset(r,0,sizeof(CpuRenderer));
+    CpuRendererSettings_Init(&r->settings);
+    r->iCameraMatrix = m4_identity();
+    r->iLightDirection = v3_norm(vec3(-0.4f, 0.7f, -0.6f));
+    CpuRenderer_SetProjectionUniforms(r,0.075f,20.f,45.f,16.f/9.f);
+}
+void CpuRenderer_SetProjectionUniforms(CpuRenderer* r,float nearPlane,float farPlane,float degFov,float aspectRatio) {
+    // Same as MyShaderStuff_SetProjectionUniforms(...) in main.c
+    const float tanFov = tan(degFov*M_PIOVER180*0.5f);
+    r->iProjectionData[0] = nearPlane;r->iProjectionData[1] = farPlane;r->iProjectionData[2] = tanFov;r->iProjectionData[3] = aspectRatio;
+    r->iProjectionData2[0] = -nearPlane*tanFov*aspectRatio;r->iProjectionData2[1] = nearPlane*tanFov;
+    r->iProjectionData2[2] = 1.f/nearPlane;r->iProjectionData2[3] = 1.f/farPlane-1.f/nearPlane;
+}
+void CpuRenderer_SetScene(CpuRenderer* r,const SdfScene* scene) {r->scene = scene;}
+void CpuRenderer_SetSceneBvh(CpuRenderer* r,const SdfBvh* bvh) {r->scene_bvh = bvh;}
+void CpuRenderer_SetSceneGrid(CpuRenderer* r,const SdfGrid* grid) {r->scene_grid = grid;}
+void CpuRenderer_SetBrickMap(CpuRenderer* r,const SdfBrickMap* brickMap) {r->brick_map = brickMap;}
+void CpuRenderer_SetConePrepass(CpuRenderer* r,const CpuConePrepass* p) {r->cone_prepass = p;}
+void CpuRenderer_SetTemporalDepth(CpuRenderer* r,CpuTemporalDepth* d) {r->temporal_depth = d;}
+void CpuRenderer_SetUniforms(CpuRenderer* r,int resX,int resY,float globalTime,const mat4_t* m,const vec3_t* lig_dir) {
+    r->iResolution[0] = (float) resX;r->iResolution[1] = (float) resY;
+    r->iGlobalTime = globalTime;
+    if (m) r->iCameraMatrix = *m;
+    if (lig_dir) r->iLightDirection = *lig_dir;
+}
+
+int CpuFramebuffer_Create(CpuFramebuffer* fb,int width,int height) {
+    fb->width = fb->height = 0;
+    fb->color = NULL;
+    if (width<=0 || height<=0) return 0;
+    fb->color = (float*) malloc(sizeof(float)*3*width*height);
+    if (!fb->color) return 0;
+    memset(fb->color,0,sizeof(float)*3*width*height);
+    fb->width = width;fb->height = height;
+    return 1;
+}
+void CpuFramebuffer_Destroy(CpuFramebuffer* fb) {
+    if (fb->color) free(fb->color);
+    fb->color = NULL;
+    fb->width = fb->height = 0;
+}
+
+int CpuGBuffer_Create(CpuGBuffer* g,int width,int height) {
+    memset(g,0,sizeof(CpuGBuffer));
+    if (width<=0 || height<=0) return 0;
+    g->t = (float*) malloc(sizeof(float)*width*height);
+    g->material = (float*) malloc(sizeof(float)*width*height);
+    g->normal = (float*) malloc(sizeof(float)*3*width*height);
+    if (!g->t || !g->material || !g->normal) {CpuGBuffer_Destroy(g);return 0;}
+    g->width = width;g->height = height;
+    g->occlusion_divisor = 1;
+    return 1;
+}
+int CpuGBuffer_SetOcclusionDivisor(CpuGBuffer* g,int divisor) {
+    if (g->occlusion) {free(g->occlusion);g->occlusion = NULL;}
+    g->occlusion_divisor = 1;g->occlusion_width = g->occlusion_height = 0;
+    if (divisor<=1) return divisor==1 ? 1 : 0;
+    g->occlusion_width = (g->width+divisor-1)/divisor;
+    g->occlusion_height = (g->height+divisor-1)/divisor;
+    g->occlusion = (float*) malloc(sizeof(float)*3*g->occlusion_width*g->occlusion_height);
+    if (!g->occlusion) {g->occlusion_width = g->occlusion_height = 0;return 0;}
+    g->occlusion_divisor = divisor;
+    return 1;
+}
+void CpuGBuffer_Destroy(CpuGBuffer* g) {
+    if (g->t) free(g->t);
+    if (g->material) free(g->material);
+    if (g->normal) free(g->normal);
+    if (g->occlusion) free(g->occlusion);
+    memset(g,0,sizeof(CpuGBuffer));
+}
+
+int CpuConePrepass_Create(CpuConePrepass* p,int frameWidth,int frameHeight,int tileSize) {
+    int i;
+    p->tile_size = p->width = p->height = 0;
+    p->start = NULL;
+    if (frameWidth<=0 || frameHeight<=0 || tileSize<=0) return 0;
+    p->width = (frameWidth+tileSize-1)/tileSize;p->height = (frameHeight+tileSize-1)/tileSize;
+    p->start = (float*) malloc(sizeof(float)*p->width*p->height);
+    if (!p->start) {p->width = p->height = 0;return 0;}
+    for (i=0;i<p->width*p->height;i++) p->start[i] = 0.f;    // (the near plane)
+    p->tile_size = tileSize;
+    return 1;
+}
+void CpuConePrepass_Destroy(CpuConePrepass* p) {
+    if (p->start) free(p->start);
+    p->start = NULL;
+    p->tile_size = p->width = p->height = 0;
+}
+
+int CpuTemporalDepth_Create(CpuTemporalDepth* d,int width,int height,float fraction) {
+    memset(d,0,sizeof(CpuTemporalDepth));
+    if (width<2 || height<2 || fraction<=0.f || fraction>1.f) return 0;
+    d->tiles_x = (width+CPU_TEMPORAL_DEPTH_TILE-1)/CPU_TEMPORAL_DEPTH_TILE;
+    d->tiles_y = (height+CPU_TEMPORAL_DEPTH_TILE-1)/CPU_TEMPORAL_DEPTH_TILE;
+    if (d->tiles_x<2) d->tiles_x = 2;
+    if (d->tiles_y<2) d->tiles_y = 2;
+    d->t[0] = (float*) malloc(sizeof(float)*width*height);
+    d->t[1] = (float*) malloc(sizeof(float)*width*height);
+    d->tile_min = (float*) malloc(sizeof(float)*d->tiles_x*d->tiles_y);
+    if (!d->t[0] || !d->t[1] || !d->tile_min) {CpuTemporalDepth_Destroy(d);return 0;}
+    d->width = width;d->height = height;
+    d->fraction = fraction;
+    return 1;
+}
+void CpuTemporalDepth_Destroy(CpuTemporalDepth* d) {
+    if (d->t[0]) free(d->t[0]);
+    if (d->t[1]) free(d->t[1]);
+    if (d->tile_min) free(d->tile_min);
+    memset(d,0,sizeof(CpuTemporalDepth));
+}
+void CpuTemporalDepth_NextFrame(CpuTemporalDepth* d,const mat4_t* cameraMatrix) {
+    if (d->num_frames>0) {
+        // the frame just rendered becomes the previous one: the smallest distances of its tiles
+        const float* t = d->t[d->current];
+        int tx,ty,x,y;
+        for (ty=0;ty<d->tiles_y;ty++) {
+            for (tx=0;tx<d->tiles_x;tx++) {
+                const int x0 = tx*CPU_TEMPORAL_DEPTH_TILE, y0 = ty*CPU_TEMPORAL_DEPTH_TILE;
+                float m = 1e30f;
+                for (y=y0;y<y0+CPU_TEMPORAL_DEPTH_TILE && y<d->height;y++) {
+                    for (x=x0;x<x0+CPU_TEMPORAL_DEPTH_TILE && x<d->width;x++) {if (t[y*d->width+x]<m) m = t[y*d->width+x];}
+                }
+                d->tile_min[ty*d->tiles_x+tx] = m;
+            }
+        }
+        d->current = !d->current;
+    }
+    d->camera[d->current] = *cameraMatrix;
+    ++d->num_frames;
+}
+void CpuTemporalDepth_Reset(CpuTemporalDepth* d) {d->num_frames = 0;}
+
+// GLSL helpers-------------------------------------------------------------
+typedef struct {float x,y;} cr_vec2_t;
+static __inline cr_vec2_t cr_vec2(float x,float y) {cr_vec2_t v;v.x=x;v.y=y;return v;}
+static __inline float cr_min(float a,float b) {return a<b ? a : b;}
+static __inline float cr_max(float a,float b) {return a>b ? a : b;}
+static __inline float cr_clamp(float x,float a,float b) {return x<a ? a : (x>b ? b : x);}
+static __inline float cr_mix(float a,float b,float t) {return a*(1.f-t)+b*t;}
+static __inline float cr_mod(float x,float y) {return x-y*floorf(x/y);}
+static __inline float cr_smoothstep(float e0,float e1,float x) {float t=cr_clamp((x-e0)/(e1-e0),0.f,1.f);return t*t*(3.f-2.f*t);}
+static __inline float cr_length2d(float x,float y) {return sqrtf(x*x+y*y);}
+static __inline vec3_t cr_v3_abs(vec3_t v) {return vec3(fabsf(v.x),fabsf(v.y),fabsf(v.z));}
+static __inline vec3_t cr_v3_maxs(vec3_t v,float s) {return vec3(cr_max(v.x,s),cr_max(v.y,s),cr_max(v.z,s));}
+static __inline vec3_t cr_v3_reflect(vec3_t i,vec3_t n) {return v3_sub(i,v3_muls(n,2.f*v3_dot(n,i)));}
+
+// Distance functions (same as in "signed_distance_shapes.glsl")------------
+static __inline float cr_sdPlane(vec3_t p) {return p.y;}
+static __inline float cr_sdSphere(vec3_t p,float s) {return v3_length(p)-s;}
+static __inline float cr_sdBox(vec3_t p,vec3_t b) {
+    const vec3_t d = v3_sub(cr_v3_abs(p),b);
+    return cr_min(cr_max(d.x,cr_max(d.y,d.z)),0.f) + v3_length(cr_v3_maxs(d,0.f));
+}
+static __inline float cr_sdEllipsoid(vec3_t p,vec3_t r) {
+    return (v3_length(v3_div(p,r)) - 1.f) * cr_min(cr_min(r.x,r.y),r.z);
+}
+static __inline float cr_udRoundBox(vec3_t p,vec3_t b,float r) {
+    return v3_length(cr_v3_maxs(v3_sub(cr_v3_abs(p),b),0.f))-r;
+}
+static __inline float cr_sdTorus(vec3_t p,cr_vec2_t t) {
+    return cr_length2d(cr_length2d(p.x,p.z)-t.x,p.y)-t.y;
+}
+static __inline float cr_sdHexPrism(vec3_t p,cr_vec2_t h) {
+    const vec3_t q = cr_v3_abs(p);
+    const float d1 = q.z-h.y;
+    const float d2 = cr_max((q.x*0.866025f+q.y*0.5f),q.y)-h.x;
+    return cr_length2d(cr_max(d1,0.f),cr_max(d2,0.f)) + cr_min(cr_max(d1,d2), 0.f);
+}
+static __inline float cr_sdCapsule(vec3_t p,vec3_t a,vec3_t b,float r) {
+    const vec3_t pa = v3_sub(p,a), ba = v3_sub(b,a);
+    const float h = cr_clamp( v3_dot(pa,ba)/v3_dot(ba,ba), 0.f, 1.f );
+    return v3_length( v3_sub(pa,v3_muls(ba,h)) ) - r;
+}
+static __inline float cr_sdTriPrism(vec3_t p,cr_vec2_t h) {
+    const vec3_t q = cr_v3_abs(p);
+    const float d1 = q.z-h.y;
+    const float d2 = cr_max(q.x*0.866025f+p.y*0.5f,-p.y)-h.x*0.5f;
+    return cr_length2d(cr_max(d1,0.f),cr_max(d2,0.f)) + cr_min(cr_max(d1,d2), 0.f);
+}
+static __inline float cr_sdCylinder(vec3_t p,cr_vec2_t h) {
+    const float dx = fabsf(cr_length2d(p.x,p.z)) - h.x;
+    const float dy = fabsf(p.y) - h.y;
+    return cr_min(cr_max(dx,dy),0.f) + cr_length2d(cr_max(dx,0.f),cr_max(dy,0.f));
+}
+static __inline float cr_sdCone(vec3_t p,vec3_t c) {
+    const cr_vec2_t q = cr_vec2( cr_length2d(p.x,p.z), p.y );
+    const float d1 = -q.y-c.z;
+    const float d2 = cr_max( q.x*c.x+q.y*c.y, q.y);
+    return cr_length2d(cr_max(d1,0.f),cr_max(d2,0.f)) + cr_min(cr_max(d1,d2), 0.f);
+}
+static __inline float cr_sdConeSection(vec3_t p,float h,float r1,float r2) {
+    const float d1 = -p.y - h;
+    const float q = p.y - h;
+    const float si = 0.5f*(r1-r2)/h;
+    const float d2 = cr_max( sqrtf( (p.x*p.x+p.z*p.z)*(1.f-si*si)) + q*si - r2, q );
+    return cr_length2d(cr_max(d1,0.f),cr_max(d2,0.f)) + cr_min(cr_max(d1,d2), 0.f);
+}
+static __inline float cr_sdPryamid4(vec3_t p,vec3_t h) {  // h = { cos a, sin a, height }
+    // Tetrahedron = Octahedron - Cube
+    const float box = cr_sdBox( v3_sub(p,vec3(0,-2.f*h.z,0)), vec3(2.f*h.z,2.f*h.z,2.f*h.z) );
+    float d = 0.f,octa;
+    d = cr_max( d, fabsf( v3_dot(p, vec3( -h.x, h.y, 0 )) ));
+    d = cr_max( d, fabsf( v3_dot(p, vec3(  h.x, h.y, 0 )) ));
+    d = cr_max( d, fabsf( v3_dot(p, vec3(  0, h.y, h.x )) ));
+    d = cr_max( d, fabsf( v3_dot(p, vec3(  0, h.y,-h.x )) ));
+    octa = d - h.z;
+    return cr_max(-box,octa); // Subtraction
+}
+static __inline float cr_length2(cr_vec2_t p) {return sqrtf( p.x*p.x + p.y*p.y );}
+static __inline float cr_length6(cr_vec2_t p) {
+    p.x = p.x*p.x*p.x;p.x*=p.x;
+    p.y = p.y*p.y*p.y;p.y*=p.y;
+    return powf( p.x + p.y, 1.f/6.f );
+}
+static __inline float cr_length8(cr_vec2_t p) {
+    p.x*=p.x;p.x*=p.x;p.x*=p.x;
+    p.y*=p.y;p.y*=p.y;p.y*=p.y;
+    return powf( p.x + p.y, 1.f/8.f );
+}
+static __inline float cr_sdTorus82(vec3_t p,cr_vec2_t t) {
+    return cr_length8(cr_vec2(cr_length2(cr_vec2(p.x,p.z))-t.x,p.y))-t.y;
+}
+static __inline float cr_sdTorus88(vec3_t p,cr_vec2_t t) {
+    return cr_length8(cr_vec2(cr_length8(cr_vec2(p.x,p.z))-t.x,p.y))-t.y;
+}
+static __inline float cr_sdCylinder6(vec3_t p,cr_vec2_t h) {
+    return cr_max( cr_length6(cr_vec2(p.x,p.z))-h.x, fabsf(p.y)-h.y );
+}
+
+static __inline float cr_opS(float d1,float d2) {return cr_max(-d2,d1);}
+static __inline cr_vec2_t cr_opU(cr_vec2_t d1,cr_vec2_t d2) {return (d1.x<d2.x) ? d1 : d2;}
+static __inline vec3_t cr_opRep(vec3_t p,vec3_t c) {
+    return vec3(cr_mod(p.x,c.x)-0.5f*c.x,cr_mod(p.y,c.y)-0.5f*c.y,cr_mod(p.z,c.z)-0.5f*c.z);
+}
+static __inline vec3_t cr_opTwist(vec3_t p) {
+    const float c = cosf(10.f*p.y+10.f);
+    const float s = sinf(10.f*p.y+10.f);
+    // mat2(c,-s,s,c)*p.xz (GLSL matrices are column-major)
+    return vec3(c*p.x+s*p.z,-s*p.x+c*p.z,p.y);
+}
+static __inline float cr_smin(float a,float b,float k) {
+    const float h = cr_clamp( 0.5f+0.5f*(b-a)/k, 0.f, 1.f );
+    return cr_mix( b, a, h ) - k*h*(1.f-h);
+}
+
+// Data-driven scene (same as "sdf_scene.glsl")------------------------------
+static __inline int cr_getNumScenePrimitives(const CpuRenderer* r) {
+    const SdfScene* s = r->scene;
+    return (r->settings.reduce_num_objects && s->num_reduced_primitives>=0 && s->num_reduced_primitives<s->num_primitives) ? s->num_reduced_primitives : s->num_primitives;
+}
+static float cr_sdScenePrimitive(int type,vec3_t p,const float* a) {
+    switch (type) {
+    case SDF_PRIMITIVE_PLANE:           return cr_sdPlane(p);
+    case SDF_PRIMITIVE_SPHERE:          return cr_sdSphere(p,a[0]);
+    case SDF_PRIMITIVE_BOX:             return cr_sdBox(p,vec3(a[0],a[1],a[2]));
+    case SDF_PRIMITIVE_ROUND_BOX:       return cr_udRoundBox(p,vec3(a[0],a[1],a[2]),a[3]);
+    case SDF_PRIMITIVE_TORUS:           return cr_sdTorus(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_CAPSULE:         return cr_sdCapsule(p,vec3(0.f,0.f,0.f),vec3(a[0],a[1],a[2]),a[3]);
+    case SDF_PRIMITIVE_TRI_PRISM:       return cr_sdTriPrism(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_CYLINDER:        return cr_sdCylinder(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_CONE:            return cr_sdCone(p,vec3(a[0],a[1],a[2]));
+    case SDF_PRIMITIVE_TORUS82:         return cr_sdTorus82(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_TORUS88:         return cr_sdTorus88(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_CYLINDER6:       return cr_sdCylinder6(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_HEX_PRISM:       return cr_sdHexPrism(p,cr_vec2(a[0],a[1]));
+    case SDF_PRIMITIVE_PYRAMID4:        return cr_sdPryamid4(p,vec3(a[0],a[1],a[2]));
+    case SDF_PRIMITIVE_CONE_SECTION:    return cr_sdConeSection(p,a[0],a[1],a[2]);
+    case SDF_PRIMITIVE_ELLIPSOID:       return cr_sdEllipsoid(p,vec3(a[0],a[1],a[2]));
+    default:                            return 1e10f;
+    }
+}
+// The objects of primitives[0..numPrimitives)
+static cr_vec2_t cr_mapScenePrimitives(const CpuRenderer* r,vec3_t pos,const SdfPrimitive* primitives,int numPrimitives) {
+    cr_vec2_t res = cr_vec2(1e10f,-1.f);
+    float objDist = 1e10f,objMat = -1.f;    // current object (see SdfOp)
+    int i;
+    if (r->counters) r->counters->primitive_evaluations+=numPrimitives;
+    for (i=0;i<numPrimitives;i++) {
+        const SdfPrimitive* prim = &primitives[i];
+        const float* mp = prim->modifier_params;
+        vec3_t p = v3_sub(pos,vec3(prim->position[0],prim->position[1],prim->position[2]));
+        float d;
+        if (prim->modifier==SDF_MODIFIER_TWIST) {
+            const float c = cosf(mp[0]*p.y+mp[1]);
+            const float s = sinf(mp[0]*p.y+mp[1]);
+            p = vec3(c*p.x+s*p.z,-s*p.x+c*p.z,p.y);     // mat2(c,-s,s,c)*p.xz (GLSL matrices are column-major)
+        }
+        else if (prim->modifier==SDF_MODIFIER_POLAR_REPEAT) {
+            p = vec3(cr_mod(atan2f(p.x,p.z)/6.2831f,mp[0])-0.5f*mp[0],p.y,cr_mod(mp[2]+mp[3]*v3_length(p),mp[1])-0.5f*mp[1]);
+        }
+        else if (prim->modifier==SDF_MODIFIER_REPEAT) p = cr_opRep(p,vec3(mp[0],mp[1],mp[2]));
+        d = cr_sdScenePrimitive(prim->type,p,prim->params);
+        if (prim->modifier==SDF_MODIFIER_TWIST) d*=mp[2];
+        else if (prim->modifier==SDF_MODIFIER_DISPLACE) d = d*mp[2] + mp[0]*sinf(mp[1]*pos.x)*sinf(mp[1]*pos.y)*sinf(mp[1]*pos.z);
+
+        switch (prim->op) {
+        case SDF_OP_SUBTRACT:       objDist = cr_opS(objDist,d);break;
+        case SDF_OP_INTERSECT:      objDist = cr_max(objDist,d);break;
+        case SDF_OP_SMOOTH_UNION:   objDist = cr_smin(objDist,d,prim->blend);break;
+        default:
+            res = cr_opU(res,cr_vec2(objDist,objMat));
+            objDist = d;objMat = prim->material;
+            break;
+        }
+    }
+    return cr_opU(res,cr_vec2(objDist,objMat));
+}
+static cr_vec2_t cr_mapScene(const CpuRenderer* r,vec3_t pos) {
+    return cr_mapScenePrimitives(r,pos,r->scene->primitives,cr_getNumScenePrimitives(r));
+}
+// Same as the USE_SCENE_BVH map() of "sdf_scene.glsl"
+static __inline float cr_boxDistance(const float* bmin,const float* bmax,vec3_t p) {
+    const float dx = cr_max(cr_max(bmin[0]-p.x,p.x-bmax[0]),0.f);
+    const float dy = cr_max(cr_max(bmin[1]-p.y,p.y-bmax[1]),0.f);
+    const float dz = cr_max(cr_max(bmin[2]-p.z,p.z-bmax[2]),0.f);
+    return sqrtf(dx*dx+dy*dy+dz*dz);
+}
+static cr_vec2_t cr_mapSceneBvh(const CpuRenderer* r,vec3_t pos) {
+    const SdfBvh* b = r->scene_bvh;
+    const int numNodes = r->settings.reduce_num_objects ? b->num_reduced_nodes : b->num_nodes;
+    cr_vec2_t res = cr_vec2(1e10f,-1.f);
+    int node = 0;
+    while (node<numNodes) {
+        const SdfBvhNode* n = &b->nodes[node];
+        if (r->counters) ++r->counters->bvh_node_visits;
+        if (cr_boxDistance(n->min,n->max,pos)>=res.x) node = n->skip;    // the whole subtree is farther than res.x
+        else {
+            if (n->first_primitive>=0) res = cr_opU(res,cr_mapScenePrimitives(r,pos,&b->primitives[n->first_primitive],n->num_primitives));
+            ++node;
+        }
+    }
+    return res;
+}
+
+// Same as mapGrid(...) in "sdf_scene.glsl" (USE_SCENE_GRID). Returns the cell of p (-1 outside the grid) and sets *free to the
+// distance up to which no object of another cell can be, minus the margin: from p (rd = NULL, map()), or along rd (mapRay())
+static int cr_getGridCell(const SdfGrid* g,const float* p,const float* rd,float* free) {
+    const float cs = g->cell_size;
+    float lo[3],hi[3],c[3];
+    int j;
+    for (j=0;j<3;j++) c[j] = (p[j]-g->origin[j])/cs;
+    *free = 1e10f;
+    if (c[0]>=0.f && c[1]>=0.f && c[2]>=0.f && c[0]<g->resolution[0] && c[1]<g->resolution[1] && c[2]<g->resolution[2]) {
+        const int cell[3] = {(int)c[0],(int)c[1],(int)c[2]};
+        for (j=0;j<3;j++) {
+            lo[j] = g->origin[j]+cell[j]*cs;hi[j] = lo[j]+cs;
+            // exit of the cell along rd, or distance to its faces
+            *free = cr_min(*free,rd ? (rd[j]>=0.f ? hi[j]-p[j] : p[j]-lo[j])/cr_max(fabsf(rd[j]),1e-8f) : cr_min(p[j]-lo[j],hi[j]-p[j]));
+        }
+        *free = cr_max(*free,0.f);
+        return cell[0]+g->resolution[0]*(cell[1]+g->resolution[1]*cell[2]);
+    }
+    // outside the grid: its bounded objects are at least margin inside it
+    for (j=0;j<3;j++) {lo[j] = g->origin[j];hi[j] = lo[j]+cs*g->resolution[j];}
+    if (rd) {
+        float tNear = -1e10f,tFar = 1e10f;
+        for (j=0;j<3;j++) {
+            const float ird = (rd[j]>=0.f ? 1.f : -1.f)/cr_max(fabsf(rd[j]),1e-8f);
+            const float t0 = (lo[j]-p[j])*ird,t1 = (hi[j]-p[j])*ird;
+            tNear = cr_max(tNear,cr_min(t0,t1));tFar = cr_min(tFar,cr_max(t0,t1));
+        }
+        if (tNear<=tFar && tFar>0.f) *free = cr_max(tNear,0.f);
+    }
+    else *free = cr_boxDistance(lo,hi,vec3(p[0],p[1],p[2]));
+    return -1;
+}
+static cr_vec2_t cr_mapSceneGrid(const CpuRenderer* r,vec3_t pos,const vec3_t* rd) {
+    const SdfGrid* g = r->scene_grid;
+    const float p[3] = {pos.x,pos.y,pos.z};
+    const float d[3] = {rd ? rd->x : 0.f,rd ? rd->y : 0.f,rd ? rd->z : 0.f};
+    cr_vec2_t res = cr_mapScenePrimitives(r,pos,g->primitives,r->settings.reduce_num_objects ? g->num_reduced_unbounded_primitives : g->num_unbounded_primitives);
+    float free;
+    const int cell = cr_getGridCell(g,p,rd ? d : NULL,&free);
+    if (cell>=0) {
+        const int end = g->cell_offsets[cell+1];
+        int k;
+        for (k=g->cell_offsets[cell];k<end;k++) {
+            const int o = g->cell_objects[k];
+            if (r->settings.reduce_num_objects && o>=g->num_reduced_objects) break;
+            res = cr_opU(res,cr_mapScenePrimitives(r,pos,&g->primitives[g->objects[o].first_primitive],g->objects[o].num_primitives));
+        }
+    }
+    res.x = cr_min(res.x,free+g->margin);
+    return res;
+}
+
+// Compiled scene (generated by "scene_compiler.c", same as "sdf_scene_compiled.glsl")
+#include "sdf_scene_compiled.h"
+
+// Scene--------------------------------------------------------------------
+static cr_vec2_t cr_map(const CpuRenderer* r,vec3_t pos) {
+    const float sinValue = 0.f;
+    cr_vec2_t res;
+    if (r->counters) ++r->counters->map_calls;
+    if (r->compiled_scene) return cr_mapCompiledScene(r,pos);
+    if (r->scene_bvh) return cr_mapSceneBvh(r,pos);
+    if (r->scene_grid) return cr_mapSceneGrid(r,pos,NULL);
+    if (r->scene) return cr_mapScene(r,pos);
+    res = cr_opU( cr_vec2( cr_sdPlane(pos), 1.f ),
+                  cr_vec2( cr_sdSphere(    v3_sub(pos,vec3( 0.0f,0.25f, 0.0f)), 0.25f ), 46.9f ) );
+    res = cr_opU( res, cr_vec2( cr_sdBox(       v3_sub(pos,vec3( 1.0f,0.25f, 0.0f+(0.5f*sinValue))), vec3(0.25f,0.25f,0.25f) ), 3.0f ) );
+    res = cr_opU( res, cr_vec2( cr_udRoundBox(  v3_sub(pos,vec3( 1.0f,0.25f, 1.0f)), vec3(0.15f,0.15f,0.15f), 0.1f ), 41.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus(     v3_sub(pos,vec3( 0.0f,0.25f, 1.0f)), cr_vec2(0.20f,0.05f) ), 25.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCapsule(   pos,vec3(-1.3f,0.10f,-0.1f), vec3(-0.8f,0.50f,0.2f), 0.1f  ), 31.9f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTriPrism(  v3_sub(pos,vec3(-1.0f,0.25f,-1.0f)), cr_vec2(0.25f,0.05f) ),43.5f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCylinder(  v3_sub(pos,vec3( 1.0f,0.30f,-1.0f)), cr_vec2(0.1f,0.2f) ), 8.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCone(      v3_sub(pos,vec3( 0.0f,0.50f,-1.0f)), vec3(0.8f,0.6f,0.3f) ), 55.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus82(   v3_sub(pos,vec3( 0.0f,0.25f, 2.0f)), cr_vec2(0.20f,0.05f) ),50.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus88(   v3_sub(pos,vec3(-1.0f,0.25f, 2.0f)), cr_vec2(0.20f,0.05f) ),43.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCylinder6( v3_sub(pos,vec3( 1.0f,0.30f, 2.0f)), cr_vec2(0.1f,0.2f) ), 12.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdHexPrism(  v3_sub(pos,vec3(-1.0f,0.20f, 1.0f)), cr_vec2(0.25f,0.05f) ),17.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdPryamid4(  v3_sub(pos,vec3(-1.0f,0.15f,-2.0f)), vec3(0.8f,0.6f,0.25f) ),37.0f ) );
+    if (!r->settings.reduce_num_objects) {
+        const vec3_t q = v3_sub(pos,vec3(-2.0f,0.2f, 0.0f));
+        res = cr_opU( res, cr_vec2( cr_opS( cr_udRoundBox( v3_sub(pos,vec3(-2.0f,0.2f, 1.0f)), vec3(0.15f,0.15f,0.15f),0.05f),
+                                            cr_sdSphere(   v3_sub(pos,vec3(-2.0f,0.2f, 1.0f)), 0.25f)), 13.0f ) );
+        res = cr_opU( res, cr_vec2( cr_opS( cr_sdTorus82(  q, cr_vec2(0.20f,0.1f)),
+                                            cr_sdCylinder( cr_opRep( vec3(atan2f(pos.x+2.0f,pos.z)/6.2831f, pos.y, 0.02f+0.5f*v3_length(q)), vec3(0.05f,1.0f,0.05f)), cr_vec2(0.02f,0.6f))), 51.0f ) );
+        res = cr_opU( res, cr_vec2( 0.5f*cr_sdSphere( v3_sub(pos,vec3(-2.0f,0.25f,-1.0f)), 0.2f ) + 0.03f*sinf(50.0f*pos.x)*sinf(50.0f*pos.y)*sinf(50.0f*pos.z), 65.0f ) );
+        res = cr_opU( res, cr_vec2( 0.5f*cr_sdTorus( cr_opTwist(v3_sub(pos,vec3(-2.0f,0.25f, 2.0f))),cr_vec2(0.20f,0.05f)), 46.7f ) );
+        // smooth union example (third arg of smin(...) is the amount of blending) [added by @Flix]
+        res = cr_opU( res, cr_vec2(cr_smin(cr_sdSphere(v3_sub(pos,vec3(0.0f,0.35f,3.0f)),0.1f),cr_sdBox(v3_sub(pos,vec3( 0.0f,0.15f, 3.0f)), vec3(0.1f,0.1f,0.1f)), 0.1f), 43.17f ) );
+    }
+    res = cr_opU( res, cr_vec2( cr_sdConeSection( v3_sub(pos,vec3( 0.0f,0.35f,-2.0f)), 0.15f, 0.2f, 0.1f ), 13.67f ) );
+    res = cr_opU( res, cr_vec2( cr_sdEllipsoid( v3_sub(pos,vec3( 1.0f,0.35f,-2.0f)), vec3(0.15f, 0.2f, 0.05f) ), 43.17f ) );
+    return res;   // res.y just controls the rendering material
+}
+
+// map() for castRay(): the grid also clamps the step to the exit of the cell (mapRay() in "sdf_scene.glsl")
+static __inline int cr_usesGridSteps(const CpuRenderer* r) {return r->scene_grid && !r->compiled_scene && !r->scene_bvh;}
+static cr_vec2_t cr_mapRay(const CpuRenderer* r,vec3_t pos,vec3_t rd) {
+    if (cr_usesGridSteps(r)) {
+        if (r->counters) ++r->counters->map_calls;
+        return cr_mapSceneGrid(r,pos,&rd);
+    }
+    return cr_map(r,pos);
+}
+
+float CpuRenderer_Map(const CpuRenderer* r,vec3_t pos,float* material) {
+    const cr_vec2_t res = cr_map(r,pos);
+    if (material) *material = res.y;
+    return res.x;
+}
+
+// Far from the surfaces: cheap steps through the brick map first (USE_BAKED_SDF in the shader). Returns the new t
+static float cr_brickMapSteps(const CpuRenderer* r,vec3_t ro,vec3_t rd,float t,float tmax) {
+    int i;
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        float p[3],far;
+        p[0] = ro.x+rd.x*t;p[1] = ro.y+rd.y*t;p[2] = ro.z+rd.z*t;
+        far = SdfBrickMap_GetStep( r->brick_map, p );
+        if( far<=0.f || t>tmax ) break;
+        t += far;
+    }
+    return t;
+}
+
+// Over-relaxed sphere tracing (RAYCAST_OVER_RELAXED in the shader, "Enhanced Sphere Tracing", Keinert et al. 2014): the
+// steps are omega times the distance as long as the unbounding spheres of two consecutive points overlap (the segment
+// between them is empty). When they don't, the marcher goes back to the previous point plus its distance, and carries on
+// with omega = 1. The hit (and its material) is the same as the one of the plain marcher. The error of a point is its
+// distance divided by t (RAYCAST_PRECISION is the radius of the cone of the pixel at t = 1): with raycast_best_candidate,
+// the rays out of iterations end at the point with the smallest error (the candidate), instead of the last one.
+// The grid steps are not distances (they're clamped to the exit of the cell): it's not used there
+static cr_vec2_t cr_castRayOverRelaxed(const CpuRenderer* r,vec3_t ro,vec3_t rd,float t,float m,float tmax) {
+    float omega = r->settings.raycast_over_relaxation;
+    float previousRadius = 0.f, stepLength = 0.f;
+    float candidateT = t, candidateError = 1e30f, candidateM = -1.f;
+    int i;
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        const cr_vec2_t res = cr_map( r, v3_add(ro,v3_muls(rd,t)) );
+        const float radius = fabsf( res.x );
+        if( r->counters ) ++r->counters->raycast_steps;
+        if( omega>1.f && radius+previousRadius<stepLength ) {
+            t -= stepLength;
+            stepLength = previousRadius;
+            omega = 1.f;
+        }
+        else {
+            const float error = radius/t;
+            if( res.x<r->settings.raycast_precision*t || t>tmax ) break;
+            if( error<candidateError ) {candidateT = t;candidateError = error;candidateM = res.y;}
+            m = res.y;
+            stepLength = res.x*omega;
+            previousRadius = radius;
+        }
+        t += stepLength;
+    }
+    if( t>tmax ) return cr_vec2( t, -1.f );
+    if( i==r->settings.raycast_iterations && r->settings.raycast_best_candidate ) return cr_vec2( candidateT, candidateM );
+    return cr_vec2( t, m );
+}
+
+// tstart = the distance of the cone pre-pass (0 = none), tguess = the one reprojected from the previous frame (0 = none)
+static cr_vec2_t cr_castRay(const CpuRenderer* r,vec3_t ro,vec3_t rd,float tstart,float tguess) {
+    float tmin = cr_max( r->iProjectionData[0], tstart );
+    float tmax = r->iProjectionData[1];
+    float t,m;int i;
+    // bounding volume
+    {
+        const float tp1 = (0.0f-ro.y)/rd.y;
+        const float tp2 = (1.6f-ro.y)/rd.y;
+        if( tp1>0.0f ) tmax = cr_min( tmax, tp1 );
+        if( tp2>0.0f ) { if( ro.y>1.6f ) tmin = cr_max( tmin, tp2 );
+                         else            tmax = cr_min( tmax, tp2 ); }
+    }
+    t = tmin;
+    m = -1.f;
+    if( tguess>t ) {
+        // it's used only if the ray is outside the shapes there (a thin object in front of it is missed, though): the first
+        // step is taken from there
+        const cr_vec2_t res = cr_map( r, v3_add(ro,v3_muls(rd,tguess)) );
+        if( r->counters ) ++r->counters->raycast_steps;
+        if( res.x>=0.f ) {
+            if( res.x<r->settings.raycast_precision*tguess || tguess>tmax ) return cr_vec2( tguess, tguess>tmax ? -1.f : res.y );
+            t = tguess+res.x;
+            m = res.y;
+        }
+        else if( r->counters ) ++r->counters->temporal_fallbacks;
+    }
+    if( r->brick_map ) t = cr_brickMapSteps( r, ro, rd, t, tmax );
+    if( r->settings.raycast_over_relaxation>1.f && !cr_usesGridSteps(r) ) return cr_castRayOverRelaxed( r, ro, rd, t, m, tmax );
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        const float precis = r->settings.raycast_precision*t;
+        const cr_vec2_t res = cr_mapRay( r, v3_add(ro,v3_muls(rd,t)), rd );
+        if( r->counters ) ++r->counters->raycast_steps;
+        if( res.x<precis || t>tmax ) break;
+        t += res.x;
+        m = res.y;
+    }
+    if( t>tmax ) m=-1.f;
+    return cr_vec2( t, m );
+}
+
+static float cr_softshadow(const CpuRenderer* r,vec3_t ro,vec3_t rd,float mint,float tmax) {
+    float res = 1.f;
+    float t = mint;
+    int i;
+    for( i=0; i<r->settings.shadow_iterations; i++ ) {
+        const float h = cr_map( r, v3_add(ro,v3_muls(rd,t)) ).x;
+        res = cr_min( res, r->settings.shadow_hardness*h/t );
+        t += cr_clamp( h, 0.02f, 0.10f );
+        if( h<0.001f || t>tmax ) break;
+    }
+    return cr_clamp( res, 0.f, 1.f );
+}
+
+static vec3_t cr_calcNormal(const CpuRenderer* r,vec3_t pos) {
+    const float e = 0.5773f*0.0005f;
+    const vec3_t xyy = vec3( e,-e,-e), yyx = vec3(-e,-e, e), yxy = vec3(-e, e,-e), xxx = vec3( e, e, e);
+    return v3_norm( v3_add(v3_add(v3_muls(xyy,cr_map( r, v3_add(pos,xyy) ).x),
+                                  v3_muls(yyx,cr_map( r, v3_add(pos,yyx) ).x)),
+                           v3_add(v3_muls(yxy,cr_map( r, v3_add(pos,yxy) ).x),
+                                  v3_muls(xxx,cr_map( r, v3_add(pos,xxx) ).x))) );
+}
+
+static float cr_calcAO(const CpuRenderer* r,vec3_t pos,vec3_t nor) {
+    float occ = 0.f;
+    float sca = 1.f;
+    int i;
+    for( i=0; i<r->settings.ambient_occlusion_precision; i++ ) {
+        const float hr = 0.01f + 0.12f*(float)i/4.f;
+        const vec3_t aopos = v3_add(v3_muls(nor,hr),pos);
+        const float dd = cr_map( r, aopos ).x;
+        occ += -(dd-hr)*sca;
+        sca *= 0.95f;
+    }
+    return cr_clamp( 1.f - 3.f*occ, 0.f, 1.f );
+}
+
+// The lighting part of render(): "sha" and "shaDom" are the softshadow(...) terms along the light and the reflected directions
+static vec3_t cr_shade(const CpuRenderer* r,vec3_t rd,float t,float m,vec3_t pos,vec3_t nor,float occ,float sha,float shaDom) {
+    const CpuRendererSettings* s = &r->settings;
+    const vec3_t ref = cr_v3_reflect( rd, nor );
+    const vec3_t lig = r->iLightDirection;
+    float amb,dif,bac=0.f,dom=0.f,fre=0.f,spe=0.f;
+    vec3_t col,lin;
+
+    // material
+    col = vec3(0.45f + 0.35f*sinf( 0.05f*(m-1.f) ),
+               0.45f + 0.35f*sinf( 0.08f*(m-1.f) ),
+               0.45f + 0.35f*sinf( 0.10f*(m-1.f) ));
+    // checker:
+    if( m<1.5f ) {
+        // checker on ground plane
+        const float f = cr_mod( floorf(5.f*pos.z) + floorf(5.f*pos.x), 2.f);
+        col = vec3(0.3f + 0.1f*f,0.3f + 0.1f*f,0.3f + 0.1f*f);
+    }
+    // lighitng
+    amb = cr_clamp( 0.5f+0.5f*nor.y, 0.f, 1.f );
+    dif = cr_clamp( v3_dot( nor, lig ), 0.f, 1.f );
+    if (s->enable_bac_lighting_component>0) bac = cr_clamp( v3_dot( nor, v3_norm(vec3(-lig.x,0.f,-lig.z))), 0.f, 1.f )*cr_clamp( 1.f-pos.y,0.f,1.f);
+    if (s->enable_dom_lighting_component>0) dom = cr_smoothstep( -0.1f, 0.1f, ref.y );
+    if (s->enable_fre_lighting_component>0) fre = powf( cr_clamp(1.f+v3_dot(nor,rd),0.f,1.f), 2.f );
+    if (s->enable_spe_lighting_component>0) spe = powf(cr_clamp( v3_dot( ref, lig ), 0.f, 1.f ),16.f);
+
+    if (s->shadow_iterations>0) {
+        dif *= sha;
+        if (s->enable_dom_lighting_component>0) dom *= shaDom;
+    }
+
+    lin = vec3(0.f,0.f,0.f);
+    lin = v3_add(lin,v3_muls(vec3(0.40f,0.60f,1.00f),0.40f*amb*occ));
+    lin = v3_add(lin,v3_muls(vec3(1.00f,0.80f,0.55f),1.30f*dif));
+    if (s->enable_spe_lighting_component>0) lin = v3_add(lin,v3_muls(vec3(1.00f,0.90f,0.70f),2.00f*spe*dif));
+    if (s->enable_dom_lighting_component>0) lin = v3_add(lin,v3_muls(vec3(0.40f,0.60f,1.00f),0.50f*dom*occ));
+    if (s->enable_bac_lighting_component>0) lin = v3_add(lin,v3_muls(vec3(0.25f,0.25f,0.25f),0.50f*bac*occ));
+    if (s->enable_fre_lighting_component>0) lin = v3_add(lin,v3_muls(vec3(1.00f,1.00f,1.00f),0.25f*fre*occ));
+    col = v3_mul(col,lin);
+
+    col = v3_lerp( col, vec3(0.8f,0.9f,1.0f), 1.f-expf( -0.0002f*t*t*t ) );
+    return col;
+}
+// The calcAO(...) and softshadow(...) terms of cr_shade(...) (1 = not occluded)
+static void cr_occlusionTerms(const CpuRenderer* r,vec3_t rd,vec3_t pos,vec3_t nor,float* occ,float* sha,float* shaDom) {
+    const CpuRendererSettings* s = &r->settings;
+    *occ = *sha = *shaDom = 1.f;
+    if (s->ambient_occlusion_precision>0) *occ = cr_calcAO( r, pos, nor );
+    if (s->shadow_iterations>0) {
+        *sha = cr_softshadow( r, pos, r->iLightDirection, 0.02f, 2.5f );
+        if (s->enable_dom_lighting_component>0) *shaDom = cr_softshadow( r, pos, cr_v3_reflect( rd, nor ), 0.02f, 2.5f );
+    }
+}
+static __inline vec3_t cr_sky(vec3_t rd) {return v3_adds(vec3(0.7f, 0.9f, 1.0f),rd.y*0.8f);}
+static __inline vec3_t cr_saturate(vec3_t col) {return vec3(cr_clamp(col.x,0.f,1.f),cr_clamp(col.y,0.f,1.f),cr_clamp(col.z,0.f,1.f));}
+
+// *hitT = the distance up to which the ray is empty (the far plane if it hits nothing)
+static vec3_t cr_render(const CpuRenderer* r,vec3_t ro,vec3_t rd,float tstart,float tguess,float* hitT) {
+    vec3_t col = cr_sky(rd);
+    const cr_vec2_t res = cr_castRay(r,ro,rd,tstart,tguess);
+    const float t = res.x;
+    const float m = res.y;
+    *hitT = m>-0.5f ? t : r->iProjectionData[1];
+    if( m>-0.5f ) {
+        const vec3_t pos = v3_add(ro,v3_muls(rd,t));
+        const vec3_t nor = cr_calcNormal( r, pos );
+        float occ,sha,shaDom;
+        cr_occlusionTerms(r,rd,pos,nor,&occ,&sha,&shaDom);
+        col = cr_shade(r,rd,t,m,pos,nor,occ,sha,shaDom);
+    }
+    return cr_saturate(col);
+}
+
+// Ray direction through the (bottom-up) window coordinates "fragCoord" (the AA offset must be already added)
+static __inline vec3_t cr_rayDirection(const CpuRenderer* r,float fragCoordX,float fragCoordY) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const float px = r->iProjectionData2[0] * (2.f * fragCoordX / r->iResolution[0] - 1.f);
+    const float py = r->iProjectionData2[1] * (2.f * fragCoordY / r->iResolution[1] - 1.f);
+    const vec3_t rdu = v3_norm( vec3(px,py,r->iProjectionData[0]) );
+    return vec3(
+        cm->m[0][0]*rdu.x + cm->m[1][0]*rdu.y + cm->m[2][0]*rdu.z,
+        cm->m[0][1]*rdu.x + cm->m[1][1]*rdu.y + cm->m[2][1]*rdu.z,
+        cm->m[0][2]*rdu.x + cm->m[1][2]*rdu.y + cm->m[2][2]*rdu.z
+    );
+}
+// cr_rayDirection(...) of n rays at once (8 or 4 at a time with the wide vectors of math_3d.h): (fx[i],fy[i]) -> (rdx[i],rdy[i],rdz[i])
+static __inline void cr_rayDirections(const CpuRenderer* r,const float* fx,const float* fy,int n,float* rdx,float* rdy,float* rdz) {
+    int i = 0;
+#ifdef MATH_3D_AVX
+    for (;i+8<=n;i+=8) {
+        const floatx8_t px = f8_mul(f8_splat(r->iProjectionData2[0]),f8_sub(f8_div(f8_mul(f8_splat(2.f),f8_load(&fx[i])),f8_splat(r->iResolution[0])),f8_splat(1.f)));
+        const floatx8_t py = f8_mul(f8_splat(r->iProjectionData2[1]),f8_sub(f8_div(f8_mul(f8_splat(2.f),f8_load(&fy[i])),f8_splat(r->iResolution[1])),f8_splat(1.f)));
+        const vec3x8_t rd = m4_mul_dir_x8(r->iCameraMatrix,v3x8_norm(vec3x8(px,py,f8_splat(r->iProjectionData[0]))));
+        f8_store(&rdx[i],rd.x);f8_store(&rdy[i],rd.y);f8_store(&rdz[i],rd.z);
+    }
+#endif //MATH_3D_AVX
+    for (;i+4<=n;i+=4) {
+        const floatx4_t px = f4_mul(f4_splat(r->iProjectionData2[0]),f4_sub(f4_div(f4_mul(f4_splat(2.f),f4_load(&fx[i])),f4_splat(r->iResolution[0])),f4_splat(1.f)));
+        const floatx4_t py = f4_mul(f4_splat(r->iProjectionData2[1]),f4_sub(f4_div(f4_mul(f4_splat(2.f),f4_load(&fy[i])),f4_splat(r->iResolution[1])),f4_splat(1.f)));
+        const vec3x4_t rd = m4_mul_dir_x4(r->iCameraMatrix,v3x4_norm(vec3x4(px,py,f4_splat(r->iProjectionData[0]))));
+        f4_store(&rdx[i],rd.x);f4_store(&rdy[i],rd.y);f4_store(&rdz[i],rd.z);
+    }
+    for (;i<n;i++) {
+        const vec3_t rd = cr_rayDirection(r,fx[i],fy[i]);
+        rdx[i]=rd.x;rdy[i]=rd.y;rdz[i]=rd.z;
+    }
+}
+static __inline vec3_t cr_gamma(const CpuRenderer* r,vec3_t col) {
+    if (!r->settings.gamma_correction_using_sqrt) return vec3(powf(col.x,0.4545f),powf(col.y,0.4545f),powf(col.z,0.4545f));
+    return vec3(sqrtf(col.x),sqrtf(col.y),sqrtf(col.z));
+}
+
+// The cone pre-pass (CONE_PREPASS in the shader): the cone from the camera through the corners of a tile contains the rays
+// of all its pixels (and their AA samples). Its half-angle is bounded by the half diagonal of the tile on the near plane
+// (sin(angle) <= half diagonal/near plane). The cone is empty up to t+s if the distance d at t along its axis covers the
+// cross sections up to t+s: s+(t+s)*tan(angle) <= d. It stops when the steps get shorter than the radius of the cone
+static float cr_coneMarch(const CpuRenderer* r,vec3_t ro,float tileX,float tileY,int tileSize) {
+    const float halfX = r->iProjectionData2[0]*(float)tileSize/r->iResolution[0];
+    const float halfY = r->iProjectionData2[1]*(float)tileSize/r->iResolution[1];
+    const float sinAngle = cr_min( sqrtf(halfX*halfX+halfY*halfY)/r->iProjectionData[0], 0.99f );
+    const float tanAngle = sinAngle/sqrtf(1.f-sinAngle*sinAngle);
+    const vec3_t rd = cr_rayDirection(r,(tileX+0.5f)*(float)tileSize,(tileY+0.5f)*(float)tileSize);
+    const float tmax = r->iProjectionData[1];
+    float t = r->iProjectionData[0]*sqrtf(1.f-sinAngle*sinAngle);    // (the near plane along the rays at the border of the cone)
+    int i;
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        const float radius = t*tanAngle;
+        const float step = (cr_map( r, v3_add(ro,v3_muls(rd,t)) ).x-radius)/(1.f+tanAngle);
+        if( r->counters ) ++r->counters->cone_prepass_steps;
+        if( step<radius ) break;
+        t += step;
+        if( t>tmax ) return tmax;
+    }
+    return t;
+}
+// The distance of the tile of fragCoord (0 without the cone pre-pass), like conePrepassStart(...) in the shader
+static __inline float cr_conePrepassStart(const CpuRenderer* r,float fragCoordX,float fragCoordY) {
+    const CpuConePrepass* p = r->cone_prepass;
+    int x,y;
+    if (!p) return 0.f;
+    x = (int)(fragCoordX/(float)p->tile_size);y = (int)(fragCoordY/(float)p->tile_size);
+    if (x<0 || y<0 || x>=p->width || y>=p->height) return 0.f;
+    return p->start[y*p->width+x];
+}
+typedef struct {
+    const CpuRenderer* r;
+    CpuConePrepass* p;
+} cr_cone_prepass_t;
+static void cr_cone_prepass_task(int taskIndex,int workerIndex,void* userData) {
+    const cr_cone_prepass_t* cp = (const cr_cone_prepass_t*) userData;
+    const mat4_t* cm = &cp->r->iCameraMatrix;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    int x;
+    (void)workerIndex;
+    for (x=0;x<cp->p->width;x++) cp->p->start[taskIndex*cp->p->width+x] = cr_coneMarch(cp->r,ro,(float)x,(float)taskIndex,cp->p->tile_size);
+}
+void CpuRenderer_RenderConePrepass(const CpuRenderer* r,CpuConePrepass* p,CpuScheduler* scheduler) {
+    cr_cone_prepass_t cp;
+    int y;
+    cp.r = r;cp.p = p;
+    if (scheduler) CpuScheduler_Run(scheduler,p->height,&cr_cone_prepass_task,&cp);
+    else for (y=0;y<p->height;y++) cr_cone_prepass_task(y,0,&cp);
+}
+
+// Temporal depth reuse (USE_TEMPORAL_DEPTH in the shader, see temporalStart(...) there). The previous frame saw empty space
+// in front of its hit distances: a point of the ray of this frame is empty (if the scene is static) when it's closer to
+// the previous camera than the hit distance there. The guess is the hit distance of the same pixel in the previous frame,
+// moved to the surface it reprojects to, times "fraction". Then TEMPORAL_DEPTH_SAMPLES points of the ray up to the guess are
+// reprojected: the ray starts from the last one in front of the previous hit distances. A point out of the previous frame
+// (or behind its near plane) is a disocclusion: the ray starts before it. The points are sparse, and a point just behind a
+// silhouette can reproject next to it (to a farther hit distance): the previous hit distances are the smallest of the 2x2
+// tiles of CPU_TEMPORAL_DEPTH_TILE^2 pixels around the points, so that the silhouettes moved by a few pixels are still there
+#define TEMPORAL_DEPTH_SAMPLES (8)
+// The previous frame at the point l (in the space of the previous camera): returns 0 if it's not there, otherwise the hit
+// distance there. scale and offset map l.xy/l.z to the tile coordinates of the previous frame (tile centers at integers)
+static __inline int cr_temporalReproject(const CpuTemporalDepth* d,const float* l,float nearPlane,const float* scale,const float* offset,float* hitT) {
+    const float* prev;
+    float fx,fy,invZ;
+    int x,y;
+    if (l[2]<=nearPlane) return 0;
+    invZ = 1.f/l[2];
+    fx = l[0]*invZ*scale[0]+offset[0];
+    fy = l[1]*invZ*scale[1]+offset[1];
+    if (fx<offset[2] || fy<offset[3] || fx>offset[4] || fy>offset[5]) return 0;
+    x = (int)(fx+1.f)-1;y = (int)(fy+1.f)-1;    // (floor)
+    x = x<0 ? 0 : (x>d->tiles_x-2 ? d->tiles_x-2 : x);
+    y = y<0 ? 0 : (y>d->tiles_y-2 ? d->tiles_y-2 : y);
+    prev = &d->tile_min[y*d->tiles_x+x];
+    *hitT = cr_min( cr_min(prev[0],prev[1]), cr_min(prev[d->tiles_x],prev[d->tiles_x+1]) );
+    return 1;
+}
+// The start distance of the pixel at fragCoord (0 = the near plane)
+static float cr_temporalStart(const CpuRenderer* r,float fragCoordX,float fragCoordY,vec3_t ro,vec3_t rd) {
+    const CpuTemporalDepth* d = r->temporal_depth;
+    const mat4_t* pc;
+    float l0[3],ld[3],l[3];   // the ray in the space of the previous camera: l0+ld*t
+    float scale[2],offset[6];   // (offset[2..5] = the bounds of the frame)
+    float hitT,t,guess;
+    int x,y,c,k;
+    if (!d || d->num_frames<2) return 0.f;
+    x = (int)fragCoordX;y = (int)fragCoordY;
+    if (x<0 || y<0 || x>=d->width || y>=d->height) return 0.f;
+    pc = &d->camera[!d->current];
+    for (c=0;c<3;c++) {
+        l0[c] = pc->m[c][0]*(ro.x-pc->m[3][0]) + pc->m[c][1]*(ro.y-pc->m[3][1]) + pc->m[c][2]*(ro.z-pc->m[3][2]);
+        ld[c] = pc->m[c][0]*rd.x + pc->m[c][1]*rd.y + pc->m[c][2]*rd.z;
+    }
+    // pixel p (center at p+0.5) is in tile (p+0.5)/CPU_TEMPORAL_DEPTH_TILE-0.5 (center at an integer)
+    scale[0] = r->iProjectionData[0]/r->iProjectionData2[0]*0.5f*(float)d->width/(float)CPU_TEMPORAL_DEPTH_TILE;
+    scale[1] = r->iProjectionData[0]/r->iProjectionData2[1]*0.5f*(float)d->height/(float)CPU_TEMPORAL_DEPTH_TILE;
+    offset[0] = 0.5f*(float)d->width/(float)CPU_TEMPORAL_DEPTH_TILE-0.5f;
+    offset[1] = 0.5f*(float)d->height/(float)CPU_TEMPORAL_DEPTH_TILE-0.5f;
+    offset[2] = offset[3] = -0.5f;
+    offset[4] = (float)d->width/(float)CPU_TEMPORAL_DEPTH_TILE-0.5f;
+    offset[5] = (float)d->height/(float)CPU_TEMPORAL_DEPTH_TILE-0.5f;
+    t = d->t[!d->current][y*d->width+x];
+    for (c=0;c<3;c++) l[c] = l0[c]+ld[c]*t;
+    if (!cr_temporalReproject(d,l,r->iProjectionData[0],scale,offset,&hitT)) {
+        if (r->counters) ++r->counters->temporal_fallbacks;
+        return 0.f;
+    }
+    guess = (t+hitT-sqrtf(l[0]*l[0]+l[1]*l[1]+l[2]*l[2]))*d->fraction;
+    for (k=1;k<=TEMPORAL_DEPTH_SAMPLES;k++) {
+        t = guess*(float)k/(float)TEMPORAL_DEPTH_SAMPLES;
+        for (c=0;c<3;c++) l[c] = l0[c]+ld[c]*t;
+        if (!cr_temporalReproject(d,l,r->iProjectionData[0],scale,offset,&hitT) || l[0]*l[0]+l[1]*l[1]+l[2]*l[2]>hitT*hitT) {
+            if (k==1 && r->counters) ++r->counters->temporal_fallbacks;
+            return guess*(float)(k-1)/(float)TEMPORAL_DEPTH_SAMPLES;
+        }
+    }
+    return guess;
+}
+// Writes the hit distance of the pixel at fragCoord (the smallest of its AA samples)
+static __inline void cr_temporalStore(const CpuRenderer* r,float fragCoordX,float fragCoordY,float hitT) {
+    CpuTemporalDepth* d = r->temporal_depth;
+    const int x = (int)fragCoordX, y = (int)fragCoordY;
+    if (d && x>=0 && y>=0 && x<d->width && y<d->height) d->t[d->current][y*d->width+x] = hitT;
+}
+
+vec3_t CpuRenderer_RenderPixel(const CpuRenderer* r,float fragCoordX,float fragCoordY) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const int AA = r->settings.aa>1 ? r->settings.aa : 1;
+    const float tstart = cr_conePrepassStart(r,fragCoordX,fragCoordY);
+    // ray origin (camera position)
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const float tguess = cr_temporalStart(r,fragCoordX,fragCoordY,ro,cr_rayDirection(r,fragCoordX,fragCoordY));
+    vec3_t tot = vec3(0.f,0.f,0.f);
+    float pixelT = r->iProjectionData[1];
+    int m,n;
+    for( m=0; m<AA; m++ )
+    for( n=0; n<AA; n++ ) {
+        // pixel coordinates
+        const float ox = AA>1 ? (float)m/(float)AA - 0.5f : 0.f;
+        const float oy = AA>1 ? (float)n/(float)AA - 0.5f : 0.f;
+        // ray direction
+        const vec3_t rd = cr_rayDirection(r,fragCoordX+ox,fragCoordY+oy);
+        float hitT;
+        // render + gamma
+        tot = v3_add(tot,cr_gamma(r,cr_render( r, ro, rd, tstart, tguess, &hitT )));
+        pixelT = cr_min( pixelT, hitT );
+    }
+    if (AA>1) tot = v3_divs(tot,(float)(AA*AA));
+    cr_temporalStore(r,fragCoordX,fragCoordY,pixelT);
+    return tot;
+}
+
+// The visibility pass of the deferred pipeline (DEFERRED_GBUFFER in the shader): castRay() and calcNormal() of the center
+// of the pixel at (x,y) of g (top-down rows). The hit distance goes to the temporal depth too
+static void cr_renderGBufferPixel(const CpuRenderer* r,CpuGBuffer* g,int x,int y) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const float fragCoordX = (float)x+0.5f, fragCoordY = (float)(g->height-1-y)+0.5f;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const vec3_t rd = cr_rayDirection(r,fragCoordX,fragCoordY);
+    const cr_vec2_t res = cr_castRay(r,ro,rd,cr_conePrepassStart(r,fragCoordX,fragCoordY),cr_temporalStart(r,fragCoordX,fragCoordY,ro,rd));
+    const int i = y*g->width+x;
+    vec3_t nor = vec3(0.f,0.f,0.f);
+    if (res.y>-0.5f) nor = cr_calcNormal( r, v3_add(ro,v3_muls(rd,res.x)) );
+    g->t[i] = res.y>-0.5f ? res.x : r->iProjectionData[1];
+    g->material[i] = res.y>-0.5f ? res.y : -1.f;
+    g->normal[3*i] = nor.x;g->normal[3*i+1] = nor.y;g->normal[3*i+2] = nor.z;
+    cr_temporalStore(r,fragCoordX,fragCoordY,g->t[i]);
+}
+// Low-resolution occlusion terms (USE_LOW_RES_OCCLUSION in the shader): the G-buffer pixel of the sample at (sx,sy)
+// (the center of its block of occlusion_divisor^2 pixels, clamped to the G-buffer)
+static __inline int cr_occlusionSamplePixel(const CpuGBuffer* g,int sx,int sy) {
+    const int d = g->occlusion_divisor;
+    const int x = sx*d+d/2, y = sy*d+d/2;
+    return (y<g->height ? y : g->height-1)*g->width + (x<g->width ? x : g->width-1);
+}
+// occlusionTerms(...) of the sample at (sx,sy) (-1 = no hit)
+static void cr_renderOcclusionSample(const CpuRenderer* r,CpuGBuffer* g,int sx,int sy) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const int i = cr_occlusionSamplePixel(g,sx,sy);
+    float* o = &g->occlusion[3*(sy*g->occlusion_width+sx)];
+    o[0] = o[1] = o[2] = -1.f;
+    if (g->material[i]>-0.5f) {
+        const vec3_t rd = cr_rayDirection(r,(float)(i%g->width)+0.5f,(float)(g->height-1-i/g->width)+0.5f);
+        const vec3_t pos = v3_add(vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]),v3_muls(rd,g->t[i]));
+        cr_occlusionTerms(r,rd,pos,vec3(g->normal[3*i],g->normal[3*i+1],g->normal[3*i+2]),&o[0],&o[1],&o[2]);
+    }
+}
+// Joint bilateral upsampling of the occlusion terms of the pixel at (x,y) (a hit): the 2x2 nearest samples, weighted by
+// their bilinear weights, by the difference of their hit distance (relative to the one of the pixel: 0 beyond
+// CR_OCCLUSION_DEPTH_TOLERANCE) and by the angle between the normals (dot^8). Returns 0 when the samples are on other
+// surfaces (their weights are below CR_OCCLUSION_MIN_WEIGHT): the terms must be computed for the pixel then.
+// The same as upsampleOcclusion(...) in "deferred.glsl"
+#define CR_OCCLUSION_DEPTH_TOLERANCE    (0.05f)
+#define CR_OCCLUSION_MIN_WEIGHT         (0.01f)
+static int cr_upsampleOcclusion(const CpuGBuffer* g,int x,int y,float* occ,float* sha,float* shaDom) {
+    const int d = g->occlusion_divisor, i = y*g->width+x;
+    const float fx = (float)(x-d/2)/(float)d, fy = (float)(y-d/2)/(float)d;     // (in samples)
+    const float x0 = floorf(fx), y0 = floorf(fy);
+    const float ax = fx-x0, ay = fy-y0;
+    const float t = g->t[i];
+    const float* n = &g->normal[3*i];
+    float sum = 0.f,o[3] = {0.f,0.f,0.f};
+    int k;
+    for (k=0;k<4;k++) {
+        int sx = (int)x0+(k&1), sy = (int)y0+(k>>1), j;
+        const float* so;
+        float w,dz,nd;
+        sx = sx<0 ? 0 : (sx>=g->occlusion_width ? g->occlusion_width-1 : sx);
+        sy = sy<0 ? 0 : (sy>=g->occlusion_height ? g->occlusion_height-1 : sy);
+        so = &g->occlusion[3*(sy*g->occlusion_width+sx)];
+        if (so[0]<0.f) continue;   // (no hit)
+        j = cr_occlusionSamplePixel(g,sx,sy);
+        dz = 1.f-fabsf(g->t[j]-t)/(CR_OCCLUSION_DEPTH_TOLERANCE*t);
+        nd = cr_max(n[0]*g->normal[3*j]+n[1]*g->normal[3*j+1]+n[2]*g->normal[3*j+2],0.f);
+        nd*=nd;nd*=nd;nd*=nd;
+        w = ((k&1) ? ax : 1.f-ax)*((k>>1) ? ay : 1.f-ay)*cr_max(dz,0.f)*nd;
+        o[0]+=w*so[0];o[1]+=w*so[1];o[2]+=w*so[2];
+        sum+=w;
+    }
+    if (sum<CR_OCCLUSION_MIN_WEIGHT) return 0;
+    *occ = o[0]/sum;*sha = o[1]/sum;*shaDom = o[2]/sum;
+    return 1;
+}
+
+// The shading pass (DEFERRED_SHADING in the shader): the rest of render() and main() for the pixel at (x,y) of g
+static vec3_t cr_shadeGBufferPixel(const CpuRenderer* r,const CpuGBuffer* g,int x,int y) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const vec3_t rd = cr_rayDirection(r,(float)x+0.5f,(float)(g->height-1-y)+0.5f);
+    const int i = y*g->width+x;
+    const float t = g->t[i], m = g->material[i];
+    vec3_t col = cr_sky(rd);
+    if( m>-0.5f ) {
+        const vec3_t pos = v3_add(vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]),v3_muls(rd,t));
+        const vec3_t nor = vec3(g->normal[3*i],g->normal[3*i+1],g->normal[3*i+2]);
+        float occ,sha,shaDom;
+        if (!g->occlusion || !cr_upsampleOcclusion(g,x,y,&occ,&sha,&shaDom)) {
+            if (g->occlusion && r->counters) ++r->counters->occlusion_fallbacks;
+            cr_occlusionTerms(r,rd,pos,nor,&occ,&sha,&shaDom);
+        }
+        col = cr_shade(r,rd,t,m,pos,nor,occ,sha,shaDom);
+    }
+    return cr_gamma(r,cr_saturate(col));
+}
+
+// SIMD packet tracing---------------------------------------------------------
+#ifdef CPU_RENDERER_HAS_X86_PACKETS
+static float cr_pow_one_sixth(float x) {return powf(x,1.f/6.f);}    // (per lane, see crp_length6(...))
+#   define CRP_ISA_SSE41    1
+#   define CRP_ISA_AVX2     2
+#   define CRP_ISA_AVX512   3
+#   define CRP_ISA CRP_ISA_SSE41
+#   include "cpu_renderer_packet.h"
+#   undef CRP_ISA
+#   define CRP_ISA CRP_ISA_AVX2
+#   include "cpu_renderer_packet.h"
+#   undef CRP_ISA
+#   define CRP_ISA CRP_ISA_AVX512
+#   include "cpu_renderer_packet.h"
+#   undef CRP_ISA
+#endif //CPU_RENDERER_HAS_X86_PACKETS
+
+int CpuRenderer_IsIsaSupported(int isa) {
+    switch (isa) {
+    case CPU_RENDERER_ISA_SCALAR: return 1;
+#   ifdef CPU_RENDERER_HAS_X86_PACKETS
+    case CPU_RENDERER_ISA_SSE41:  return __builtin_cpu_supports("sse4.1") ? 1 : 0;
+    case CPU_RENDERER_ISA_AVX2:   return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? 1 : 0;
+    case CPU_RENDERER_ISA_AVX512: return __builtin_cpu_supports("avx512f") ? 1 : 0;
+#   endif //CPU_RENDERER_HAS_X86_PACKETS
+    default: break;
+    }
+    return 0;
+}
+int CpuRenderer_GetBestIsa(void) {
+    static int best = CPU_RENDERER_ISA_AUTO;    // cached (benign race: every thread computes the same value)
+    if (best==CPU_RENDERER_ISA_AUTO) {
+        int isa = CPU_RENDERER_ISA_COUNT-1;
+        while (isa>CPU_RENDERER_ISA_SCALAR && !CpuRenderer_IsIsaSupported(isa)) --isa;
+        best = isa;
+    }
+    return best;
+}
+const char* CpuRenderer_GetIsaName(int isa) {
+    switch (isa) {
+    case CPU_RENDERER_ISA_AUTO:   return "auto";
+    case CPU_RENDERER_ISA_SCALAR: return "scalar";
+    case CPU_RENDERER_ISA_SSE41:  return "sse4.1";
+    case CPU_RENDERER_ISA_AVX2:   return "avx2";
+    case CPU_RENDERER_ISA_AVX512: return "avx512";
+    default: break;
+    }
+    return "unknown";
+}
+int CpuRenderer_GetIsaPacketWidth(int isa) {
+    if (isa==CPU_RENDERER_ISA_AUTO) isa = CpuRenderer_GetBestIsa();
+    switch (isa) {
+    case CPU_RENDERER_ISA_SSE41:  return 4;
+    case CPU_RENDERER_ISA_AVX2:   return 8;
+    case CPU_RENDERER_ISA_AVX512: return 16;
+    default: break;
+    }
+    return 1;
+}
+
+void CpuRenderer_RenderTile(const CpuRenderer* r,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd) {
+    int x,y,isa = r->settings.isa;
+    if (xStart<0) xStart=0;
+    if (yStart<0) yStart=0;
+    if (xEnd>fb->width) xEnd=fb->width;
+    if (yEnd>fb->height) yEnd=fb->height;
+    if (isa==CPU_RENDERER_ISA_AUTO) isa = CpuRenderer_GetBestIsa();
+    else if (isa!=CPU_RENDERER_ISA_SCALAR && !CpuRenderer_IsIsaSupported(isa)) isa = CPU_RENDERER_ISA_SCALAR;
+#   ifdef CPU_RENDERER_HAS_X86_PACKETS
+    switch (isa) {
+    case CPU_RENDERER_ISA_SSE41:  cr_RenderTilePacket_sse41(r,fb,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX2:   cr_RenderTilePacket_avx2(r,fb,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX512: cr_RenderTilePacket_avx512(r,fb,xStart,yStart,xEnd,yEnd);return;
+    default: break;
+    }
+#   endif //CPU_RENDERER_HAS_X86_PACKETS
+    for (y=yStart;y<yEnd;y++) {
+        float* pColor = &fb->color[3*(y*fb->width+xStart)];
+        const float fragCoordY = (float)(fb->height-1-y)+0.5f;
+        for (x=xStart;x<xEnd;x++) {
+            const vec3_t col = CpuRenderer_RenderPixel(r,(float)x+0.5f,fragCoordY);
+            *pColor++ = col.x;*pColor++ = col.y;*pColor++ = col.z;
+        }
+    }
+}
+
+void CpuRenderer_RenderRows(const CpuRenderer* r,CpuFramebuffer* fb,int rowStart,int rowEnd) {
+    CpuRenderer_RenderTile(r,fb,0,rowStart,fb->width,rowEnd);
+}
+
+void CpuRenderer_RenderFrame(const CpuRenderer* r,CpuFramebuffer* fb) {
+    CpuRenderer_RenderRows(r,fb,0,fb->height);
+}
+
+typedef struct {
+    const CpuRenderer* r;
+    CpuFramebuffer* fb;
+    int tile_size,num_tiles_x;
+} cr_tiled_frame_t;
+static void cr_render_tile_task(int taskIndex,int workerIndex,void* userData) {
+    const cr_tiled_frame_t* tf = (const cr_tiled_frame_t*) userData;
+    const int x = (taskIndex%tf->num_tiles_x)*tf->tile_size;
+    const int y = (taskIndex/tf->num_tiles_x)*tf->tile_size;
+    (void)workerIndex;
+    CpuRenderer_RenderTile(tf->r,tf->fb,x,y,x+tf->tile_size,y+tf->tile_size);
+}
+void CpuRenderer_RenderFrameTiled(const CpuRenderer* r,CpuFramebuffer* fb,CpuScheduler* scheduler,int tileSize) {
+    cr_tiled_frame_t tf;
+    if (!scheduler) {CpuRenderer_RenderFrame(r,fb);return;}
+    if (tileSize<=0) tileSize = CPU_RENDERER_DEFAULT_TILE_SIZE;
+    tf.r = r;tf.fb = fb;tf.tile_size = tileSize;
+    tf.num_tiles_x = (fb->width+tileSize-1)/tileSize;
+    CpuScheduler_Run(scheduler,tf.num_tiles_x*((fb->height+tileSize-1)/tileSize),&cr_render_tile_task,&tf);
+}
+
+void CpuRenderer_RenderGBufferTile(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd) {
+    int x,y,isa = r->settings.isa;
+    if (xStart<0) xStart=0;
+    if (yStart<0) yStart=0;
+    if (xEnd>g->width) xEnd=g->width;
+    if (yEnd>g->height) yEnd=g->height;
+    if (isa==CPU_RENDERER_ISA_AUTO) isa = CpuRenderer_GetBestIsa();
+    else if (isa!=CPU_RENDERER_ISA_SCALAR && !CpuRenderer_IsIsaSupported(isa)) isa = CPU_RENDERER_ISA_SCALAR;
+#   ifdef CPU_RENDERER_HAS_X86_PACKETS
+    switch (isa) {
+    case CPU_RENDERER_ISA_SSE41:  cr_RenderGBufferTilePacket_sse41(r,g,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX2:   cr_RenderGBufferTilePacket_avx2(r,g,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX512: cr_RenderGBufferTilePacket_avx512(r,g,xStart,yStart,xEnd,yEnd);return;
+    default: break;
+    }
+#   endif //CPU_RENDERER_HAS_X86_PACKETS
+    for (y=yStart;y<yEnd;y++) {
+        for (x=xStart;x<xEnd;x++) cr_renderGBufferPixel(r,g,x,y);
+    }
+}
+void CpuRenderer_ShadeGBufferTile(const CpuRenderer* r,const CpuGBuffer* g,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd) {
+    int x,y,isa = r->settings.isa;
+    if (xStart<0) xStart=0;
+    if (yStart<0) yStart=0;
+    if (xEnd>fb->width) xEnd=fb->width;
+    if (yEnd>fb->height) yEnd=fb->height;
+    if (fb->width!=g->width || fb->height!=g->height) return;
+    if (isa==CPU_RENDERER_ISA_AUTO) isa = CpuRenderer_GetBestIsa();
+    else if (isa!=CPU_RENDERER_ISA_SCALAR && !CpuRenderer_IsIsaSupported(isa)) isa = CPU_RENDERER_ISA_SCALAR;
+#   ifdef CPU_RENDERER_HAS_X86_PACKETS
+    switch (isa) {
+    case CPU_RENDERER_ISA_SSE41:  cr_ShadeGBufferTilePacket_sse41(r,g,fb,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX2:   cr_ShadeGBufferTilePacket_avx2(r,g,fb,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX512: cr_ShadeGBufferTilePacket_avx512(r,g,fb,xStart,yStart,xEnd,yEnd);return;
+    default: break;
+    }
+#   endif //CPU_RENDERER_HAS_X86_PACKETS
+    for (y=yStart;y<yEnd;y++) {
+        float* pColor = &fb->color[3*(y*fb->width+xStart)];
+        for (x=xStart;x<xEnd;x++) {
+            const vec3_t col = cr_shadeGBufferPixel(r,g,x,y);
+            *pColor++ = col.x;*pColor++ = col.y;*pColor++ = col.z;
+        }
+    }
+}
+
+void CpuRenderer_RenderGBufferOcclusionTile(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd) {
+    int x,y,isa = r->settings.isa;
+    if (!g->occlusion) return;
+    if (xStart<0) xStart=0;
+    if (yStart<0) yStart=0;
+    if (xEnd>g->occlusion_width) xEnd=g->occlusion_width;
+    if (yEnd>g->occlusion_height) yEnd=g->occlusion_height;
+    if (isa==CPU_RENDERER_ISA_AUTO) isa = CpuRenderer_GetBestIsa();
+    else if (isa!=CPU_RENDERER_ISA_SCALAR && !CpuRenderer_IsIsaSupported(isa)) isa = CPU_RENDERER_ISA_SCALAR;
+#   ifdef CPU_RENDERER_HAS_X86_PACKETS
+    switch (isa) {
+    case CPU_RENDERER_ISA_SSE41:  cr_RenderOcclusionTilePacket_sse41(r,g,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX2:   cr_RenderOcclusionTilePacket_avx2(r,g,xStart,yStart,xEnd,yEnd);return;
+    case CPU_RENDERER_ISA_AVX512: cr_RenderOcclusionTilePacket_avx512(r,g,xStart,yStart,xEnd,yEnd);return;
+    default: break;
+    }
+#   endif //CPU_RENDERER_HAS_X86_PACKETS
+    for (y=yStart;y<yEnd;y++) {
+        for (x=xStart;x<xEnd;x++) cr_renderOcclusionSample(r,g,x,y);
+    }
+}
+
+typedef enum {
+    CR_DEFERRED_PASS_GBUFFER = 0,
+    CR_DEFERRED_PASS_OCCLUSION,     // (tiles of the low-resolution occlusion terms)
+    CR_DEFERRED_PASS_SHADING
+} cr_deferred_pass_t;
+typedef struct {
+    const CpuRenderer* r;
+    CpuGBuffer* g;
+    CpuFramebuffer* fb;     // CR_DEFERRED_PASS_SHADING only
+    int pass;               // cr_deferred_pass_t
+    int tile_size,num_tiles_x;
+} cr_deferred_frame_t;
+static void cr_deferred_tile_task(int taskIndex,int workerIndex,void* userData) {
+    const cr_deferred_frame_t* df = (const cr_deferred_frame_t*) userData;
+    const int x = (taskIndex%df->num_tiles_x)*df->tile_size;
+    const int y = (taskIndex/df->num_tiles_x)*df->tile_size;
+    (void)workerIndex;
+    if (df->pass==CR_DEFERRED_PASS_SHADING) CpuRenderer_ShadeGBufferTile(df->r,df->g,df->fb,x,y,x+df->tile_size,y+df->tile_size);
+    else if (df->pass==CR_DEFERRED_PASS_OCCLUSION) CpuRenderer_RenderGBufferOcclusionTile(df->r,df->g,x,y,x+df->tile_size,y+df->tile_size);
+    else CpuRenderer_RenderGBufferTile(df->r,df->g,x,y,x+df->tile_size,y+df->tile_size);
+}
+static void cr_runDeferredPass(const CpuRenderer* r,CpuGBuffer* g,CpuFramebuffer* fb,int pass,CpuScheduler* scheduler,int tileSize) {
+    const int width = pass==CR_DEFERRED_PASS_OCCLUSION ? g->occlusion_width : g->width;
+    const int height = pass==CR_DEFERRED_PASS_OCCLUSION ? g->occlusion_height : g->height;
+    cr_deferred_frame_t df;
+    if (tileSize<=0) tileSize = CPU_RENDERER_DEFAULT_TILE_SIZE;
+    df.r = r;df.g = g;df.fb = fb;df.pass = pass;df.tile_size = tileSize;
+    df.num_tiles_x = (width+tileSize-1)/tileSize;
+    if (scheduler) CpuScheduler_Run(scheduler,df.num_tiles_x*((height+tileSize-1)/tileSize),&cr_deferred_tile_task,&df);
+    else {
+        // (a single tile)
+        df.tile_size = width>height ? width : height;df.num_tiles_x = 1;
+        cr_deferred_tile_task(0,0,&df);
+    }
+}
+void CpuRenderer_RenderGBuffer(const CpuRenderer* r,CpuGBuffer* g,CpuScheduler* scheduler,int tileSize) {
+    cr_runDeferredPass(r,g,NULL,CR_DEFERRED_PASS_GBUFFER,scheduler,tileSize);
+}
+void CpuRenderer_RenderGBufferOcclusion(const CpuRenderer* r,CpuGBuffer* g,CpuScheduler* scheduler,int tileSize) {
+    if (g->occlusion) cr_runDeferredPass(r,g,NULL,CR_DEFERRED_PASS_OCCLUSION,scheduler,tileSize);
+}
+void CpuRenderer_ShadeGBuffer(const CpuRenderer* r,const CpuGBuffer* g,CpuFramebuffer* fb,CpuScheduler* scheduler,int tileSize) {
+    cr_runDeferredPass(r,(CpuGBuffer*)g,fb,CR_DEFERRED_PASS_SHADING,scheduler,tileSize);     // (the shading pass only reads g)
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CPU_RENDERER_IMPLEMENTATION_GUARD
+#endif //CPU_RENDERER_IMPLEMENTATION
@@ -0,0 +1,880 @@
+/* Internal file of "cpu_renderer.h": don't include it directly.
+ *
+ * It's included by the implementation of "cpu_renderer.h" once for every supported SIMD
+ * instruction set (CRP_ISA = CRP_ISA_SSE41, CRP_ISA_AVX2 or CRP_ISA_AVX512) and it defines the
+ * packet (structure-of-arrays) version of map(), castRay(), calcNormal(), softshadow() and calcAO():
+ * CRP_W rays are marched together and every lane has its own active mask, so that finished rays
+ * stop updating while the others keep marching.
+ * Every function is compiled with __attribute__((target(...))), so that a single binary can
+ * contain all the code paths (the right one is picked at runtime by CpuRenderer_RenderTile(...)).
+ * Transcendental functions (sin, cos, atan2, pow, exp) have no SIMD instruction: they're evaluated lane by lane.
+*/
+
+#if CRP_ISA==CRP_ISA_SSE41
+#   define CRP_W 4
+#   define CRP_TARGET __attribute__((target("sse4.1")))
+#   define CRP(name) name##_sse41
+#   define crp_f __m128
+#   define crp_m __m128
+#   define crp_set1(v)          _mm_set1_ps(v)
+#   define crp_loadu(p)         _mm_loadu_ps(p)
+#   define crp_storeu(p,v)      _mm_storeu_ps(p,v)
+#   define crp_add(a,b)         _mm_add_ps(a,b)
+#   define crp_sub(a,b)         _mm_sub_ps(a,b)
+#   define crp_mul(a,b)         _mm_mul_ps(a,b)
+#   define crp_div(a,b)         _mm_div_ps(a,b)
+#   define crp_min(a,b)         _mm_min_ps(a,b)
+#   define crp_max(a,b)         _mm_max_ps(a,b)
+#   define crp_sqrt(a)          _mm_sqrt_ps(a)
+#   define crp_abs(a)           _mm_andnot_ps(_mm_set1_ps(-0.f),a)
+#   define crp_neg(a)           _mm_xor_ps(a,_mm_set1_ps(-0.f))
+#   define crp_floor(a)         _mm_floor_ps(a)
+#   define crp_lt(a,b)          _mm_cmplt_ps(a,b)
+#   define crp_gt(a,b)          _mm_cmpgt_ps(a,b)
+#   define crp_m_and(a,b)       _mm_and_ps(a,b)
+#   define crp_m_or(a,b)        _mm_or_ps(a,b)
+#   define crp_m_andnot(a,b)    _mm_andnot_ps(b,a)      // a & ~b
+#   define crp_m_bits(m)        _mm_movemask_ps(m)
+#   define crp_select(m,a,b)    _mm_blendv_ps(b,a,m)    // m ? a : b
+#elif CRP_ISA==CRP_ISA_AVX2
+#   define CRP_W 8
+#   define CRP_TARGET __attribute__((target("avx2,fma")))
+#   define CRP(name) name##_avx2
+#   define crp_f __m256
+#   define crp_m __m256
+#   define crp_set1(v)          _mm256_set1_ps(v)
+#   define crp_loadu(p)         _mm256_loadu_ps(p)
+#   define crp_storeu(p,v)      _mm256_storeu_ps(p,v)
+#   define crp_add(a,b)         _mm256_add_ps(a,b)
+#   define crp_sub(a,b)         _mm256_sub_ps(a,b)
+#   define crp_mul(a,b)         _mm256_mul_ps(a,b)
+#   define crp_div(a,b)         _mm256_div_ps(a,b)
+#   define crp_min(a,b)         _mm256_min_ps(a,b)
+#   define crp_max(a,b)         _mm256_max_ps(a,b)
+#   define crp_sqrt(a)          _mm256_sqrt_ps(a)
+#   define crp_abs(a)           _mm256_andnot_ps(_mm256_set1_ps(-0.f),a)
+#   define crp_neg(a)           _mm256_xor_ps(a,_mm256_set1_ps(-0.f))
+#   define crp_floor(a)         _mm256_floor_ps(a)
+#   define crp_lt(a,b)          _mm256_cmp_ps(a,b,_CMP_LT_OQ)
+#   define crp_gt(a,b)          _mm256_cmp_ps(a,b,_CMP_GT_OQ)
+#   define crp_m_and(a,b)       _mm256_and_ps(a,b)
+#   define crp_m_or(a,b)        _mm256_or_ps(a,b)
+#   define crp_m_andnot(a,b)    _mm256_andnot_ps(b,a)   // a & ~b
+#   define crp_m_bits(m)        _mm256_movemask_ps(m)
+#   define crp_select(m,a,b)    _mm256_blendv_ps(b,a,m) // m ? a : b
+#elif CRP_ISA==CRP_ISA_AVX512
+#   define CRP_W 16
+#   define CRP_TARGET __attribute__((target("avx512f")))
+#   define CRP(name) name##_avx512
+#   define crp_f __m512
+#   define crp_m __mmask16
+#   define crp_set1(v)          _mm512_set1_ps(v)
+#   define crp_loadu(p)         _mm512_loadu_ps(p)
+#   define crp_storeu(p,v)      _mm512_storeu_ps(p,v)
+#   define crp_add(a,b)         _mm512_add_ps(a,b)
+#   define crp_sub(a,b)         _mm512_sub_ps(a,b)
+#   define crp_mul(a,b)         _mm512_mul_ps(a,b)
+#   define crp_div(a,b)         _mm512_div_ps(a,b)
+#   define crp_min(a,b)         _mm512_min_ps(a,b)
+#   define crp_max(a,b)         _mm512_max_ps(a,b)
+#   define crp_sqrt(a)          _mm512_sqrt_ps(a)
+#   define crp_abs(a)           _mm512_abs_ps(a)
+#   define crp_neg(a)           _mm512_sub_ps(_mm512_setzero_ps(),a)
+#   define crp_floor(a)         _mm512_roundscale_ps(a,_MM_FROUND_TO_NEG_INF|_MM_FROUND_NO_EXC)
+#   define crp_lt(a,b)          _mm512_cmp_ps_mask(a,b,_CMP_LT_OQ)
+#   define crp_gt(a,b)          _mm512_cmp_ps_mask(a,b,_CMP_GT_OQ)
+#   define crp_m_and(a,b)       ((__mmask16)((a)&(b)))
+#   define crp_m_or(a,b)        ((__mmask16)((a)|(b)))
+#   define crp_m_andnot(a,b)    ((__mmask16)((a)&~(b)))  // a & ~b
+#   define crp_m_bits(m)        ((int)(m))
+#   define crp_select(m,a,b)    _mm512_mask_blend_ps(m,b,a) // m ? a : b
+#else
+#   error "cpu_renderer_packet.h: unknown CRP_ISA"
+#endif
+
+#define crp_v3 CRP(crp_v3_t)
+typedef struct {crp_f x,y,z;} crp_v3;
+
+// Helpers------------------------------------------------------------------
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_set)(float x,float y,float z) {crp_v3 v;v.x=crp_set1(x);v.y=crp_set1(y);v.z=crp_set1(z);return v;}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_add)(crp_v3 a,crp_v3 b) {crp_v3 v;v.x=crp_add(a.x,b.x);v.y=crp_add(a.y,b.y);v.z=crp_add(a.z,b.z);return v;}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_sub)(crp_v3 a,crp_v3 b) {crp_v3 v;v.x=crp_sub(a.x,b.x);v.y=crp_sub(a.y,b.y);v.z=crp_sub(a.z,b.z);return v;}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_subc)(crp_v3 a,float x,float y,float z) {crp_v3 v;v.x=crp_sub(a.x,crp_set1(x));v.y=crp_sub(a.y,crp_set1(y));v.z=crp_sub(a.z,crp_set1(z));return v;}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_muls)(crp_v3 a,crp_f s) {crp_v3 v;v.x=crp_mul(a.x,s);v.y=crp_mul(a.y,s);v.z=crp_mul(a.z,s);return v;}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_abs)(crp_v3 a) {crp_v3 v;v.x=crp_abs(a.x);v.y=crp_abs(a.y);v.z=crp_abs(a.z);return v;}
+static __inline CRP_TARGET crp_f CRP(crp_v3_dot)(crp_v3 a,crp_v3 b) {return crp_add(crp_add(crp_mul(a.x,b.x),crp_mul(a.y,b.y)),crp_mul(a.z,b.z));}
+static __inline CRP_TARGET crp_f CRP(crp_v3_length)(crp_v3 a) {return crp_sqrt(CRP(crp_v3_dot)(a,a));}
+static __inline CRP_TARGET crp_v3 CRP(crp_v3_norm)(crp_v3 a) {return CRP(crp_v3_muls)(a,crp_div(crp_set1(1.f),CRP(crp_v3_length)(a)));}
+static __inline CRP_TARGET crp_f CRP(crp_length2d)(crp_f x,crp_f y) {return crp_sqrt(crp_add(crp_mul(x,x),crp_mul(y,y)));}
+static __inline CRP_TARGET crp_f CRP(crp_clamp)(crp_f x,float a,float b) {return crp_min(crp_max(x,crp_set1(a)),crp_set1(b));}
+static __inline CRP_TARGET crp_f CRP(crp_lanes1)(crp_f x,float (*fn)(float)) {
+    float a[CRP_W];int l;
+    crp_storeu(a,x);
+    for (l=0;l<CRP_W;l++) a[l] = fn(a[l]);
+    return crp_loadu(a);
+}
+static __inline CRP_TARGET crp_f CRP(crp_lanes2)(crp_f x,crp_f y,float (*fn)(float,float)) {
+    float a[CRP_W],b[CRP_W];int l;
+    crp_storeu(a,x);crp_storeu(b,y);
+    for (l=0;l<CRP_W;l++) a[l] = fn(a[l],b[l]);
+    return crp_loadu(a);
+}
+// length(max(vec2(d1,d2),0.0)) + min(max(d1,d2), 0.) (used by many distance functions)
+static __inline CRP_TARGET crp_f CRP(crp_max2_dist)(crp_f d1,crp_f d2) {
+    const crp_f zero = crp_set1(0.f);
+    return crp_add(CRP(crp_length2d)(crp_max(d1,zero),crp_max(d2,zero)),crp_min(crp_max(d1,d2),zero));
+}
+
+// Distance functions-------------------------------------------------------
+static __inline CRP_TARGET crp_f CRP(crp_sdSphere)(crp_v3 p,float s) {return crp_sub(CRP(crp_v3_length)(p),crp_set1(s));}
+static __inline CRP_TARGET crp_f CRP(crp_sdBox)(crp_v3 p,float bx,float by,float bz) {
+    const crp_f zero = crp_set1(0.f);
+    const crp_f dx = crp_sub(crp_abs(p.x),crp_set1(bx)), dy = crp_sub(crp_abs(p.y),crp_set1(by)), dz = crp_sub(crp_abs(p.z),crp_set1(bz));
+    crp_v3 dp;dp.x = crp_max(dx,zero);dp.y = crp_max(dy,zero);dp.z = crp_max(dz,zero);
+    return crp_add(crp_min(crp_max(dx,crp_max(dy,dz)),zero),CRP(crp_v3_length)(dp));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdEllipsoid)(crp_v3 p,float rx,float ry,float rz) {
+    crp_v3 q;q.x = crp_div(p.x,crp_set1(rx));q.y = crp_div(p.y,crp_set1(ry));q.z = crp_div(p.z,crp_set1(rz));
+    return crp_mul(crp_sub(CRP(crp_v3_length)(q),crp_set1(1.f)),crp_set1(cr_min(cr_min(rx,ry),rz)));
+}
+static __inline CRP_TARGET crp_f CRP(crp_udRoundBox)(crp_v3 p,float bx,float by,float bz,float r) {
+    const crp_f zero = crp_set1(0.f);
+    crp_v3 q;q.x = crp_max(crp_sub(crp_abs(p.x),crp_set1(bx)),zero);q.y = crp_max(crp_sub(crp_abs(p.y),crp_set1(by)),zero);q.z = crp_max(crp_sub(crp_abs(p.z),crp_set1(bz)),zero);
+    return crp_sub(CRP(crp_v3_length)(q),crp_set1(r));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdTorus)(crp_v3 p,float tx,float ty) {
+    return crp_sub(CRP(crp_length2d)(crp_sub(CRP(crp_length2d)(p.x,p.z),crp_set1(tx)),p.y),crp_set1(ty));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdHexPrism)(crp_v3 p,float hx,float hy) {
+    const crp_v3 q = CRP(crp_v3_abs)(p);
+    const crp_f d1 = crp_sub(q.z,crp_set1(hy));
+    const crp_f d2 = crp_sub(crp_max(crp_add(crp_mul(q.x,crp_set1(0.866025f)),crp_mul(q.y,crp_set1(0.5f))),q.y),crp_set1(hx));
+    return CRP(crp_max2_dist)(d1,d2);
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdCapsule)(crp_v3 p,vec3_t a,vec3_t b,float r) {
+    const crp_v3 pa = CRP(crp_v3_subc)(p,a.x,a.y,a.z);
+    const vec3_t ba = v3_sub(b,a);
+    const crp_f h = CRP(crp_clamp)(crp_mul(CRP(crp_v3_dot)(pa,CRP(crp_v3_set)(ba.x,ba.y,ba.z)),crp_set1(1.f/v3_dot(ba,ba))),0.f,1.f);
+    return crp_sub(CRP(crp_v3_length)(CRP(crp_v3_sub)(pa,CRP(crp_v3_muls)(CRP(crp_v3_set)(ba.x,ba.y,ba.z),h))),crp_set1(r));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdTriPrism)(crp_v3 p,float hx,float hy) {
+    const crp_f d1 = crp_sub(crp_abs(p.z),crp_set1(hy));
+    const crp_f d2 = crp_sub(crp_max(crp_add(crp_mul(crp_abs(p.x),crp_set1(0.866025f)),crp_mul(p.y,crp_set1(0.5f))),crp_neg(p.y)),crp_set1(hx*0.5f));
+    return CRP(crp_max2_dist)(d1,d2);
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdCylinder)(crp_v3 p,float hx,float hy) {
+    const crp_f zero = crp_set1(0.f);
+    const crp_f dx = crp_sub(CRP(crp_length2d)(p.x,p.z),crp_set1(hx));
+    const crp_f dy = crp_sub(crp_abs(p.y),crp_set1(hy));
+    return crp_add(crp_min(crp_max(dx,dy),zero),CRP(crp_length2d)(crp_max(dx,zero),crp_max(dy,zero)));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdCone)(crp_v3 p,vec3_t c) {
+    const crp_f qx = CRP(crp_length2d)(p.x,p.z);
+    const crp_f d1 = crp_sub(crp_neg(p.y),crp_set1(c.z));
+    const crp_f d2 = crp_max(crp_add(crp_mul(qx,crp_set1(c.x)),crp_mul(p.y,crp_set1(c.y))),p.y);
+    return CRP(crp_max2_dist)(d1,d2);
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdConeSection)(crp_v3 p,float h,float r1,float r2) {
+    const float si = 0.5f*(r1-r2)/h;
+    const crp_f d1 = crp_sub(crp_neg(p.y),crp_set1(h));
+    const crp_f q = crp_sub(p.y,crp_set1(h));
+    const crp_f d2 = crp_max(crp_sub(crp_add(crp_sqrt(crp_mul(crp_add(crp_mul(p.x,p.x),crp_mul(p.z,p.z)),crp_set1(1.f-si*si))),crp_mul(q,crp_set1(si))),crp_set1(r2)),q);
+    return CRP(crp_max2_dist)(d1,d2);
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdPryamid4)(crp_v3 p,vec3_t h) {
+    const crp_f box = CRP(crp_sdBox)(CRP(crp_v3_subc)(p,0.f,-2.f*h.z,0.f),2.f*h.z,2.f*h.z,2.f*h.z);
+    const crp_f hx = crp_set1(h.x), hyy = crp_mul(p.y,crp_set1(h.y));
+    crp_f d = crp_set1(0.f);
+    d = crp_max( d, crp_abs(crp_add(crp_neg(crp_mul(p.x,hx)),hyy)) );
+    d = crp_max( d, crp_abs(crp_add(crp_mul(p.x,hx),hyy)) );
+    d = crp_max( d, crp_abs(crp_add(hyy,crp_mul(p.z,hx))) );
+    d = crp_max( d, crp_abs(crp_sub(hyy,crp_mul(p.z,hx))) );
+    return crp_max(crp_neg(box),crp_sub(d,crp_set1(h.z)));
+}
+static __inline CRP_TARGET crp_f CRP(crp_length6)(crp_f x,crp_f y) {
+    x = crp_mul(crp_mul(x,x),x);x = crp_mul(x,x);
+    y = crp_mul(crp_mul(y,y),y);y = crp_mul(y,y);
+    return CRP(crp_lanes1)(crp_add(x,y),&cr_pow_one_sixth);
+}
+static __inline CRP_TARGET crp_f CRP(crp_length8)(crp_f x,crp_f y) {
+    x = crp_mul(x,x);x = crp_mul(x,x);x = crp_mul(x,x);
+    y = crp_mul(y,y);y = crp_mul(y,y);y = crp_mul(y,y);
+    return crp_sqrt(crp_sqrt(crp_sqrt(crp_add(x,y))));  // pow(x+y,1.0/8.0)
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdTorus82)(crp_v3 p,float tx,float ty) {
+    return crp_sub(CRP(crp_length8)(crp_sub(CRP(crp_length2d)(p.x,p.z),crp_set1(tx)),p.y),crp_set1(ty));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdTorus88)(crp_v3 p,float tx,float ty) {
+    return crp_sub(CRP(crp_length8)(crp_sub(CRP(crp_length8)(p.x,p.z),crp_set1(tx)),p.y),crp_set1(ty));
+}
+static __inline CRP_TARGET crp_f CRP(crp_sdCylinder6)(crp_v3 p,float hx,float hy) {
+    return crp_max(crp_sub(CRP(crp_length6)(p.x,p.z),crp_set1(hx)),crp_sub(crp_abs(p.y),crp_set1(hy)));
+}
+static __inline CRP_TARGET crp_f CRP(crp_mod)(crp_f x,float y) {return crp_sub(x,crp_mul(crp_set1(y),crp_floor(crp_div(x,crp_set1(y)))));}
+static __inline CRP_TARGET crp_f CRP(crp_smin)(crp_f a,crp_f b,float k) {
+    const crp_f h = CRP(crp_clamp)(crp_add(crp_set1(0.5f),crp_mul(crp_set1(0.5f/k),crp_sub(b,a))),0.f,1.f);
+    // mix( b, a, h ) - k*h*(1.0-h)
+    return crp_sub(crp_add(b,crp_mul(crp_sub(a,b),h)),crp_mul(crp_mul(crp_set1(k),h),crp_sub(crp_set1(1.f),h)));
+}
+static __inline CRP_TARGET void CRP(crp_opU)(crp_f* d,crp_f* m,crp_f d2,float m2) {
+    const crp_m keep = crp_lt(*d,d2);
+    *m = crp_select(keep,*m,crp_set1(m2));
+    *d = crp_select(keep,*d,d2);
+}
+
+// Data-driven scene (same as cr_mapScene(...))-----------------------------
+static CRP_TARGET crp_f CRP(crp_sdScenePrimitive)(int type,crp_v3 p,const float* a) {
+    switch (type) {
+    case SDF_PRIMITIVE_PLANE:           return p.y;
+    case SDF_PRIMITIVE_SPHERE:          return CRP(crp_sdSphere)(p,a[0]);
+    case SDF_PRIMITIVE_BOX:             return CRP(crp_sdBox)(p,a[0],a[1],a[2]);
+    case SDF_PRIMITIVE_ROUND_BOX:       return CRP(crp_udRoundBox)(p,a[0],a[1],a[2],a[3]);
+    case SDF_PRIMITIVE_TORUS:           return CRP(crp_sdTorus)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_CAPSULE:         return CRP(crp_sdCapsule)(p,vec3(0.f,0.f,0.f),vec3(a[0],a[1],a[2]),a[3]);
+    case SDF_PRIMITIVE_TRI_PRISM:       return CRP(crp_sdTriPrism)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_CYLINDER:        return CRP(crp_sdCylinder)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_CONE:            return CRP(crp_sdCone)(p,vec3(a[0],a[1],a[2]));
+    case SDF_PRIMITIVE_TORUS82:         return CRP(crp_sdTorus82)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_TORUS88:         return CRP(crp_sdTorus88)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_CYLINDER6:       return CRP(crp_sdCylinder6)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_HEX_PRISM:       return CRP(crp_sdHexPrism)(p,a[0],a[1]);
+    case SDF_PRIMITIVE_PYRAMID4:        return CRP(crp_sdPryamid4)(p,vec3(a[0],a[1],a[2]));
+    case SDF_PRIMITIVE_CONE_SECTION:    return CRP(crp_sdConeSection)(p,a[0],a[1],a[2]);
+    case SDF_PRIMITIVE_ELLIPSOID:       return CRP(crp_sdEllipsoid)(p,a[0],a[1],a[2]);
+    default:                            return crp_set1(1e10f);
+    }
+}
+// The objects of primitives[0..numPrimitives)
+static CRP_TARGET void CRP(crp_mapScenePrimitives)(crp_v3 pos,const SdfPrimitive* primitives,int numPrimitives,crp_f* pd,crp_f* pm) {
+    crp_f d = crp_set1(1e10f), m = crp_set1(-1.f);
+    crp_f objDist = crp_set1(1e10f);    // current object (see SdfOp)
+    float objMat = -1.f;
+    int i;
+    for (i=0;i<numPrimitives;i++) {
+        const SdfPrimitive* prim = &primitives[i];
+        const float* mp = prim->modifier_params;
+        crp_v3 p = CRP(crp_v3_subc)(pos,prim->position[0],prim->position[1],prim->position[2]);
+        crp_f dist;
+        if (prim->modifier==SDF_MODIFIER_TWIST) {
+            const crp_f a = crp_add(crp_mul(crp_set1(mp[0]),p.y),crp_set1(mp[1]));
+            const crp_f c = CRP(crp_lanes1)(a,&cosf), s = CRP(crp_lanes1)(a,&sinf);
+            crp_v3 tw;
+            tw.x = crp_add(crp_mul(c,p.x),crp_mul(s,p.z));
+            tw.y = crp_sub(crp_mul(c,p.z),crp_mul(s,p.x));
+            tw.z = p.y;
+            p = tw;
+        }
+        else if (prim->modifier==SDF_MODIFIER_POLAR_REPEAT) {
+            const crp_f len = CRP(crp_v3_length)(p);
+            p.x = crp_sub(CRP(crp_mod)(crp_div(CRP(crp_lanes2)(p.x,p.z,&atan2f),crp_set1(6.2831f)),mp[0]),crp_set1(0.5f*mp[0]));
+            p.z = crp_sub(CRP(crp_mod)(crp_add(crp_set1(mp[2]),crp_mul(crp_set1(mp[3]),len)),mp[1]),crp_set1(0.5f*mp[1]));
+        }
+        else if (prim->modifier==SDF_MODIFIER_REPEAT) {
+            p.x = crp_sub(CRP(crp_mod)(p.x,mp[0]),crp_set1(0.5f*mp[0]));
+            p.y = crp_sub(CRP(crp_mod)(p.y,mp[1]),crp_set1(0.5f*mp[1]));
+            p.z = crp_sub(CRP(crp_mod)(p.z,mp[2]),crp_set1(0.5f*mp[2]));
+        }
+        dist = CRP(crp_sdScenePrimitive)(prim->type,p,prim->params);
+        if (prim->modifier==SDF_MODIFIER_TWIST) dist = crp_mul(dist,crp_set1(mp[2]));
+        else if (prim->modifier==SDF_MODIFIER_DISPLACE) {
+            const crp_f f = crp_set1(mp[1]);
+            dist = crp_add(crp_mul(dist,crp_set1(mp[2])),
+                           crp_mul(crp_mul(crp_mul(crp_set1(mp[0]),CRP(crp_lanes1)(crp_mul(f,pos.x),&sinf)),
+                                           CRP(crp_lanes1)(crp_mul(f,pos.y),&sinf)),CRP(crp_lanes1)(crp_mul(f,pos.z),&sinf)));
+        }
+
+        switch (prim->op) {
+        case SDF_OP_SUBTRACT:       objDist = crp_max(crp_neg(dist),objDist);break;
+        case SDF_OP_INTERSECT:      objDist = crp_max(objDist,dist);break;
+        case SDF_OP_SMOOTH_UNION:   objDist = CRP(crp_smin)(objDist,dist,prim->blend);break;
+        default:
+            CRP(crp_opU)(&d,&m,objDist,objMat);
+            objDist = dist;objMat = prim->material;
+            break;
+        }
+    }
+    CRP(crp_opU)(&d,&m,objDist,objMat);
+    *pd = d;
+    *pm = m;
+}
+static CRP_TARGET void CRP(crp_mapScene)(const CpuRenderer* r,crp_v3 pos,crp_f* pd,crp_f* pm) {
+    crp_f m;
+    CRP(crp_mapScenePrimitives)(pos,r->scene->primitives,cr_getNumScenePrimitives(r),pd,&m);
+    if (pm) *pm = m;
+}
+// A node is skipped when it's farther than the distance found so far for all the lanes
+static CRP_TARGET void CRP(crp_mapSceneBvh)(const CpuRenderer* r,crp_v3 pos,crp_f* pd,crp_f* pm) {
+    const SdfBvh* b = r->scene_bvh;
+    const int numNodes = r->settings.reduce_num_objects ? b->num_reduced_nodes : b->num_nodes;
+    const crp_f zero = crp_set1(0.f);
+    crp_f d = crp_set1(1e10f), m = crp_set1(-1.f);
+    int node = 0;
+    while (node<numNodes) {
+        const SdfBvhNode* n = &b->nodes[node];
+        const crp_f dx = crp_max(crp_max(crp_sub(crp_set1(n->min[0]),pos.x),crp_sub(pos.x,crp_set1(n->max[0]))),zero);
+        const crp_f dy = crp_max(crp_max(crp_sub(crp_set1(n->min[1]),pos.y),crp_sub(pos.y,crp_set1(n->max[1]))),zero);
+        const crp_f dz = crp_max(crp_max(crp_sub(crp_set1(n->min[2]),pos.z),crp_sub(pos.z,crp_set1(n->max[2]))),zero);
+        const crp_f boxDist = crp_sqrt(crp_add(crp_add(crp_mul(dx,dx),crp_mul(dy,dy)),crp_mul(dz,dz)));
+        if (!crp_m_bits(crp_lt(boxDist,d))) node = n->skip;
+        else {
+            if (n->first_primitive>=0) {
+                crp_f od,om;
+                crp_m keep;
+                CRP(crp_mapScenePrimitives)(pos,&b->primitives[n->first_primitive],n->num_primitives,&od,&om);
+                keep = crp_lt(d,od);    // (opU(...))
+                m = crp_select(keep,m,om);
+                d = crp_select(keep,d,od);
+            }
+            ++node;
+        }
+    }
+    *pd = d;
+    if (pm) *pm = m;
+}
+
+// The lanes are grouped by cell, and the (sorted) lists of their cells are merged: every object is evaluated once for the
+// whole packet, and kept for the lanes of the cells that list it (rd = NULL for map(), the ray directions for mapRay())
+static CRP_TARGET void CRP(crp_mapSceneGrid)(const CpuRenderer* r,crp_v3 pos,const crp_v3* rd,crp_f* pd,crp_f* pm) {
+    const SdfGrid* g = r->scene_grid;
+    const int endObject = r->settings.reduce_num_objects ? g->num_reduced_objects : g->num_objects;
+    const crp_f zero = crp_set1(0.f), cs = crp_set1(g->cell_size), ics = crp_set1(1.f/g->cell_size);
+    const crp_f p[3] = {pos.x,pos.y,pos.z};
+    const crp_f dir[3] = {rd ? rd->x : zero,rd ? rd->y : zero,rd ? rd->z : zero};
+    float cellCoords[3][CRP_W],inCell[CRP_W];
+    int cells[CRP_W],heads[CRP_W],ends[CRP_W],numGroups = 0,j,l,k;
+    crp_m groupMasks[CRP_W],inside = crp_gt(cs,zero);
+    crp_f freeIn = crp_set1(1e10f), freeOut = crp_set1(1e10f), boxDist2 = zero, tNear = crp_set1(-1e10f), tFar = crp_set1(1e10f);
+    crp_f d,m;
+    CRP(crp_mapScenePrimitives)(pos,g->primitives,r->settings.reduce_num_objects ? g->num_reduced_unbounded_primitives : g->num_unbounded_primitives,&d,&m);
+    // Same as cr_getGridCell(...), for all the lanes
+    for (j=0;j<3;j++) {
+        const crp_f origin = crp_set1(g->origin[j]), res = crp_set1((float)g->resolution[j]);
+        const crp_f c = crp_mul(crp_sub(p[j],origin),ics), cell = crp_floor(c);
+        const crp_f lo = crp_add(origin,crp_mul(cell,cs)), hi = crp_add(lo,cs);
+        const crp_f gridHi = crp_add(origin,crp_mul(res,cs));
+        inside = crp_m_and(crp_m_andnot(inside,crp_lt(c,zero)),crp_lt(c,res));
+        crp_storeu(cellCoords[j],cell);
+        if (rd) {
+            const crp_m neg = crp_lt(dir[j],zero);
+            const crp_f ird = crp_div(crp_set1(1.f),crp_max(crp_abs(dir[j]),crp_set1(1e-8f)));
+            const crp_f t0 = crp_mul(crp_select(neg,crp_sub(p[j],origin),crp_sub(origin,p[j])),ird);  // (signed: the slabs of the grid)
+            const crp_f t1 = crp_mul(crp_select(neg,crp_sub(p[j],gridHi),crp_sub(gridHi,p[j])),ird);
+            freeIn = crp_min(freeIn,crp_mul(crp_select(neg,crp_sub(p[j],lo),crp_sub(hi,p[j])),ird));
+            tNear = crp_max(tNear,crp_min(t0,t1));tFar = crp_min(tFar,crp_max(t0,t1));
+        }
+        else {
+            const crp_f o = crp_max(crp_max(crp_sub(origin,p[j]),crp_sub(p[j],gridHi)),zero);
+            freeIn = crp_min(freeIn,crp_min(crp_sub(p[j],lo),crp_sub(hi,p[j])));
+            boxDist2 = crp_add(boxDist2,crp_mul(o,o));
+        }
+    }
+    if (rd) freeOut = crp_select(crp_m_andnot(crp_gt(tFar,zero),crp_gt(tNear,tFar)),crp_max(tNear,zero),freeOut);
+    else freeOut = crp_sqrt(boxDist2);
+    crp_storeu(inCell,crp_select(inside,crp_set1(1.f),zero));
+    for (l=0;l<CRP_W;l++) {
+        cells[l] = inCell[l]>0.f ? (int)cellCoords[0][l]+g->resolution[0]*((int)cellCoords[1][l]+g->resolution[1]*(int)cellCoords[2][l]) : -1;
+    }
+    for (l=0;l<CRP_W;l++) {
+        const int cell = cells[l];
+        if (cell<0) continue;
+        for (k=0;k<CRP_W;k++) {
+            inCell[k] = cells[k]==cell ? 1.f : 0.f;
+            if (k>l && cells[k]==cell) cells[k] = -1;   // (same group)
+        }
+        groupMasks[numGroups] = crp_gt(crp_loadu(inCell),zero);
+        heads[numGroups] = g->cell_offsets[cell];
+        ends[numGroups] = g->cell_offsets[cell+1];
+        ++numGroups;
+    }
+    for (;;) {
+        int o = endObject;
+        crp_m mask = crp_lt(zero,zero);
+        crp_f od,om;
+        crp_m take;
+        for (k=0;k<numGroups;k++) {if (heads[k]<ends[k] && g->cell_objects[heads[k]]<o) o = g->cell_objects[heads[k]];}
+        if (o>=endObject) break;
+        for (k=0;k<numGroups;k++) {
+            if (heads[k]<ends[k] && g->cell_objects[heads[k]]==o) {mask = crp_m_or(mask,groupMasks[k]);++heads[k];}
+        }
+        CRP(crp_mapScenePrimitives)(pos,&g->primitives[g->objects[o].first_primitive],g->objects[o].num_primitives,&od,&om);
+        take = crp_m_andnot(mask,crp_lt(d,od));     // (opU(...) in the lanes of mask)
+        m = crp_select(take,om,m);
+        d = crp_select(take,od,d);
+    }
+    *pd = crp_min(d,crp_add(crp_max(crp_select(inside,freeIn,freeOut),zero),crp_set1(g->margin)));
+    if (pm) *pm = m;
+}
+
+// Compiled scene (the CRP_ISA part of "sdf_scene_compiled.h")
+#include "sdf_scene_compiled.h"
+
+// Scene--------------------------------------------------------------------
+static CRP_TARGET void CRP(crp_map)(const CpuRenderer* r,crp_v3 pos,crp_f* pd,crp_f* pm) {
+    crp_f d = pos.y, m = crp_set1(1.f);
+    if (r->compiled_scene) {CRP(crp_mapCompiledScene)(r,pos,pd,pm);return;}
+    if (r->scene_bvh) {CRP(crp_mapSceneBvh)(r,pos,pd,pm);return;}
+    if (r->scene_grid) {CRP(crp_mapSceneGrid)(r,pos,NULL,pd,pm);return;}
+    if (r->scene) {CRP(crp_mapScene)(r,pos,pd,pm);return;}
+    CRP(crp_opU)(&d,&m, CRP(crp_sdSphere)(      CRP(crp_v3_subc)(pos, 0.0f,0.25f, 0.0f), 0.25f ), 46.9f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdBox)(         CRP(crp_v3_subc)(pos, 1.0f,0.25f, 0.0f), 0.25f,0.25f,0.25f ), 3.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_udRoundBox)(    CRP(crp_v3_subc)(pos, 1.0f,0.25f, 1.0f), 0.15f,0.15f,0.15f, 0.1f ), 41.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus)(       CRP(crp_v3_subc)(pos, 0.0f,0.25f, 1.0f), 0.20f,0.05f ), 25.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCapsule)(     pos,vec3(-1.3f,0.10f,-0.1f), vec3(-0.8f,0.50f,0.2f), 0.1f ), 31.9f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTriPrism)(    CRP(crp_v3_subc)(pos,-1.0f,0.25f,-1.0f), 0.25f,0.05f ), 43.5f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCylinder)(    CRP(crp_v3_subc)(pos, 1.0f,0.30f,-1.0f), 0.1f,0.2f ), 8.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCone)(        CRP(crp_v3_subc)(pos, 0.0f,0.50f,-1.0f), vec3(0.8f,0.6f,0.3f) ), 55.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus82)(     CRP(crp_v3_subc)(pos, 0.0f,0.25f, 2.0f), 0.20f,0.05f ), 50.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus88)(     CRP(crp_v3_subc)(pos,-1.0f,0.25f, 2.0f), 0.20f,0.05f ), 43.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCylinder6)(   CRP(crp_v3_subc)(pos, 1.0f,0.30f, 2.0f), 0.1f,0.2f ), 12.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdHexPrism)(    CRP(crp_v3_subc)(pos,-1.0f,0.20f, 1.0f), 0.25f,0.05f ), 17.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdPryamid4)(    CRP(crp_v3_subc)(pos,-1.0f,0.15f,-2.0f), vec3(0.8f,0.6f,0.25f) ), 37.0f );
+    if (!r->settings.reduce_num_objects) {
+        const crp_v3 q = CRP(crp_v3_subc)(pos,-2.0f,0.2f,0.0f);
+        crp_v3 rep;
+        CRP(crp_opU)(&d,&m, crp_max(crp_neg(CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,-2.0f,0.2f, 1.0f), 0.25f)),
+                                    CRP(crp_udRoundBox)(CRP(crp_v3_subc)(pos,-2.0f,0.2f, 1.0f), 0.15f,0.15f,0.15f, 0.05f)), 13.0f );
+        rep.x = crp_sub(CRP(crp_mod)(crp_div(CRP(crp_lanes2)(crp_add(pos.x,crp_set1(2.0f)),pos.z,&atan2f),crp_set1(6.2831f)),0.05f),crp_set1(0.5f*0.05f));
+        rep.y = crp_sub(CRP(crp_mod)(pos.y,1.0f),crp_set1(0.5f));
+        rep.z = crp_sub(CRP(crp_mod)(crp_add(crp_set1(0.02f),crp_mul(crp_set1(0.5f),CRP(crp_v3_length)(q))),0.05f),crp_set1(0.5f*0.05f));
+        CRP(crp_opU)(&d,&m, crp_max(crp_neg(CRP(crp_sdCylinder)(rep,0.02f,0.6f)),CRP(crp_sdTorus82)(q,0.20f,0.1f)), 51.0f );
+        CRP(crp_opU)(&d,&m, crp_add(crp_mul(crp_set1(0.5f),CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,-2.0f,0.25f,-1.0f), 0.2f)),
+                                    crp_mul(crp_mul(crp_mul(crp_set1(0.03f),CRP(crp_lanes1)(crp_mul(crp_set1(50.f),pos.x),&sinf)),
+                                                    CRP(crp_lanes1)(crp_mul(crp_set1(50.f),pos.y),&sinf)),CRP(crp_lanes1)(crp_mul(crp_set1(50.f),pos.z),&sinf))), 65.0f );
+        {
+            // opTwist
+            const crp_v3 p = CRP(crp_v3_subc)(pos,-2.0f,0.25f, 2.0f);
+            const crp_f a = crp_add(crp_mul(crp_set1(10.f),p.y),crp_set1(10.f));
+            const crp_f c = CRP(crp_lanes1)(a,&cosf), s = CRP(crp_lanes1)(a,&sinf);
+            crp_v3 tw;
+            tw.x = crp_add(crp_mul(c,p.x),crp_mul(s,p.z));
+            tw.y = crp_sub(crp_mul(c,p.z),crp_mul(s,p.x));
+            tw.z = p.y;
+            CRP(crp_opU)(&d,&m, crp_mul(crp_set1(0.5f),CRP(crp_sdTorus)(tw,0.20f,0.05f)), 46.7f );
+        }
+        CRP(crp_opU)(&d,&m, CRP(crp_smin)(CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,0.0f,0.35f,3.0f),0.1f),CRP(crp_sdBox)(CRP(crp_v3_subc)(pos,0.0f,0.15f,3.0f),0.1f,0.1f,0.1f),0.1f), 43.17f );
+    }
+    CRP(crp_opU)(&d,&m, CRP(crp_sdConeSection)( CRP(crp_v3_subc)(pos, 0.0f,0.35f,-2.0f), 0.15f, 0.2f, 0.1f ), 13.67f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdEllipsoid)(   CRP(crp_v3_subc)(pos, 1.0f,0.35f,-2.0f), 0.15f, 0.2f, 0.05f ), 43.17f );
+    *pd = d;
+    if (pm) *pm = m;
+}
+
+// map() for castRay() (see cr_mapRay(...))
+static CRP_TARGET void CRP(crp_mapRay)(const CpuRenderer* r,crp_v3 pos,crp_v3 rd,crp_f* pd,crp_f* pm) {
+    if (cr_usesGridSteps(r)) CRP(crp_mapSceneGrid)(r,pos,&rd,pd,pm);
+    else CRP(crp_map)(r,pos,pd,pm);
+}
+
+// cr_castRayOverRelaxed(...) (see there) with a mask per condition
+static CRP_TARGET void CRP(crp_castRayOverRelaxed)(const CpuRenderer* r,vec3_t ro,crp_v3 rd,crp_m active,crp_f t,crp_f m,crp_f tmax,crp_f* pt,crp_f* pm) {
+    const crp_f one = crp_set1(1.f), precision = crp_set1(r->settings.raycast_precision);
+    crp_f omega = crp_set1(r->settings.raycast_over_relaxation);
+    crp_f previousRadius = crp_set1(0.f), stepLength = crp_set1(0.f);
+    crp_f candidateT = t, candidateError = crp_set1(1e30f), candidateM = m;
+    crp_m outOfRange;
+    int i;
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        crp_f d,mat,radius,error;
+        crp_m fail,better;
+        crp_v3 p;
+        if (!crp_m_bits(active)) break;
+        p.x = crp_add(crp_set1(ro.x),crp_mul(rd.x,t));p.y = crp_add(crp_set1(ro.y),crp_mul(rd.y,t));p.z = crp_add(crp_set1(ro.z),crp_mul(rd.z,t));
+        CRP(crp_map)(r,p,&d,&mat);
+        radius = crp_abs(d);
+        error = crp_div(radius,t);
+        // The failed lanes go back to the previous point plus its distance, the others step omega times the distance
+        fail = crp_m_and(active,crp_m_and(crp_gt(omega,one),crp_lt(crp_add(radius,previousRadius),stepLength)));
+        t = crp_select(fail,crp_sub(t,stepLength),t);
+        stepLength = crp_select(fail,previousRadius,stepLength);
+        omega = crp_select(fail,one,omega);
+        active = crp_m_andnot(active,crp_m_andnot(crp_m_or(crp_lt(d,crp_mul(precision,t)),crp_gt(t,tmax)),fail));
+        better = crp_m_andnot(crp_m_and(active,crp_lt(error,candidateError)),fail);
+        candidateT = crp_select(better,t,candidateT);
+        candidateError = crp_select(better,error,candidateError);
+        candidateM = crp_select(better,mat,candidateM);
+        {
+            const crp_m step = crp_m_andnot(active,fail);
+            m = crp_select(step,mat,m);
+            stepLength = crp_select(step,crp_mul(d,omega),stepLength);
+            previousRadius = crp_select(step,radius,previousRadius);
+            t = crp_select(active,crp_add(t,stepLength),t);
+        }
+    }
+    outOfRange = crp_gt(t,tmax);
+    if (r->settings.raycast_best_candidate) {
+        // (the lanes still active are out of iterations)
+        const crp_m candidate = crp_m_andnot(active,outOfRange);
+        t = crp_select(candidate,candidateT,t);
+        m = crp_select(candidate,candidateM,m);
+    }
+    *pt = t;
+    *pm = crp_select(outOfRange,crp_set1(-1.f),m);
+}
+
+static CRP_TARGET void CRP(crp_castRay)(const CpuRenderer* r,vec3_t ro,crp_v3 rd,crp_m active,crp_f tstart,crp_f tguess,crp_f* pt,crp_f* pm) {
+    const crp_f roy = crp_set1(ro.y), zero = crp_set1(0.f);
+    crp_f tmin = crp_max(crp_set1(r->iProjectionData[0]),tstart);
+    crp_f tmax = crp_set1(r->iProjectionData[1]);
+    crp_f t,m;
+    int i;
+    // bounding volume
+    {
+        const crp_f tp1 = crp_div(crp_sub(zero,roy),rd.y);
+        const crp_f tp2 = crp_div(crp_sub(crp_set1(1.6f),roy),rd.y);
+        const crp_m tp2pos = crp_gt(tp2,zero);
+        tmax = crp_select(crp_gt(tp1,zero),crp_min(tmax,tp1),tmax);
+        if (ro.y>1.6f) tmin = crp_select(tp2pos,crp_max(tmin,tp2),tmin);
+        else           tmax = crp_select(tp2pos,crp_min(tmax,tp2),tmax);
+    }
+    t = tmin;
+    m = crp_set1(-1.f);
+    {
+        // The lanes outside the shapes at their guess (see cr_castRay(...)) step from there: the ones that hit there are done
+        crp_m guess = crp_m_and(active,crp_gt(tguess,t));
+        if (crp_m_bits(guess)) {
+            crp_f d,mat;
+            crp_v3 p;
+            crp_m done;
+            p.x = crp_add(crp_set1(ro.x),crp_mul(rd.x,tguess));p.y = crp_add(roy,crp_mul(rd.y,tguess));p.z = crp_add(crp_set1(ro.z),crp_mul(rd.z,tguess));
+            CRP(crp_map)(r,p,&d,&mat);
+            guess = crp_m_andnot(guess,crp_lt(d,zero));
+            done = crp_m_and(guess,crp_m_or(crp_lt(d,crp_mul(crp_set1(r->settings.raycast_precision),tguess)),crp_gt(tguess,tmax)));
+            t = crp_select(guess,crp_select(done,tguess,crp_add(tguess,d)),t);
+            m = crp_select(guess,mat,m);
+            active = crp_m_andnot(active,done);
+        }
+    }
+    if (r->brick_map) {
+        // The brick map steps are scalar (cr_brickMapSteps(...)): the lanes don't step the same number of times anyway
+        float tl[CRP_W],tmaxl[CRP_W],dx[CRP_W],dy[CRP_W],dz[CRP_W];
+        int k;
+        crp_storeu(tl,t);crp_storeu(tmaxl,tmax);
+        crp_storeu(dx,rd.x);crp_storeu(dy,rd.y);crp_storeu(dz,rd.z);
+        for (k=0;k<CRP_W;k++) tl[k] = cr_brickMapSteps(r,ro,vec3(dx[k],dy[k],dz[k]),tl[k],tmaxl[k]);
+        t = crp_loadu(tl);
+    }
+    if (r->settings.raycast_over_relaxation>1.f && !cr_usesGridSteps(r)) {CRP(crp_castRayOverRelaxed)(r,ro,rd,active,t,m,tmax,pt,pm);return;}
+    for( i=0; i<r->settings.raycast_iterations; i++ ) {
+        crp_f d,mat;
+        crp_v3 p;
+        if (!crp_m_bits(active)) break;
+        p.x = crp_add(crp_set1(ro.x),crp_mul(rd.x,t));p.y = crp_add(roy,crp_mul(rd.y,t));p.z = crp_add(crp_set1(ro.z),crp_mul(rd.z,t));
+        CRP(crp_mapRay)(r,p,rd,&d,&mat);
+        active = crp_m_andnot(active,crp_m_or(crp_lt(d,crp_mul(crp_set1(r->settings.raycast_precision),t)),crp_gt(t,tmax)));
+        t = crp_select(active,crp_add(t,d),t);
+        m = crp_select(active,mat,m);
+    }
+    *pt = t;
+    *pm = crp_select(crp_gt(t,tmax),crp_set1(-1.f),m);
+}
+
+static CRP_TARGET crp_f CRP(crp_softshadow)(const CpuRenderer* r,crp_v3 ro,crp_v3 rd,crp_m active,float mint,float tmax) {
+    crp_f res = crp_set1(1.f);
+    crp_f t = crp_set1(mint);
+    int i;
+    for( i=0; i<r->settings.shadow_iterations; i++ ) {
+        crp_f h;
+        if (!crp_m_bits(active)) break;
+        CRP(crp_map)(r,CRP(crp_v3_add)(ro,CRP(crp_v3_muls)(rd,t)),&h,NULL);
+        res = crp_select(active,crp_min(res,crp_div(crp_mul(crp_set1(r->settings.shadow_hardness),h),t)),res);
+        t = crp_select(active,crp_add(t,CRP(crp_clamp)(h,0.02f,0.10f)),t);
+        active = crp_m_andnot(active,crp_m_or(crp_lt(h,crp_set1(0.001f)),crp_gt(t,crp_set1(tmax))));
+    }
+    return CRP(crp_clamp)(res,0.f,1.f);
+}
+
+static CRP_TARGET crp_v3 CRP(crp_calcNormal)(const CpuRenderer* r,crp_v3 pos) {
+    const float e = 0.5773f*0.0005f;
+    crp_f d0,d1,d2,d3;
+    crp_v3 n;
+    CRP(crp_map)(r,CRP(crp_v3_add)(pos,CRP(crp_v3_set)( e,-e,-e)),&d0,NULL);
+    CRP(crp_map)(r,CRP(crp_v3_add)(pos,CRP(crp_v3_set)(-e,-e, e)),&d1,NULL);
+    CRP(crp_map)(r,CRP(crp_v3_add)(pos,CRP(crp_v3_set)(-e, e,-e)),&d2,NULL);
+    CRP(crp_map)(r,CRP(crp_v3_add)(pos,CRP(crp_v3_set)( e, e, e)),&d3,NULL);
+    // e.xyy*d0 + e.yyx*d1 + e.yxy*d2 + e.xxx*d3 (the common factor "e" doesn't change the normalized result)
+    n.x = crp_add(crp_sub(crp_sub(d0,d1),d2),d3);
+    n.y = crp_add(crp_add(crp_sub(crp_neg(d0),d1),d2),d3);
+    n.z = crp_add(crp_sub(crp_add(crp_neg(d0),d1),d2),d3);
+    return CRP(crp_v3_norm)(n);
+}
+
+static CRP_TARGET crp_f CRP(crp_calcAO)(const CpuRenderer* r,crp_v3 pos,crp_v3 nor) {
+    crp_f occ = crp_set1(0.f);
+    float sca = 1.f;
+    int i;
+    for( i=0; i<r->settings.ambient_occlusion_precision; i++ ) {
+        const float hr = 0.01f + 0.12f*(float)i/4.f;
+        crp_f dd;
+        CRP(crp_map)(r,CRP(crp_v3_add)(CRP(crp_v3_muls)(nor,crp_set1(hr)),pos),&dd,NULL);
+        occ = crp_add(occ,crp_mul(crp_sub(crp_set1(hr),dd),crp_set1(sca)));
+        sca *= 0.95f;
+    }
+    return CRP(crp_clamp)(crp_sub(crp_set1(1.f),crp_mul(crp_set1(3.f),occ)),0.f,1.f);
+}
+
+// The ambient occlusion and the two soft shadows of render() (cr_occlusionTerms(...)) at "pos" for the lanes in "hit"
+static CRP_TARGET void CRP(crp_occlusionTerms)(const CpuRenderer* r,crp_v3 rd,crp_v3 pos,crp_v3 nor,crp_m hit,float* occ,float* sha,float* shaDom) {
+    const CpuRendererSettings* s = &r->settings;
+    const crp_f one = crp_set1(1.f);
+    crp_f vocc = one,vsha = one,vshaDom = one;
+    if (s->ambient_occlusion_precision>0) vocc = CRP(crp_calcAO)(r,pos,nor);
+    if (s->shadow_iterations>0) {
+        vsha = CRP(crp_softshadow)(r,pos,CRP(crp_v3_set)(r->iLightDirection.x,r->iLightDirection.y,r->iLightDirection.z),hit,0.02f,2.5f);
+        if (s->enable_dom_lighting_component>0) {
+            const crp_v3 ref = CRP(crp_v3_sub)(rd,CRP(crp_v3_muls)(nor,crp_mul(crp_set1(2.f),CRP(crp_v3_dot)(nor,rd))));
+            vshaDom = CRP(crp_softshadow)(r,pos,ref,hit,0.02f,2.5f);
+        }
+    }
+    crp_storeu(occ,vocc);crp_storeu(sha,vsha);crp_storeu(shaDom,vshaDom);
+}
+
+// render() for a packet of rays: "numLanes" rays (<=CRP_W) starting from "ro" with directions in "rdx","rdy","rdz"
+// (and the distances of the cone pre-pass in "tstart", the temporal guesses in "tguess"). The output (not gamma corrected)
+// goes to "col" (3 floats per ray), the distances up to which the rays are empty to "hitT" (the far plane = no hit)
+static CRP_TARGET void CRP(crp_render)(const CpuRenderer* r,vec3_t ro,const float* rdx,const float* rdy,const float* rdz,const float* tstart,const float* tguess,int numLanes,float* col,float* hitT) {
+    float lane[CRP_W],t[CRP_W],m[CRP_W],nx[CRP_W],ny[CRP_W],nz[CRP_W],occ[CRP_W],sha[CRP_W],shaDom[CRP_W];
+    crp_v3 rd;
+    crp_f vt,vm;
+    crp_m active,hit;
+    int l;
+    for (l=0;l<CRP_W;l++) lane[l] = (float)l;
+    active = crp_lt(crp_loadu(lane),crp_set1((float)numLanes));
+    rd.x = crp_loadu(rdx);rd.y = crp_loadu(rdy);rd.z = crp_loadu(rdz);
+    CRP(crp_castRay)(r,ro,rd,active,crp_loadu(tstart),crp_loadu(tguess),&vt,&vm);
+    hit = crp_m_and(active,crp_gt(vm,crp_set1(-0.5f)));
+    crp_storeu(t,vt);crp_storeu(m,vm);
+    crp_storeu(hitT,crp_select(hit,vt,crp_set1(r->iProjectionData[1])));
+    if (crp_m_bits(hit)) {
+        const crp_v3 pos = CRP(crp_v3_add)(CRP(crp_v3_set)(ro.x,ro.y,ro.z),CRP(crp_v3_muls)(rd,vt));
+        const crp_v3 nor = CRP(crp_calcNormal)(r,pos);
+        crp_storeu(nx,nor.x);crp_storeu(ny,nor.y);crp_storeu(nz,nor.z);
+        CRP(crp_occlusionTerms)(r,rd,pos,nor,hit,occ,sha,shaDom);
+    }
+    for (l=0;l<numLanes;l++) {
+        const vec3_t lrd = vec3(rdx[l],rdy[l],rdz[l]);
+        vec3_t c = cr_sky(lrd);
+        if (m[l]>-0.5f) c = cr_shade(r,lrd,t[l],m[l],v3_add(ro,v3_muls(lrd,t[l])),vec3(nx[l],ny[l],nz[l]),occ[l],sha[l],shaDom[l]);
+        c = cr_saturate(c);
+        col[3*l]=c.x;col[3*l+1]=c.y;col[3*l+2]=c.z;
+    }
+}
+
+static CRP_TARGET void CRP(cr_RenderTilePacket)(const CpuRenderer* r,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const int AA = r->settings.aa>1 ? r->settings.aa : 1;
+    const int spp = AA*AA, tileWidth = xEnd-xStart;
+    const int numSamples = tileWidth*(yEnd-yStart)*spp;
+    float fx[CRP_W],fy[CRP_W],rdx[CRP_W],rdy[CRP_W],rdz[CRP_W],tstart[CRP_W],tguess[CRP_W],hitT[CRP_W],col[3*CRP_W];
+    float pixelGuess = 0.f;
+    int pix[CRP_W],tpix[CRP_W];    // fb->color and CpuTemporalDepth::t (bottom-up rows) indices
+    int k,l,y;
+    if (tileWidth<=0 || yEnd<=yStart) return;
+    for (y=yStart;y<yEnd;y++) memset(&fb->color[3*(y*fb->width+xStart)],0,sizeof(float)*3*tileWidth);
+    // Samples are enumerated pixel by pixel (row-major inside the tile), so that the rays of a packet stay coherent
+    for (k=0;k<numSamples;k+=CRP_W) {
+        const int numLanes = (numSamples-k)<CRP_W ? (numSamples-k) : CRP_W;
+        for (l=0;l<numLanes;l++) {
+            const int sample = (k+l)%spp, pixel = (k+l)/spp;
+            const int x = xStart + pixel%tileWidth, yy = yStart + pixel/tileWidth;
+            const float ox = AA>1 ? (float)(sample/AA)/(float)AA - 0.5f : 0.f;
+            const float oy = AA>1 ? (float)(sample%AA)/(float)AA - 0.5f : 0.f;
+            fx[l] = (float)x+0.5f+ox;fy[l] = (float)(fb->height-1-yy)+0.5f+oy;
+            pix[l] = yy*fb->width+x;
+            tpix[l] = (fb->height-1-yy)*fb->width+x;
+        }
+        for (;l<CRP_W;l++) {fx[l]=fx[0];fy[l]=fy[0];}
+        cr_rayDirections(r,fx,fy,CRP_W,rdx,rdy,rdz);
+        for (l=0;l<numLanes;l++) {
+            const int x = pix[l]%fb->width, yy = pix[l]/fb->width;
+            tstart[l] = cr_conePrepassStart(r,(float)x+0.5f,(float)(fb->height-1-yy)+0.5f);
+            // (the guess is the same for all the samples of a pixel)
+            if ((k+l)%spp==0) pixelGuess = cr_temporalStart(r,(float)x+0.5f,(float)(fb->height-1-yy)+0.5f,ro,
+                                                            AA>1 ? cr_rayDirection(r,(float)x+0.5f,(float)(fb->height-1-yy)+0.5f) : vec3(rdx[l],rdy[l],rdz[l]));
+            tguess[l] = pixelGuess;
+        }
+        for (l=numLanes;l<CRP_W;l++) {tstart[l]=tstart[0];tguess[l]=tguess[0];}
+        CRP(crp_render)(r,ro,rdx,rdy,rdz,tstart,tguess,numLanes,col,hitT);
+        for (l=0;l<numLanes;l++) {
+            const vec3_t c = cr_gamma(r,vec3(col[3*l],col[3*l+1],col[3*l+2]));
+            float* pColor = &fb->color[3*pix[l]];
+            pColor[0]+=c.x;pColor[1]+=c.y;pColor[2]+=c.z;
+            if (r->temporal_depth && r->temporal_depth->width==fb->width && r->temporal_depth->height==fb->height) {
+                // the smallest of the samples of the pixel
+                float* pT = &r->temporal_depth->t[r->temporal_depth->current][tpix[l]];
+                if ((k+l)%spp==0 || hitT[l]<*pT) *pT = hitT[l];
+            }
+        }
+    }
+    if (AA>1) {
+        const float invSpp = 1.f/(float)spp;
+        int x;
+        for (y=yStart;y<yEnd;y++) {
+            float* pColor = &fb->color[3*(y*fb->width+xStart)];
+            for (x=0;x<3*tileWidth;x++) pColor[x]*=invSpp;
+        }
+    }
+}
+
+// The visibility pass of the deferred pipeline (cr_renderGBufferPixel(...) for CRP_W pixels at a time)
+static CRP_TARGET void CRP(cr_RenderGBufferTilePacket)(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const int tileWidth = xEnd-xStart;
+    const int numPixels = tileWidth*(yEnd-yStart);
+    float lane[CRP_W],rdx[CRP_W],rdy[CRP_W],rdz[CRP_W],tstart[CRP_W],tguess[CRP_W],t[CRP_W],m[CRP_W],nx[CRP_W],ny[CRP_W],nz[CRP_W];
+    float fx[CRP_W],fy[CRP_W];
+    int pix[CRP_W];
+    int k,l;
+    if (tileWidth<=0 || yEnd<=yStart) return;
+    for (l=0;l<CRP_W;l++) lane[l] = (float)l;
+    for (k=0;k<numPixels;k+=CRP_W) {
+        const int numLanes = (numPixels-k)<CRP_W ? (numPixels-k) : CRP_W;
+        crp_v3 rd;
+        crp_f vt,vm;
+        crp_m hit;
+        for (l=0;l<numLanes;l++) {
+            const int x = xStart + (k+l)%tileWidth, y = yStart + (k+l)/tileWidth;
+            fx[l] = (float)x+0.5f;fy[l] = (float)(g->height-1-y)+0.5f;
+            pix[l] = y*g->width+x;
+        }
+        for (;l<CRP_W;l++) {fx[l]=fx[0];fy[l]=fy[0];}
+        cr_rayDirections(r,fx,fy,CRP_W,rdx,rdy,rdz);
+        for (l=0;l<numLanes;l++) {
+            tstart[l] = cr_conePrepassStart(r,fx[l],fy[l]);
+            tguess[l] = cr_temporalStart(r,fx[l],fy[l],ro,vec3(rdx[l],rdy[l],rdz[l]));
+        }
+        for (;l<CRP_W;l++) {tstart[l]=tstart[0];tguess[l]=tguess[0];}
+        rd.x = crp_loadu(rdx);rd.y = crp_loadu(rdy);rd.z = crp_loadu(rdz);
+        CRP(crp_castRay)(r,ro,rd,crp_lt(crp_loadu(lane),crp_set1((float)numLanes)),crp_loadu(tstart),crp_loadu(tguess),&vt,&vm);
+        hit = crp_gt(vm,crp_set1(-0.5f));
+        crp_storeu(t,crp_select(hit,vt,crp_set1(r->iProjectionData[1])));
+        crp_storeu(m,vm);
+        if (crp_m_bits(hit)) {
+            const crp_v3 nor = CRP(crp_calcNormal)(r,CRP(crp_v3_add)(CRP(crp_v3_set)(ro.x,ro.y,ro.z),CRP(crp_v3_muls)(rd,vt)));
+            crp_storeu(nx,crp_select(hit,nor.x,crp_set1(0.f)));crp_storeu(ny,crp_select(hit,nor.y,crp_set1(0.f)));crp_storeu(nz,crp_select(hit,nor.z,crp_set1(0.f)));
+        }
+        else for (l=0;l<CRP_W;l++) nx[l]=ny[l]=nz[l]=0.f;
+        for (l=0;l<numLanes;l++) {
+            const int i = pix[l];
+            g->t[i] = t[l];
+            g->material[i] = m[l]>-0.5f ? m[l] : -1.f;
+            g->normal[3*i] = nx[l];g->normal[3*i+1] = ny[l];g->normal[3*i+2] = nz[l];
+            cr_temporalStore(r,fx[l],fy[l],t[l]);
+        }
+    }
+}
+
+// The low-resolution occlusion terms of the deferred pipeline (cr_renderOcclusionSample(...) for CRP_W samples at a time)
+static CRP_TARGET void CRP(cr_RenderOcclusionTilePacket)(const CpuRenderer* r,CpuGBuffer* g,int xStart,int yStart,int xEnd,int yEnd) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const int tileWidth = xEnd-xStart;
+    const int numSamples = tileWidth*(yEnd-yStart);
+    float fx[CRP_W],fy[CRP_W],rdx[CRP_W],rdy[CRP_W],rdz[CRP_W],t[CRP_W],m[CRP_W],nx[CRP_W],ny[CRP_W],nz[CRP_W],occ[CRP_W],sha[CRP_W],shaDom[CRP_W];
+    int smp[CRP_W];
+    int k,l;
+    if (tileWidth<=0 || yEnd<=yStart) return;
+    for (k=0;k<numSamples;k+=CRP_W) {
+        const int numLanes = (numSamples-k)<CRP_W ? (numSamples-k) : CRP_W;
+        crp_v3 rd,pos,nor;
+        crp_m hit;
+        for (l=0;l<numLanes;l++) {
+            const int sx = xStart + (k+l)%tileWidth, sy = yStart + (k+l)/tileWidth;
+            const int i = cr_occlusionSamplePixel(g,sx,sy);
+            fx[l] = (float)(i%g->width)+0.5f;fy[l] = (float)(g->height-1-i/g->width)+0.5f;
+            t[l] = g->t[i];m[l] = g->material[i];
+            nx[l] = g->normal[3*i];ny[l] = g->normal[3*i+1];nz[l] = g->normal[3*i+2];
+            smp[l] = sy*g->occlusion_width+sx;
+        }
+        for (;l<CRP_W;l++) {fx[l]=fx[0];fy[l]=fy[0];t[l]=t[0];m[l]=-1.f;nx[l]=nx[0];ny[l]=ny[0];nz[l]=nz[0];}
+        hit = crp_gt(crp_loadu(m),crp_set1(-0.5f));
+        if (crp_m_bits(hit)) {
+            cr_rayDirections(r,fx,fy,CRP_W,rdx,rdy,rdz);
+            rd.x = crp_loadu(rdx);rd.y = crp_loadu(rdy);rd.z = crp_loadu(rdz);
+            pos = CRP(crp_v3_add)(CRP(crp_v3_set)(ro.x,ro.y,ro.z),CRP(crp_v3_muls)(rd,crp_loadu(t)));
+            nor.x = crp_loadu(nx);nor.y = crp_loadu(ny);nor.z = crp_loadu(nz);
+            CRP(crp_occlusionTerms)(r,rd,pos,nor,hit,occ,sha,shaDom);
+        }
+        for (l=0;l<numLanes;l++) {
+            float* o = &g->occlusion[3*smp[l]];
+            if (m[l]>-0.5f) {o[0]=occ[l];o[1]=sha[l];o[2]=shaDom[l];}
+            else o[0]=o[1]=o[2]=-1.f;
+        }
+    }
+}
+
+// The shading pass of the deferred pipeline (cr_shadeGBufferPixel(...) for CRP_W pixels at a time).
+// With low-resolution occlusion terms, only the lanes that cr_upsampleOcclusion(...) can't fill compute them
+static CRP_TARGET void CRP(cr_ShadeGBufferTilePacket)(const CpuRenderer* r,const CpuGBuffer* g,CpuFramebuffer* fb,int xStart,int yStart,int xEnd,int yEnd) {
+    const mat4_t* cm = &r->iCameraMatrix;
+    const vec3_t ro = vec3(cm->m[3][0],cm->m[3][1],cm->m[3][2]);
+    const int tileWidth = xEnd-xStart;
+    const int numPixels = tileWidth*(yEnd-yStart);
+    float fx[CRP_W],fy[CRP_W],rdx[CRP_W],rdy[CRP_W],rdz[CRP_W],t[CRP_W],m[CRP_W],nx[CRP_W],ny[CRP_W],nz[CRP_W],occ[CRP_W],sha[CRP_W],shaDom[CRP_W];
+    float missing[CRP_W],mocc[CRP_W],msha[CRP_W],mshaDom[CRP_W];    // 1.f = the lane needs its occlusion terms (m... = them)
+    int pix[CRP_W];
+    int k,l;
+    if (tileWidth<=0 || yEnd<=yStart) return;
+    for (k=0;k<numPixels;k+=CRP_W) {
+        const int numLanes = (numPixels-k)<CRP_W ? (numPixels-k) : CRP_W;
+        crp_v3 rd,pos,nor;
+        crp_m hit;
+        for (l=0;l<numLanes;l++) {
+            const int x = xStart + (k+l)%tileWidth, y = yStart + (k+l)/tileWidth;
+            const int i = y*g->width+x;
+            fx[l] = (float)x+0.5f;fy[l] = (float)(g->height-1-y)+0.5f;
+            t[l] = g->t[i];m[l] = g->material[i];
+            nx[l] = g->normal[3*i];ny[l] = g->normal[3*i+1];nz[l] = g->normal[3*i+2];
+            pix[l] = i;
+            missing[l] = (m[l]>-0.5f && !(g->occlusion && cr_upsampleOcclusion(g,x,y,&occ[l],&sha[l],&shaDom[l]))) ? 1.f : 0.f;
+        }
+        for (;l<CRP_W;l++) {fx[l]=fx[0];fy[l]=fy[0];t[l]=t[0];m[l]=-1.f;nx[l]=nx[0];ny[l]=ny[0];nz[l]=nz[0];missing[l]=0.f;}
+        cr_rayDirections(r,fx,fy,CRP_W,rdx,rdy,rdz);
+        hit = crp_gt(crp_loadu(missing),crp_set1(0.5f));
+        if (crp_m_bits(hit)) {
+            rd.x = crp_loadu(rdx);rd.y = crp_loadu(rdy);rd.z = crp_loadu(rdz);
+            pos = CRP(crp_v3_add)(CRP(crp_v3_set)(ro.x,ro.y,ro.z),CRP(crp_v3_muls)(rd,crp_loadu(t)));
+            nor.x = crp_loadu(nx);nor.y = crp_loadu(ny);nor.z = crp_loadu(nz);
+            CRP(crp_occlusionTerms)(r,rd,pos,nor,hit,mocc,msha,mshaDom);
+            for (l=0;l<numLanes;l++) {
+                if (missing[l]>0.5f) {occ[l]=mocc[l];sha[l]=msha[l];shaDom[l]=mshaDom[l];}
+            }
+        }
+        for (l=0;l<numLanes;l++) {
+            const vec3_t lrd = vec3(rdx[l],rdy[l],rdz[l]);
+            float* pColor = &fb->color[3*pix[l]];
+            vec3_t c = cr_sky(lrd);
+            if (m[l]>-0.5f) c = cr_shade(r,lrd,t[l],m[l],v3_add(ro,v3_muls(lrd,t[l])),vec3(nx[l],ny[l],nz[l]),occ[l],sha[l],shaDom[l]);
+            c = cr_gamma(r,cr_saturate(c));
+            pColor[0]=c.x;pColor[1]=c.y;pColor[2]=c.z;
+        }
+    }
+}
+
+#undef crp_v3
+#undef CRP_W
+#undef CRP_TARGET
+#undef CRP
+#undef crp_f
+#undef crp_m
+#undef crp_set1
+#undef crp_loadu
+#undef crp_storeu
+#undef crp_add
+#undef crp_sub
+#undef crp_mul
+#undef crp_div
+#undef crp_min
+#undef crp_max
+#undef crp_sqrt
+#undef crp_abs
+#undef crp_neg
+#undef crp_floor
+#undef crp_lt
+#undef crp_gt
+#undef crp_m_and
+#undef crp_m_or
+#undef crp_m_andnot
+#undef crp_m_bits
+#undef crp_select
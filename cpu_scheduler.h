@@ -0,0 +1,408 @@
+#ifndef CPU_SCHEDULER_H_
+#define CPU_SCHEDULER_H_
+
+/* LICENSE: MIT license.
+*/
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only work-stealing thread pool.
+ * CpuScheduler_Run(...) splits [0,numTasks) over per-thread deques: every thread pops
+ * tasks from the back of its own deque and, when it runs out of work, steals from the
+ * front of the deque of a random victim. This keeps all the cores busy even when the
+ * cost of every task is very different (e.g. sky tiles vs grazing ground tiles in the
+ * CPU sphere tracer).
+ * The calling thread works too (it's worker 0), so CpuScheduler_Create(1) spawns no thread at all.
+*/
+
+/* USAGE:
+ * Define CPU_SCHEDULER_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ * On POSIX systems link with -lpthread.
+ * Define CPU_SCHEDULER_NO_THREADS to get a single-threaded fallback (automatically defined for emscripten builds
+ * without -s USE_PTHREADS=1).
+ *
+ * static void MyTask(int taskIndex,int workerIndex,void* userData) {...}
+ *
+ * CpuScheduler* s = CpuScheduler_Create(0);                    // 0 = CpuScheduler_GetNumHardwareThreads()
+ * CpuScheduler_Run(s,numTasks,&MyTask,userData);               // returns when all tasks are done
+ * CpuScheduler_FprintStats(s,stdout);                          // optional: per-thread busy time of the last run
+ * CpuScheduler_Destroy(s);
+*/
+
+#include <stdio.h>  // FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*CpuSchedulerTaskFunc)(int taskIndex,int workerIndex,void* userData);
+
+typedef struct {
+    unsigned long long busy_ns;     // time spent executing tasks in the last run
+    int num_tasks;                  // tasks executed in the last run
+    int num_stolen_tasks;           // tasks stolen from other threads in the last run
+} CpuSchedulerWorkerStats;
+
+typedef struct CpuScheduler CpuScheduler;
+
+CpuScheduler* CpuScheduler_Create(int numThreads);  // numThreads<=0 means CpuScheduler_GetNumHardwareThreads()
+void CpuScheduler_Destroy(CpuScheduler* s);
+void CpuScheduler_Run(CpuScheduler* s,int numTasks,CpuSchedulerTaskFunc func,void* userData);
+int  CpuScheduler_GetNumThreads(const CpuScheduler* s);
+const CpuSchedulerWorkerStats* CpuScheduler_GetWorkerStats(const CpuScheduler* s,int workerIndex);
+unsigned long long CpuScheduler_GetLastRunWallTimeNs(const CpuScheduler* s);
+void CpuScheduler_FprintStats(const CpuScheduler* s,FILE* stream);
+
+int CpuScheduler_GetNumHardwareThreads(void);
+unsigned long long CpuScheduler_GetTimeNs(void);    // monotonic clock
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CPU_SCHEDULER_H_
+
+#ifdef CPU_SCHEDULER_IMPLEMENTATION
+#ifndef CPU_SCHEDULER_IMPLEMENTATION_GUARD
+#define CPU_SCHEDULER_IMPLEMENTATION_GUARD
+
+#include <stdlib.h> // malloc
+#include <string.h> // memset
+
+#if (defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__))
+#   undef CPU_SCHEDULER_NO_THREADS
+#   define CPU_SCHEDULER_NO_THREADS
+#endif
+
+#ifdef _WIN32
+#   include <windows.h>
+#else //_WIN32
+#   include <time.h>
+#   include <unistd.h>
+#   ifndef CPU_SCHEDULER_NO_THREADS
+#       include <pthread.h>
+#   endif //CPU_SCHEDULER_NO_THREADS
+#endif //_WIN32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CPU_SCHEDULER_MAX_THREADS
+#define CPU_SCHEDULER_MAX_THREADS (256)
+#endif
+
+#ifdef CPU_SCHEDULER_NO_THREADS
+typedef int cs_mutex_t;
+typedef int cs_cond_t;
+static __inline void cs_mutex_init(cs_mutex_t* m) {*m=0;}
+static __inline void cs_mutex_destroy(cs_mutex_t* m) {(void)m;}
+static __inline void cs_mutex_lock(cs_mutex_t* m) {(void)m;}
+static __inline void cs_mutex_unlock(cs_mutex_t* m) {(void)m;}
+#elif defined(_WIN32)
+typedef CRITICAL_SECTION cs_mutex_t;
+typedef CONDITION_VARIABLE cs_cond_t;
+typedef HANDLE cs_thread_t;
+static __inline void cs_mutex_init(cs_mutex_t* m) {InitializeCriticalSection(m);}
+static __inline void cs_mutex_destroy(cs_mutex_t* m) {DeleteCriticalSection(m);}
+static __inline void cs_mutex_lock(cs_mutex_t* m) {EnterCriticalSection(m);}
+static __inline void cs_mutex_unlock(cs_mutex_t* m) {LeaveCriticalSection(m);}
+static __inline void cs_cond_init(cs_cond_t* c) {InitializeConditionVariable(c);}
+static __inline void cs_cond_destroy(cs_cond_t* c) {(void)c;}
+static __inline void cs_cond_wait(cs_cond_t* c,cs_mutex_t* m) {SleepConditionVariableCS(c,m,INFINITE);}
+static __inline void cs_cond_broadcast(cs_cond_t* c) {WakeAllConditionVariable(c);}
+#else //_WIN32
+typedef pthread_mutex_t cs_mutex_t;
+typedef pthread_cond_t cs_cond_t;
+typedef pthread_t cs_thread_t;
+static __inline void cs_mutex_init(cs_mutex_t* m) {pthread_mutex_init(m,NULL);}
+static __inline void cs_mutex_destroy(cs_mutex_t* m) {pthread_mutex_destroy(m);}
+static __inline void cs_mutex_lock(cs_mutex_t* m) {pthread_mutex_lock(m);}
+static __inline void cs_mutex_unlock(cs_mutex_t* m) {pthread_mutex_unlock(m);}
+static __inline void cs_cond_init(cs_cond_t* c) {pthread_cond_init(c,NULL);}
+static __inline void cs_cond_destroy(cs_cond_t* c) {pthread_cond_destroy(c);}
+static __inline void cs_cond_wait(cs_cond_t* c,cs_mutex_t* m) {pthread_cond_wait(c,m);}
+static __inline void cs_cond_broadcast(cs_cond_t* c) {pthread_cond_broadcast(c);}
+#endif //_WIN32
+
+unsigned long long CpuScheduler_GetTimeNs(void) {
+#   ifdef _WIN32
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER c;
+    if (freq.QuadPart==0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&c);
+    return (unsigned long long) ((double)c.QuadPart*1000000000.0/(double)freq.QuadPart);
+#   else //_WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL+(unsigned long long)ts.tv_nsec;
+#   endif //_WIN32
+}
+
+int CpuScheduler_GetNumHardwareThreads(void) {
+#   ifdef CPU_SCHEDULER_NO_THREADS
+    return 1;
+#   elif defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors>0 ? (int)si.dwNumberOfProcessors : 1;
+#   else
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n>0 ? (int)n : 1;
+#   endif
+}
+
+// A worker deque: the owner pops from the back, thieves steal from the front.
+// It's padded to a cache line to avoid false sharing between workers.
+typedef struct {
+    cs_mutex_t lock;
+    int* tasks;
+    int front,back;         // valid tasks are in [front,back)
+    unsigned rnd;           // xorshift state to pick victims
+    CpuSchedulerWorkerStats stats;
+    char padding[64];
+} cs_worker_t;
+
+struct CpuScheduler {
+    int num_threads;
+    cs_worker_t* workers;
+    int* task_storage;
+    int task_storage_capacity;
+    unsigned long long last_run_wall_time_ns;
+
+    CpuSchedulerTaskFunc func;
+    void* user_data;
+
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    cs_thread_t* threads;
+    cs_mutex_t run_lock;
+    cs_cond_t run_cond;     // signaled when a new run starts (or on exit)
+    cs_cond_t done_cond;    // signaled when a spawned thread finishes its run
+    unsigned run_generation;
+    int num_running;
+    int exit_requested;
+#   endif //CPU_SCHEDULER_NO_THREADS
+};
+
+static int cs_pop(cs_worker_t* w,int* task) {
+    int ok = 0;
+    cs_mutex_lock(&w->lock);
+    if (w->back>w->front) {*task = w->tasks[--w->back];ok=1;}
+    cs_mutex_unlock(&w->lock);
+    return ok;
+}
+static int cs_steal(cs_worker_t* w,int* task) {
+    int ok = 0;
+    cs_mutex_lock(&w->lock);
+    if (w->back>w->front) {*task = w->tasks[w->front++];ok=1;}
+    cs_mutex_unlock(&w->lock);
+    return ok;
+}
+
+static void cs_work(CpuScheduler* s,int workerIndex) {
+    cs_worker_t* w = &s->workers[workerIndex];
+    const int N = s->num_threads;
+    int task,i;
+    for (;;) {
+        int stolen = 0;
+        if (!cs_pop(w,&task)) {
+            // Steal: start from a random victim and scan all the others once
+            int start;
+            w->rnd ^= w->rnd<<13;w->rnd ^= w->rnd>>17;w->rnd ^= w->rnd<<5;
+            start = (int)(w->rnd%(unsigned)N);
+            for (i=0;i<N;i++) {
+                const int victim = (start+i)%N;
+                if (victim==workerIndex) continue;
+                if (cs_steal(&s->workers[victim],&task)) {stolen=1;break;}
+            }
+            // No task spawns other tasks: when all the deques are empty we're done
+            if (!stolen) break;
+        }
+        {
+            const unsigned long long begin = CpuScheduler_GetTimeNs();
+            s->func(task,workerIndex,s->user_data);
+            w->stats.busy_ns+=CpuScheduler_GetTimeNs()-begin;
+            ++w->stats.num_tasks;
+            if (stolen) ++w->stats.num_stolen_tasks;
+        }
+    }
+}
+
+#ifndef CPU_SCHEDULER_NO_THREADS
+typedef struct {CpuScheduler* s;int workerIndex;} cs_thread_arg_t;
+#ifdef _WIN32
+static DWORD WINAPI cs_thread_main(LPVOID arg)
+#else
+static void* cs_thread_main(void* arg)
+#endif
+{
+    cs_thread_arg_t a = *((cs_thread_arg_t*) arg);
+    CpuScheduler* s = a.s;
+    unsigned generation = 0;
+    free(arg);
+    for (;;) {
+        cs_mutex_lock(&s->run_lock);
+        while (!s->exit_requested && s->run_generation==generation) cs_cond_wait(&s->run_cond,&s->run_lock);
+        if (s->exit_requested) {cs_mutex_unlock(&s->run_lock);break;}
+        generation = s->run_generation;
+        cs_mutex_unlock(&s->run_lock);
+
+        cs_work(s,a.workerIndex);
+
+        cs_mutex_lock(&s->run_lock);
+        if (--s->num_running==0) cs_cond_broadcast(&s->done_cond);
+        cs_mutex_unlock(&s->run_lock);
+    }
+    return 0;
+}
+#endif //CPU_SCHEDULER_NO_THREADS
+
+CpuScheduler* CpuScheduler_Create(int numThreads) {
+    CpuScheduler* s;
+    int i;
+    if (numThreads<=0) numThreads = CpuScheduler_GetNumHardwareThreads();
+#   ifdef CPU_SCHEDULER_NO_THREADS
+    numThreads = 1;
+#   endif //CPU_SCHEDULER_NO_THREADS
+    if (numThreads>CPU_SCHEDULER_MAX_THREADS) numThreads = CPU_SCHEDULER_MAX_THREADS;
+    s = (CpuScheduler*) malloc(sizeof(CpuScheduler));
+    if (!s) return NULL;
+    memset(s,0,sizeof(CpuScheduler));
+    s->num_threads = numThreads;
+    s->workers = (cs_worker_t*) malloc(sizeof(cs_worker_t)*numThreads);
+    if (!s->workers) {free(s);return NULL;}
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    s->threads = (cs_thread_t*) malloc(sizeof(cs_thread_t)*numThreads);
+    if (!s->threads) {free(s->workers);free(s);return NULL;}
+#   endif //CPU_SCHEDULER_NO_THREADS
+    memset(s->workers,0,sizeof(cs_worker_t)*numThreads);
+    for (i=0;i<numThreads;i++) {
+        cs_mutex_init(&s->workers[i].lock);
+        s->workers[i].rnd = 2463534242U+(unsigned)i*2654435761U;
+    }
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    cs_mutex_init(&s->run_lock);
+    cs_cond_init(&s->run_cond);
+    cs_cond_init(&s->done_cond);
+    for (i=1;i<numThreads;i++) {
+        int ok;
+        cs_thread_arg_t* a = (cs_thread_arg_t*) malloc(sizeof(cs_thread_arg_t));
+        if (!a) break;
+        a->s = s;a->workerIndex = i;
+#       ifdef _WIN32
+        s->threads[i] = CreateThread(NULL,0,cs_thread_main,a,0,NULL);
+        ok = (s->threads[i]!=NULL);
+#       else //_WIN32
+        ok = (pthread_create(&s->threads[i],NULL,cs_thread_main,a)==0);
+#       endif //_WIN32
+        if (!ok) {free(a);break;}
+    }
+    if (i<numThreads) {
+        // Keep only the threads we could start (worker 0, the calling thread, is always there):
+        // CpuScheduler_Run(...) waits for s->num_threads-1 of them, so it must not count the missing ones.
+        // No spawned thread reads s->num_threads before the first run (that's ordered by run_lock)
+        fprintf(stderr,"CpuScheduler_Create(...): could only start %d of %d threads\n",i,numThreads);
+        for (numThreads=i;i<s->num_threads;i++) cs_mutex_destroy(&s->workers[i].lock);
+        s->num_threads = numThreads;
+    }
+#   endif //CPU_SCHEDULER_NO_THREADS
+    return s;
+}
+
+void CpuScheduler_Destroy(CpuScheduler* s) {
+    int i;
+    if (!s) return;
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    cs_mutex_lock(&s->run_lock);
+    s->exit_requested = 1;
+    cs_cond_broadcast(&s->run_cond);
+    cs_mutex_unlock(&s->run_lock);
+    for (i=1;i<s->num_threads;i++) {
+#       ifdef _WIN32
+        WaitForSingleObject(s->threads[i],INFINITE);
+        CloseHandle(s->threads[i]);
+#       else //_WIN32
+        pthread_join(s->threads[i],NULL);
+#       endif //_WIN32
+    }
+    free(s->threads);
+    cs_cond_destroy(&s->done_cond);
+    cs_cond_destroy(&s->run_cond);
+    cs_mutex_destroy(&s->run_lock);
+#   endif //CPU_SCHEDULER_NO_THREADS
+    for (i=0;i<s->num_threads;i++) cs_mutex_destroy(&s->workers[i].lock);
+    free(s->workers);
+    if (s->task_storage) free(s->task_storage);
+    free(s);
+}
+
+void CpuScheduler_Run(CpuScheduler* s,int numTasks,CpuSchedulerTaskFunc func,void* userData) {
+    const unsigned long long begin = CpuScheduler_GetTimeNs();
+    const int N = s->num_threads;
+    int i,j;
+    if (numTasks<=0 || !func) {s->last_run_wall_time_ns=0;return;}
+    if (s->task_storage_capacity<numTasks) {
+        if (s->task_storage) free(s->task_storage);
+        s->task_storage = (int*) malloc(sizeof(int)*numTasks);
+        s->task_storage_capacity = numTasks;
+    }
+    s->func = func;
+    s->user_data = userData;
+    // Every worker gets a contiguous chunk of tasks (neighbouring tiles are likely to share the same cache lines).
+    // The chunk is stored in reverse order, so that cs_pop(...) executes the tasks in ascending order.
+    for (i=0;i<N;i++) {
+        cs_worker_t* w = &s->workers[i];
+        const int first = (int)((long long)numTasks*i/N), last = (int)((long long)numTasks*(i+1)/N);
+        w->tasks = &s->task_storage[first];
+        for (j=first;j<last;j++) s->task_storage[j] = first+last-1-j;
+        w->front = 0;w->back = last-first;
+        memset(&w->stats,0,sizeof(CpuSchedulerWorkerStats));
+    }
+
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    if (N>1) {
+        cs_mutex_lock(&s->run_lock);
+        s->num_running = N-1;
+        ++s->run_generation;
+        cs_cond_broadcast(&s->run_cond);
+        cs_mutex_unlock(&s->run_lock);
+    }
+#   endif //CPU_SCHEDULER_NO_THREADS
+
+    cs_work(s,0);
+
+#   ifndef CPU_SCHEDULER_NO_THREADS
+    if (N>1) {
+        cs_mutex_lock(&s->run_lock);
+        while (s->num_running>0) cs_cond_wait(&s->done_cond,&s->run_lock);
+        cs_mutex_unlock(&s->run_lock);
+    }
+#   endif //CPU_SCHEDULER_NO_THREADS
+    s->last_run_wall_time_ns = CpuScheduler_GetTimeNs()-begin;
+}
+
+int CpuScheduler_GetNumThreads(const CpuScheduler* s) {return s ? s->num_threads : 0;}
+const CpuSchedulerWorkerStats* CpuScheduler_GetWorkerStats(const CpuScheduler* s,int workerIndex) {
+    if (!s || workerIndex<0 || workerIndex>=s->num_threads) return NULL;
+    return &s->workers[workerIndex].stats;
+}
+unsigned long long CpuScheduler_GetLastRunWallTimeNs(const CpuScheduler* s) {return s ? s->last_run_wall_time_ns : 0;}
+
+void CpuScheduler_FprintStats(const CpuScheduler* s,FILE* stream) {
+    const double wall_ms = (double)s->last_run_wall_time_ns/1000000.0;
+    double tot_busy_ms = 0.0;
+    int i;
+    for (i=0;i<s->num_threads;i++) {
+        const CpuSchedulerWorkerStats* ws = &s->workers[i].stats;
+        const double busy_ms = (double)ws->busy_ns/1000000.0;
+        tot_busy_ms+=busy_ms;
+        fprintf(stream,"thread %3d: busy %9.3f ms (%5.1f%%) tasks: %6d (stolen: %d)\n",i,busy_ms,wall_ms>0.0 ? 100.0*busy_ms/wall_ms : 0.0,ws->num_tasks,ws->num_stolen_tasks);
+    }
+    fprintf(stream,"%d threads: wall %.3f ms, average utilization %.1f%%\n",s->num_threads,wall_ms,wall_ms>0.0 ? 100.0*tot_busy_ms/(wall_ms*s->num_threads) : 0.0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //CPU_SCHEDULER_IMPLEMENTATION_GUARD
+#endif //CPU_SCHEDULER_IMPLEMENTATION
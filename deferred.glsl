@@ -0,0 +1,159 @@
+// Deferred shading (included by "signed_distance_shapes.glsl" when DEFERRED_GBUFFER, DEFERRED_OCCLUSION or DEFERRED_SHADING is defined).
+// render() is split in two passes, with one sample per pixel (AA is ignored):
+// DEFERRED_GBUFFER: main() runs castRay() and calcNormal() only, and writes the hit distance, the material and the normal
+// of its pixel to two RGBA8 render targets (the G-buffer, gl_FragData[0] and gl_FragData[1]).
+// DEFERRED_SHADING: main() reads them back at its pixel and runs the rest of render() (occlusionTerms(...), shade(...),
+// the depth) and the gamma correction: the expensive softshadow() and calcAO() no longer depend on the visibility pass.
+// Layout: iGBuffer0.rgb = the hit distance (24 bits, the far plane = no hit) .a = the integer part of m+1.0 (0 = no hit)
+//         iGBuffer1.rgb = the normal (nor*0.5+0.5) .a = the fractional part of m+1.0
+// USE_LOW_RES_OCCLUSION (with DEFERRED_SHADING): the occlusion terms are low-frequency, so a DEFERRED_OCCLUSION pass computes
+// them for one pixel of every block of iOcclusionInfo.x^2 (iOcclusion.rgb, .a = 0.0 when the pixel is not a hit), and the
+// shading pass upsamples them with a joint bilateral filter (upsampleOcclusion(...)): it computes them again only where the
+// 2x2 nearest samples are on other surfaces.
+// The same as CpuGBuffer in "cpu_renderer.h" (that stores floats).
+
+uniform vec4 iGBufferTexel;         // .xy = 1/G-buffer size .zw = 1/iOcclusion size (texels)
+
+// The ray of the center of the pixel at fragCoord (the same as main() in "signed_distance_shapes.glsl" with AA 1)
+vec3 gbufferRayDirection( in vec2 fragCoord )
+{
+    vec2 p = iProjectionData2.xy * (2.0 * fragCoord / iResolution.xy - 1.0);
+    vec3 rdu = normalize( vec3(p.xy,iProjectionData.x));
+    return vec3(
+        iCameraMatrix[0][0]*rdu.x + iCameraMatrix[1][0]*rdu.y + iCameraMatrix[2][0]*rdu.z,
+        iCameraMatrix[0][1]*rdu.x + iCameraMatrix[1][1]*rdu.y + iCameraMatrix[2][1]*rdu.z,
+        iCameraMatrix[0][2]*rdu.x + iCameraMatrix[1][2]*rdu.y + iCameraMatrix[2][2]*rdu.z
+        );
+}
+
+#ifdef DEFERRED_GBUFFER
+// Distances in [0,far] packed in three 8-bit channels (rounded to the nearest: the shading pass needs the surface, not a bound)
+vec3 packGBufferDistance( in float t )
+{
+    float v = floor( clamp( t/iProjectionData.y, 0.0, 1.0 )*16777215.0 + 0.5 );
+    return floor( vec3( v/65536.0, mod( v/256.0, 256.0 ), mod( v, 256.0 ) ) )/255.0;
+}
+
+void main()
+{
+	vec2 fragCoord = gl_FragCoord.xy;
+#ifdef USE_CONE_PREPASS
+	coneStart = conePrepassStart( fragCoord );
+#endif
+    vec3 ro = vec3(iCameraMatrix[3][0],iCameraMatrix[3][1],iCameraMatrix[3][2]);
+    vec3 rd = gbufferRayDirection( fragCoord );
+    vec2 res = castRay( ro, rd );
+    float t = iProjectionData.y;
+    float m = 0.0;                  // m+1.0 (0.0 = no hit)
+    vec3 nor = vec3(0.0);
+    if( res.y>-0.5 )
+    {
+        t = res.x;
+        m = clamp( res.y+1.0, 1.0, 255.99 );
+        nor = calcNormal( ro + t*rd );
+    }
+    gl_FragData[0] = vec4( packGBufferDistance( t ), floor( m )/255.0 );
+    gl_FragData[1] = vec4( nor*0.5+0.5, fract( m ) );
+}
+#endif //DEFERRED_GBUFFER
+
+#if defined(DEFERRED_OCCLUSION) || defined(DEFERRED_SHADING)
+uniform sampler2D iGBuffer0;        // RGBA8 textures of the DEFERRED_GBUFFER pass (nearest filtering)
+uniform sampler2D iGBuffer1;
+uniform vec4 iOcclusionInfo;        // .x = the divisor of the resolution of the occlusion terms .yz = samples (of the pass)
+
+// The hit distance, the material m (-1.0 = no hit) and the normal nor (not normalized) of the pixel whose center is at pixel
+float readGBuffer( in vec2 pixel, out float m, out vec3 nor )
+{
+    vec2 uv = pixel*iGBufferTexel.xy;
+    vec4 g0 = texture2D( iGBuffer0, uv );
+    vec4 g1 = texture2D( iGBuffer1, uv );
+    vec3 b = floor( g0.rgb*255.0 + 0.5 );
+    m = floor( g0.a*255.0 + 0.5 ) + floor( g1.a*255.0 + 0.5 )/255.0 - 1.0;
+    nor = g1.rgb*2.0 - 1.0;
+    return dot( b, vec3(65536.0,256.0,1.0) )*(1.0/16777215.0)*iProjectionData.y;
+}
+
+// The center of the pixel of the occlusion sample s (the center of its block, clamped to the pass)
+vec2 occlusionSamplePixel( in vec2 s )
+{
+    return min( s*iOcclusionInfo.x + floor( iOcclusionInfo.x*0.5 ), iResolution.xy-1.0 ) + 0.5;
+}
+#endif //DEFERRED_OCCLUSION || DEFERRED_SHADING
+
+#ifdef DEFERRED_OCCLUSION
+void main()
+{
+    vec2 pixel = occlusionSamplePixel( floor( gl_FragCoord.xy ) );
+    vec3 nor;
+    float m;
+    float t = readGBuffer( pixel, m, nor );
+    vec4 occlusion = vec4( 0.0 );
+    if( m>-0.5 )
+    {
+        vec3 ro = vec3(iCameraMatrix[3][0],iCameraMatrix[3][1],iCameraMatrix[3][2]);
+        vec3 rd = gbufferRayDirection( pixel );
+        occlusion = vec4( occlusionTerms( rd, ro + t*rd, normalize( nor ) ), 1.0 );
+    }
+    gl_FragColor = occlusion;
+}
+#endif //DEFERRED_OCCLUSION
+
+#ifdef DEFERRED_SHADING
+#ifdef USE_LOW_RES_OCCLUSION
+#define OCCLUSION_DEPTH_TOLERANCE 0.05  // the same as CR_OCCLUSION_DEPTH_TOLERANCE in "cpu_renderer.h"
+#define OCCLUSION_MIN_WEIGHT 0.01       // the same as CR_OCCLUSION_MIN_WEIGHT
+
+uniform sampler2D iOcclusion;       // RGBA8 texture of the DEFERRED_OCCLUSION pass (nearest filtering)
+
+// The occlusion terms of the pixel at fragCoord (a hit at t, with the normal nor) from the 2x2 nearest samples, weighted by
+// their bilinear weights, by the difference of their hit distance and by the angle between the normals.
+// Returns false when the samples are on other surfaces (the same as cr_upsampleOcclusion(...) in "cpu_renderer.h")
+bool upsampleOcclusion( in vec2 fragCoord, in float t, in vec3 nor, out vec3 occlusion )
+{
+    vec2 f = ( floor( fragCoord ) - floor( iOcclusionInfo.x*0.5 ) )/iOcclusionInfo.x;     // (in samples)
+    vec2 s0 = floor( f );
+    vec2 a = f - s0;
+    vec4 sum = vec4( 0.0 );
+    for( int k=0; k<4; k++ )
+    {
+        vec2 o = vec2( mod( float(k), 2.0 ), floor( float(k)*0.5 ) );
+        vec2 s = clamp( s0+o, vec2(0.0), iOcclusionInfo.yz-1.0 );
+        vec4 so = texture2D( iOcclusion, (s+0.5)*iGBufferTexel.zw );
+        if( so.a<0.5 ) continue;    // (no hit)
+        vec3 nj;
+        float mj;
+        float tj = readGBuffer( occlusionSamplePixel( s ), mj, nj );
+        vec2 b = mix( 1.0-a, a, o );
+        float nd = max( dot( nor, normalize( nj ) ), 0.0 );
+        nd *= nd; nd *= nd; nd *= nd;
+        sum += b.x*b.y*max( 1.0 - abs( tj-t )/( OCCLUSION_DEPTH_TOLERANCE*t ), 0.0 )*nd*vec4( so.rgb, 1.0 );
+    }
+    occlusion = sum.rgb/max( sum.w, 1e-6 );
+    return sum.w>=OCCLUSION_MIN_WEIGHT;
+}
+#endif //USE_LOW_RES_OCCLUSION
+
+void main()
+{
+    vec3 ro = vec3(iCameraMatrix[3][0],iCameraMatrix[3][1],iCameraMatrix[3][2]);
+    vec3 rd = gbufferRayDirection( gl_FragCoord.xy );
+    vec3 nor;
+    float m;
+    float t = readGBuffer( gl_FragCoord.xy, m, nor );
+    vec3 col = sky( rd );
+    if( m>-0.5 )
+    {
+        vec3 pos = ro + t*rd;
+        vec3 occlusion;
+        nor = normalize( nor );
+#ifdef USE_LOW_RES_OCCLUSION
+        if( !upsampleOcclusion( gl_FragCoord.xy, t, nor, occlusion ) )
+#endif
+        occlusion = occlusionTerms( rd, pos, nor );
+        col = shade( rd, t, m, pos, nor, occlusion );
+    }
+    writeDepth( t, rd );
+    gl_FragColor = vec4( gammaCorrection( clamp(col,0.0,1.0) ), 1.0 );
+}
+#endif //DEFERRED_SHADING
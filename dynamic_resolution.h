@@ -0,0 +1,223 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only closed-loop dynamic resolution controller (no OpenGL inside).
+ * It's fed with the measured GPU time of the scaled pass (e.g. a GL_TIME_ELAPSED query around the raycast pass)
+ * together with the resolution scales that pass was rendered at, and it outputs the scales (X and Y) of the next frames,
+ * so that the pass fits a frame time budget.
+ *
+ * How it works:
+ * -> The GPU time of the pass is (roughly) proportional to the number of pixels: measurements are rescaled
+ *    to the current resolution, so the latency of the queries (results arrive some frames later) doesn't make it overshoot.
+ * -> A PID controller works on the log of the time error (log(budget/time)) and outputs the log of the pixel area.
+ * -> Hysteresis: inside a dead band just below the budget nothing changes, and two changes are at least "cooldown_frames" apart.
+ * -> The area is split between X and Y (see "x_weight"), and both scales are quantized (see "step"), to avoid tiny changes every frame.
+ *
+ * DynResTrace records (frame, time, scales) so that a run can be replayed offline with different settings
+ * (see dynres_replay.c).
+*/
+
+/* USAGE:
+ * Define DYNAMIC_RESOLUTION_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * DynResSettings s;DynResController c;
+ * DynResSettings_Init(&s,16.f);           // budget in ms
+ * DynResController_Init(&c,&s);
+ * // every time a GPU time is available (ms of a frame rendered at scale sx,sy):
+ * if (DynResController_Update(&c,ms,sx,sy)) {...}    // c.scale_x and c.scale_y changed
+*/
+
+#include <stdio.h> // FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float budget_ms;                // target GPU time of the scaled pass
+    float kp,ki,kd;                 // PID gains (the error is log(target/measured_ms), where target is the center of the dead band)
+    float hysteresis;               // dead band: nothing changes while measured_ms is in [budget_ms*(1-2*hysteresis),budget_ms]
+    float smoothing;                // exponential smoothing of the measurements in [0,1) (0 = none)
+    float min_scale_x,min_scale_y;
+    float max_scale_x,max_scale_y;
+    float x_weight;                 // in [0,1]: how a change of the area is split between the axes: 0.5 = uniform, 1 = X as long as possible
+    float step;                     // quantization step of the scales (0 = none)
+    int cooldown_frames;            // min number of updates between two changes of the scales
+} DynResSettings;
+
+typedef struct {
+    DynResSettings settings;
+    float scale_x,scale_y;          // output (quantized)
+    float log_area;                 // continuous (unquantized) output: log(scale_x*scale_y)
+    float integral,prev_error;
+    float filtered_ms;              // smoothed measurement (rescaled to the current scales); <0 = no measurements yet
+    int updates_since_change;
+    int num_changes;                // number of times the scales have changed
+} DynResController;
+
+void DynResSettings_Init(DynResSettings* s,float budgetMs);
+void DynResController_Init(DynResController* c,const DynResSettings* s);
+void DynResController_Reset(DynResController* c);  // back to max scales (it keeps the settings)
+int  DynResController_Update(DynResController* c,float measuredMs,float measuredScaleX,float measuredScaleY);  // returns 1 if scale_x or scale_y has changed
+
+typedef struct {
+    unsigned frame;
+    float ms;                       // measured GPU time of the scaled pass
+    float scale_x,scale_y;          // the pass was rendered at these scales
+    float budget_ms;
+} DynResTraceSample;
+
+typedef struct {
+    DynResTraceSample* samples;
+    int num_samples,capacity;
+} DynResTrace;
+
+void DynResTrace_Init(DynResTrace* t);
+void DynResTrace_Destroy(DynResTrace* t);
+int  DynResTrace_Add(DynResTrace* t,const DynResTraceSample* s);    // returns 0 on failure (out of memory)
+int  DynResTrace_Load(DynResTrace* t,const char* filePath);         // CSV; returns 0 on success, -1 on failure
+int  DynResTrace_Save(const DynResTrace* t,const char* filePath);   // CSV; returns 0 on success, -1 on failure
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //DYNAMIC_RESOLUTION_H_
+
+#ifdef DYNAMIC_RESOLUTION_IMPLEMENTATION
+#ifndef DYNAMIC_RESOLUTION_IMPLEMENTATION_GUARD
+#define DYNAMIC_RESOLUTION_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void DynResSettings_Init(DynResSettings* s,float budgetMs) {
+    s->budget_ms = budgetMs;
+    s->kp = 0.15f;s->ki = 0.25f;s->kd = 0.f;
+    s->hysteresis = 0.08f;
+    s->smoothing = 0.5f;
+    s->min_scale_x = s->min_scale_y = 0.25f;
+    s->max_scale_x = s->max_scale_y = 1.f;
+    s->x_weight = 0.5f;
+    s->step = 1.f/32.f;
+    s->cooldown_frames = 4;
+}
+void DynResController_Init(DynResController* c,const DynResSettings* s) {
+    c->settings = *s;
+    DynResController_Reset(c);
+}
+void DynResController_Reset(DynResController* c) {
+    c->scale_x = c->settings.max_scale_x;
+    c->scale_y = c->settings.max_scale_y;
+    c->log_area = c->integral = logf(c->scale_x*c->scale_y);
+    c->prev_error = 0.f;
+    c->filtered_ms = -1.f;
+    c->updates_since_change = 0;
+    c->num_changes = 0;
+}
+static float DynRes_Clamp(float v,float mn,float mx) {return v<mn ? mn : (v>mx ? mx : v);}
+static float DynRes_Quantize(float v,float step,float mn,float mx) {
+    if (step>0.f) {
+        v = floorf(v/step+0.5f)*step;
+        // the min and max scales don't need to be multiples of the step
+        if (v<mn) v = mn;
+        if (v>mx) v = mx;
+    }
+    return v;
+}
+int DynResController_Update(DynResController* c,float measuredMs,float measuredScaleX,float measuredScaleY) {
+    const DynResSettings* s = &c->settings;
+    const float minLogArea = logf(s->min_scale_x*s->min_scale_y);
+    const float maxLogArea = logf(s->max_scale_x*s->max_scale_y);
+    const float measuredArea = measuredScaleX*measuredScaleY;
+    const float targetMs = s->budget_ms*(1.f-s->hysteresis);   // center of the dead band
+    float ms,error,logScaleX,logScaleY,scaleX,scaleY;
+    if (measuredMs<=0.f || measuredArea<=0.f || s->budget_ms<=0.f) return 0;
+
+    // Rescale the measurement to the current scales (they might have changed since that frame was rendered)
+    ms = measuredMs*(c->scale_x*c->scale_y)/measuredArea;
+    c->filtered_ms = c->filtered_ms<0.f ? ms : c->filtered_ms+(ms-c->filtered_ms)*(1.f-s->smoothing);
+    ++c->updates_since_change;
+
+    error = logf(targetMs/c->filtered_ms);
+    if (fabsf(c->filtered_ms-targetMs)<=s->budget_ms*s->hysteresis) error = 0.f;   // dead band
+    c->integral = DynRes_Clamp(c->integral+s->ki*error,minLogArea,maxLogArea);       // anti-windup
+    c->log_area = DynRes_Clamp(c->integral+s->kp*error+s->kd*(error-c->prev_error),minLogArea,maxLogArea);
+    c->prev_error = error;
+    if (c->updates_since_change<s->cooldown_frames) return 0;
+
+    // Split the area between X and Y: what one axis can't take (because of its limits) goes to the other one
+    logScaleX = DynRes_Clamp(c->log_area*s->x_weight,logf(s->min_scale_x),logf(s->max_scale_x));
+    logScaleY = DynRes_Clamp(c->log_area-logScaleX,logf(s->min_scale_y),logf(s->max_scale_y));
+    logScaleX = DynRes_Clamp(c->log_area-logScaleY,logf(s->min_scale_x),logf(s->max_scale_x));
+    scaleX = DynRes_Quantize(expf(logScaleX),s->step,s->min_scale_x,s->max_scale_x);
+    scaleY = DynRes_Quantize(expf(logScaleY),s->step,s->min_scale_y,s->max_scale_y);
+    if (scaleX==c->scale_x && scaleY==c->scale_y) return 0;
+
+    // The measurement is kept in sync with the new scales
+    c->filtered_ms*= (scaleX*scaleY)/(c->scale_x*c->scale_y);
+    c->scale_x = scaleX;c->scale_y = scaleY;
+    c->updates_since_change = 0;
+    ++c->num_changes;
+    return 1;
+}
+
+void DynResTrace_Init(DynResTrace* t) {
+    t->samples = NULL;
+    t->num_samples = t->capacity = 0;
+}
+void DynResTrace_Destroy(DynResTrace* t) {
+    if (t->samples) free(t->samples);
+    DynResTrace_Init(t);
+}
+int DynResTrace_Add(DynResTrace* t,const DynResTraceSample* s) {
+    if (t->num_samples==t->capacity) {
+        const int capacity = t->capacity>0 ? t->capacity*2 : 1024;
+        DynResTraceSample* samples = (DynResTraceSample*) realloc(t->samples,capacity*sizeof(DynResTraceSample));
+        if (!samples) return 0;
+        t->samples = samples;t->capacity = capacity;
+    }
+    t->samples[t->num_samples++] = *s;
+    return 1;
+}
+int DynResTrace_Load(DynResTrace* t,const char* filePath) {
+    FILE* f = fopen(filePath,"rt");
+    char buf[256];
+    if (!f) return -1;
+    t->num_samples = 0;
+    while (fgets(buf,sizeof(buf),f)) {
+        DynResTraceSample s;
+        if (sscanf(buf,"%u,%f,%f,%f,%f",&s.frame,&s.ms,&s.scale_x,&s.scale_y,&s.budget_ms)!=5) continue;   // e.g. the header line
+        if (!DynResTrace_Add(t,&s)) {fclose(f);return -1;}
+    }
+    fclose(f);
+    return t->num_samples>0 ? 0 : -1;
+}
+int DynResTrace_Save(const DynResTrace* t,const char* filePath) {
+    FILE* f = fopen(filePath,"wt");
+    int i;
+    if (!f) return -1;
+    fprintf(f,"frame,ms,scale_x,scale_y,budget_ms\n");
+    for (i=0;i<t->num_samples;i++) {
+        const DynResTraceSample* s = &t->samples[i];
+        fprintf(f,"%u,%.4f,%.5f,%.5f,%.4f\n",s->frame,s->ms,s->scale_x,s->scale_y,s->budget_ms);
+    }
+    fclose(f);
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //DYNAMIC_RESOLUTION_IMPLEMENTATION_GUARD
+#endif //DYNAMIC_RESOLUTION_IMPLEMENTATION
@@ -0,0 +1,165 @@
+// Offline replay of a dynamic resolution trace (see DynResTrace in "dynamic_resolution.h"): no OpenGL needed.
+// A trace (recorded by the demo with --dynres-trace <file.csv>) stores the GPU time of the raycast pass of every frame
+// and the scales it was rendered at. Here every recorded frame becomes a "cost per pixel area", and the controller
+// is run again on it (with the settings passed on the command-line and a simulated query latency),
+// so that its stability can be evaluated and tuned without running the demo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DYNAMIC_RESOLUTION_IMPLEMENTATION
+#include "dynamic_resolution.h"
+
+#define FRAME_STATS_IMPLEMENTATION
+#include "frame_stats.h"
+
+typedef struct {
+    const char* trace_file;
+    const char* output_file;    // per-frame CSV of the simulation (NULL = none)
+    DynResSettings settings;    // budget_ms<=0 = the one stored in the trace
+    int latency;                // frames between a frame and the availability of its GPU time
+    float overhead_ms;          // part of the pass time that doesn't depend on the resolution
+    int legacy;                 // the old controller (FPS sampled every 2 seconds, fixed gain)
+} ReplayArgs;
+
+static void PrintUsage(const char* exe) {
+    DynResSettings d;
+    DynResSettings_Init(&d,0.f);
+    printf("Usage: %s -i <trace.csv> [options]\n",exe);
+    printf("  -o <file.csv>       writes the simulated frames\n");
+    printf("  --budget <ms>       (default: the one in the trace)\n");
+    printf("  --kp <gain>         (default: %g)\n",d.kp);
+    printf("  --ki <gain>         (default: %g)\n",d.ki);
+    printf("  --kd <gain>         (default: %g)\n",d.kd);
+    printf("  --hysteresis <f>    (default: %g)\n",d.hysteresis);
+    printf("  --smoothing <f>     (default: %g)\n",d.smoothing);
+    printf("  --step <f>          (default: %g)\n",d.step);
+    printf("  --cooldown <n>      (default: %d)\n",d.cooldown_frames);
+    printf("  --x-weight <f>      (default: %g)\n",d.x_weight);
+    printf("  --min-scale <f>     (default: %g)\n",d.min_scale_x);
+    printf("  --latency <frames>  (default: 2)\n");
+    printf("  --overhead <ms>     (default: 0)\n");
+    printf("  --legacy            simulates the old controller instead\n");
+}
+
+static int ParseArgs(ReplayArgs* a,int argc,char* argv[]) {
+    int i;
+    memset(a,0,sizeof(ReplayArgs));
+    DynResSettings_Init(&a->settings,0.f);
+    a->latency = 2;
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (strcmp(arg,"--legacy")==0) {a->legacy = 1;continue;}
+        if (strcmp(arg,"--help")==0) return 0;
+        if (!val) {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        if      (strcmp(arg,"-i")==0)           a->trace_file = val;
+        else if (strcmp(arg,"-o")==0)           a->output_file = val;
+        else if (strcmp(arg,"--budget")==0)     a->settings.budget_ms = (float) atof(val);
+        else if (strcmp(arg,"--kp")==0)         a->settings.kp = (float) atof(val);
+        else if (strcmp(arg,"--ki")==0)         a->settings.ki = (float) atof(val);
+        else if (strcmp(arg,"--kd")==0)         a->settings.kd = (float) atof(val);
+        else if (strcmp(arg,"--hysteresis")==0) a->settings.hysteresis = (float) atof(val);
+        else if (strcmp(arg,"--smoothing")==0)  a->settings.smoothing = (float) atof(val);
+        else if (strcmp(arg,"--step")==0)       a->settings.step = (float) atof(val);
+        else if (strcmp(arg,"--cooldown")==0)   a->settings.cooldown_frames = atoi(val);
+        else if (strcmp(arg,"--x-weight")==0)   a->settings.x_weight = (float) atof(val);
+        else if (strcmp(arg,"--min-scale")==0)  a->settings.min_scale_x = a->settings.min_scale_y = (float) atof(val);
+        else if (strcmp(arg,"--latency")==0)    a->latency = atoi(val);
+        else if (strcmp(arg,"--overhead")==0)   a->overhead_ms = (float) atof(val);
+        else {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        ++i;
+    }
+    if (!a->trace_file) {fprintf(stderr,"Missing trace file (-i)\n");return 0;}
+    if (a->latency<0 || a->overhead_ms<0.f || a->settings.smoothing<0.f || a->settings.smoothing>=1.f ||
+        a->settings.min_scale_x<=0.f || a->settings.min_scale_x>1.f) {
+        fprintf(stderr,"Invalid argument values\n");
+        return 0;
+    }
+    return 1;
+}
+
+// GPU time of the recorded frame "s" if it was rendered at scaleX,scaleY
+static float SimulatePass(const DynResTraceSample* s,float overheadMs,float scaleX,float scaleY) {
+    const float overhead = overheadMs<s->ms ? overheadMs : s->ms;
+    return overhead+(s->ms-overhead)*(scaleX*scaleY)/(s->scale_x*s->scale_y);
+}
+
+int main(int argc,char* argv[]) {
+    ReplayArgs args;
+    DynResTrace trace;
+    DynResController c;
+    FILE* out = NULL;
+    float* scales;              // [2*num_samples]: simulated scales of every frame
+    double* ms;                 // [num_samples]: simulated times
+    double sumArea = 0.0,sumAbsLogError = 0.0;
+    int i,numOverBudget = 0,numChanges = 0;
+    float budget;
+    // legacy controller state
+    float legacyFactor = 1.f,legacyTime = 0.f;int legacyFrames = 0;
+    FrameStatsSummary summary;
+
+    if (!ParseArgs(&args,argc,argv)) {PrintUsage(argv[0]);return 1;}
+    DynResTrace_Init(&trace);
+    if (DynResTrace_Load(&trace,args.trace_file)!=0) {fprintf(stderr,"Can't load trace: %s\n",args.trace_file);return 1;}
+    if (args.settings.budget_ms<=0.f) args.settings.budget_ms = trace.samples[0].budget_ms;
+    budget = args.settings.budget_ms;
+    if (budget<=0.f) {fprintf(stderr,"Invalid budget\n");DynResTrace_Destroy(&trace);return 1;}
+    DynResController_Init(&c,&args.settings);
+
+    scales = (float*) malloc(2*trace.num_samples*sizeof(float));
+    ms = (double*) malloc(trace.num_samples*sizeof(double));
+    if (!scales || !ms) {fprintf(stderr,"Out of memory\n");return 1;}
+    if (args.output_file) {
+        out = fopen(args.output_file,"wt");
+        if (!out) fprintf(stderr,"Can't write: %s\n",args.output_file);
+        else fprintf(out,"frame,ms,scale_x,scale_y,budget_ms\n");
+    }
+
+    for (i=0;i<trace.num_samples;i++) {
+        const DynResTraceSample* s = &trace.samples[i];
+        float scaleX,scaleY;
+        if (args.legacy) scaleX = scaleY = legacyFactor;
+        else {scaleX = c.scale_x;scaleY = c.scale_y;}
+        if (i>0 && (scaleX!=scales[2*(i-1)] || scaleY!=scales[2*(i-1)+1])) ++numChanges;
+        scales[2*i] = scaleX;scales[2*i+1] = scaleY;
+        ms[i] = SimulatePass(s,args.overhead_ms,scaleX,scaleY);
+
+        if (args.legacy) {
+            // Same code of the old DrawGL(): the whole frame is the pass here
+            legacyTime+=(float)ms[i];++legacyFrames;
+            if (legacyTime>2000.f) {
+                const float FPS_TARGET = (float)(int)(1000.f/budget);
+                const float FPS = (float)(unsigned)((float)legacyFrames*1000.f/legacyTime);
+                if (FPS<FPS_TARGET) {legacyFactor-= legacyFactor*(FPS_TARGET-FPS)*0.0175f;if (legacyFactor<0.15f) legacyFactor=0.15f;}
+                else {legacyFactor+= legacyFactor*(FPS-FPS_TARGET)*0.0175f;if (legacyFactor>1.0f) legacyFactor=1.0f;}
+                legacyTime = 0.f;legacyFrames = 0;
+            }
+        }
+        else if (i>=args.latency) {
+            // The GPU time of frame i-latency is available now
+            const int j = i-args.latency;
+            DynResController_Update(&c,(float)ms[j],scales[2*j],scales[2*j+1]);
+        }
+
+        if (ms[i]>budget) ++numOverBudget;
+        sumAbsLogError+=fabs(log(ms[i]/budget));
+        sumArea+=scaleX*scaleY;
+        if (out) fprintf(out,"%u,%.4f,%.5f,%.5f,%.4f\n",s->frame,ms[i],scaleX,scaleY,budget);
+    }
+    if (out) fclose(out);
+
+    FrameStats_Summarize(ms,trace.num_samples,&summary);
+    printf("Trace: %s (%d frames) Controller: %s Budget: %.3f ms Latency: %d frames\n",args.trace_file,trace.num_samples,
+           args.legacy?"legacy":"PID",budget,args.latency);
+    printf("Pass time (ms): mean %.3f median %.3f p95 %.3f p99 %.3f max %.3f stddev %.3f\n",
+           summary.mean,summary.median,summary.p95,summary.p99,summary.max,summary.stddev);
+    printf("Frames over budget: %.2f%%  Mean |log(time/budget)|: %.4f\n",100.0*numOverBudget/trace.num_samples,sumAbsLogError/trace.num_samples);
+    printf("Resolution changes: %d (%.2f per 100 frames)  Mean pixel area: %.3f\n",numChanges,100.0*numChanges/trace.num_samples,sumArea/trace.num_samples);
+
+    free(ms);free(scales);
+    DynResTrace_Destroy(&trace);
+    return 0;
+}
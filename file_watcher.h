@@ -0,0 +1,147 @@
+#ifndef FILE_WATCHER_H_
+#define FILE_WATCHER_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only file to know when a file has been written (e.g. to hot-reload a shader), without blocking.
+ * -> On Linux it uses inotify on the directory of the file (so that it works with editors that save to a temporary file and then
+ *    rename it), with a non-blocking descriptor.
+ * -> Elsewhere it compares the modification time (and size) of the file every time it's polled.
+ * Poll it once per frame: it never blocks, and many events between two polls are reported once.
+*/
+
+/* USAGE:
+ * Define FILE_WATCHER_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * FileWatcher w;
+ * if (FileWatcher_Init(&w,"signed_distance_shapes.glsl")) {
+ *     // once per frame:
+ *     if (FileWatcher_Poll(&w)) {...}      // the file has been written since the last poll
+ *     // at the end:
+ *     FileWatcher_Destroy(&w);
+ * }
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (defined(__linux__) && !defined(FILE_WATCHER_NO_INOTIFY))
+#define FILE_WATCHER_USE_INOTIFY
+#endif
+
+#ifndef FILE_WATCHER_MAX_PATH_LENGTH
+#define FILE_WATCHER_MAX_PATH_LENGTH (1024)
+#endif
+
+typedef struct {
+    char file_path[FILE_WATCHER_MAX_PATH_LENGTH];
+#   ifdef FILE_WATCHER_USE_INOTIFY
+    int fd,wd;                      // inotify instance and watch (of the directory)
+    const char* file_name;          // points inside file_path
+#   else
+    long long mtime,size;           // last seen values (-1 = missing file)
+#   endif
+} FileWatcher;
+
+int  FileWatcher_Init(FileWatcher* w,const char* filePath);    // returns 0 on failure (the file doesn't need to exist)
+void FileWatcher_Destroy(FileWatcher* w);
+int  FileWatcher_Poll(FileWatcher* w);                         // returns 1 if the file has been written (or created, or replaced) since the last call
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FILE_WATCHER_H_
+
+#ifdef FILE_WATCHER_IMPLEMENTATION
+#ifndef FILE_WATCHER_IMPLEMENTATION_GUARD
+#define FILE_WATCHER_IMPLEMENTATION_GUARD
+
+#include <string.h>
+#ifdef FILE_WATCHER_USE_INOTIFY
+#   include <sys/inotify.h>
+#   include <unistd.h>
+#   include <errno.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef FILE_WATCHER_USE_INOTIFY
+int FileWatcher_Init(FileWatcher* w,const char* filePath) {
+    char dir[FILE_WATCHER_MAX_PATH_LENGTH];
+    const char* slash;
+    memset(w,0,sizeof(FileWatcher));
+    w->fd = w->wd = -1;
+    if (strlen(filePath)>=FILE_WATCHER_MAX_PATH_LENGTH) return 0;
+    strcpy(w->file_path,filePath);
+    slash = strrchr(w->file_path,'/');
+    if (slash) {
+        const size_t len = slash==w->file_path ? 1 : (size_t)(slash-w->file_path);
+        memcpy(dir,w->file_path,len);dir[len] = '\0';
+        w->file_name = slash+1;
+    }
+    else {strcpy(dir,".");w->file_name = w->file_path;}
+    w->fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if (w->fd<0) return 0;
+    // IN_CLOSE_WRITE: saved in place; IN_MOVED_TO/IN_CREATE: replaced by another file (IN_MODIFY would fire in the middle of a write)
+    w->wd = inotify_add_watch(w->fd,dir,IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE);
+    if (w->wd<0) {close(w->fd);w->fd = -1;return 0;}
+    return 1;
+}
+void FileWatcher_Destroy(FileWatcher* w) {
+    if (w->fd>=0) close(w->fd);     // (it removes the watch too)
+    w->fd = w->wd = -1;
+}
+int FileWatcher_Poll(FileWatcher* w) {
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    if (w->fd<0) return 0;
+    for (;;) {
+        const ssize_t len = read(w->fd,buf,sizeof(buf));
+        ssize_t i;
+        if (len<=0) break;      // EAGAIN: no more events
+        for (i=0;i<len;) {
+            const struct inotify_event* e = (const struct inotify_event*) &buf[i];
+            if (e->len>0 && strcmp(e->name,w->file_name)==0) changed = 1;
+            i+=sizeof(struct inotify_event)+e->len;
+        }
+    }
+    return changed;
+}
+#else //FILE_WATCHER_USE_INOTIFY
+static void FileWatcher_Stat(const char* filePath,long long* mtime,long long* size) {
+    struct stat st;
+    if (stat(filePath,&st)!=0) {*mtime = *size = -1;return;}
+    *mtime = (long long) st.st_mtime;
+    *size = (long long) st.st_size;
+}
+int FileWatcher_Init(FileWatcher* w,const char* filePath) {
+    memset(w,0,sizeof(FileWatcher));
+    if (strlen(filePath)>=FILE_WATCHER_MAX_PATH_LENGTH) return 0;
+    strcpy(w->file_path,filePath);
+    FileWatcher_Stat(w->file_path,&w->mtime,&w->size);
+    return 1;
+}
+void FileWatcher_Destroy(FileWatcher* w) {(void)w;}
+int FileWatcher_Poll(FileWatcher* w) {
+    long long mtime,size;
+    FileWatcher_Stat(w->file_path,&mtime,&size);
+    if (mtime==w->mtime && size==w->size) return 0;
+    w->mtime = mtime;w->size = size;
+    return mtime>=0;
+}
+#endif //FILE_WATCHER_USE_INOTIFY
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FILE_WATCHER_IMPLEMENTATION_GUARD
+#endif //FILE_WATCHER_IMPLEMENTATION
@@ -0,0 +1,280 @@
+#ifndef FRAME_STATS_H_
+#define FRAME_STATS_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only helper to measure frame times:
+ * a monotonic nanosecond clock, the summary statistics (mean, median, percentiles...)
+ * of a set of frame time samples, and FrameTelemetry: a lock-free ring buffer
+ * that records the timings of every frame (rolling statistics and CSV dump).
+*/
+
+/* USAGE:
+ * Define FRAME_STATS_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * unsigned long long start = FrameStats_GetTimeNs();
+ * // ... draw a frame ...
+ * samples[n++] = (double)(FrameStats_GetTimeNs()-start)*1.0e-6;   // ms
+ * FrameStats_Summarize(samples,n,&summary);                         // summary.mean, summary.p99, ...
+ *
+ * FrameTelemetry t;FrameTelemetrySample fs;
+ * FrameTelemetry_Create(&t,0);                             // 0 = FRAME_TELEMETRY_DEFAULT_CAPACITY frames
+ * // every frame (from a single thread):
+ * fs.frame = frame;fs.start_ns = ...;fs.frame_ns = ...;fs.cpu_ns = ...;fs.gpu_ns = 0;
+ * FrameTelemetry_Push(&t,&fs);
+ * // from any thread:
+ * FrameTelemetry_GetRollingStats(&t,120,&frameMs,&cpuMs,&gpuMs);  // last 120 frames
+ * FrameTelemetry_SaveCsv(&t,"telemetry.csv");
+ * FrameTelemetry_Destroy(&t);
+*/
+
+#include <stdio.h> // FILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int num_samples;
+    double mean,median,p95,p99,min,max,stddev;  // same unit of the samples
+} FrameStatsSummary;
+
+unsigned long long FrameStats_GetTimeNs(void);      // monotonic clock (it's never affected by changes of the system time)
+void FrameStats_Summarize(const double* samples,int numSamples,FrameStatsSummary* s);  // samples are not modified
+double FrameStats_Percentile(const double* sortedSamples,int numSamples,double percentile);  // percentile in [0,100], linear interpolation between the closest ranks
+void FrameStatsSummary_FprintJson(FILE* f,const FrameStatsSummary* s);    // a JSON object (on a single line) with all the fields of "s"
+
+#ifndef FRAME_TELEMETRY_DEFAULT_CAPACITY
+#define FRAME_TELEMETRY_DEFAULT_CAPACITY (8192)    // frames (rounded up to a power of two)
+#endif
+
+typedef struct {
+    unsigned long long frame;
+    unsigned long long start_ns;    // FrameStats_GetTimeNs() at the start of the frame
+    unsigned long long frame_ns;    // since the start of the previous frame (0 for the first frame)
+    unsigned long long cpu_ns;      // CPU time spent to build the frame
+    unsigned long long gpu_ns;      // GPU time of the frame (0 = not available: e.g. no timer queries)
+} FrameTelemetrySample;
+
+// Single producer (the thread that calls FrameTelemetry_Push(...)), multiple readers:
+// readers never block the producer, and the samples overwritten while they were copied are discarded.
+typedef struct {
+    FrameTelemetrySample* samples;
+    unsigned capacity;                  // power of two
+    volatile unsigned long long head;   // number of samples pushed so far
+} FrameTelemetry;
+
+int  FrameTelemetry_Create(FrameTelemetry* t,unsigned capacity);   // returns 0 on failure (out of memory)
+void FrameTelemetry_Destroy(FrameTelemetry* t);
+void FrameTelemetry_Clear(FrameTelemetry* t);                       // must be called by the producer thread
+void FrameTelemetry_Push(FrameTelemetry* t,const FrameTelemetrySample* s);
+int  FrameTelemetry_GetLastSamples(const FrameTelemetry* t,FrameTelemetrySample* out,int maxSamples);  // copies (oldest first) and returns the number of copied samples
+int  FrameTelemetry_GetRollingStats(const FrameTelemetry* t,int numFrames,FrameStatsSummary* frameMs,FrameStatsSummary* cpuMs,FrameStatsSummary* gpuMs);  // stats (in ms) of the last numFrames frames; any output can be NULL; returns the number of frames (0 on failure)
+int  FrameTelemetry_SaveCsv(const FrameTelemetry* t,const char* filePath);  // all the samples in the ring buffer; returns 0 on success, -1 on failure
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FRAME_STATS_H_
+
+#ifdef FRAME_STATS_IMPLEMENTATION
+#ifndef FRAME_STATS_IMPLEMENTATION_GUARD
+#define FRAME_STATS_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#   include <windows.h>
+#elif defined(__EMSCRIPTEN__)
+#   include <emscripten.h>
+#else
+#   include <time.h>
+#endif
+
+// Acquire/release accesses of FrameTelemetry::head (and the fences around the copies of the samples)
+#if defined(__GNUC__) || defined(__clang__)
+#   define FRAME_TELEMETRY_LOAD_ACQUIRE(p)      __atomic_load_n((p),__ATOMIC_ACQUIRE)
+#   define FRAME_TELEMETRY_STORE_RELEASE(p,v)   __atomic_store_n((p),(v),__ATOMIC_RELEASE)
+#   define FRAME_TELEMETRY_FENCE_ACQUIRE()      __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#   define FRAME_TELEMETRY_FENCE_RELEASE()      __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+#   include <intrin.h>
+#   define FRAME_TELEMETRY_LOAD_ACQUIRE(p)      ((unsigned long long)_InterlockedCompareExchange64((volatile long long*)(p),0,0))
+#   define FRAME_TELEMETRY_STORE_RELEASE(p,v)   _InterlockedExchange64((volatile long long*)(p),(long long)(v))
+#   define FRAME_TELEMETRY_FENCE_ACQUIRE()      MemoryBarrier()
+#   define FRAME_TELEMETRY_FENCE_RELEASE()      MemoryBarrier()
+#else
+#   define FRAME_TELEMETRY_LOAD_ACQUIRE(p)      (*(p))
+#   define FRAME_TELEMETRY_STORE_RELEASE(p,v)   (*(p)=(v))
+#   define FRAME_TELEMETRY_FENCE_ACQUIRE()
+#   define FRAME_TELEMETRY_FENCE_RELEASE()
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned long long FrameStats_GetTimeNs(void) {
+#   ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart==0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)((double)counter.QuadPart*(1.0e9/(double)frequency.QuadPart));
+#   elif defined(__EMSCRIPTEN__)
+    return (unsigned long long)(emscripten_get_now()*1.0e6);
+#   else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL+(unsigned long long)ts.tv_nsec;
+#   endif
+}
+
+static int FrameStats_CompareDoubles(const void* a,const void* b) {
+    const double da = *(const double*)a, db = *(const double*)b;
+    return da<db ? -1 : (da>db ? 1 : 0);
+}
+double FrameStats_Percentile(const double* sortedSamples,int numSamples,double percentile) {
+    double rank;int i;
+    if (numSamples<=0) return 0.0;
+    if (percentile<=0.0) return sortedSamples[0];
+    if (percentile>=100.0) return sortedSamples[numSamples-1];
+    rank = percentile*0.01*(double)(numSamples-1);
+    i = (int)rank;
+    if (i+1>=numSamples) return sortedSamples[numSamples-1];
+    return sortedSamples[i]+(sortedSamples[i+1]-sortedSamples[i])*(rank-(double)i);
+}
+void FrameStats_Summarize(const double* samples,int numSamples,FrameStatsSummary* s) {
+    double* sorted;
+    double sum = 0.0,sum2 = 0.0;
+    int i;
+    memset(s,0,sizeof(FrameStatsSummary));
+    if (numSamples<=0) return;
+    sorted = (double*) malloc(numSamples*sizeof(double));
+    if (!sorted) return;
+    memcpy(sorted,samples,numSamples*sizeof(double));
+    qsort(sorted,numSamples,sizeof(double),&FrameStats_CompareDoubles);
+    for (i=0;i<numSamples;i++) sum+=sorted[i];
+    s->num_samples = numSamples;
+    s->mean = sum/(double)numSamples;
+    for (i=0;i<numSamples;i++) sum2+=(sorted[i]-s->mean)*(sorted[i]-s->mean);
+    s->stddev = sqrt(sum2/(double)numSamples);
+    s->min = sorted[0];
+    s->max = sorted[numSamples-1];
+    s->median = FrameStats_Percentile(sorted,numSamples,50.0);
+    s->p95 = FrameStats_Percentile(sorted,numSamples,95.0);
+    s->p99 = FrameStats_Percentile(sorted,numSamples,99.0);
+    free(sorted);
+}
+void FrameStatsSummary_FprintJson(FILE* f,const FrameStatsSummary* s) {
+    fprintf(f,"{\"samples\": %d, \"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f, \"stddev\": %.4f}",
+            s->num_samples,s->mean,s->median,s->p95,s->p99,s->min,s->max,s->stddev);
+}
+
+int FrameTelemetry_Create(FrameTelemetry* t,unsigned capacity) {
+    unsigned c = 1;
+    if (capacity==0) capacity = FRAME_TELEMETRY_DEFAULT_CAPACITY;
+    while (c<capacity) c<<=1;
+    t->head = 0;
+    t->capacity = 0;
+    t->samples = (FrameTelemetrySample*) malloc(c*sizeof(FrameTelemetrySample));
+    if (!t->samples) return 0;
+    t->capacity = c;
+    return 1;
+}
+void FrameTelemetry_Destroy(FrameTelemetry* t) {
+    if (t->samples) free(t->samples);
+    t->samples = NULL;
+    t->capacity = 0;
+    t->head = 0;
+}
+void FrameTelemetry_Clear(FrameTelemetry* t) {FRAME_TELEMETRY_STORE_RELEASE(&t->head,0ULL);}
+void FrameTelemetry_Push(FrameTelemetry* t,const FrameTelemetrySample* s) {
+    const unsigned long long head = t->head;    // only the producer writes it
+    if (t->capacity==0) return;
+    // Like the sequence counter of a seqlock: a reader that sees (part of) the new sample
+    // must also see the previous store to head (paired with the acquire fence in FrameTelemetry_GetLastSamples(...))
+    FRAME_TELEMETRY_FENCE_RELEASE();
+    t->samples[head&(t->capacity-1)] = *s;
+    FRAME_TELEMETRY_STORE_RELEASE(&t->head,head+1);
+}
+int FrameTelemetry_GetLastSamples(const FrameTelemetry* t,FrameTelemetrySample* out,int maxSamples) {
+    unsigned long long head,headAfter,first;
+    int i,n,skip;
+    if (t->capacity==0 || maxSamples<=0) return 0;
+    head = FRAME_TELEMETRY_LOAD_ACQUIRE(&t->head);
+    n = head<(unsigned long long)t->capacity ? (int)head : (int)t->capacity;
+    if (n>maxSamples) n = maxSamples;
+    first = head-(unsigned long long)n;
+    for (i=0;i<n;i++) out[i] = t->samples[(first+i)&(t->capacity-1)];
+    // The producer might have overwritten the oldest samples while we were copying them
+    // (and it might be writing the slot of sample number headAfter-capacity right now).
+    // The acquire fence keeps the copies above from being reordered after the second read of head
+    FRAME_TELEMETRY_FENCE_ACQUIRE();
+    headAfter = FRAME_TELEMETRY_LOAD_ACQUIRE(&t->head);
+    if (headAfter-first<(unsigned long long)t->capacity) return n;
+    skip = (int)(headAfter-first-(unsigned long long)t->capacity)+1;
+    if (skip>=n) return 0;
+    memmove(out,&out[skip],(n-skip)*sizeof(FrameTelemetrySample));
+    return n-skip;
+}
+int FrameTelemetry_GetRollingStats(const FrameTelemetry* t,int numFrames,FrameStatsSummary* frameMs,FrameStatsSummary* cpuMs,FrameStatsSummary* gpuMs) {
+    FrameTelemetrySample* samples;
+    double* values;
+    int i,j,n;
+    if (frameMs) memset(frameMs,0,sizeof(FrameStatsSummary));
+    if (cpuMs) memset(cpuMs,0,sizeof(FrameStatsSummary));
+    if (gpuMs) memset(gpuMs,0,sizeof(FrameStatsSummary));
+    if (numFrames<=0) return 0;
+    if (numFrames>(int)t->capacity) numFrames = (int)t->capacity;
+    samples = (FrameTelemetrySample*) malloc(numFrames*sizeof(FrameTelemetrySample));
+    values = (double*) malloc(numFrames*sizeof(double));
+    if (!samples || !values) {if (samples) free(samples);if (values) free(values);return 0;}
+    n = FrameTelemetry_GetLastSamples(t,samples,numFrames);
+    if (frameMs) {
+        for (i=0,j=0;i<n;i++) {if (samples[i].frame_ns>0) values[j++] = (double)samples[i].frame_ns*1.0e-6;}
+        FrameStats_Summarize(values,j,frameMs);
+    }
+    if (cpuMs) {
+        for (i=0;i<n;i++) values[i] = (double)samples[i].cpu_ns*1.0e-6;
+        FrameStats_Summarize(values,n,cpuMs);
+    }
+    if (gpuMs) {
+        for (i=0,j=0;i<n;i++) {if (samples[i].gpu_ns>0) values[j++] = (double)samples[i].gpu_ns*1.0e-6;}
+        FrameStats_Summarize(values,j,gpuMs);
+    }
+    free(values);
+    free(samples);
+    return n;
+}
+int FrameTelemetry_SaveCsv(const FrameTelemetry* t,const char* filePath) {
+    FrameTelemetrySample* samples;
+    FILE* f;
+    int i,n;
+    if (t->capacity==0) return -1;
+    samples = (FrameTelemetrySample*) malloc(t->capacity*sizeof(FrameTelemetrySample));
+    if (!samples) return -1;
+    n = FrameTelemetry_GetLastSamples(t,samples,(int)t->capacity);
+    f = fopen(filePath,"wt");
+    if (!f) {free(samples);return -1;}
+    fprintf(f,"frame,start_ns,frame_ns,cpu_ns,gpu_ns\n");
+    for (i=0;i<n;i++) {
+        const FrameTelemetrySample* s = &samples[i];
+        if (s->gpu_ns>0) fprintf(f,"%llu,%llu,%llu,%llu,%llu\n",s->frame,s->start_ns,s->frame_ns,s->cpu_ns,s->gpu_ns);
+        else fprintf(f,"%llu,%llu,%llu,%llu,\n",s->frame,s->start_ns,s->frame_ns,s->cpu_ns);
+    }
+    fclose(f);
+    free(samples);
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //FRAME_STATS_IMPLEMENTATION_GUARD
+#endif //FRAME_STATS_IMPLEMENTATION
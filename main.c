@@ -41,11 +41,70 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#ifdef _WIN32
+#   include <io.h>          // _dup(...), _dup2(...) (see Benchmark_Prepare(...))
+#   define dup _dup
+#   define dup2 _dup2
+#   define fileno _fileno
+#   define fdopen _fdopen
+#else //_WIN32
+#   include <unistd.h>      // dup(...), dup2(...)
+#endif //_WIN32
 
 #define MATH_3D_IMPLEMENTATION
 #include "math_3d.h"
 #undef MATH_3D_IMPLEMENTATION
 
+#define CAMERA_PATH_IMPLEMENTATION
+#include "camera_path.h"
+#undef CAMERA_PATH_IMPLEMENTATION
+
+#define FRAME_STATS_IMPLEMENTATION
+#include "frame_stats.h"
+#undef FRAME_STATS_IMPLEMENTATION
+
+#define DYNAMIC_RESOLUTION_IMPLEMENTATION
+#include "dynamic_resolution.h"
+#undef DYNAMIC_RESOLUTION_IMPLEMENTATION
+
+#define SHADER_PERMUTATIONS_IMPLEMENTATION
+#include "shader_permutations.h"
+#undef SHADER_PERMUTATIONS_IMPLEMENTATION
+
+#define SHADER_SOURCE_IMPLEMENTATION
+#include "shader_source.h"
+#undef SHADER_SOURCE_IMPLEMENTATION
+
+#define SDF_SCENE_IMPLEMENTATION
+#include "sdf_scene.h"
+#undef SDF_SCENE_IMPLEMENTATION
+#define SDF_BVH_IMPLEMENTATION
+#include "sdf_bvh.h"
+#undef SDF_BVH_IMPLEMENTATION
+#define SDF_GRID_IMPLEMENTATION
+#include "sdf_grid.h"
+#undef SDF_GRID_IMPLEMENTATION
+
+#define CPU_SCHEDULER_IMPLEMENTATION
+#include "cpu_scheduler.h"
+#undef CPU_SCHEDULER_IMPLEMENTATION
+#define CPU_RENDERER_NO_SIMD    // (only its map() is used, to bake the distance field: see BakedSdf)
+#define CPU_RENDERER_IMPLEMENTATION
+#include "cpu_renderer.h"
+#undef CPU_RENDERER_IMPLEMENTATION
+#define SDF_BAKE_IMPLEMENTATION
+#include "sdf_bake.h"
+#undef SDF_BAKE_IMPLEMENTATION
+#define SDF_BRICK_MAP_IMPLEMENTATION
+#include "sdf_brick_map.h"
+#undef SDF_BRICK_MAP_IMPLEMENTATION
+
+#ifndef __EMSCRIPTEN__
+#define FILE_WATCHER_IMPLEMENTATION
+#include "file_watcher.h"
+#undef FILE_WATCHER_IMPLEMENTATION
+#endif //__EMSCRIPTEN__
+
 #ifdef WRITE_DEPTH_VALUE
 #define TEAPOT_IMPLEMENTATION
 #define TEAPOT_CENTER_MESHES_ON_FLOOR   // (Optional) Otherwise meshes are centered in their local aabb center
@@ -55,6 +114,91 @@
 #undef TEAPOT_IMPLEMENTATION
 #endif //WRITE_DEPTH_VALUE
 
+// Quality tiers: each one is a permutation of "signed_distance_shapes.glsl" (see QualityTier_GetPermutation(...)).
+// They can be switched at runtime (F4): every program is compiled once and then cached (see ShaderProgramCache).
+typedef struct {
+    const char* name;
+    int raycast_iterations;
+    const char* raycast_precision;
+    int shadow_iterations;              // 0 = no shadows
+    const char* shadow_hardness;
+    int ambient_occlusion_precision;    // 0 = no AO
+    int enable_spe,enable_dom,enable_bac,enable_fre;   // ENABLE_*_LIGHTING_COMPONENT
+    int reduce_num_objects;
+    int aa;
+} QualityTier;
+const QualityTier QualityTiers[] = {
+    {"low",     16,"(0.002)",    0,"(5.0)",  0,  0,0,1,0,   1,  1},
+    {"medium",  28,"(0.001)",    6,"(5.0)",  0,  0,0,1,1,   1,  1},     // the USE_CUSTOM_SETTINGS defaults of the shader
+    {"high",    64,"(0.0005)",  16,"(8.0)",  5,  1,1,1,1,   0,  1},     // the original settings by Inigo Quilez
+    {"ultra",   64,"(0.0005)",  16,"(8.0)",  5,  1,1,1,1,   0,  2}
+};
+#define NUM_QUALITY_TIERS ((int)(sizeof(QualityTiers)/sizeof(QualityTiers[0])))
+// Where map() comes from (F5, --scene <name>)
+enum SceneMode {
+    SCENE_MODE_BUILT_IN = 0,    // the hard-coded map() of the shader
+    SCENE_MODE_TEXTURE,         // USE_SCENE_TEXTURE: map() interprets the primitives of scene_texture (see SceneTexture)
+    SCENE_MODE_BVH,             // USE_SCENE_TEXTURE and USE_SCENE_BVH: the same, walking the bounding volume hierarchy of the scene (SdfBvh)
+    SCENE_MODE_GRID,            // USE_SCENE_TEXTURE and USE_SCENE_GRID: the same, stepping through a uniform grid over the scene (SdfGrid)
+    SCENE_MODE_COMPILED,        // USE_COMPILED_SCENE: the map() generated by the scene compiler ("sdf_scene_compiled.glsl")
+    SCENE_MODE_COUNT
+};
+const char* SceneModeNames[SCENE_MODE_COUNT] = {"built-in","texture","bvh","grid","compiled"};
+int scene_mode = SCENE_MODE_BUILT_IN;
+int animate_scene = 1;          // SceneTexture_Animate(...) (only the default scene: not with --scene-file or --scene-random)
+#define SceneMode_UsesTexture(mode) ((mode)==SCENE_MODE_TEXTURE || (mode)==SCENE_MODE_BVH || (mode)==SCENE_MODE_GRID)
+int baked_sdf_enabled = 0;      // USE_BAKED_SDF (--baked-sdf, F6): castRay() steps through a distance field baked by the CPU (see BakedSdf)
+int baked_sdf_resolution = 128; // samples of the baked distance field along the longest axis of its bounds (--baked-sdf <resolution>)
+int baked_sdf_brick_map_kb = 0; // >0 = the baked distance field is a sparse brick map streamed around the camera, with an atlas of this size (--brick-map <KB>)
+float raycast_over_relaxation = 1.f;  // >1 = RAYCAST_OVER_RELAXED with this RAYCAST_OVER_RELAXATION (--over-relaxation <omega>)
+int cone_prepass_tile = 0;      // >0 = USE_CONE_PREPASS: castRay() starts from the distance reached by a cone per tile of this many pixels (--cone-prepass <tile>, see ConePrepass)
+float temporal_depth_fraction = 0.f;  // >0 = USE_TEMPORAL_DEPTH: castRay() starts from this fraction of the distance reprojected from the previous frame (--temporal-depth <fraction>, see TemporalDepth)
+int deferred_enabled = 0;       // DEFERRED_GBUFFER and DEFERRED_SHADING: a visibility pass writes a G-buffer, and a shading pass lights it (--deferred, see Deferred)
+int deferred_occlusion_divisor = 1; // >1 = USE_LOW_RES_OCCLUSION: a DEFERRED_OCCLUSION pass computes AO and soft shadows at 1/divisor of the resolution (--deferred-occlusion <divisor>)
+#define BakedSdf_IsUsed() (baked_sdf_enabled && (baked_sdf_brick_map_kb>0 || !(SceneMode_UsesTexture(scene_mode) && animate_scene)))   // (static scenes only, unless the brick map bakes the edits again)
+#define TemporalDepth_IsUsed() (temporal_depth_fraction>0.f && !deferred_enabled && !(SceneMode_UsesTexture(scene_mode) && animate_scene))   // (static scenes only: the previous frame must still be empty)
+void QualityTier_GetPermutation(int tier,ShaderPermutation* p) {
+    const QualityTier* q = &QualityTiers[tier];
+    ShaderPermutation_Init(p);
+    ShaderPermutation_SetInt(p,"RAYCAST_ITERATIONS",q->raycast_iterations);
+    ShaderPermutation_Set(p,"RAYCAST_PRECISION",q->raycast_precision);
+    if (raycast_over_relaxation>1.f) {
+        char omega[16];
+        sprintf(omega,"(%1.3f)",raycast_over_relaxation);
+        ShaderPermutation_Set(p,"RAYCAST_OVER_RELAXED",NULL);
+        ShaderPermutation_Set(p,"RAYCAST_OVER_RELAXATION",omega);
+    }
+    ShaderPermutation_SetInt(p,"SHADOW_ITERATIONS",q->shadow_iterations);
+    ShaderPermutation_Set(p,"SHADOW_HARDNESS",q->shadow_hardness);
+    ShaderPermutation_SetInt(p,"AMBIENT_OCCLUSION_PRECISION",q->ambient_occlusion_precision);
+    ShaderPermutation_SetInt(p,"ENABLE_SPE_LIGHTING_COMPONENT",q->enable_spe);
+    ShaderPermutation_SetInt(p,"ENABLE_DOM_LIGHTING_COMPONENT",q->enable_dom);
+    ShaderPermutation_SetInt(p,"ENABLE_BAC_LIGHTING_COMPONENT",q->enable_bac);
+    ShaderPermutation_SetInt(p,"ENABLE_FRE_LIGHTING_COMPONENT",q->enable_fre);
+    ShaderPermutation_SetInt(p,"REDUCE_NUM_OBJECTS",q->reduce_num_objects);
+    ShaderPermutation_SetInt(p,"AA",q->aa);
+    if (SceneMode_UsesTexture(scene_mode)) ShaderPermutation_Set(p,"USE_SCENE_TEXTURE",NULL);
+    if (scene_mode==SCENE_MODE_BVH) ShaderPermutation_Set(p,"USE_SCENE_BVH",NULL);
+    else if (scene_mode==SCENE_MODE_GRID) ShaderPermutation_Set(p,"USE_SCENE_GRID",NULL);
+    else if (scene_mode==SCENE_MODE_COMPILED) ShaderPermutation_Set(p,"USE_COMPILED_SCENE",NULL);
+    if (BakedSdf_IsUsed()) {
+        ShaderPermutation_Set(p,"USE_BAKED_SDF",NULL);
+        if (baked_sdf_brick_map_kb>0) ShaderPermutation_Set(p,"USE_SDF_BRICK_MAP",NULL);
+    }
+    if (cone_prepass_tile>0) ShaderPermutation_Set(p,"USE_CONE_PREPASS",NULL);
+    if (TemporalDepth_IsUsed()) ShaderPermutation_Set(p,"USE_TEMPORAL_DEPTH",NULL);
+#   ifdef WRITE_DEPTH_VALUE
+    ShaderPermutation_Set(p,"WRITE_DEPTH_VALUE",NULL);
+#   endif
+}
+int QualityTier_FindByName(const char* name) {
+    int i;
+    for (i=0;i<NUM_QUALITY_TIERS;i++) {
+        if (strcmp(QualityTiers[i].name,name)==0) return i;
+    }
+    return -1;
+}
+
 const char* ConfigFileName = "3D_Signed_Distance_Shapes_demo.ini";
 typedef struct {
     int fullscreen_width,fullscreen_height;
@@ -63,6 +207,8 @@ typedef struct {
     int dynamic_resolution_enabled;
     int dynamic_resolution_target_fps;
     int show_fps;
+    float dynamic_resolution_budget_ms;    // GPU time budget of the raycast pass (0 = 1000/dynamic_resolution_target_fps)
+    int quality_tier;                      // index in QualityTiers
 } Config;
 void Config_Init(Config* c) {
     c->fullscreen_width=c->fullscreen_height=0;
@@ -70,6 +216,8 @@ void Config_Init(Config* c) {
     c->fullscreen_enabled=0;
     c->dynamic_resolution_enabled=1;
     c->dynamic_resolution_target_fps=35;
+    c->dynamic_resolution_budget_ms=0.f;
+    c->quality_tier=1;
 #   ifdef NO_FIXED_FUNCTION_PIPELINE
     c->show_fps = 0;
 #   else //NO_FIXED_FUNCTION_PIPELINE
@@ -114,6 +262,12 @@ int Config_Load(Config* c,const char* filePath)  {
                case 5:
                sscanf(buf, "%d", &c->show_fps);
                break;
+               case 6:
+               sscanf(buf, "%f", &c->dynamic_resolution_budget_ms);
+               break;
+               case 7:
+               sscanf(buf, "%d", &c->quality_tier);
+               break;
            }
            nread=0;
            ++numParsedItem;
@@ -123,6 +277,8 @@ int Config_Load(Config* c,const char* filePath)  {
     if (c->windowed_width<=0) c->windowed_width=720;
     if (c->windowed_height<=0) c->windowed_height=405;
     if (c->dynamic_resolution_target_fps<=0) c->dynamic_resolution_target_fps=35;
+    if (c->dynamic_resolution_budget_ms<0.f) c->dynamic_resolution_budget_ms=0.f;
+    if (c->quality_tier<0 || c->quality_tier>=NUM_QUALITY_TIERS) c->quality_tier=1;
 
     return 0;
 }
@@ -135,12 +291,199 @@ int Config_Save(Config* c,const char* filePath)  {
     fprintf(f, "[Dynamic Resolution Enabled (0 or 1) (F1)]\n%d\n", c->dynamic_resolution_enabled);
     fprintf(f, "[Dynamic Resolution Target FPS]\n%d\n", c->dynamic_resolution_target_fps);
     fprintf(f, "[Show FPS (0 or 1) (F2)]\n%d\n", c->show_fps);
+    fprintf(f, "[Dynamic Resolution GPU Time Budget Of The Raycast Pass In ms (0 = 1000/Target FPS)]\n%g\n", c->dynamic_resolution_budget_ms);
+    fprintf(f, "[Quality Tier (0 = low, 1 = medium, 2 = high, 3 = ultra) (F4)]\n%d\n", c->quality_tier);
     fprintf(f,"\n");
     fclose(f);
     return 0;
 }
 #endif //__EMSCRIPTEN__
 Config config;
+float Config_GetDynamicResolutionBudgetMs(const Config* c) {
+    return c->dynamic_resolution_budget_ms>0.f ? c->dynamic_resolution_budget_ms : 1000.f/(float)c->dynamic_resolution_target_fps;
+}
+
+// Telemetry: the timings of every frame (see FrameTelemetry in "frame_stats.h") are recorded in a ring buffer;
+// F3 saves them as CSV, and they are saved on exit too when --telemetry <file.csv> is used.
+// The GPU time of a frame comes from GL_TIMESTAMP queries (when available), read a few frames later to avoid stalls
+// (GL_TIME_ELAPSED queries can't be nested, and the raycast pass has its own one: see DynamicResolution).
+#ifndef TELEMETRY_NUM_GPU_QUERIES
+#define TELEMETRY_NUM_GPU_QUERIES (4)   // max number of frames in flight
+#endif
+typedef struct {
+    FrameTelemetry ring;
+    const char* csv_file;           // NULL = not saved on exit
+    unsigned long long frame;
+    unsigned long long frame_start_ns,prev_frame_start_ns;
+    // GPU timer queries
+    int gpu_timer_available;
+    GLuint queries[TELEMETRY_NUM_GPU_QUERIES][2];               // timestamps at the start and at the end of the frame
+    FrameTelemetrySample pending[TELEMETRY_NUM_GPU_QUERIES];   // samples waiting for their GPU time
+    int pending_begin,num_pending;
+} Telemetry;
+Telemetry telemetry;
+const char* TelemetryDefaultCsvFile = "3D_Signed_Distance_Shapes_telemetry.csv";
+
+// Dynamic resolution: the raycast pass is rendered into an offscreen target at (scale_x,scale_y) of the window size,
+// and then stretched to the window. The scales come from a DynResController ("dynamic_resolution.h") fed with
+// the GPU time of the raycast pass (GL_TIME_ELAPSED queries), or with the frame time when timer queries are not available.
+// With --dynres-trace <file.csv> the measurements are saved on exit: they can be replayed with "make dynres_replay".
+typedef struct {
+    DynResController controller;
+    DynResTrace trace;
+    const char* trace_file;         // NULL = no trace
+    unsigned frame;
+    // GL_TIME_ELAPSED queries around the raycast pass
+    int gpu_timer_available;
+    GLuint queries[TELEMETRY_NUM_GPU_QUERIES];
+    DynResTraceSample pending[TELEMETRY_NUM_GPU_QUERIES];   // pass scales waiting for their GPU time
+    int pending_begin,num_pending;
+    // fallback (no timer queries)
+    unsigned long long last_pass_ns;
+    float last_scale_x,last_scale_y;
+} DynamicResolution;
+DynamicResolution dynamic_resolution;
+
+// Startup timings (printed after the first frame, and written to the benchmark JSON)
+typedef struct {
+    unsigned long long main_ns;         // when main() started
+    unsigned long long first_frame_ns;  // when the first frame was presented (0 = not yet)
+    unsigned long long full_quality_ns; // when the first frame with the requested quality tier was presented (0 = not yet)
+    double shader_ms;                   // time spent to get the program of the requested quality tier (<0 = not yet)
+    const char* program_cache;          // "off", "cold" (the program has been compiled) or "warm" (loaded from the on-disk cache)
+    int placeholder;                    // 1 if the first frames have been drawn with the placeholder tier
+    unsigned long long init_gl_ns;      // last call to InitGL() (the GL context is recreated when fullscreen is toggled)
+    int waiting_first_frame;            // 1 until the first frame after InitGL() is presented
+} Startup;
+Startup startup = {0,0,0,-1.0,"off",0,0,0};
+
+// Benchmark mode (--benchmark): a fixed camera/light script is played with a fixed time step
+// (so every run draws exactly the same frames), dynamic resolution is disabled, and the frame times
+// of the measured frames are written as JSON at the end. See Benchmark_ParseCommandLine(...).
+typedef struct {
+    int enabled;
+    int num_warmup_frames,num_frames;
+    int width,height;               // window size
+    float time_step;                // seconds of camera path per frame
+    const char* path_file;          // NULL = built-in fly-through
+    const char* output_file;        // NULL = stdout
+    FILE* output;                   // the JSON (stdout is then only for it: the rest of the text goes to stderr)
+    CameraPath path;
+    int frame;                      // warmup frames included
+    double* frame_times_ms;         // [num_frames]
+    unsigned long long last_frame_end_ns,start_ns;
+} Benchmark;
+Benchmark benchmark;
+void Benchmark_Init(Benchmark* b) {
+    memset(b,0,sizeof(Benchmark));
+    b->num_warmup_frames = 60;
+    b->num_frames = 600;
+    b->width = 960;b->height = 540;
+    b->time_step = 1.f/60.f;
+    CameraPath_Init(&b->path);
+}
+void Benchmark_Destroy(Benchmark* b) {
+    if (b->output) {fclose(b->output);b->output = NULL;}
+    CameraPath_Destroy(&b->path);
+    if (b->frame_times_ms) free(b->frame_times_ms);
+    b->frame_times_ms = NULL;
+}
+void Benchmark_PrintUsage(void) {
+    printf("Benchmark mode:\n");
+    printf("  --benchmark             plays a fixed camera/light script and writes the frame times as JSON\n");
+    printf("  --warmup <frames>       warmup frames (default: 60)\n");
+    printf("  --frames <frames>       measured frames (default: 600)\n");
+    printf("  --size <width>x<height> window size (default: 960x540)\n");
+    printf("  --path <file>           camera path file (see camera_path.h). Default: built-in fly-through\n");
+    printf("  --time-step <seconds>   camera path time per frame (default: 1/60)\n");
+    printf("  --output <file.json>    (default: stdout, and the rest of the text goes to stderr)\n");
+}
+// returns 0 if "arg" is not a benchmark option
+int Benchmark_ParseArg(Benchmark* b,const char* arg,const char* val) {
+    if      (strcmp(arg,"--warmup")==0)     b->num_warmup_frames = atoi(val);
+    else if (strcmp(arg,"--frames")==0)     b->num_frames = atoi(val);
+    else if (strcmp(arg,"--size")==0)       {if (sscanf(val,"%dx%d",&b->width,&b->height)!=2) b->width=b->height=0;}
+    else if (strcmp(arg,"--path")==0)       b->path_file = val;
+    else if (strcmp(arg,"--time-step")==0)  b->time_step = (float) atof(val);
+    else if (strcmp(arg,"--output")==0)     b->output_file = val;
+    else return 0;
+    return 1;
+}
+// Called after the command-line has been parsed. Returns 0 on failure
+int Benchmark_Prepare(Benchmark* b) {
+    if (!b->enabled) return 1;
+    if (b->num_warmup_frames<0 || b->num_frames<=0 || b->width<=0 || b->height<=0 || b->time_step<0.f) {
+        fprintf(stderr,"Invalid benchmark argument values\n");
+        return 0;
+    }
+    if (b->path_file) {
+        if (CameraPath_Load(&b->path,b->path_file)!=0) {fprintf(stderr,"Can't load camera path: %s\n",b->path_file);return 0;}
+    }
+    else CameraPath_SetDefault(&b->path);
+    b->frame_times_ms = (double*) malloc(b->num_frames*sizeof(double));
+    if (!b->frame_times_ms) {fprintf(stderr,"Out of memory\n");return 0;}
+    if (b->output_file) {
+        b->output = fopen(b->output_file,"wt");
+        if (!b->output) {fprintf(stderr,"Can't write: %s\n",b->output_file);return 0;}
+    }
+    else {
+        // "demo --benchmark > out.json": the JSON keeps the original stdout, and everything else printed to stdout
+        // (GL info, startup times, logs of the headers...) goes to stderr from now on
+        const int fd = dup(fileno(stdout));
+        fflush(stdout);
+        if (fd<0 || !(b->output = fdopen(fd,"w")) || dup2(fileno(stderr),fileno(stdout))<0) {
+            fprintf(stderr,"Can't redirect stdout to stderr: use --output <file.json>\n");
+            if (b->output) {fclose(b->output);b->output = NULL;}
+            return 0;
+        }
+    }
+    return 1;
+}
+static void Benchmark_FprintJsonString(FILE* f,const char* str) {
+    fputc('"',f);
+    for (;str && *str;++str) {
+        if (*str=='"' || *str=='\\') fputc('\\',f);
+        if ((unsigned char)*str>=32) fputc(*str,f);
+    }
+    fputc('"',f);
+}
+void Benchmark_WriteResults(const Benchmark* b,int width,int height) {
+    FILE* f = b->output;    // (opened by Benchmark_Prepare(...))
+    FrameStatsSummary s,cpuMs,gpuMs;
+    FrameStats_Summarize(b->frame_times_ms,b->num_frames,&s);
+    FrameTelemetry_GetRollingStats(&telemetry.ring,b->num_frames,NULL,&cpuMs,&gpuMs);
+    fprintf(f,"{\n");
+    fprintf(f,"  \"gl_vendor\": ");Benchmark_FprintJsonString(f,(const char*)glGetString(GL_VENDOR));fprintf(f,",\n");
+    fprintf(f,"  \"gl_renderer\": ");Benchmark_FprintJsonString(f,(const char*)glGetString(GL_RENDERER));fprintf(f,",\n");
+    fprintf(f,"  \"gl_version\": ");Benchmark_FprintJsonString(f,(const char*)glGetString(GL_VERSION));fprintf(f,",\n");
+    fprintf(f,"  \"width\": %d,\n  \"height\": %d,\n",width,height);
+    fprintf(f,"  \"camera_path\": ");Benchmark_FprintJsonString(f,b->path_file ? b->path_file : "built-in");fprintf(f,",\n");
+    fprintf(f,"  \"time_step\": %.6f,\n",b->time_step);
+    fprintf(f,"  \"quality\": \"%s\",\n",QualityTiers[config.quality_tier].name);
+    fprintf(f,"  \"scene\": \"%s\",\n",SceneModeNames[scene_mode]);   // (--scene)
+    fprintf(f,"  \"baked_sdf\": %d,\n",BakedSdf_IsUsed() && baked_sdf_brick_map_kb<=0 ? baked_sdf_resolution : 0);  // (--baked-sdf)
+    fprintf(f,"  \"brick_map_kb\": %d,\n",BakedSdf_IsUsed() ? baked_sdf_brick_map_kb : 0);     // (--brick-map)
+    fprintf(f,"  \"over_relaxation\": %.3f,\n",raycast_over_relaxation>1.f ? raycast_over_relaxation : 1.f);    // (--over-relaxation)
+    fprintf(f,"  \"cone_prepass\": %d,\n",cone_prepass_tile);  // (--cone-prepass)
+    fprintf(f,"  \"temporal_depth\": %.3f,\n",TemporalDepth_IsUsed() ? temporal_depth_fraction : 0.f);  // (--temporal-depth)
+    fprintf(f,"  \"deferred\": %d,\n",deferred_enabled);  // (--deferred)
+    fprintf(f,"  \"deferred_occlusion\": %d,\n",deferred_enabled ? deferred_occlusion_divisor : 1);  // (--deferred-occlusion)
+    fprintf(f,"  \"warmup_frames\": %d,\n  \"frames\": %d,\n",b->num_warmup_frames,b->num_frames);
+    fprintf(f,"  \"total_time_s\": %.4f,\n",(double)(b->last_frame_end_ns-b->start_ns)*1.0e-9);
+    fprintf(f,"  \"fps\": %.3f,\n",s.mean>0.0 ? 1000.0/s.mean : 0.0);
+    fprintf(f,"  \"frame_time_ms\": ");FrameStatsSummary_FprintJson(f,&s);fprintf(f,",\n");
+    fprintf(f,"  \"cpu_time_ms\": ");FrameStatsSummary_FprintJson(f,&cpuMs);fprintf(f,",\n");
+    fprintf(f,"  \"gpu_time_ms\": ");   // GL_TIME_ELAPSED queries
+    if (gpuMs.num_samples>0) FrameStatsSummary_FprintJson(f,&gpuMs);
+    else fprintf(f,"null");
+    fprintf(f,",\n");
+    // cold = the program has been compiled, warm = loaded from the on-disk program cache (run twice to get both)
+    fprintf(f,"  \"startup\": {\"program_cache\": \"%s\", \"shader_ms\": %.3f, \"first_frame_ms\": %.3f, \"full_quality_ms\": %.3f, \"placeholder\": %s}\n",
+            startup.program_cache,startup.shader_ms,(double)(startup.first_frame_ns-startup.main_ns)*1.0e-6,
+            (double)(startup.full_quality_ns-startup.main_ns)*1.0e-6,startup.placeholder ? "true" : "false");
+    fprintf(f,"}\n");
+    fflush(f);
+}
 
 
 int windowId = 0; 			// window Id when not in fullscreen mode
@@ -174,23 +517,22 @@ const char ScreenQuadFS[] =
         "#else\n"\
         "uniform sampler2D s_diffuse;\n"\
         "#endif\n"\
-        "uniform vec3 screenResAndFactor; // .x and .y in pixels; .z in [0,1]: default: 1\n"\
+        "uniform vec4 screenResAndFactor; // .x and .y in pixels; .z and .w (X and Y factors) in [0,1]: default: 1\n"\
         "\n"\
         "void main() {\n"\
-        "	 vec2 texCoords = (gl_FragCoord.xy/screenResAndFactor.xy)*screenResAndFactor.z;\n"\
+        "	 vec2 texCoords = (gl_FragCoord.xy/screenResAndFactor.xy)*screenResAndFactor.zw;\n"\
         "    gl_FragColor = texture2D( s_diffuse, texCoords);\n"\
         "}\n";
 
 
 
-GLuint getTextFromFile(char* buffer,int buffer_size,const char* filename);
 GLuint loadShaderProgramFromSource(const char* vs,const char* fs);
 
 typedef struct {
     GLuint frame_buffer[NUM_RENDER_TARGETS];
     GLuint depth_buffer[NUM_RENDER_TARGETS];
     GLuint texture[NUM_RENDER_TARGETS];
-    float resolution_factor[NUM_RENDER_TARGETS];
+    float resolution_factor[NUM_RENDER_TARGETS][2];    // X and Y
 
     GLuint screenQuadProgramId;
     GLint aLoc_APosition;
@@ -241,7 +583,7 @@ void RenderTarget_Init(RenderTarget* rt,int width, int height) {
 
 
     for (i=0;i<NUM_RENDER_TARGETS;i++)	{
-        rt->resolution_factor[i] = 1;
+        rt->resolution_factor[i][0] = rt->resolution_factor[i][1] = 1;
 
         glBindTexture(GL_TEXTURE_2D, rt->texture[i]);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -286,7 +628,7 @@ void RenderTarget_Init(RenderTarget* rt,int width, int height) {
 RenderTarget render_target;
 
 typedef struct {
-    GLuint programId;
+    GLuint programId;       // owned by shader_cache
     GLint aLoc_APosition;
     GLint uLoc_iResolution;
     GLint uLoc_iGlobalTime;
@@ -295,27 +637,42 @@ typedef struct {
     GLint uLoc_iProjectionData;
     GLint uLoc_iProjectionData2;
     GLint uLoc_iLightDirection;
+    GLint uLoc_iSceneTexture;   // (USE_SCENE_TEXTURE only)
+    GLint uLoc_iSceneInfo;
+    GLint uLoc_iBvhInfo;        // (USE_SCENE_BVH only)
+    GLint uLoc_iGridInfo;       // (USE_SCENE_GRID only)
+    GLint uLoc_iGridOrigin;
+    GLint uLoc_iGridSize;
+    GLint uLoc_iBakedSdf;       // (USE_BAKED_SDF only)
+    GLint uLoc_iBakedSdfOrigin;
+    GLint uLoc_iBakedSdfSize;
+    GLint uLoc_iBakedSdfAtlas;
+    GLint uLoc_iBrickMapIndirection;    // (USE_SDF_BRICK_MAP only)
+    GLint uLoc_iBrickMapAtlas;
+    GLint uLoc_iBrickMapOrigin;
+    GLint uLoc_iBrickMapSize;
+    GLint uLoc_iBrickMapTextures;
+    GLint uLoc_iBrickMapAtlasTexel;
+    GLint uLoc_iConePrepass;            // (USE_CONE_PREPASS only)
+    GLint uLoc_iConePrepassInfo;        // (USE_CONE_PREPASS and CONE_PREPASS)
+    GLint uLoc_iTemporalDepth;          // (USE_TEMPORAL_DEPTH and TEMPORAL_DEPTH_REDUCE)
+    GLint uLoc_iTemporalDepthInfo;
+    GLint uLoc_iTemporalDepthTexel;
+    GLint uLoc_iTemporalDepthTiles;     // (USE_TEMPORAL_DEPTH only)
+    GLint uLoc_iTemporalDepthCamera;
+    GLint uLoc_iGBuffer0;               // (DEFERRED_OCCLUSION and DEFERRED_SHADING)
+    GLint uLoc_iGBuffer1;
+    GLint uLoc_iGBufferTexel;           // (DEFERRED_GBUFFER, DEFERRED_OCCLUSION and DEFERRED_SHADING)
+    GLint uLoc_iOcclusion;              // (USE_LOW_RES_OCCLUSION only)
+    GLint uLoc_iOcclusionInfo;          // (USE_LOW_RES_OCCLUSION and DEFERRED_OCCLUSION)
+
+    float projection[4];    // last values passed to MyShaderStuff_SetProjectionUniforms(...) (they're set again when the program changes)
+    int has_projection;
 } MyShaderStuff;
-void MyShaderStuff_Create(MyShaderStuff* p) {
-    const char* fsFileName = "signed_distance_shapes.glsl";
-    char fragmentShaderCode[400000]="";//fragmentShaderCode[0]='\0';
-    if (!getTextFromFile(fragmentShaderCode,400000,fsFileName))	{
-        fprintf(stderr,"Error: \"%s\" not found\n",fsFileName);
-        return;
-    }
-#   ifdef WRITE_DEPTH_VALUE
-    // Delicate part: overwrite "fragmentShaderCode" to define WRITE_DEPTH_VALUE on the fly there too
-    {
-       const char def[] = "#define WRITE_DEPTH_VALUE\n//";
-       char* firstNewLine = strchr(fragmentShaderCode,'\n'); // We'd like to leave the first line of the shader intact
-       if (firstNewLine) {
-           ++firstNewLine;
-           memcpy(firstNewLine,def,strlen(def));    // a bit unsafe
-       }
-    }
-#   endif
-    p->programId = loadShaderProgramFromSource(ScreenQuadVS,fragmentShaderCode);
-    //progParams.programId = loadShaderProgram("default.vs",fsFileName);
+void MyShaderStuff_SetProjectionUniforms(MyShaderStuff* p,float nearPlane,float farPlane,float degFov,float aspectRatio);
+// Sets a program of shader_cache (a permutation of "signed_distance_shapes.glsl")
+void MyShaderStuff_SetProgram(MyShaderStuff* p,GLuint programId) {
+    p->programId = programId;
     if (!p->programId) return;
 
     p->aLoc_APosition = glGetAttribLocation(p->programId, "a_position");
@@ -325,12 +682,44 @@ void MyShaderStuff_Create(MyShaderStuff* p) {
     p->uLoc_iProjectionData = glGetUniformLocation(p->programId,"iProjectionData");
     p->uLoc_iProjectionData2 = glGetUniformLocation(p->programId,"iProjectionData2");
     p->uLoc_iLightDirection = glGetUniformLocation(p->programId,"iLightDirection");
-
+    p->uLoc_iSceneTexture = glGetUniformLocation(p->programId,"iSceneTexture");
+    p->uLoc_iSceneInfo = glGetUniformLocation(p->programId,"iSceneInfo");
+    p->uLoc_iBvhInfo = glGetUniformLocation(p->programId,"iBvhInfo");
+    p->uLoc_iGridInfo = glGetUniformLocation(p->programId,"iGridInfo");
+    p->uLoc_iGridOrigin = glGetUniformLocation(p->programId,"iGridOrigin");
+    p->uLoc_iGridSize = glGetUniformLocation(p->programId,"iGridSize");
+    p->uLoc_iBakedSdf = glGetUniformLocation(p->programId,"iBakedSdf");
+    p->uLoc_iBakedSdfOrigin = glGetUniformLocation(p->programId,"iBakedSdfOrigin");
+    p->uLoc_iBakedSdfSize = glGetUniformLocation(p->programId,"iBakedSdfSize");
+    p->uLoc_iBakedSdfAtlas = glGetUniformLocation(p->programId,"iBakedSdfAtlas");
+    p->uLoc_iBrickMapIndirection = glGetUniformLocation(p->programId,"iBrickMapIndirection");
+    p->uLoc_iBrickMapAtlas = glGetUniformLocation(p->programId,"iBrickMapAtlas");
+    p->uLoc_iBrickMapOrigin = glGetUniformLocation(p->programId,"iBrickMapOrigin");
+    p->uLoc_iBrickMapSize = glGetUniformLocation(p->programId,"iBrickMapSize");
+    p->uLoc_iBrickMapTextures = glGetUniformLocation(p->programId,"iBrickMapTextures");
+    p->uLoc_iBrickMapAtlasTexel = glGetUniformLocation(p->programId,"iBrickMapAtlasTexel");
+    p->uLoc_iConePrepass = glGetUniformLocation(p->programId,"iConePrepass");
+    p->uLoc_iConePrepassInfo = glGetUniformLocation(p->programId,"iConePrepassInfo");
+    p->uLoc_iTemporalDepth = glGetUniformLocation(p->programId,"iTemporalDepth");
+    p->uLoc_iTemporalDepthInfo = glGetUniformLocation(p->programId,"iTemporalDepthInfo");
+    p->uLoc_iTemporalDepthTexel = glGetUniformLocation(p->programId,"iTemporalDepthTexel");
+    p->uLoc_iTemporalDepthTiles = glGetUniformLocation(p->programId,"iTemporalDepthTiles");
+    p->uLoc_iTemporalDepthCamera = glGetUniformLocation(p->programId,"iTemporalDepthCamera");
+    p->uLoc_iGBuffer0 = glGetUniformLocation(p->programId,"iGBuffer0");
+    p->uLoc_iGBuffer1 = glGetUniformLocation(p->programId,"iGBuffer1");
+    p->uLoc_iGBufferTexel = glGetUniformLocation(p->programId,"iGBufferTexel");
+    p->uLoc_iOcclusion = glGetUniformLocation(p->programId,"iOcclusion");
+    p->uLoc_iOcclusionInfo = glGetUniformLocation(p->programId,"iOcclusionInfo");
+
+    if (p->has_projection) MyShaderStuff_SetProjectionUniforms(p,p->projection[0],p->projection[1],p->projection[2],p->projection[3]);
 }
-void MyShaderStuff_Destroy(MyShaderStuff* p) {if (p->programId) glDeleteProgram(p->programId);p->programId=0;}
+void MyShaderStuff_Destroy(MyShaderStuff* p) {p->programId=0;}
 void MyShaderStuff_SetProjectionUniforms(MyShaderStuff* p,float nearPlane,float farPlane,float degFov,float aspectRatio) {
     float tanFov;
-    if (p==NULL || p->programId==0) return;
+    if (p==NULL) return;
+    p->projection[0]=nearPlane;p->projection[1]=farPlane;p->projection[2]=degFov;p->projection[3]=aspectRatio;
+    p->has_projection=1;
+    if (p->programId==0) return;
     glUseProgram(p->programId);
     tanFov = tan(degFov*M_PIOVER180*0.5f);
     glUniform4f(p->uLoc_iProjectionData,nearPlane,farPlane,tanFov,aspectRatio);
@@ -346,6 +735,609 @@ void MyShaderStuff_SetUniforms(MyShaderStuff* p,int resX,int resY,float globalTi
 }
 MyShaderStuff progParams;
 
+// Data-driven scene: the primitives of "scene" are uploaded to a float texture (4 RGBA texels per primitive, see SdfScene),
+// that the generic map() of "sdf_scene.glsl" reads when USE_SCENE_TEXTURE is defined.
+// Changing the scene is just a texture upload (scene.revision is checked every frame): no shader is compiled again.
+// With SCENE_MODE_BVH the texture holds the layout of SdfBvh instead (the primitives in leaf order, then the nodes),
+// and with SCENE_MODE_GRID the one of SdfGrid (the primitives, then the cells and their lists): rebuilt on every change.
+#define SCENE_TEXTURE_UNIT              (1)     // (unit 0 is used by the render targets)
+#define SCENE_ANIMATED_PRIMITIVE        (2)     // the sdBox of SdfScene_SetDefault(...), moved like the commented sinValue of the original map()
+#ifndef __EMSCRIPTEN__
+#define SCENE_TEXTURE_INTERNAL_FORMAT   GL_RGBA32F
+#else //__EMSCRIPTEN__
+#define SCENE_TEXTURE_INTERNAL_FORMAT   GL_RGBA     // (WebGL 1 has no sized float formats: OES_texture_float uses the type)
+#endif //__EMSCRIPTEN__
+typedef struct {
+    SdfScene scene;
+    SdfBvh bvh;                 // (SCENE_MODE_BVH only)
+    SdfGrid grid;               // (SCENE_MODE_GRID only)
+    GLuint texture;             // 0 = float textures are not supported (SceneMode_UsesTexture(...) modes are not available)
+    int width,height;           // of texture (texels)
+    unsigned uploaded_revision; // scene.revision of the texture content
+    int uploaded_mode;          // the SceneMode of the texture layout (SCENE_MODE_TEXTURE, SCENE_MODE_BVH or SCENE_MODE_GRID)
+    float* texels;              // staging buffer (width*height*4 floats)
+    int texels_capacity;
+} SceneTexture;
+SceneTexture scene_texture;
+
+void SceneTexture_Init(SceneTexture* t) {
+    memset(t,0,sizeof(SceneTexture));
+    SdfScene_Init(&t->scene);
+    SdfBvh_Init(&t->bvh);
+    SdfGrid_Init(&t->grid);
+    if (!SdfScene_SetDefault(&t->scene)) fprintf(stderr,"SceneTexture: out of memory\n");
+}
+void SceneTexture_Destroy(SceneTexture* t) {
+    SdfScene_Destroy(&t->scene);
+    SdfBvh_Destroy(&t->bvh);
+    SdfGrid_Destroy(&t->grid);
+    if (t->texels) {free(t->texels);t->texels=NULL;}
+    t->texels_capacity = 0;
+}
+// RGBA float textures (GL_ARB_texture_float: core in OpenGL 3.0, OES_texture_float in WebGL)
+int HasFloatTextures(void) {
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+#   ifndef __EMSCRIPTEN__
+    const char* version = (const char*) glGetString(GL_VERSION);
+    int major = 0,minor = 0;
+    if (version) sscanf(version,"%d.%d",&major,&minor);
+    return (major>=3 || (extensions && strstr(extensions,"GL_ARB_texture_float"))) ? 1 : 0;
+#   else //__EMSCRIPTEN__
+    return (extensions && strstr(extensions,"OES_texture_float")) ? 1 : 0;
+#   endif //__EMSCRIPTEN__
+}
+// Uploads the scene if it has changed since the last call (it's called every frame, and it leaves the texture bound)
+void SceneTexture_Update(SceneTexture* t) {
+    const int mode = (scene_mode==SCENE_MODE_BVH || scene_mode==SCENE_MODE_GRID) ? scene_mode : SCENE_MODE_TEXTURE;
+    int width,height,sameSize;
+    if (!t->texture) return;
+    glActiveTexture(GL_TEXTURE0+SCENE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,t->texture);
+    glActiveTexture(GL_TEXTURE0);
+    if (t->uploaded_revision==t->scene.revision && t->uploaded_mode==mode) return;
+    if (mode==SCENE_MODE_BVH) {
+        if (!SdfBvh_Build(&t->bvh,&t->scene)) {fprintf(stderr,"SceneTexture: out of memory\n");return;}
+        SdfBvh_GetTextureSize(&t->bvh,&width,&height);
+    }
+    else if (mode==SCENE_MODE_GRID) {
+        if (!SdfGrid_Build(&t->grid,&t->scene,0.f,0.f)) {fprintf(stderr,"SceneTexture: out of memory\n");return;}
+        SdfGrid_GetTextureSize(&t->grid,&width,&height);
+    }
+    else SdfScene_GetTextureSize(&t->scene,&width,&height);
+    if (t->texels_capacity<width*height*4) {
+        float* texels = (float*) realloc(t->texels,width*height*4*sizeof(float));
+        if (!texels) {fprintf(stderr,"SceneTexture: out of memory\n");return;}
+        t->texels = texels;t->texels_capacity = width*height*4;
+    }
+    if (mode==SCENE_MODE_BVH) SdfBvh_GetTexels(&t->bvh,t->texels);
+    else if (mode==SCENE_MODE_GRID) SdfGrid_GetTexels(&t->grid,t->texels);
+    else SdfScene_GetTexels(&t->scene,t->texels);
+    sameSize = (width==t->width && height==t->height);
+    t->width = width;t->height = height;
+    glActiveTexture(GL_TEXTURE0+SCENE_TEXTURE_UNIT);
+    if (sameSize) glTexSubImage2D(GL_TEXTURE_2D,0,0,0,width,height,GL_RGBA,GL_FLOAT,t->texels);
+    else glTexImage2D(GL_TEXTURE_2D,0,SCENE_TEXTURE_INTERNAL_FORMAT,width,height,0,GL_RGBA,GL_FLOAT,t->texels);
+    glActiveTexture(GL_TEXTURE0);
+    t->uploaded_revision = t->scene.revision;
+    t->uploaded_mode = mode;
+}
+// GL objects (they must be recreated together with the GL context)
+void SceneTexture_CreateGL(SceneTexture* t) {
+    t->texture = 0;t->width = t->height = 0;
+    if (!HasFloatTextures()) {
+        if (SceneMode_UsesTexture(scene_mode)) {
+            fprintf(stderr,"SceneTexture: float textures are not supported: the built-in map() is used\n");
+            scene_mode = SCENE_MODE_BUILT_IN;
+        }
+        return;
+    }
+    glGenTextures(1,&t->texture);
+    glActiveTexture(GL_TEXTURE0+SCENE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,t->texture);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);   // (texels are fetched one by one)
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glActiveTexture(GL_TEXTURE0);
+    t->uploaded_revision = t->scene.revision-1;     // (forces the first upload)
+    SceneTexture_Update(t);
+}
+void SceneTexture_DestroyGL(SceneTexture* t) {
+    if (t->texture) {glDeleteTextures(1,&t->texture);t->texture=0;}
+}
+// Sets the iSceneTexture, iSceneInfo, iBvhInfo and iGrid* uniforms of the current program (when it uses them)
+void SceneTexture_SetUniforms(const SceneTexture* t,const MyShaderStuff* p) {
+    float gridInfo[4],gridOrigin[4],gridSize[4];
+    if (p->uLoc_iSceneTexture>=0) glUniform1i(p->uLoc_iSceneTexture,SCENE_TEXTURE_UNIT);
+    if (p->uLoc_iSceneInfo>=0) glUniform4f(p->uLoc_iSceneInfo,(float)SdfScene_GetNumPrimitives(&t->scene,0),(float)SdfScene_GetNumPrimitives(&t->scene,1),(float)t->width,(float)t->height);
+    if (p->uLoc_iBvhInfo>=0) glUniform4f(p->uLoc_iBvhInfo,(float)SdfBvh_GetFirstNodeTexel(&t->bvh),(float)t->bvh.num_reduced_nodes,(float)t->bvh.num_nodes,0.f);
+    if (p->uLoc_iGridInfo>=0) {
+        SdfGrid_GetUniforms(&t->grid,gridInfo,gridOrigin,gridSize);
+        glUniform4fv(p->uLoc_iGridInfo,1,gridInfo);
+        glUniform4fv(p->uLoc_iGridOrigin,1,gridOrigin);
+        glUniform4fv(p->uLoc_iGridSize,1,gridSize);
+    }
+}
+// Moves SCENE_ANIMATED_PRIMITIVE (a change of the layout at runtime)
+void SceneTexture_Animate(SceneTexture* t,float globalTime) {
+    SdfPrimitive* p;
+    if (t->scene.num_primitives<=SCENE_ANIMATED_PRIMITIVE) return;
+    p = &t->scene.primitives[SCENE_ANIMATED_PRIMITIVE];
+    p->position[2] = 0.5f*sin(globalTime);
+    ++t->scene.revision;
+}
+
+// Baked distance field (USE_BAKED_SDF): the map() of the current scene is sampled by the CPU renderer on a grid over the
+// bounds of the objects ("sdf_bake.h"), and castRay() steps through it far from the surfaces (two texture fetches instead
+// of the whole map()). It's baked again when the scene changes, so it's only used with static scenes (see BakedSdf_IsUsed()).
+// The bounds are the ones of scene_texture.scene (the built-in scene, unless --scene-file or --scene-random is used): they
+// only limit where the field helps, since its distances always come from the map() of the current scene.
+// With --brick-map the field is a sparse brick map ("sdf_brick_map.h", USE_SDF_BRICK_MAP) instead: only the bricks near the
+// surfaces are baked, the ones around the camera, a few of them per frame, within a fixed atlas (the least recently used
+// ones are evicted). The changed bricks are uploaded with glTexSubImage2D(...). An edit of the data-driven scene (e.g. the
+// animated one) only bakes again the bricks it can reach, on the same threads, before the frame is drawn (see
+// SdfBrickMap_InvalidateSceneChanges(...)), so the brick map is used with the animated scene too.
+#define BAKED_SDF_TEXTURE_UNIT          (2)     // (the indirection texture of the brick map too)
+#define BAKED_SDF_MARGIN                (0.5f)  // the bounds of the objects are grown by this
+#define BRICK_MAP_TEXTURE_UNIT          (3)     // the atlas of the brick map
+#define BRICK_MAP_BRICK_SIZE            (0.35f) // world size of a brick (8 samples per axis)
+#define BRICK_MAP_RADIUS                (8.f)   // the surface bricks closer than this to the camera are made resident
+#define BRICK_MAP_MAX_BAKES_PER_FRAME   (256)   // (the others are baked by the next frames)
+#ifndef __EMSCRIPTEN__
+#define BAKED_SDF_INTERNAL_FORMAT       GL_R16F
+#define BAKED_SDF_FORMAT                GL_RED
+#else //__EMSCRIPTEN__
+#define BAKED_SDF_INTERNAL_FORMAT       GL_LUMINANCE    // (WebGL 1: OES_texture_float. Without OES_texture_float_linear the
+#define BAKED_SDF_FORMAT                GL_LUMINANCE    // filtering falls back to nearest, that has the same error bound)
+#endif //__EMSCRIPTEN__
+typedef struct {
+    SdfBake bake;
+    SdfBrickMap brick_map;      // (--brick-map) instead of bake
+    GLuint texture;             // 0 = float textures are not supported (USE_BAKED_SDF is not available)
+    GLuint brick_map_textures[2];   // indirection and atlas
+    int baked_mode;             // the SceneMode of the baked distances (-1 = none)
+    unsigned baked_revision;    // scene_texture.scene.revision of the baked distances (data-driven modes only)
+    CpuRenderer renderer;       // the map() of the baked scene (the brick map keeps baking with it)
+    SdfScene baked_scene;       // a copy of scene_texture.scene as baked (the brick map finds the edits by comparing them)
+    float* texels;              // staging buffer
+    int texels_capacity;
+    CpuScheduler* scheduler;    // the slices (or the bricks) are baked in parallel (created by the first bake)
+} BakedSdf;
+BakedSdf baked_sdf;
+
+void BakedSdf_Init(BakedSdf* b) {
+    memset(b,0,sizeof(BakedSdf));
+    SdfBake_Init(&b->bake);
+    SdfBrickMap_Init(&b->brick_map);
+    SdfScene_Init(&b->baked_scene);
+    b->baked_mode = -1;
+}
+void BakedSdf_Destroy(BakedSdf* b) {
+    SdfBake_Destroy(&b->bake);
+    SdfBrickMap_Destroy(&b->brick_map);
+    SdfScene_Destroy(&b->baked_scene);
+    if (b->texels) {free(b->texels);b->texels=NULL;}
+    if (b->scheduler) {CpuScheduler_Destroy(b->scheduler);b->scheduler=NULL;}
+    b->texels_capacity = 0;
+}
+static float BakedSdf_Map(const float* pos,void* userData) {
+    return CpuRenderer_Map((const CpuRenderer*)userData,vec3(pos[0],pos[1],pos[2]),NULL);
+}
+int SetQualityTier(int tier);
+// Turns USE_BAKED_SDF off (the current program is replaced)
+static void BakedSdf_Disable(const char* reason) {
+    fprintf(stderr,"Baked distance field: %s: disabled\n",reason);
+    baked_sdf_enabled = 0;
+    SetQualityTier(config.quality_tier);
+}
+static int BakedSdf_ReserveTexels(BakedSdf* b,int count) {
+    if (b->texels_capacity<count) {
+        float* texels = (float*) realloc(b->texels,count*sizeof(float));
+        if (!texels) return 0;
+        b->texels = texels;b->texels_capacity = count;
+    }
+    return 1;
+}
+// Makes the surface bricks around the camera resident, and uploads what has changed
+static void BakedSdf_StreamBrickMap(BakedSdf* b) {
+    SdfBrickMap* m = &b->brick_map;
+    const int* slots;const int* bricks;
+    float pos[3],texel[4];
+    int numSlots,numBricks,i,x,y,width,height;
+    pos[0] = cameraMatrix.m30;pos[1] = cameraMatrix.m31;pos[2] = cameraMatrix.m32;
+    SdfBrickMap_Update(m,pos,BRICK_MAP_RADIUS,BRICK_MAP_MAX_BAKES_PER_FRAME,&BakedSdf_Map,&b->renderer,b->scheduler);
+    SdfBrickMap_GetChanges(m,&slots,&numSlots,&bricks,&numBricks);
+    if (numSlots>0 && BakedSdf_ReserveTexels(b,SDF_BRICK_SAMPLES)) {
+        glActiveTexture(GL_TEXTURE0+BRICK_MAP_TEXTURE_UNIT);
+        for (i=0;i<numSlots;i++) {
+            SdfBrickMap_GetSlotRect(m,slots[i],&x,&y);
+            SdfBrickMap_GetSlotTexels(m,slots[i],b->texels);
+            glTexSubImage2D(GL_TEXTURE_2D,0,x,y,SDF_BRICK_SIZE*SDF_BRICK_SIZE,SDF_BRICK_SIZE,BAKED_SDF_FORMAT,GL_FLOAT,b->texels);
+        }
+    }
+    if (numBricks>0) {
+        glActiveTexture(GL_TEXTURE0+BAKED_SDF_TEXTURE_UNIT);
+        SdfBrickMap_GetIndirectionTextureSize(m,&width,&height);
+        if (numBricks>=width) {
+            // Many changes (e.g. all the bricks, after SdfBrickMap_Create(...)): the whole texture
+            if (BakedSdf_ReserveTexels(b,width*height*4)) {
+                SdfBrickMap_GetIndirectionTexels(m,b->texels);
+                glTexImage2D(GL_TEXTURE_2D,0,SCENE_TEXTURE_INTERNAL_FORMAT,width,height,0,GL_RGBA,GL_FLOAT,b->texels);
+            }
+        }
+        else {
+            for (i=0;i<numBricks;i++) {
+                SdfBrickMap_GetIndirectionTexel(m,bricks[i],texel);
+                glTexSubImage2D(GL_TEXTURE_2D,0,bricks[i]%width,bricks[i]/width,1,1,GL_RGBA,GL_FLOAT,texel);
+            }
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+    SdfBrickMap_ClearChanges(m);
+}
+// Bakes and uploads the current scene if it has changed (it's called every frame, and it leaves the textures bound)
+void BakedSdf_Update(BakedSdf* b) {
+    const int useBrickMap = baked_sdf_brick_map_kb>0;
+    float bmin[3],bmax[3];
+    unsigned long long startNs;
+    double ms;
+    int width,height;
+    if (!b->texture || !BakedSdf_IsUsed()) return;
+    glActiveTexture(GL_TEXTURE0+BAKED_SDF_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,useBrickMap ? b->brick_map_textures[0] : b->texture);
+    if (useBrickMap) {
+        glActiveTexture(GL_TEXTURE0+BRICK_MAP_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D,b->brick_map_textures[1]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    if (b->baked_mode==scene_mode && (!SceneMode_UsesTexture(scene_mode) || b->baked_revision==scene_texture.scene.revision)) {
+        if (useBrickMap) BakedSdf_StreamBrickMap(b);
+        return;
+    }
+    if (useBrickMap && b->baked_mode==scene_mode && b->brick_map.num_bricks>0 &&
+        SdfBrickMap_InvalidateSceneChanges(&b->brick_map,&b->baked_scene,&scene_texture.scene,&BakedSdf_Map,&b->renderer,b->scheduler)>=0) {
+        // Only the bricks reached by the edits have been baked again (they're uploaded with the others)
+        if (!SdfScene_Copy(&b->baked_scene,&scene_texture.scene)) {BakedSdf_Disable("out of memory");return;}
+        b->baked_revision = scene_texture.scene.revision;
+        BakedSdf_StreamBrickMap(b);
+        return;
+    }
+    startNs = FrameStats_GetTimeNs();
+    CpuRenderer_Init(&b->renderer);
+    b->renderer.settings.reduce_num_objects = 0;    // (all the objects: the distances are lower bounds for every quality tier)
+    if (scene_mode==SCENE_MODE_COMPILED) b->renderer.compiled_scene = 1;
+    else if (SceneMode_UsesTexture(scene_mode)) CpuRenderer_SetScene(&b->renderer,&scene_texture.scene);
+    if (!SdfBake_GetSceneBounds(&scene_texture.scene,BAKED_SDF_MARGIN,bmin,bmax)) {BakedSdf_Disable("the scene has no bounded objects");return;}
+    if (!b->scheduler) b->scheduler = CpuScheduler_Create(0);
+    if (!b->scheduler) {BakedSdf_Disable("out of memory");return;}
+    if (useBrickMap) {
+        GLint maxTextureSize = 0;
+        size_t atlasBytes,indirectionBytes;
+        if (bmax[1]<1.6f) bmax[1] = 1.6f;   // (up to the top of the bounding volume of castRay(), where the camera usually is)
+        if (!SdfBrickMap_Create(&b->brick_map,bmin,bmax,BRICK_MAP_BRICK_SIZE,(size_t)baked_sdf_brick_map_kb*1024,&BakedSdf_Map,&b->renderer,b->scheduler)) {
+            BakedSdf_Disable("out of memory");return;
+        }
+        SdfBrickMap_GetAtlasTextureSize(&b->brick_map,&width,&height);
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE,&maxTextureSize);
+        if (height>maxTextureSize) {BakedSdf_Disable("the atlas of the brick map is bigger than the max texture size");return;}
+        ms = (double)(FrameStats_GetTimeNs()-startNs)*1.0e-6;
+        while (glGetError()!=GL_NO_ERROR) {}
+        glActiveTexture(GL_TEXTURE0+BRICK_MAP_TEXTURE_UNIT);
+        glTexImage2D(GL_TEXTURE_2D,0,BAKED_SDF_INTERNAL_FORMAT,width,height,0,BAKED_SDF_FORMAT,GL_FLOAT,NULL);    // (the slots are uploaded when they're baked)
+        glActiveTexture(GL_TEXTURE0);
+        if (!SdfScene_Copy(&b->baked_scene,&scene_texture.scene)) {BakedSdf_Disable("out of memory");return;}
+        b->baked_mode = scene_mode;
+        b->baked_revision = scene_texture.scene.revision;
+        BakedSdf_StreamBrickMap(b);         // (it uploads the whole indirection texture)
+        if (glGetError()!=GL_NO_ERROR) {BakedSdf_Disable("the texture format is not supported");return;}
+        SdfBrickMap_GetMemoryUsage(&b->brick_map,&atlasBytes,&indirectionBytes);
+        printf("Brick map: %dx%dx%d bricks of %1.3f (%d near the surfaces) classified in %1.1f ms, atlas of %d bricks (%1.1f KB, dense: %1.1f KB), indirection: %1.1f KB.\n",
+               b->brick_map.resolution[0],b->brick_map.resolution[1],b->brick_map.resolution[2],b->brick_map.brick_size,
+               b->brick_map.num_surface_bricks,ms,b->brick_map.num_slots,(double)atlasBytes/1024.0,
+               (double)SdfBrickMap_GetDenseMemoryUsage(&b->brick_map)/1024.0,(double)indirectionBytes/1024.0);
+        return;
+    }
+    if (!SdfBake_Bake(&b->bake,bmin,bmax,baked_sdf_resolution,&BakedSdf_Map,&b->renderer,b->scheduler)) {BakedSdf_Disable("out of memory");return;}
+    SdfBake_GetTextureSize(&b->bake,&width,&height);
+    if (!BakedSdf_ReserveTexels(b,width*height)) {BakedSdf_Disable("out of memory");return;}
+    SdfBake_GetTexels(&b->bake,b->texels);
+    ms = (double)(FrameStats_GetTimeNs()-startNs)*1.0e-6;
+    while (glGetError()!=GL_NO_ERROR) {}
+    glActiveTexture(GL_TEXTURE0+BAKED_SDF_TEXTURE_UNIT);
+    glTexImage2D(GL_TEXTURE_2D,0,BAKED_SDF_INTERNAL_FORMAT,width,height,0,BAKED_SDF_FORMAT,GL_FLOAT,b->texels);
+    glActiveTexture(GL_TEXTURE0);
+    if (glGetError()!=GL_NO_ERROR) {BakedSdf_Disable("the texture format is not supported");return;}
+    printf("Baked distance field: %dx%dx%d samples (voxel: %1.4f) in %1.1f ms with %d threads, %1.1f KB of texture (%dx%d).\n",
+           b->bake.resolution[0],b->bake.resolution[1],b->bake.resolution[2],b->bake.voxel_size,ms,
+           CpuScheduler_GetNumThreads(b->scheduler),(double)SdfBake_GetMemoryUsage(&b->bake)/1024.0,width,height);
+    b->baked_mode = scene_mode;
+    b->baked_revision = scene_texture.scene.revision;
+}
+// GL objects (they must be recreated together with the GL context)
+void BakedSdf_CreateGL(BakedSdf* b) {
+    int i;
+    b->texture = 0;b->baked_mode = -1;
+    if (!HasFloatTextures()) {
+        if (baked_sdf_enabled) {fprintf(stderr,"Baked distance field: float textures are not supported: disabled\n");baked_sdf_enabled = 0;}
+        return;
+    }
+    glGenTextures(1,&b->texture);
+    glGenTextures(2,b->brick_map_textures);
+    for (i=0;i<3;i++) {
+        const GLuint texture = i==0 ? b->texture : b->brick_map_textures[i-1];
+        const GLint filter = i==1 ? GL_NEAREST : GL_LINEAR;     // (the indirection texture of the brick map is never filtered)
+        glActiveTexture(GL_TEXTURE0+(i==2 ? BRICK_MAP_TEXTURE_UNIT : BAKED_SDF_TEXTURE_UNIT));
+        glBindTexture(GL_TEXTURE_2D,texture);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,filter);   // (the shader only reads inside the slices)
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,filter);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+void BakedSdf_DestroyGL(BakedSdf* b) {
+    if (b->texture) {glDeleteTextures(1,&b->texture);b->texture=0;}
+    if (b->brick_map_textures[0]) {glDeleteTextures(2,b->brick_map_textures);b->brick_map_textures[0]=b->brick_map_textures[1]=0;}
+}
+// Sets the iBakedSdf* (or iBrickMap*) uniforms of the current program (when it uses them)
+void BakedSdf_SetUniforms(const BakedSdf* b,const MyShaderStuff* p) {
+    float origin[4],size[4],atlas[4];
+    if (p->uLoc_iBrickMapIndirection>=0) {
+        float textures[4];
+        SdfBrickMap_GetUniforms(&b->brick_map,origin,size,textures,atlas);
+        glUniform1i(p->uLoc_iBrickMapIndirection,BAKED_SDF_TEXTURE_UNIT);
+        glUniform1i(p->uLoc_iBrickMapAtlas,BRICK_MAP_TEXTURE_UNIT);
+        glUniform4fv(p->uLoc_iBrickMapOrigin,1,origin);
+        glUniform4fv(p->uLoc_iBrickMapSize,1,size);
+        glUniform4fv(p->uLoc_iBrickMapTextures,1,textures);
+        glUniform4fv(p->uLoc_iBrickMapAtlasTexel,1,atlas);
+        return;
+    }
+    if (p->uLoc_iBakedSdf<0) return;
+    SdfBake_GetUniforms(&b->bake,origin,size,atlas);
+    glUniform1i(p->uLoc_iBakedSdf,BAKED_SDF_TEXTURE_UNIT);
+    glUniform4fv(p->uLoc_iBakedSdfOrigin,1,origin);
+    glUniform4fv(p->uLoc_iBakedSdfSize,1,size);
+    glUniform4fv(p->uLoc_iBakedSdfAtlas,1,atlas);
+}
+
+ShaderProgramCache shader_cache;   // all the permutations of "signed_distance_shapes.glsl" built so far (for the current GL context)
+const char* ProgramCacheDirectory = "3D_Signed_Distance_Shapes_cache";  // on-disk cache of the program binaries (NULL = disabled)
+
+const char* SceneShaderFileName = "signed_distance_shapes.glsl";
+int hot_reload_enabled = 1;     // (--no-hot-reload) see ShaderHotReload
+
+ShaderSource scene_shader_source;   // "signed_distance_shapes.glsl" with its #include files (the source of shader_cache)
+
+// Translates the line numbers of the fragment shader logs into file:line pairs of the ShaderSource passed as userData
+void SceneShaderLogCallback(GLenum shaderType,const char* defineHeader,const char* log,void* userData) {
+    const ShaderSource* src = (const ShaderSource*) userData;
+    char* translated = (shaderType==GL_FRAGMENT_SHADER && src && src->num_lines>0) ? ShaderSource_TranslateLog(src,log) : NULL;
+    fprintf(stderr,"%s failed (defines:\n%s):\n%s\n",shaderType==0 ? "Program link" : (shaderType==GL_VERTEX_SHADER ? "Vertex shader compilation" : "Fragment shader compilation"),defineHeader,translated ? translated : log);
+    if (translated) free(translated);
+}
+
+// Loads the sources of shader_cache (only once: they're kept when the GL context is recreated). Returns 0 on failure
+int LoadSceneShaderSources(ShaderProgramCache* c) {
+    if (c->fragment_source) return 1;
+    if (ShaderSource_Load(&scene_shader_source,SceneShaderFileName)!=0) return 0;
+    ShaderPermutation_SetLogCallback(&SceneShaderLogCallback,&scene_shader_source);
+    return ShaderProgramCache_SetSources(c,ScreenQuadVS,scene_shader_source.text);
+}
+// Quality tiers are built asynchronously (see ShaderProgramCache_Request(...)): until the requested one is ready, the current program is kept.
+// When there's none (at startup, and every time the GL context is recreated) and the requested tier is not in the on-disk
+// program cache, the placeholder tier (cheap to compile and to draw) is built first, and the requested one only after
+// the first frame has been presented (some drivers advertise GL_KHR_parallel_shader_compile but still compile in glCompileShader(...)).
+#define PLACEHOLDER_QUALITY_TIER (0)
+int shown_quality_tier = -1;                // tier of progParams (-1 = none)
+int pending_quality_tier = -1;              // tier being built (-1 = none)
+int pending_quality_tier_started = 0;       // 0 = its build starts at the next PollQualityTier(...)
+unsigned long long pending_quality_tier_ns; // when the build of pending_quality_tier started
+
+// Called when the program of "tier" is ready ("ms" is the time spent to build it, <0 = it was already cached)
+static void OnQualityTierReady(int tier,GLuint programId,double ms) {
+    if (ms>=0.0) {
+        ShaderPermutation perm;
+        int fromBinary;
+        QualityTier_GetPermutation(tier,&perm);
+        fromBinary = ShaderProgramCache_IsFromBinary(&shader_cache,&perm);
+        printf("Quality tier \"%s\" %s in %1.1f ms.\n",QualityTiers[tier].name,fromBinary ? "loaded from the program cache" : "built",ms);
+        if (startup.shader_ms<0.0 && tier==config.quality_tier) {
+            startup.shader_ms = ms;
+            startup.program_cache = fromBinary ? "warm" : ((shader_cache.binary_directory && ShaderProgramCache_HasProgramBinarySupport()) ? "cold" : "off");
+        }
+    }
+    MyShaderStuff_SetProgram(&progParams,programId);
+    shown_quality_tier = tier;
+}
+// Starts the build of pending_quality_tier. Returns 0 on failure
+static int StartPendingQualityTier(void) {
+    ShaderPermutation perm;
+    GLuint programId;
+    const int tier = pending_quality_tier;
+    QualityTier_GetPermutation(tier,&perm);
+    pending_quality_tier_started = 1;
+    pending_quality_tier_ns = FrameStats_GetTimeNs();
+    programId = ShaderProgramCache_Request(&shader_cache,&perm);
+    if (ShaderProgramCache_IsPending(&shader_cache,&perm)) return 1;
+    pending_quality_tier = -1;
+    if (!programId) {
+        fprintf(stderr,"Error: can't build quality tier \"%s\"%s\n",QualityTiers[tier].name,progParams.programId ? " (the current one is kept)" : "");
+        return 0;
+    }
+    OnQualityTierReady(tier,programId,(double)(FrameStats_GetTimeNs()-pending_quality_tier_ns)*1.0e-6);
+    return 1;
+}
+// Switches progParams to a quality tier: immediately if its program is cached, otherwise when PollQualityTier(...) finds it ready.
+// Returns 0 on failure (the current program is kept)
+int SetQualityTier(int tier) {
+    ShaderPermutation perm;
+    GLuint programId;
+    unsigned long long startNs;
+    if (tier<0 || tier>=NUM_QUALITY_TIERS) return 0;
+    QualityTier_GetPermutation(tier,&perm);
+    pending_quality_tier = -1;
+    startNs = FrameStats_GetTimeNs();
+    programId = ShaderProgramCache_Load(&shader_cache,&perm);
+    if (programId) OnQualityTierReady(tier,programId,(double)(FrameStats_GetTimeNs()-startNs)*1.0e-6);
+    else if (progParams.programId) {
+        pending_quality_tier = tier;
+        if (!StartPendingQualityTier()) return 0;
+    }
+    else {
+        // Nothing to draw with: the placeholder is built now
+        QualityTier_GetPermutation(PLACEHOLDER_QUALITY_TIER,&perm);
+        programId = ShaderProgramCache_Get(&shader_cache,&perm);
+        if (!programId) {fprintf(stderr,"Error: can't build quality tier \"%s\"\n",QualityTiers[PLACEHOLDER_QUALITY_TIER].name);return 0;}
+        OnQualityTierReady(PLACEHOLDER_QUALITY_TIER,programId,(double)(FrameStats_GetTimeNs()-startNs)*1.0e-6);
+        if (tier!=PLACEHOLDER_QUALITY_TIER) {
+            pending_quality_tier = tier;
+            pending_quality_tier_started = 0;
+            if (!startup.first_frame_ns) startup.placeholder = 1;
+            printf("Drawing with quality tier \"%s\" until \"%s\" is ready.\n",QualityTiers[PLACEHOLDER_QUALITY_TIER].name,QualityTiers[tier].name);
+        }
+    }
+    config.quality_tier = tier;     // (the requested one, even if it's still pending: it's the one saved in the config file)
+    return 1;
+}
+// Called once per frame, before drawing (wait=1 blocks until the pending tier is ready)
+void PollQualityTier(int wait) {
+    ShaderPermutation perm;
+    GLuint programId;
+    const int tier = pending_quality_tier;
+    if (tier<0) return;
+    if (!pending_quality_tier_started) {
+        if (!StartPendingQualityTier()) config.quality_tier = shown_quality_tier;
+        if (pending_quality_tier<0 || !wait) return;
+    }
+    if (ShaderProgramCache_Poll(&shader_cache,wait)>0) return;
+    pending_quality_tier = -1;
+    QualityTier_GetPermutation(tier,&perm);
+    programId = ShaderProgramCache_Find(&shader_cache,&perm);
+    if (!programId) {
+        fprintf(stderr,"Error: can't build quality tier \"%s\" (\"%s\" is kept)\n",QualityTiers[tier].name,QualityTiers[shown_quality_tier].name);
+        config.quality_tier = shown_quality_tier;
+        return;
+    }
+    OnQualityTierReady(tier,programId,(double)(FrameStats_GetTimeNs()-pending_quality_tier_ns)*1.0e-6);
+}
+
+#ifndef __EMSCRIPTEN__
+// Hot reload of "signed_distance_shapes.glsl": when the file (or one of its #include files) is saved, the current quality tier
+// is built in background from the new sources in a separate cache, and progParams is switched to it (between two frames)
+// only if it links: on errors the old program (and shader_cache) is kept.
+#define SHADER_HOT_RELOAD_MAX_FILES (16)
+typedef struct {
+    int enabled;
+    FileWatcher watchers[SHADER_HOT_RELOAD_MAX_FILES];     // one per file of the source
+    int num_watchers;
+    ShaderSource source;                // new sources (valid while tier>=0)
+    ShaderProgramCache cache;
+    int tier;                           // quality tier being built (-1 = none)
+    unsigned long long detected_ns;     // when the change has been detected
+    double last_latency_ms;             // from the detection of the last change to the swap (<0 = none yet)
+} ShaderHotReload;
+ShaderHotReload shader_hot_reload;
+void ShaderHotReload_Init(ShaderHotReload* h) {
+    memset(h,0,sizeof(ShaderHotReload));
+    h->tier = -1;
+    h->last_latency_ms = -1.0;
+    ShaderSource_Init(&h->source);
+    ShaderProgramCache_Init(&h->cache);
+}
+// Watches all the files of "s" (or just SceneShaderFileName if it's not loaded)
+void ShaderHotReload_Watch(ShaderHotReload* h,const ShaderSource* s) {
+    int i;
+    for (i=0;i<h->num_watchers;i++) FileWatcher_Destroy(&h->watchers[i]);
+    h->num_watchers = 0;
+    for (i=0;i<(s->num_files>0 ? s->num_files : 1);i++) {
+        const char* filePath = s->num_files>0 ? s->files[i] : SceneShaderFileName;
+        if (h->num_watchers==SHADER_HOT_RELOAD_MAX_FILES) {fprintf(stderr,"Too many shader files: \"%s\" is not watched\n",filePath);continue;}
+        if (FileWatcher_Init(&h->watchers[h->num_watchers],filePath)) ++h->num_watchers;
+        else fprintf(stderr,"Can't watch \"%s\"\n",filePath);
+    }
+}
+void ShaderHotReload_Start(ShaderHotReload* h) {
+    ShaderHotReload_Watch(h,&scene_shader_source);
+    h->enabled = h->num_watchers>0;
+    if (!h->enabled) fprintf(stderr,"Hot reload is disabled\n");
+}
+// Stops the current build (e.g. before the GL context is destroyed)
+void ShaderHotReload_Cancel(ShaderHotReload* h) {
+    ShaderProgramCache_Destroy(&h->cache);
+    ShaderSource_Destroy(&h->source);
+    h->tier = -1;
+}
+void ShaderHotReload_Destroy(ShaderHotReload* h) {
+    int i;
+    ShaderHotReload_Cancel(h);
+    for (i=0;i<h->num_watchers;i++) FileWatcher_Destroy(&h->watchers[i]);
+    h->num_watchers = 0;
+    h->enabled = 0;
+}
+// Called once per frame, before drawing: it never waits for the driver
+void ShaderHotReload_Update(ShaderHotReload* h) {
+    ShaderPermutation perm;
+    GLuint programId;
+    int i,changed = 0,pending;
+    if (!h->enabled) return;
+    for (i=0;i<h->num_watchers;i++) changed|=FileWatcher_Poll(&h->watchers[i]);
+    if (changed) {
+        ShaderSource source;
+        ShaderSource_Init(&source);
+        if (ShaderSource_Load(&source,SceneShaderFileName)==0 && source.length>0 &&
+            (!shader_cache.fragment_source || strcmp(source.text,shader_cache.fragment_source)!=0) &&
+            (h->tier<0 || strcmp(source.text,h->cache.fragment_source)!=0)) {
+            ShaderHotReload_Cancel(h);
+            h->source = source;
+            ShaderSource_Init(&source);
+            ShaderHotReload_Watch(h,&h->source);   // (the #include files might have changed)
+            h->detected_ns = FrameStats_GetTimeNs();
+            h->tier = shown_quality_tier>=0 ? (pending_quality_tier>=0 ? pending_quality_tier : shown_quality_tier) : config.quality_tier;
+            if (!ShaderProgramCache_SetSources(&h->cache,ScreenQuadVS,h->source.text) ||
+                (shader_cache.binary_directory && !ShaderProgramCache_SetBinaryDirectory(&h->cache,shader_cache.binary_directory))) {
+                fprintf(stderr,"Out of memory\n");
+                ShaderHotReload_Cancel(h);
+            }
+            else {
+                printf("\"%s\" changed: rebuilding quality tier \"%s\"...\n",SceneShaderFileName,QualityTiers[h->tier].name);
+                QualityTier_GetPermutation(h->tier,&perm);
+                ShaderPermutation_SetLogCallback(&SceneShaderLogCallback,&h->source);
+                ShaderProgramCache_Request(&h->cache,&perm);
+                ShaderPermutation_SetLogCallback(&SceneShaderLogCallback,&scene_shader_source);
+            }
+        }
+        ShaderSource_Destroy(&source);
+    }
+    if (h->tier<0) return;
+    ShaderPermutation_SetLogCallback(&SceneShaderLogCallback,&h->source);  // (errors refer to the new sources)
+    pending = ShaderProgramCache_Poll(&h->cache,0);
+    ShaderPermutation_SetLogCallback(&SceneShaderLogCallback,&scene_shader_source);
+    if (pending>0) return;
+
+    QualityTier_GetPermutation(h->tier,&perm);
+    programId = ShaderProgramCache_Find(&h->cache,&perm);
+    if (!programId) {
+        fprintf(stderr,"Hot reload of \"%s\" failed: the old program is kept\n",SceneShaderFileName);
+        ShaderHotReload_Cancel(h);
+        return;
+    }
+    // Swap: the new cache (with the new sources) replaces shader_cache, and every other tier will be built again when needed
+    pending_quality_tier = -1;
+    ShaderProgramCache_Destroy(&shader_cache);
+    shader_cache = h->cache;
+    ShaderProgramCache_Init(&h->cache);
+    ShaderSource_Destroy(&scene_shader_source);
+    scene_shader_source = h->source;
+    ShaderSource_Init(&h->source);
+    MyShaderStuff_SetProgram(&progParams,programId);
+    shown_quality_tier = config.quality_tier = h->tier;
+    h->tier = -1;
+    h->last_latency_ms = (double)(FrameStats_GetTimeNs()-h->detected_ns)*1.0e-6;
+    printf("\"%s\" reloaded: %1.1f ms after the change was detected.\n",SceneShaderFileName,h->last_latency_ms);
+}
+#endif //__EMSCRIPTEN__
+
 
 GLuint screenQuadVbo = 0;
 void ScreenQuadVBO_Init() {	
@@ -368,24 +1360,418 @@ void ScreenQuadVBO_Unbind() {
     glDisableVertexAttribArray(0);
 }
 
+// The programs of the extra passes (ConePrepass, TemporalDepth, Deferred) are permutations of progParams: the same defines,
+// without the "removed" ones and with "define". They're built asynchronously in shader_cache, and DerivedProgram_Update(...)
+// keeps them in sync with progParams (a new quality tier, scene mode or hot reload): it never waits for the driver
+typedef struct {
+    MyShaderStuff params;               // 0 = not ready
+    GLuint params_for;                  // the progParams.programId that params belongs to
+    int requested;                      // 1 = params has been requested, -1 = its build failed
+    ShaderPermutation permutation;      // of params
+    const char* define;
+    const char* option;                 // another define (can be NULL)
+    const char* const* removed;         // NULL-terminated
+    const char* name;                   // for the error message
+} DerivedProgram;
+void DerivedProgram_Init(DerivedProgram* d,const char* define,const char* const* removed,const char* name) {
+    d->define = define;d->option = NULL;d->removed = removed;d->name = name;
+    d->params_for = 0;d->requested = 0;
+}
+void DerivedProgram_Destroy(DerivedProgram* d) {
+    MyShaderStuff_Destroy(&d->params);
+    d->params_for = 0;d->requested = 0;     // (shader_cache is cleared too)
+}
+// Returns 1 when params is ready
+static int DerivedProgram_Update(DerivedProgram* d) {
+    GLuint programId;
+    int i;
+    if (d->params_for!=progParams.programId) {
+        d->params_for = progParams.programId;
+        MyShaderStuff_SetProgram(&d->params,0);
+        d->requested = 0;
+        if (!progParams.programId || shown_quality_tier<0) return 0;
+        // (the permutation of progParams: shown_quality_tier with the options of when it was set)
+        QualityTier_GetPermutation(shown_quality_tier,&d->permutation);
+        for (i=0;d->removed[i];i++) ShaderPermutation_Remove(&d->permutation,d->removed[i]);
+        ShaderPermutation_Set(&d->permutation,d->define,NULL);
+        if (d->option) ShaderPermutation_Set(&d->permutation,d->option,NULL);
+    }
+    if (d->params.programId || d->requested<0 || !d->params_for) return d->params.programId ? 1 : 0;
+    if (!d->requested) {
+        d->requested = 1;
+        programId = ShaderProgramCache_Request(&shader_cache,&d->permutation);
+    }
+    else {
+        if (ShaderProgramCache_IsPending(&shader_cache,&d->permutation) && ShaderProgramCache_Poll(&shader_cache,0)>0 &&
+            ShaderProgramCache_IsPending(&shader_cache,&d->permutation)) return 0;
+        programId = ShaderProgramCache_Find(&shader_cache,&d->permutation);
+        if (!programId) {fprintf(stderr,"Error: can't build %s\n",d->name);d->requested = -1;return 0;}
+    }
+    if (programId) MyShaderStuff_SetProgram(&d->params,programId);
+    return d->params.programId ? 1 : 0;
+}
 
-GLuint getTextFromFile(char* buffer,int buffer_size,const char* filename) {
-    FILE *pfile;
-    memset(buffer,0,buffer_size);
-
-    // This will raise a warning on MS compiler
-    pfile = fopen(filename, "rb");
-    if(!pfile)
-    {
-        printf("Sorry, can't open file: '%s'.\n", filename);
-        exit(0);
-        return 0;
+// Cone pre-pass (--cone-prepass <tile>, USE_CONE_PREPASS): before the raycast pass, a pass with one fragment per tile of
+// cone_prepass_tile*cone_prepass_tile pixels (CONE_PREPASS, "cone_prepass.glsl") marches a cone containing all the rays of
+// the tile, and writes the distance up to which it's empty to a small RGBA8 texture: castRay() starts from there instead of
+// the near plane. Its program is the permutation of progParams with CONE_PREPASS, built asynchronously in shader_cache:
+// until it's ready the texture is just cleared (every ray starts from the near plane, like before).
+#define CONE_PREPASS_TEXTURE_UNIT       (4)
+typedef struct {
+    GLuint frame_buffer;
+    GLuint texture;
+    int width,height;                   // of texture (the tiles of the whole window)
+    DerivedProgram program;             // CONE_PREPASS
+} ConePrepass;
+ConePrepass cone_prepass;
+static const char* const ConePrepassRemovedDefines[] = {"USE_CONE_PREPASS","WRITE_DEPTH_VALUE",NULL};
+void ConePrepass_CreateGL(ConePrepass* c) {
+    glGenFramebuffers(1,&c->frame_buffer);
+    glGenTextures(1,&c->texture);
+    glActiveTexture(GL_TEXTURE0+CONE_PREPASS_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,c->texture);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);     // (one texel per tile: never filtered)
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glActiveTexture(GL_TEXTURE0);
+    c->width = c->height = 0;
+    DerivedProgram_Init(&c->program,"CONE_PREPASS",ConePrepassRemovedDefines,"the cone pre-pass (castRay() starts from the near plane)");
+}
+void ConePrepass_DestroyGL(ConePrepass* c) {
+    if (c->frame_buffer) {glDeleteFramebuffers(1,&c->frame_buffer);c->frame_buffer=0;}
+    if (c->texture) {glDeleteTextures(1,&c->texture);c->texture=0;}
+    DerivedProgram_Destroy(&c->program);
+}
+// The texture covers the tiles of the whole window (the raycast pass can be smaller with dynamic resolution)
+void ConePrepass_Resize(ConePrepass* c,int width,int height) {
+    if (!c->texture || cone_prepass_tile<=0 || width<=0 || height<=0) return;
+    c->width = (width+cone_prepass_tile-1)/cone_prepass_tile;
+    c->height = (height+cone_prepass_tile-1)/cone_prepass_tile;
+    glActiveTexture(GL_TEXTURE0+CONE_PREPASS_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,c->texture);
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,c->width,c->height,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER,c->frame_buffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,c->texture,0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE) printf("Cone pre-pass: glCheckFramebufferStatus(...) FAILED.\n");
+    glBindFramebuffer(GL_FRAMEBUFFER,render_target.default_frame_buffer);
+}
+// Sets the iConePrepass* uniforms of the current program (when it uses them)
+void ConePrepass_SetUniforms(const ConePrepass* c,const MyShaderStuff* p) {
+    if (p->uLoc_iConePrepass>=0) glUniform1i(p->uLoc_iConePrepass,CONE_PREPASS_TEXTURE_UNIT);
+    if (p->uLoc_iConePrepassInfo>=0) glUniform4f(p->uLoc_iConePrepassInfo,(float)cone_prepass_tile,1.f/(float)c->width,1.f/(float)c->height,0.f);
+}
+// Draws the pre-pass of a raycast pass of resX*resY pixels (with the scene uniforms of the current frame), and then
+// binds frameBuffer again (the target of the raycast pass). The program in use is changed
+void ConePrepass_Draw(ConePrepass* c,int resX,int resY,float globalTime,GLint frameBuffer) {
+    MyShaderStuff* p = &c->program.params;
+    glBindFramebuffer(GL_FRAMEBUFFER,c->frame_buffer);
+    glViewport(0,0,(resX+cone_prepass_tile-1)/cone_prepass_tile,(resY+cone_prepass_tile-1)/cone_prepass_tile);
+    if (DerivedProgram_Update(&c->program)) {
+        glUseProgram(p->programId);
+        MyShaderStuff_SetUniforms(p,resX,resY,globalTime,&cameraMatrix,NULL);
+        SceneTexture_SetUniforms(&scene_texture,p);
+        BakedSdf_SetUniforms(&baked_sdf,p);
+        ConePrepass_SetUniforms(c,p);
+        ScreenQuadVBO_Draw();
     }
+    else glClear(GL_COLOR_BUFFER_BIT);     // (distance 0)
+    glBindFramebuffer(GL_FRAMEBUFFER,frameBuffer);
+    glViewport(0,0,resX,resY);
+}
 
-    fread(buffer,sizeof(char),buffer_size,pfile);
-    //printf("%s\n",buffer);
+// Temporal depth reuse (--temporal-depth <fraction>, USE_TEMPORAL_DEPTH): the raycast pass writes the hit distance of every
+// pixel to a second RGBA8 texture (gl_FragData[1]) attached to its render target, and castRay() starts from a distance
+// reprojected from the previous frame (see "temporal_depth.glsl"). Before the raycast pass, a pass with one fragment per
+// tile of TEMPORAL_DEPTH_TILE*TEMPORAL_DEPTH_TILE pixels (TEMPORAL_DEPTH_REDUCE) writes the smallest hit distance of the
+// tiles of the previous frame. The raycast pass always draws to the render targets then (one hit texture each: the one
+// of the previous frame is never the one being written). Its reduce program is built asynchronously like the one of
+// ConePrepass: until it's ready (and after a resize or a frame without USE_TEMPORAL_DEPTH) every ray starts from the near plane.
+#define TEMPORAL_DEPTH_TEXTURE_UNIT         (5)     // the hit distances of the previous frame
+#define TEMPORAL_DEPTH_TILES_TEXTURE_UNIT   (6)     // their smallest value per tile
+#define TEMPORAL_DEPTH_TILE                 (4)     // the same as TEMPORAL_DEPTH_TILE in "temporal_depth.glsl"
+#ifndef GL_COLOR_ATTACHMENT1
+#define GL_COLOR_ATTACHMENT1                0x8CE1  // (the same as GL_COLOR_ATTACHMENT1_EXT of GL_EXT_draw_buffers)
+#endif
+typedef struct {
+    GLuint texture[NUM_RENDER_TARGETS];     // hit distances, attached to render_target.frame_buffer (GL_COLOR_ATTACHMENT1)
+    GLuint tiles_frame_buffer;
+    GLuint tiles_texture;
+    int tiles_width,tiles_height;           // of tiles_texture (the tiles of the whole window)
+    int previous;                           // render target of the previous frame (-1 = none)
+    int previous_width,previous_height;     // its viewport (it changes with dynamic resolution)
+    mat4_t previous_camera;
+    int reduced;                            // 1 = tiles_texture holds the tiles of previous (for the current frame)
+    DerivedProgram program;                 // TEMPORAL_DEPTH_REDUCE
+} TemporalDepth;
+TemporalDepth temporal_depth;
+static const char* const TemporalDepthRemovedDefines[] = {"USE_TEMPORAL_DEPTH","USE_CONE_PREPASS","WRITE_DEPTH_VALUE",NULL};
+// Two draw buffers (OpenGL 2.0, GL_EXT_draw_buffers in WebGL 1)
+int HasDrawBuffers(void) {
+#   ifndef __EMSCRIPTEN__
+    GLint maxDrawBuffers = 0;
+    glGetIntegerv(GL_MAX_DRAW_BUFFERS,&maxDrawBuffers);
+    return maxDrawBuffers>=2 ? 1 : 0;
+#   else //__EMSCRIPTEN__
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+    return (extensions && strstr(extensions,"draw_buffers")) ? 1 : 0;
+#   endif //__EMSCRIPTEN__
+}
+// GL objects (before the first program: it resets temporal_depth_fraction when draw buffers are not supported)
+void TemporalDepth_CreateGL(TemporalDepth* t) {
+    int i;
+    memset(t->texture,0,sizeof(t->texture));
+    t->tiles_frame_buffer = t->tiles_texture = 0;
+    t->tiles_width = t->tiles_height = 0;
+    t->previous = -1;t->reduced = 0;
+    DerivedProgram_Init(&t->program,"TEMPORAL_DEPTH_REDUCE",TemporalDepthRemovedDefines,"the temporal depth reduction (castRay() starts from the near plane)");
+    if (!HasDrawBuffers()) {
+        fprintf(stderr,"TemporalDepth: draw buffers are not supported: castRay() starts from the near plane\n");
+        temporal_depth_fraction = 0.f;
+        return;
+    }
+    glGenTextures(NUM_RENDER_TARGETS,t->texture);
+    glGenTextures(1,&t->tiles_texture);
+    glGenFramebuffers(1,&t->tiles_frame_buffer);
+    glActiveTexture(GL_TEXTURE0+TEMPORAL_DEPTH_TEXTURE_UNIT);
+    for (i=0;i<=NUM_RENDER_TARGETS;i++) {
+        glBindTexture(GL_TEXTURE_2D,i<NUM_RENDER_TARGETS ? t->texture[i] : t->tiles_texture);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);     // (packed distances: never filtered)
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D,0);
+    glActiveTexture(GL_TEXTURE0);
+}
+void TemporalDepth_DestroyGL(TemporalDepth* t) {
+    if (t->texture[0]) {glDeleteTextures(NUM_RENDER_TARGETS,t->texture);memset(t->texture,0,sizeof(t->texture));}
+    if (t->tiles_texture) {glDeleteTextures(1,&t->tiles_texture);t->tiles_texture=0;}
+    if (t->tiles_frame_buffer) {glDeleteFramebuffers(1,&t->tiles_frame_buffer);t->tiles_frame_buffer=0;}
+    DerivedProgram_Destroy(&t->program);
+    t->previous = -1;
+}
+// After RenderTarget_Init(...): the hit textures have the size of the render targets (and the previous frame is lost)
+void TemporalDepth_Resize(TemporalDepth* t,int width,int height) {
+    int i;
+    t->previous = -1;
+    if (!t->texture[0] || width<=0 || height<=0) return;
+    t->tiles_width = (width+TEMPORAL_DEPTH_TILE-1)/TEMPORAL_DEPTH_TILE;
+    t->tiles_height = (height+TEMPORAL_DEPTH_TILE-1)/TEMPORAL_DEPTH_TILE;
+    glActiveTexture(GL_TEXTURE0+TEMPORAL_DEPTH_TEXTURE_UNIT);
+    for (i=0;i<NUM_RENDER_TARGETS;i++) {
+        glBindTexture(GL_TEXTURE_2D,t->texture[i]);
+        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+        glBindFramebuffer(GL_FRAMEBUFFER,render_target.frame_buffer[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT1,GL_TEXTURE_2D,t->texture[i],0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE) printf("Temporal depth: glCheckFramebufferStatus(...) FAILED.\n");
+    }
+    glBindTexture(GL_TEXTURE_2D,t->tiles_texture);
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,t->tiles_width,t->tiles_height,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+    glBindTexture(GL_TEXTURE_2D,0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER,t->tiles_frame_buffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,t->tiles_texture,0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE) printf("Temporal depth: glCheckFramebufferStatus(...) FAILED.\n");
+    glBindFramebuffer(GL_FRAMEBUFFER,render_target.default_frame_buffer);
+}
+// Selects the draw buffers of the render target currently bound: the hit texture too only when the program writes it
+// (with GL_EXT_draw_buffers gl_FragColor would be written to both)
+void TemporalDepth_SetDrawBuffers(const TemporalDepth* t,int writeHitDistances) {
+    const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0,GL_COLOR_ATTACHMENT1};
+    if (t->texture[0]) glDrawBuffers(writeHitDistances ? 2 : 1,buffers);
+}
+// Sets the iTemporalDepth* uniforms of the current program (when it uses them), and binds the textures of the previous frame
+void TemporalDepth_SetUniforms(const TemporalDepth* t,const MyShaderStuff* p) {
+    glActiveTexture(GL_TEXTURE0+TEMPORAL_DEPTH_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,t->previous>=0 ? t->texture[t->previous] : 0);     // (never the texture being written)
+    glActiveTexture(GL_TEXTURE0+TEMPORAL_DEPTH_TILES_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D,t->reduced ? t->tiles_texture : 0);
+    glActiveTexture(GL_TEXTURE0);
+    if (p->uLoc_iTemporalDepth>=0) glUniform1i(p->uLoc_iTemporalDepth,TEMPORAL_DEPTH_TEXTURE_UNIT);
+    if (p->uLoc_iTemporalDepthTiles>=0) glUniform1i(p->uLoc_iTemporalDepthTiles,TEMPORAL_DEPTH_TILES_TEXTURE_UNIT);
+    if (p->uLoc_iTemporalDepthCamera>=0) glUniformMatrix4fv(p->uLoc_iTemporalDepthCamera,1,GL_FALSE,&t->previous_camera.m[0][0]);
+    // (0.0 = every ray starts from the near plane)
+    if (p->uLoc_iTemporalDepthInfo>=0) glUniform4f(p->uLoc_iTemporalDepthInfo,t->reduced ? temporal_depth_fraction : 0.f,(float)t->previous_width,(float)t->previous_height,0.f);
+    if (p->uLoc_iTemporalDepthTexel>=0 && render_target.width>0 && t->tiles_width>0)
+        glUniform4f(p->uLoc_iTemporalDepthTexel,1.f/(float)render_target.width,1.f/(float)render_target.height,1.f/(float)t->tiles_width,1.f/(float)t->tiles_height);
+}
+// Draws the reduction of the previous frame (if any) before a raycast pass of resX*resY pixels, and then binds
+// frameBuffer again (the target of the raycast pass). The program in use is changed
+void TemporalDepth_Draw(TemporalDepth* t,int resX,int resY,GLint frameBuffer) {
+    t->reduced = 0;
+    if (!DerivedProgram_Update(&t->program) || t->previous<0) return;
+    glBindFramebuffer(GL_FRAMEBUFFER,t->tiles_frame_buffer);
+    glViewport(0,0,(t->previous_width+TEMPORAL_DEPTH_TILE-1)/TEMPORAL_DEPTH_TILE,(t->previous_height+TEMPORAL_DEPTH_TILE-1)/TEMPORAL_DEPTH_TILE);
+    glUseProgram(t->program.params.programId);
+    TemporalDepth_SetUniforms(t,&t->program.params);
+    ScreenQuadVBO_Draw();
+    t->reduced = 1;
+    glBindFramebuffer(GL_FRAMEBUFFER,frameBuffer);
+    glViewport(0,0,resX,resY);
+}
+// After the raycast pass of render target index (writeHitDistances = 0 when its program doesn't use USE_TEMPORAL_DEPTH)
+void TemporalDepth_EndFrame(TemporalDepth* t,int index,int writeHitDistances,int resX,int resY,const mat4_t* camera) {
+    t->previous = (writeHitDistances && t->texture[0] && NUM_RENDER_TARGETS>1) ? index : -1;     // (the next frame writes another one)
+    t->previous_width = resX;t->previous_height = resY;
+    t->previous_camera = *camera;
+}
 
-    fclose(pfile);
+// Deferred shading (--deferred, "deferred.glsl"): render() is split in two passes with one sample per pixel. The visibility
+// pass (DEFERRED_GBUFFER) runs castRay() and calcNormal() and writes the hit distance, the material and the normal of every
+// pixel to two RGBA8 textures of its own frame buffer (the G-buffer: gl_FragData[0] and [1], GL_EXT_draw_buffers in WebGL 1);
+// then the shading pass (DEFERRED_SHADING) reads them back and runs the occlusion terms (calcAO() and softshadow()), the
+// lighting and the depth of every pixel, to the target of the raycast pass. Both programs are permutations of progParams
+// built in background: until they're ready the frame is drawn by progParams (forward). It disables the temporal depth reuse
+// (the shading pass doesn't know the hit distances before the G-buffer: their texture units are reused).
+// With --deferred-occlusion <divisor>, a third pass between the two (DEFERRED_OCCLUSION) computes the occlusion terms for one
+// pixel of every block of divisor*divisor to a small RGBA8 texture, and the shading pass (USE_LOW_RES_OCCLUSION) upsamples
+// them with a depth and normal-aware (bilateral) filter.
+#define DEFERRED_TEXTURE_UNIT           (5)     // iGBuffer0 (and iGBuffer1 in the next one): the units of TemporalDepth
+#define DEFERRED_OCCLUSION_TEXTURE_UNIT (7)     // iOcclusion
+typedef struct {
+    GLuint frame_buffer;
+    GLuint texture[2];                  // iGBuffer0 and iGBuffer1 (see "deferred.glsl")
+    int width,height;                   // of the textures (the whole window)
+    GLuint occlusion_frame_buffer;      // (0 when deferred_occlusion_divisor is 1)
+    GLuint occlusion_texture;           // iOcclusion (width and height divided by deferred_occlusion_divisor, rounded up)
+    DerivedProgram gbuffer;             // DEFERRED_GBUFFER
+    DerivedProgram occlusion;           // DEFERRED_OCCLUSION
+    DerivedProgram shading;             // DEFERRED_SHADING
+} Deferred;
+Deferred deferred;
+static const char* const DeferredGBufferRemovedDefines[] = {"WRITE_DEPTH_VALUE",NULL};
+static const char* const DeferredOcclusionRemovedDefines[] = {"USE_CONE_PREPASS","WRITE_DEPTH_VALUE",NULL};
+static const char* const DeferredShadingRemovedDefines[] = {"USE_CONE_PREPASS",NULL};
+#define Deferred_GetOcclusionSamples(size) (((size)+deferred_occlusion_divisor-1)/deferred_occlusion_divisor)
+static void Deferred_CreateTexture(GLuint texture,int unit) {
+    glActiveTexture(GL_TEXTURE0+unit);
+    glBindTexture(GL_TEXTURE_2D,texture);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);     // (packed values: never filtered)
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D,0);
+}
+// GL objects (before the first program: it resets deferred_enabled when draw buffers are not supported)
+void Deferred_CreateGL(Deferred* d) {
+    int i;
+    d->frame_buffer = 0;d->texture[0] = d->texture[1] = 0;
+    d->width = d->height = 0;
+    d->occlusion_frame_buffer = d->occlusion_texture = 0;
+    DerivedProgram_Init(&d->gbuffer,"DEFERRED_GBUFFER",DeferredGBufferRemovedDefines,"the G-buffer pass (forward rendering is used)");
+    DerivedProgram_Init(&d->occlusion,"DEFERRED_OCCLUSION",DeferredOcclusionRemovedDefines,"the low-resolution occlusion pass (forward rendering is used)");
+    DerivedProgram_Init(&d->shading,"DEFERRED_SHADING",DeferredShadingRemovedDefines,"the deferred shading pass (forward rendering is used)");
+    if (deferred_occlusion_divisor>1) d->shading.option = "USE_LOW_RES_OCCLUSION";
+    if (!HasDrawBuffers()) {
+        fprintf(stderr,"Deferred: draw buffers are not supported: forward rendering is used\n");
+        deferred_enabled = 0;
+        return;
+    }
+    if (deferred_occlusion_divisor>1) {
+        glGenFramebuffers(1,&d->occlusion_frame_buffer);
+        glGenTextures(1,&d->occlusion_texture);
+        Deferred_CreateTexture(d->occlusion_texture,DEFERRED_OCCLUSION_TEXTURE_UNIT);
+    }
+    glGenFramebuffers(1,&d->frame_buffer);
+    glGenTextures(2,d->texture);
+    for (i=0;i<2;i++) Deferred_CreateTexture(d->texture[i],DEFERRED_TEXTURE_UNIT+i);
+    glActiveTexture(GL_TEXTURE0);
+}
+void Deferred_DestroyGL(Deferred* d) {
+    if (d->frame_buffer) {glDeleteFramebuffers(1,&d->frame_buffer);d->frame_buffer=0;}
+    if (d->texture[0]) {glDeleteTextures(2,d->texture);d->texture[0]=d->texture[1]=0;}
+    if (d->occlusion_frame_buffer) {glDeleteFramebuffers(1,&d->occlusion_frame_buffer);d->occlusion_frame_buffer=0;}
+    if (d->occlusion_texture) {glDeleteTextures(1,&d->occlusion_texture);d->occlusion_texture=0;}
+    DerivedProgram_Destroy(&d->gbuffer);
+    DerivedProgram_Destroy(&d->occlusion);
+    DerivedProgram_Destroy(&d->shading);
+}
+// The G-buffer covers the whole window (the passes can be smaller with dynamic resolution)
+void Deferred_Resize(Deferred* d,int width,int height) {
+    const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0,GL_COLOR_ATTACHMENT1};
+    int i;
+    if (!d->frame_buffer || width<=0 || height<=0) return;
+    d->width = width;d->height = height;
+    glBindFramebuffer(GL_FRAMEBUFFER,d->frame_buffer);
+    for (i=0;i<2;i++) {
+        glActiveTexture(GL_TEXTURE0+DEFERRED_TEXTURE_UNIT+i);
+        glBindTexture(GL_TEXTURE_2D,d->texture[i]);
+        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,i==0 ? GL_COLOR_ATTACHMENT0 : GL_COLOR_ATTACHMENT1,GL_TEXTURE_2D,d->texture[i],0);
+        glBindTexture(GL_TEXTURE_2D,0);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glDrawBuffers(2,buffers);   // (state of the frame buffer)
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE) printf("Deferred: glCheckFramebufferStatus(...) FAILED.\n");
+    if (d->occlusion_frame_buffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER,d->occlusion_frame_buffer);
+        glActiveTexture(GL_TEXTURE0+DEFERRED_OCCLUSION_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D,d->occlusion_texture);
+        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,Deferred_GetOcclusionSamples(width),Deferred_GetOcclusionSamples(height),0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,d->occlusion_texture,0);
+        glBindTexture(GL_TEXTURE_2D,0);
+        glActiveTexture(GL_TEXTURE0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER)!=GL_FRAMEBUFFER_COMPLETE) printf("Deferred: glCheckFramebufferStatus(...) of the occlusion FAILED.\n");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER,render_target.default_frame_buffer);
+}
+// Sets the uniforms of one of the programs (the scene ones too) for a frame of resX*resY pixels
+static void Deferred_SetUniforms(const Deferred* d,MyShaderStuff* p,int resX,int resY,float globalTime) {
+    glUseProgram(p->programId);
+    MyShaderStuff_SetUniforms(p,resX,resY,globalTime,&cameraMatrix,&light_direction);
+    SceneTexture_SetUniforms(&scene_texture,p);
+    BakedSdf_SetUniforms(&baked_sdf,p);
+    ConePrepass_SetUniforms(&cone_prepass,p);
+    if (p->uLoc_iGBuffer0>=0) glUniform1i(p->uLoc_iGBuffer0,DEFERRED_TEXTURE_UNIT);
+    if (p->uLoc_iGBuffer1>=0) glUniform1i(p->uLoc_iGBuffer1,DEFERRED_TEXTURE_UNIT+1);
+    if (p->uLoc_iGBufferTexel>=0) glUniform4f(p->uLoc_iGBufferTexel,1.f/(float)d->width,1.f/(float)d->height,
+                                              1.f/(float)Deferred_GetOcclusionSamples(d->width),1.f/(float)Deferred_GetOcclusionSamples(d->height));
+    if (p->uLoc_iOcclusion>=0) glUniform1i(p->uLoc_iOcclusion,DEFERRED_OCCLUSION_TEXTURE_UNIT);
+    if (p->uLoc_iOcclusionInfo>=0) glUniform4f(p->uLoc_iOcclusionInfo,(float)deferred_occlusion_divisor,
+                                               (float)Deferred_GetOcclusionSamples(resX),(float)Deferred_GetOcclusionSamples(resY),0.f);
+}
+// Draws the passes of a frame of resX*resY pixels (after the cone pre-pass, if any): the shading pass to frameBuffer.
+// Returns 0 (and draws nothing) when the programs are not ready: the caller draws the frame with progParams then.
+// The program in use is changed
+int Deferred_Draw(Deferred* d,int resX,int resY,float globalTime,GLint frameBuffer) {
+    const int gbufferReady = DerivedProgram_Update(&d->gbuffer);    // (all of them are requested together)
+    const int occlusionReady = !d->occlusion_frame_buffer || DerivedProgram_Update(&d->occlusion);
+    const int shadingReady = DerivedProgram_Update(&d->shading);
+    int i;
+    if (!gbufferReady || !occlusionReady || !shadingReady || !d->width) return 0;
+    glBindFramebuffer(GL_FRAMEBUFFER,d->frame_buffer);
+    glViewport(0,0,resX,resY);
+    Deferred_SetUniforms(d,&d->gbuffer.params,resX,resY,globalTime);
+    ScreenQuadVBO_Draw();
+    for (i=0;i<2;i++) {
+        glActiveTexture(GL_TEXTURE0+DEFERRED_TEXTURE_UNIT+i);
+        glBindTexture(GL_TEXTURE_2D,d->texture[i]);
+    }
+    if (d->occlusion_frame_buffer) {
+        // (iResolution is still resX*resY: the samples are pixels of the G-buffer)
+        glBindFramebuffer(GL_FRAMEBUFFER,d->occlusion_frame_buffer);
+        glViewport(0,0,Deferred_GetOcclusionSamples(resX),Deferred_GetOcclusionSamples(resY));
+        Deferred_SetUniforms(d,&d->occlusion.params,resX,resY,globalTime);
+        ScreenQuadVBO_Draw();
+        glActiveTexture(GL_TEXTURE0+DEFERRED_OCCLUSION_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D,d->occlusion_texture);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER,frameBuffer);
+    glViewport(0,0,resX,resY);
+    Deferred_SetUniforms(d,&d->shading.params,resX,resY,globalTime);
+    ScreenQuadVBO_Draw();
+    for (i=0;i<2;i++) {
+        glActiveTexture(GL_TEXTURE0+DEFERRED_TEXTURE_UNIT+i);
+        glBindTexture(GL_TEXTURE_2D,0);     // (the next G-buffer pass renders to them)
+    }
+    if (d->occlusion_frame_buffer) {
+        glActiveTexture(GL_TEXTURE0+DEFERRED_OCCLUSION_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D,0);
+    }
+    glActiveTexture(GL_TEXTURE0);
     return 1;
 }
 
@@ -500,12 +1886,188 @@ GLuint loadShaderProgramFromSource(const char* vs,const char* fs)	{
 }
 
 GLuint loadShaderProgramFromFile(const char* vspath,const char* fspath) {
-    char vsbuf[40000];
-    char fsbuf[40000];
-    vsbuf[0]='\0';fsbuf[0]='\0';
-    if (!getTextFromFile(vsbuf,40000,vspath) || !getTextFromFile(fsbuf,40000,fspath)) return 0;
+    ShaderSource vs,fs;
+    GLuint programId = 0;
+    ShaderSource_Init(&vs);ShaderSource_Init(&fs);
+    if (ShaderSource_Load(&vs,vspath)==0 && ShaderSource_Load(&fs,fspath)==0) programId = loadShaderProgramFromSource(vs.text,fs.text);
+    ShaderSource_Destroy(&vs);ShaderSource_Destroy(&fs);
+    return programId;
+}
 
-    return loadShaderProgramFromSource(vsbuf,fsbuf);
+void Telemetry_Init(Telemetry* t) {
+    memset(t,0,sizeof(Telemetry));
+    if (!FrameTelemetry_Create(&t->ring,0)) fprintf(stderr,"Telemetry: out of memory\n");
+}
+void Telemetry_Destroy(Telemetry* t) {FrameTelemetry_Destroy(&t->ring);}
+// GL_TIME_ELAPSED and GL_TIMESTAMP queries (GL_ARB_timer_query: core in OpenGL 3.3)
+int HasTimerQueries(void) {
+#   ifndef __EMSCRIPTEN__
+    const char* version = (const char*) glGetString(GL_VERSION);
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+    int major = 0,minor = 0;
+    if (version) sscanf(version,"%d.%d",&major,&minor);
+    return (major>3 || (major==3 && minor>=3) || (extensions && strstr(extensions,"GL_ARB_timer_query"))) ? 1 : 0;
+#   else //__EMSCRIPTEN__
+    return 0;
+#   endif //__EMSCRIPTEN__
+}
+// GL objects (they must be recreated together with the GL context)
+void Telemetry_CreateGL(Telemetry* t) {
+    t->gpu_timer_available = HasTimerQueries();
+    t->pending_begin = t->num_pending = 0;
+#   ifndef __EMSCRIPTEN__
+    if (t->gpu_timer_available) glGenQueries(2*TELEMETRY_NUM_GPU_QUERIES,&t->queries[0][0]);
+#   endif //__EMSCRIPTEN__
+}
+void Telemetry_DestroyGL(Telemetry* t) {
+    // The pending samples are pushed without their GPU time
+    while (t->num_pending>0) {
+        FrameTelemetry_Push(&t->ring,&t->pending[t->pending_begin]);
+        t->pending_begin = (t->pending_begin+1)%TELEMETRY_NUM_GPU_QUERIES;
+        --t->num_pending;
+    }
+#   ifndef __EMSCRIPTEN__
+    if (t->gpu_timer_available) glDeleteQueries(2*TELEMETRY_NUM_GPU_QUERIES,&t->queries[0][0]);
+#   endif //__EMSCRIPTEN__
+    t->gpu_timer_available = 0;
+}
+// Pushes the oldest pending samples whose GPU times are ready (all of them when "wait" is true)
+static void Telemetry_PollGpuQueries(Telemetry* t,int wait) {
+#   ifndef __EMSCRIPTEN__
+    while (t->num_pending>0) {
+        FrameTelemetrySample* s = &t->pending[t->pending_begin];
+        GLuint64 start = 0,end = 0;
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(t->queries[t->pending_begin][1],GL_QUERY_RESULT_AVAILABLE,&available);
+            if (!available) break;
+        }
+        glGetQueryObjectui64v(t->queries[t->pending_begin][0],GL_QUERY_RESULT,&start);
+        glGetQueryObjectui64v(t->queries[t->pending_begin][1],GL_QUERY_RESULT,&end);
+        s->gpu_ns = end>start ? (unsigned long long)(end-start) : 0;
+        FrameTelemetry_Push(&t->ring,s);
+        t->pending_begin = (t->pending_begin+1)%TELEMETRY_NUM_GPU_QUERIES;
+        --t->num_pending;
+    }
+#   endif //__EMSCRIPTEN__
+}
+void Telemetry_BeginFrame(Telemetry* t) {
+    t->prev_frame_start_ns = t->frame_start_ns;
+    t->frame_start_ns = FrameStats_GetTimeNs();
+#   ifndef __EMSCRIPTEN__
+    if (t->gpu_timer_available) {
+        if (t->num_pending==TELEMETRY_NUM_GPU_QUERIES) Telemetry_PollGpuQueries(t,1);  // it shouldn't happen often
+        glQueryCounter(t->queries[(t->pending_begin+t->num_pending)%TELEMETRY_NUM_GPU_QUERIES][0],GL_TIMESTAMP);
+    }
+#   endif //__EMSCRIPTEN__
+}
+void Telemetry_EndFrame(Telemetry* t) {
+    FrameTelemetrySample s;
+    s.frame = t->frame++;
+    s.start_ns = t->frame_start_ns;
+    s.frame_ns = t->prev_frame_start_ns>0 ? t->frame_start_ns-t->prev_frame_start_ns : 0;
+    s.cpu_ns = FrameStats_GetTimeNs()-t->frame_start_ns;
+    s.gpu_ns = 0;
+    if (!t->gpu_timer_available) {FrameTelemetry_Push(&t->ring,&s);return;}
+#   ifndef __EMSCRIPTEN__
+    glQueryCounter(t->queries[(t->pending_begin+t->num_pending)%TELEMETRY_NUM_GPU_QUERIES][1],GL_TIMESTAMP);
+    t->pending[(t->pending_begin+t->num_pending)%TELEMETRY_NUM_GPU_QUERIES] = s;
+    ++t->num_pending;
+    Telemetry_PollGpuQueries(t,0);
+#   endif //__EMSCRIPTEN__
+}
+void Telemetry_SaveCsv(Telemetry* t,const char* filePath) {
+    Telemetry_PollGpuQueries(t,1);
+    if (FrameTelemetry_SaveCsv(&t->ring,filePath)==0) printf("Telemetry saved to: %s\n",filePath);
+    else fprintf(stderr,"Can't save telemetry to: %s\n",filePath);
+}
+
+void DynamicResolution_Init(DynamicResolution* d,float budgetMs) {
+    DynResSettings s;
+    memset(d,0,sizeof(DynamicResolution));
+    DynResSettings_Init(&s,budgetMs);
+    DynResController_Init(&d->controller,&s);
+    DynResTrace_Init(&d->trace);
+    d->last_scale_x = d->last_scale_y = 1.f;
+}
+void DynamicResolution_Destroy(DynamicResolution* d) {DynResTrace_Destroy(&d->trace);}
+void DynamicResolution_CreateGL(DynamicResolution* d) {
+    d->gpu_timer_available = HasTimerQueries();
+    d->pending_begin = d->num_pending = 0;
+    d->last_pass_ns = 0;
+#   ifndef __EMSCRIPTEN__
+    if (d->gpu_timer_available) glGenQueries(TELEMETRY_NUM_GPU_QUERIES,d->queries);
+#   endif //__EMSCRIPTEN__
+}
+void DynamicResolution_DestroyGL(DynamicResolution* d) {
+#   ifndef __EMSCRIPTEN__
+    if (d->gpu_timer_available) glDeleteQueries(TELEMETRY_NUM_GPU_QUERIES,d->queries);
+#   endif //__EMSCRIPTEN__
+    d->gpu_timer_available = 0;
+    d->num_pending = 0;
+}
+// A new measurement of the raycast pass (of frame s->frame)
+static void DynamicResolution_OnMeasurement(DynamicResolution* d,const DynResTraceSample* s) {
+    if (config.dynamic_resolution_enabled) DynResController_Update(&d->controller,s->ms,s->scale_x,s->scale_y);
+    if (d->trace_file) DynResTrace_Add(&d->trace,s);
+}
+static void DynamicResolution_PollGpuQueries(DynamicResolution* d,int wait) {
+#   ifndef __EMSCRIPTEN__
+    while (d->num_pending>0) {
+        DynResTraceSample* s = &d->pending[d->pending_begin];
+        const GLuint query = d->queries[d->pending_begin];
+        GLuint64 elapsed = 0;
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(query,GL_QUERY_RESULT_AVAILABLE,&available);
+            if (!available) break;
+        }
+        glGetQueryObjectui64v(query,GL_QUERY_RESULT,&elapsed);
+        s->ms = (float)((double)elapsed*1.0e-6);
+        DynamicResolution_OnMeasurement(d,s);
+        d->pending_begin = (d->pending_begin+1)%TELEMETRY_NUM_GPU_QUERIES;
+        --d->num_pending;
+    }
+#   endif //__EMSCRIPTEN__
+}
+// Around the raycast pass
+void DynamicResolution_BeginPass(DynamicResolution* d,float scaleX,float scaleY) {
+    DynResTraceSample s;
+    s.frame = d->frame++;
+    s.ms = 0.f;
+    s.scale_x = scaleX;s.scale_y = scaleY;
+    s.budget_ms = d->controller.settings.budget_ms;
+    if (!d->gpu_timer_available) {
+        // Fallback: the time between two passes (this includes everything, v-sync too) is the measurement of the previous pass
+        const unsigned long long now = FrameStats_GetTimeNs();
+        if (d->last_pass_ns>0) {
+            s.ms = (float)((double)(now-d->last_pass_ns)*1.0e-6);
+            s.scale_x = d->last_scale_x;s.scale_y = d->last_scale_y;
+            DynamicResolution_OnMeasurement(d,&s);
+        }
+        d->last_pass_ns = now;
+        d->last_scale_x = scaleX;d->last_scale_y = scaleY;
+        return;
+    }
+#   ifndef __EMSCRIPTEN__
+    if (d->num_pending==TELEMETRY_NUM_GPU_QUERIES) DynamicResolution_PollGpuQueries(d,1);
+    d->pending[(d->pending_begin+d->num_pending)%TELEMETRY_NUM_GPU_QUERIES] = s;
+    glBeginQuery(GL_TIME_ELAPSED,d->queries[(d->pending_begin+d->num_pending)%TELEMETRY_NUM_GPU_QUERIES]);
+#   endif //__EMSCRIPTEN__
+}
+void DynamicResolution_EndPass(DynamicResolution* d) {
+    if (!d->gpu_timer_available) return;
+#   ifndef __EMSCRIPTEN__
+    glEndQuery(GL_TIME_ELAPSED);
+    ++d->num_pending;
+    DynamicResolution_PollGpuQueries(d,0);
+#   endif //__EMSCRIPTEN__
+}
+void DynamicResolution_SaveTrace(DynamicResolution* d) {
+    if (!d->trace_file) return;
+    DynamicResolution_PollGpuQueries(d,1);
+    if (DynResTrace_Save(&d->trace,d->trace_file)==0) printf("Dynamic resolution trace saved to: %s (%d frames)\n",d->trace_file,d->trace.num_samples);
+    else fprintf(stderr,"Can't save dynamic resolution trace to: %s\n",d->trace_file);
 }
 
 void ResizeGL(int w,int h) {
@@ -515,6 +2077,11 @@ void ResizeGL(int w,int h) {
 
         // Warning when using inside DrawGL(): this method binds and unbinds a shader program (unlike the other similiar one)
         MyShaderStuff_SetProjectionUniforms(&progParams,nearPlane,farPlane,degFov,(float)w/(float)h);
+        MyShaderStuff_SetProjectionUniforms(&cone_prepass.program.params,nearPlane,farPlane,degFov,(float)w/(float)h);
+        MyShaderStuff_SetProjectionUniforms(&temporal_depth.program.params,nearPlane,farPlane,degFov,(float)w/(float)h);
+        MyShaderStuff_SetProjectionUniforms(&deferred.gbuffer.params,nearPlane,farPlane,degFov,(float)w/(float)h);
+        MyShaderStuff_SetProjectionUniforms(&deferred.occlusion.params,nearPlane,farPlane,degFov,(float)w/(float)h);
+        MyShaderStuff_SetProjectionUniforms(&deferred.shading.params,nearPlane,farPlane,degFov,(float)w/(float)h);
 
 #       ifdef WRITE_DEPTH_VALUE
         Teapot_SetProjectionMatrix(pMatrix.v);
@@ -522,6 +2089,9 @@ void ResizeGL(int w,int h) {
     }
 
     if (h>0) RenderTarget_Init(&render_target,w,h);
+    ConePrepass_Resize(&cone_prepass,w,h);
+    TemporalDepth_Resize(&temporal_depth,w,h);
+    Deferred_Resize(&deferred,w,h);
 
     if (w>0 && h>0 && !config.fullscreen_enabled) {
         config.windowed_width=w;
@@ -536,9 +2106,18 @@ void ResizeGL(int w,int h) {
 
 void InitGL(void) {
     glEnable(GL_TEXTURE_2D);
-    MyShaderStuff_Create(&progParams);
+    startup.init_gl_ns = FrameStats_GetTimeNs();
+    startup.waiting_first_frame = 1;
+    SceneTexture_CreateGL(&scene_texture);  // (before the first program: it resets scene_mode when float textures are not supported)
+    BakedSdf_CreateGL(&baked_sdf);          // (the same for baked_sdf_enabled)
+    if (deferred_enabled) Deferred_CreateGL(&deferred);    // (the same for deferred_enabled)
+    if (temporal_depth_fraction>0.f && !deferred_enabled) TemporalDepth_CreateGL(&temporal_depth);  // (the same for temporal_depth_fraction)
+    if (LoadSceneShaderSources(&shader_cache)) SetQualityTier(config.quality_tier);
     RenderTarget_Create(&render_target);
     ScreenQuadVBO_Init();
+    Telemetry_CreateGL(&telemetry);
+    DynamicResolution_CreateGL(&dynamic_resolution);
+    if (cone_prepass_tile>0) ConePrepass_CreateGL(&cone_prepass);
 
 #   ifdef WRITE_DEPTH_VALUE
     Teapot_Init();
@@ -560,9 +2139,21 @@ void DestroyGL() {
 #   ifdef WRITE_DEPTH_VALUE
     Teapot_Destroy();
 #   endif //WRITE_DEPTH_VALUE
+    ConePrepass_DestroyGL(&cone_prepass);
+    TemporalDepth_DestroyGL(&temporal_depth);
+    Deferred_DestroyGL(&deferred);
+    DynamicResolution_DestroyGL(&dynamic_resolution);
+    Telemetry_DestroyGL(&telemetry);
     ScreenQuadVBO_Destroy();
     RenderTarget_Destroy(&render_target);
+    SceneTexture_DestroyGL(&scene_texture);
+    BakedSdf_DestroyGL(&baked_sdf);
     MyShaderStuff_Destroy(&progParams);
+#   ifndef __EMSCRIPTEN__
+    ShaderHotReload_Cancel(&shader_hot_reload);
+#   endif //__EMSCRIPTEN__
+    ShaderProgramCache_Clear(&shader_cache);
+    shown_quality_tier = pending_quality_tier = -1;
 }
 
 #ifndef NO_FIXED_FUNCTION_PIPELINE
@@ -571,8 +2162,8 @@ void DrawGlutText(int x, int y, char *string);
 
 void DrawGL(void) 
 {	
-    static char tmp[64] = "";
-    static float resolution_factor = 1.0f;
+    static char tmp[160] = "";
+    float resolution_factor_x,resolution_factor_y;
     static int frame = 0;
     static unsigned begin = 0;
     static unsigned cur_time = 0;
@@ -581,12 +2172,21 @@ void DrawGL(void)
     static int render_target_index = 0;
     static unsigned cameraMatrixSlerpTimerBegin = 0;
     int render_target_index2 = 0;
+    // (USE_TEMPORAL_DEPTH writes the hit distances to the render targets: they're used without dynamic resolution too)
+    const int temporal = TemporalDepth_IsUsed() && progParams.uLoc_iTemporalDepthInfo>=0;
+    const int use_render_targets = config.dynamic_resolution_enabled || temporal;
+    int resX,resY;
     unsigned elapsed_time,delta_time;
     if (begin==0) begin = glutGet(GLUT_ELAPSED_TIME);
     elapsed_time = glutGet(GLUT_ELAPSED_TIME) - begin;
     delta_time = elapsed_time - cur_time;
     cur_time = elapsed_time;
 
+    if (benchmark.enabled) {
+        // The camera and the light follow the script: the time doesn't depend on the frame rate
+        CameraPath_Evaluate(&benchmark.path,(float)benchmark.frame*benchmark.time_step,&cameraMatrix,&light_direction);
+        elapsed_time = (unsigned)((float)benchmark.frame*benchmark.time_step*1000.f);
+    }
 
 #   ifdef WRITE_DEPTH_VALUE
     // The modelview matrix is the inverse of the camera matrix
@@ -598,7 +2198,7 @@ void DrawGL(void)
 #   endif //WRITE_DEPTH_VALUE
 
 
-    if (cameraMatrixSlerpTimer<1.f)	{
+    if (!benchmark.enabled && cameraMatrixSlerpTimer<1.f)	{
         if (cameraMatrixSlerpTimerBegin==0) cameraMatrixSlerpTimerBegin = glutGet(GLUT_ELAPSED_TIME);
         cameraMatrixSlerpTimer = (float)(glutGet(GLUT_ELAPSED_TIME) - cameraMatrixSlerpTimerBegin)*0.0001f*cameraMatrixSlerpTimerSpeed;
         if (cameraMatrixSlerpTimer>1.f) {
@@ -613,21 +2213,38 @@ void DrawGL(void)
 
     // Render to framebuffer---------------------------------------------------------------------------------------
     if (config.dynamic_resolution_enabled)	{
-        render_target.resolution_factor[render_target_index] = resolution_factor;
-        glViewport(0, 0, (int)(render_target.width * resolution_factor),(int) (render_target.height * resolution_factor));
+        resolution_factor_x = dynamic_resolution.controller.scale_x;
+        resolution_factor_y = dynamic_resolution.controller.scale_y;
+        render_target.resolution_factor[render_target_index][0] = resolution_factor_x;
+        render_target.resolution_factor[render_target_index][1] = resolution_factor_y;
+    }
+    else {
+        resolution_factor_x = resolution_factor_y = 1.f;
+        render_target.resolution_factor[render_target_index][0] = render_target.resolution_factor[render_target_index][1] = 1.f;
+    }
+    resX = (int)(render_target.width * resolution_factor_x);
+    resY = (int)(render_target.height * resolution_factor_y);
+    glViewport(0, 0, resX, resY);
+    if (use_render_targets) {
         glBindFramebuffer(GL_FRAMEBUFFER, render_target.frame_buffer[render_target_index]); //NUM_RENDER_TARGETS
+        TemporalDepth_SetDrawBuffers(&temporal_depth,temporal);
     }
-    else glViewport(0, 0, render_target.width, render_target.height);
 
     //Using the raycast shader
     glUseProgram(progParams.programId);
     MyShaderStuff_SetUniforms(&progParams,
-                              render_target.width *  (config.dynamic_resolution_enabled ? resolution_factor : 1.0f),
-                              render_target.height * (config.dynamic_resolution_enabled ? resolution_factor : 1.0f),
+                              resX,
+                              resY,
                               (float)elapsed_time/1000.f,
                               &cameraMatrix,
                               &light_direction
                               );
+    if (SceneMode_UsesTexture(scene_mode) && animate_scene) SceneTexture_Animate(&scene_texture,(float)elapsed_time/1000.f);
+    SceneTexture_Update(&scene_texture);    // (the current program can still be the other variant, while the new one is built)
+    SceneTexture_SetUniforms(&scene_texture,&progParams);
+    BakedSdf_Update(&baked_sdf);
+    BakedSdf_SetUniforms(&baked_sdf,&progParams);
+    ConePrepass_SetUniforms(&cone_prepass,&progParams);
 #   ifdef WRITE_DEPTH_VALUE
     glEnable(GL_DEPTH_TEST);    // For some odd reasons gl_FragDepth (in shader) seems to work only with GL_DEPTH_TEST enabled
     glDepthFunc(GL_ALWAYS);     // Always pass GL_DEPTH_TEST
@@ -635,7 +2252,26 @@ void DrawGL(void)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Mandatory (at least GL_DEPTH_BUFFER_BIT)
 #   endif //WRITE_DEPTH_VALUE
 
-    ScreenQuadVBO_Draw();    // Draw the spherecast scene
+    DynamicResolution_BeginPass(&dynamic_resolution,resolution_factor_x,resolution_factor_y);
+    if (cone_prepass_tile>0 && progParams.uLoc_iConePrepass>=0) {
+        // (measured with the raycast pass: it's part of its cost)
+        ConePrepass_Draw(&cone_prepass,resX,resY,(float)elapsed_time/1000.f,
+                         use_render_targets ? (GLint)render_target.frame_buffer[render_target_index] : render_target.default_frame_buffer);
+        glUseProgram(progParams.programId);
+    }
+    if (temporal) {
+        // (the reduction of the previous frame is measured with the raycast pass too)
+        TemporalDepth_Draw(&temporal_depth,resX,resY,(GLint)render_target.frame_buffer[render_target_index]);
+        glUseProgram(progParams.programId);
+        TemporalDepth_SetUniforms(&temporal_depth,&progParams);
+    }
+    if (!deferred_enabled || !Deferred_Draw(&deferred,resX,resY,(float)elapsed_time/1000.f,
+                                            use_render_targets ? (GLint)render_target.frame_buffer[render_target_index] : render_target.default_frame_buffer)) {
+        glUseProgram(progParams.programId);     // (Deferred_Draw(...) can change it before failing)
+        ScreenQuadVBO_Draw();    // Draw the spherecast scene
+    }
+    DynamicResolution_EndPass(&dynamic_resolution);
+    TemporalDepth_EndFrame(&temporal_depth,render_target_index,temporal,resX,resY,&cameraMatrix);
     //glUseProgram(0);
 
 
@@ -645,6 +2281,7 @@ void DrawGL(void)
     glDepthFunc(GL_LESS);    // default value
     glDepthMask(GL_TRUE);    // Write depth values of teapot
     glEnable(GL_CULL_FACE);  // Don't draw back faces of teapot
+    if (temporal) TemporalDepth_SetDrawBuffers(&temporal_depth,0);    // (the meshes are not in the hit distances)
     {
     Teapot_PreDraw();
 
@@ -701,16 +2338,19 @@ void DrawGL(void)
 #   endif //WRITE_DEPTH_VALUE
 
 
-    if (config.dynamic_resolution_enabled)
+    if (use_render_targets)
         glBindFramebuffer(GL_FRAMEBUFFER,render_target.default_frame_buffer);
     //-------------------------------------------------------------------------------------------------------------
 
-    // Draw to screen at resolution_factor: render_target.resolution_factor[render_target_index2]------------------
-    if (config.dynamic_resolution_enabled)	{
+    // Draw to screen at render_target.resolution_factor[render_target_index2]-------------------------------------
+    if (use_render_targets)	{
         glViewport(0, 0, render_target.width, render_target.height);
         //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        render_target_index2 = render_target_index + 1;
-        if (render_target_index2>=NUM_RENDER_TARGETS) render_target_index2-=NUM_RENDER_TARGETS;
+        render_target_index2 = render_target_index;
+        if (config.dynamic_resolution_enabled) {
+            render_target_index2 = render_target_index + 1;
+            if (render_target_index2>=NUM_RENDER_TARGETS) render_target_index2-=NUM_RENDER_TARGETS;
+        }
 
         //printf("%d - %d\n",render_target_index,render_target_index2);
         glActiveTexture(GL_TEXTURE0);
@@ -718,7 +2358,7 @@ void DrawGL(void)
 
         glUseProgram(render_target.screenQuadProgramId);
         glUniform1i(render_target.uLoc_SDiffuse,0);
-        glUniform3f(render_target.uLoc_screenResAndFactor,render_target.width,render_target.height,render_target.resolution_factor[render_target_index2]);
+        glUniform4f(render_target.uLoc_screenResAndFactor,render_target.width,render_target.height,render_target.resolution_factor[render_target_index2][0],render_target.resolution_factor[render_target_index2][1]);
         ScreenQuadVBO_Draw();
 
         //glUseProgram(0);
@@ -733,33 +2373,22 @@ void DrawGL(void)
     if (config.show_fps) DrawGlutText(20,(int) (render_target.height-20), tmp);
 #	endif
 
-    // Do FPS count and adjust resolution_factor
+    // Do FPS count (the resolution is adjusted by DynamicResolution every frame)
     ++frame;
     if (++render_target_index>=NUM_RENDER_TARGETS) render_target_index=0;
     display_fps_time+=delta_time;
     ++delta_frames;
     if (display_fps_time>2000 && delta_frames>0) {
-        const float FPS_TARGET = (float) config.dynamic_resolution_target_fps;
+        FrameStatsSummary frameMs,gpuMs;
+        FrameTelemetry_GetRollingStats(&telemetry.ring,(int)delta_frames,&frameMs,NULL,&gpuMs);  // the FPS average hides stutter
         FPS = delta_frames*1000/display_fps_time;
         display_fps_time = 0;
         delta_frames = 0;
-        if (config.dynamic_resolution_enabled)
-        {
-            if (FPS<FPS_TARGET) {
-                resolution_factor-= resolution_factor*(FPS_TARGET-FPS)*0.0175f;
-                if (resolution_factor<0.15f) resolution_factor=0.15f;
-            }
-            else {
-                resolution_factor+= resolution_factor*(FPS-FPS_TARGET)*0.0175f;
-                if (resolution_factor>1.0f) resolution_factor=1.0f;
-            }
-        }
-        else resolution_factor=1.f;
-        sprintf(tmp,"FPS: %u DYN-RES:%s DRF=%1.3f (%dx%d %s)",FPS,config.dynamic_resolution_enabled ? "ON " : "OFF",resolution_factor,render_target.width,render_target.height,windowId ? "windowed" : "fullscreen");
+        sprintf(tmp,"FPS: %u (%1.2f ms p99: %1.2f ms GPU: %1.2f ms) DYN-RES:%s DRF=%1.3fx%1.3f (%dx%d %s)",FPS,frameMs.median,frameMs.p99,gpuMs.median,config.dynamic_resolution_enabled ? "ON " : "OFF",resolution_factor_x,resolution_factor_y,render_target.width,render_target.height,windowId ? "windowed" : "fullscreen");
 #		ifdef NO_FIXED_FUNCTION_PIPELINE
         if (config.show_fps)	{
             //glutSetWindowTitle(tmp);
-            printf("FPS: %u DYN-RES:%s DRF=%1.3f (%dx%d %s)\n",FPS,config.dynamic_resolution_enabled ? "ON " : "OFF",resolution_factor,render_target.width,render_target.height,windowId ? "windowed" : "fullscreen");
+            printf("%s\n",tmp);
             config.show_fps=0;
         }
 #		endif //NO_FIXED_FUNCTION_PIPELINE
@@ -811,7 +2440,9 @@ static void GlutCreateWindow();
 
 void GlutCloseWindow(void)  {
 #ifndef __EMSCRIPTEN__
-Config_Save(&config,ConfigFileName);
+if (!benchmark.enabled) Config_Save(&config,ConfigFileName);
+if (telemetry.csv_file) Telemetry_SaveCsv(&telemetry,telemetry.csv_file);
+DynamicResolution_SaveTrace(&dynamic_resolution);
 #endif //__EMSCRIPTEN__
 }
 
@@ -820,7 +2451,9 @@ void GlutNormalKeys(unsigned char key, int x, int y) {
     switch (key) {
 #	ifndef __EMSCRIPTEN__	
     case 27: 	// esc key
-        Config_Save(&config,ConfigFileName);
+        if (!benchmark.enabled) Config_Save(&config,ConfigFileName);
+        if (telemetry.csv_file) Telemetry_SaveCsv(&telemetry,telemetry.csv_file);
+        DynamicResolution_SaveTrace(&dynamic_resolution);
         GlutDestroyWindow();
 #		ifdef __FREEGLUT_STD_H__
         glutLeaveMainLoop();
@@ -830,7 +2463,7 @@ void GlutNormalKeys(unsigned char key, int x, int y) {
         break;
     case 13:	// return key
     {
-        if (mod&GLUT_ACTIVE_CTRL) {
+        if (mod&GLUT_ACTIVE_CTRL && !benchmark.enabled) {
             config.fullscreen_enabled = gameModeWindowId ? 0 : 1;
             GlutDestroyWindow();
             GlutCreateWindow();
@@ -919,6 +2552,8 @@ void GlutSpecialKeys(int key,int x,int y)
     //  But main problem here is that FPS is sampled every two seconds, and even with dynamic resolution on,
     //  it's not stable at all on my system... But I guess that on good GPUs it's stable enough..
 
+    if (benchmark.enabled) return;  // The camera script can't be changed
+
     if (!(mod&GLUT_ACTIVE_CTRL) && !(mod&GLUT_ACTIVE_SHIFT))	{
         switch (key) {
         case GLUT_KEY_LEFT:
@@ -936,6 +2571,7 @@ void GlutSpecialKeys(int key,int x,int y)
         case GLUT_KEY_F1:
         {
             config.dynamic_resolution_enabled = !config.dynamic_resolution_enabled;
+            DynResController_Reset(&dynamic_resolution.controller);
             printf("dynamic_resolution_enabled: %s.\n",config.dynamic_resolution_enabled?"ON":"OFF");
         }
             break;
@@ -947,6 +2583,28 @@ void GlutSpecialKeys(int key,int x,int y)
 #           endif
         }
             break;
+#       ifndef __EMSCRIPTEN__
+        case GLUT_KEY_F3:
+            Telemetry_SaveCsv(&telemetry,telemetry.csv_file ? telemetry.csv_file : TelemetryDefaultCsvFile);
+            break;
+#       endif //__EMSCRIPTEN__
+        case GLUT_KEY_F4:
+            if (SetQualityTier((config.quality_tier+1)%NUM_QUALITY_TIERS)) printf("Quality tier: %s.\n",QualityTiers[config.quality_tier].name);
+            break;
+        case GLUT_KEY_F5:
+            scene_mode = (scene_mode+1)%SCENE_MODE_COUNT;
+            if (SceneMode_UsesTexture(scene_mode) && !scene_texture.texture) {
+                printf("Data-driven scene: not supported (no float textures).\n");
+                while (SceneMode_UsesTexture(scene_mode)) scene_mode = (scene_mode+1)%SCENE_MODE_COUNT;
+            }
+            if (SetQualityTier(config.quality_tier)) printf("Scene: %s.\n",SceneModeNames[scene_mode]);
+            break;
+        case GLUT_KEY_F6:
+            if (!baked_sdf.texture) {printf("Baked distance field: not supported (no float textures).\n");break;}
+            baked_sdf_enabled = !baked_sdf_enabled;
+            if (SetQualityTier(config.quality_tier)) printf("Baked distance field: %s%s.\n",baked_sdf_enabled?"ON":"OFF",
+                (baked_sdf_enabled && !BakedSdf_IsUsed()) ? " (not used with the animated scene)" : "");
+            break;
         }
     }
     else if (mod&GLUT_ACTIVE_CTRL) {
@@ -997,7 +2655,54 @@ void GlutMouse(int a,int b,int c,int d) {
 
 
 
-static void GlutDrawGL(void)		{DrawGL();glutSwapBuffers();}
+// Called after every glutSwapBuffers() in benchmark mode
+static void Benchmark_OnFrameEnd(Benchmark* b) {
+    unsigned long long now;
+    glFinish();     // we measure what the GPU does too
+    now = FrameStats_GetTimeNs();
+    if (pending_quality_tier>=0) {b->last_frame_end_ns = now;return;}   // the frames drawn with the placeholder don't count
+    if (b->frame==b->num_warmup_frames) b->start_ns = b->last_frame_end_ns;
+    if (b->frame>=b->num_warmup_frames) b->frame_times_ms[b->frame-b->num_warmup_frames] = (double)(now-b->last_frame_end_ns)*1.0e-6;
+    b->last_frame_end_ns = now;
+    if (++b->frame==b->num_warmup_frames+b->num_frames) {
+        Telemetry_PollGpuQueries(&telemetry,1);
+        Benchmark_WriteResults(b,render_target.width,render_target.height);
+        if (telemetry.csv_file) Telemetry_SaveCsv(&telemetry,telemetry.csv_file);
+        DynamicResolution_SaveTrace(&dynamic_resolution);
+        Benchmark_Destroy(b);
+        GlutDestroyWindow();
+#       ifdef __FREEGLUT_STD_H__
+        glutLeaveMainLoop();
+#       else
+        exit(0);
+#       endif
+    }
+}
+static void GlutDrawGL(void)		{
+    Telemetry_BeginFrame(&telemetry);
+    PollQualityTier(0);
+#   ifndef __EMSCRIPTEN__
+    ShaderHotReload_Update(&shader_hot_reload);
+#   endif //__EMSCRIPTEN__
+    DrawGL();
+    Telemetry_EndFrame(&telemetry);
+    glutSwapBuffers();
+    if (startup.waiting_first_frame) {
+        const unsigned long long now = FrameStats_GetTimeNs();
+        startup.waiting_first_frame = 0;
+        if (!startup.first_frame_ns) {
+            startup.first_frame_ns = now;
+            printf("Startup: first frame after %1.1f ms.\n",(double)(now-startup.main_ns)*1.0e-6);
+        }
+        else printf("GL context recreated: first frame after %1.1f ms.\n",(double)(now-startup.init_gl_ns)*1.0e-6);
+    }
+    if (!startup.full_quality_ns && pending_quality_tier<0 && shown_quality_tier==config.quality_tier) {
+        startup.full_quality_ns = FrameStats_GetTimeNs();
+        printf("Startup: first frame with quality tier \"%s\" after %1.1f ms (shader: %1.1f ms, program cache: %s).\n",QualityTiers[shown_quality_tier].name,
+               (double)(startup.full_quality_ns-startup.main_ns)*1.0e-6,startup.shader_ms,startup.program_cache);
+    }
+    if (benchmark.enabled) Benchmark_OnFrameEnd(&benchmark);
+}
 static void GlutIdle(void)			{glutPostRedisplay();}
 static void GlutFakeDrawGL(void) 	{glutDisplayFunc(GlutDrawGL);}
 void GlutDestroyWindow(void) {
@@ -1071,8 +2776,103 @@ void GlutCreateWindow() {
 }
 
 
+void PrintUsage(void) {
+    printf("Options:\n");
+    printf("  --telemetry <file.csv>  saves the timings of the last %d frames on exit (F3 saves them at any time)\n",FRAME_TELEMETRY_DEFAULT_CAPACITY);
+    printf("  --quality <tier>        low, medium, high or ultra (default: the one in the config file)\n");
+    printf("  --dynres-trace <file.csv> saves the GPU times of the raycast pass on exit (they can be replayed with \"make dynres_replay\")\n");
+    printf("  --program-cache <dir>   on-disk cache of the compiled shader programs (default: %s)\n",ProgramCacheDirectory);
+    printf("  --no-program-cache      always compiles the shader programs\n");
+    printf("  --scene <name>          built-in, texture (map() interprets a primitive list stored in a texture), bvh (the same\n");
+    printf("                          through a bounding volume hierarchy), grid (the same through a uniform grid) or compiled\n");
+    printf("                          (the map() generated by \"make compiled_scene\") (F5 switches them at runtime)\n");
+    printf("  --scene-file <file>     scene file used by \"--scene texture|bvh|grid\" (default: the built-in scene, animated)\n");
+    printf("  --scene-random <count>  the same with a random scene of count primitives\n");
+    printf("  --baked-sdf <resolution> castRay() steps through the distance field of the scene baked by the CPU, far from\n");
+    printf("                          the surfaces (resolution = samples along the longest axis, e.g. 128; F6 toggles it)\n");
+    printf("  --brick-map <KB>        the same with a sparse brick map (only the bricks near the surfaces, around the camera)\n");
+    printf("                          within an atlas of KB kilobytes (e.g. 4096)\n");
+    printf("  --over-relaxation <omega> over-relaxed sphere tracing in castRay() (omega in (1,2), e.g. 1.2): fewer steps per ray\n");
+    printf("  --cone-prepass <tile>   castRay() starts from the distance reached by a cone per tile of tile*tile pixels (e.g. 8 or 16),\n");
+    printf("                          marched by a low-resolution pass before the raycast pass\n");
+    printf("  --temporal-depth <fraction> castRay() starts from this fraction (e.g. 0.9) of the hit distance of the previous frame\n");
+    printf("                          reprojected to the current one, where it's still empty (static scenes only)\n");
+    printf("  --deferred              two passes: castRay() and calcNormal() write a G-buffer, then a shading pass reads it\n");
+    printf("                          (AO, soft shadows and lighting): one sample per pixel, no --temporal-depth\n");
+    printf("  --deferred-occlusion <divisor> the same (--deferred) with AO and soft shadows computed at 1/divisor of the\n");
+    printf("                          resolution (2 or 4), then upsampled by a depth and normal-aware filter\n");
+#   ifndef __EMSCRIPTEN__
+    printf("  --no-hot-reload         doesn't watch \"%s\" for changes\n",SceneShaderFileName);
+#   endif //__EMSCRIPTEN__
+    Benchmark_PrintUsage();
+}
+// returns 0 on failure
+int ParseCommandLine(int argc,char** argv) {
+    int i;
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (strcmp(arg,"--benchmark")==0) {benchmark.enabled = 1;continue;}
+        if (strcmp(arg,"--no-program-cache")==0) {ProgramCacheDirectory = NULL;continue;}
+        if (strcmp(arg,"--no-hot-reload")==0) {hot_reload_enabled = 0;continue;}
+        if (strcmp(arg,"--deferred")==0) {deferred_enabled = 1;continue;}
+        if (strcmp(arg,"--help")==0) return 0;
+        if (!val) {fprintf(stderr,"Missing value for: %s\n",arg);return 0;}
+        if (strcmp(arg,"--telemetry")==0) telemetry.csv_file = val;
+        else if (strcmp(arg,"--quality")==0) {
+            config.quality_tier = QualityTier_FindByName(val);
+            if (config.quality_tier<0) {fprintf(stderr,"Unknown quality tier: %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"--dynres-trace")==0) dynamic_resolution.trace_file = val;
+        else if (strcmp(arg,"--program-cache")==0) ProgramCacheDirectory = val;
+        else if (strcmp(arg,"--scene")==0) {
+            for (scene_mode=0;scene_mode<SCENE_MODE_COUNT;scene_mode++) {if (strcmp(val,SceneModeNames[scene_mode])==0) break;}
+            if (scene_mode==SCENE_MODE_COUNT) {fprintf(stderr,"Unknown scene: %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"--scene-file")==0) {
+            if (SdfScene_Load(&scene_texture.scene,val)!=0) {fprintf(stderr,"Can't load the scene file: %s\n",val);return 0;}
+            animate_scene = 0;
+        }
+        else if (strcmp(arg,"--scene-random")==0) {
+            if (atoi(val)<=0 || !SdfScene_SetRandom(&scene_texture.scene,atoi(val),1)) {fprintf(stderr,"Invalid random scene: %s\n",val);return 0;}
+            animate_scene = 0;
+        }
+        else if (strcmp(arg,"--baked-sdf")==0) {
+            baked_sdf_resolution = atoi(val);
+            if (baked_sdf_resolution<2) {fprintf(stderr,"Invalid baked distance field resolution: %s\n",val);return 0;}
+            baked_sdf_enabled = 1;
+        }
+        else if (strcmp(arg,"--brick-map")==0) {
+            baked_sdf_brick_map_kb = atoi(val);
+            if (baked_sdf_brick_map_kb<=0) {fprintf(stderr,"Invalid brick map budget: %s\n",val);return 0;}
+            baked_sdf_enabled = 1;
+        }
+        else if (strcmp(arg,"--over-relaxation")==0) {
+            raycast_over_relaxation = (float) atof(val);
+            if (raycast_over_relaxation<1.f || raycast_over_relaxation>=2.f) {fprintf(stderr,"Invalid over-relaxation (omega in [1,2)): %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"--cone-prepass")==0) {
+            cone_prepass_tile = atoi(val);
+            if (cone_prepass_tile<=0) {fprintf(stderr,"Invalid cone pre-pass tile size: %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"--temporal-depth")==0) {
+            temporal_depth_fraction = (float) atof(val);
+            if (temporal_depth_fraction<=0.f || temporal_depth_fraction>1.f) {fprintf(stderr,"Invalid temporal depth fraction (in (0,1]): %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"--deferred-occlusion")==0) {
+            deferred_occlusion_divisor = atoi(val);
+            if (deferred_occlusion_divisor<1 || deferred_occlusion_divisor>8) {fprintf(stderr,"Invalid occlusion divisor (in [1,8]): %s\n",val);return 0;}
+            deferred_enabled = 1;
+        }
+        else if (!Benchmark_ParseArg(&benchmark,arg,val)) {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        ++i;
+    }
+    return 1;
+}
+
 int main(int argc, char** argv)
 {
+    startup.main_ns = FrameStats_GetTimeNs();
 
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);	// GLUT_ALPHA
@@ -1088,7 +2888,38 @@ int main(int argc, char** argv)
     Config_Load(&config,ConfigFileName);
 #endif //__EMSCRIPTEN__
 
+    Benchmark_Init(&benchmark);
+    Telemetry_Init(&telemetry);
+    DynamicResolution_Init(&dynamic_resolution,Config_GetDynamicResolutionBudgetMs(&config));
+    ShaderProgramCache_Init(&shader_cache);
+    SceneTexture_Init(&scene_texture);
+    BakedSdf_Init(&baked_sdf);
+    if (!ParseCommandLine(argc,argv) || !Benchmark_Prepare(&benchmark)) {
+        PrintUsage();
+        SceneTexture_Destroy(&scene_texture);
+        BakedSdf_Destroy(&baked_sdf);
+        Benchmark_Destroy(&benchmark);
+        Telemetry_Destroy(&telemetry);
+        DynamicResolution_Destroy(&dynamic_resolution);
+        return 1;
+    }
+    if (benchmark.enabled) {
+        // These settings are not saved
+        config.fullscreen_enabled = 0;
+        config.windowed_width = benchmark.width;
+        config.windowed_height = benchmark.height;
+        config.dynamic_resolution_enabled = 0;
+        config.show_fps = 0;
+    }
+#   ifndef __EMSCRIPTEN__
+    if (ProgramCacheDirectory && !ShaderProgramCache_SetBinaryDirectory(&shader_cache,ProgramCacheDirectory)) fprintf(stderr,"Out of memory\n");
+    ShaderHotReload_Init(&shader_hot_reload);
+#   endif //__EMSCRIPTEN__
+
     GlutCreateWindow();
+#   ifndef __EMSCRIPTEN__
+    if (hot_reload_enabled && !benchmark.enabled) ShaderHotReload_Start(&shader_hot_reload);    // (after the sources have been loaded, to watch their #include files too)
+#   endif //__EMSCRIPTEN__
 
     //OpenGL info
     printf("\nGL Vendor: %s\n", glGetString( GL_VENDOR ));
@@ -1109,7 +2940,14 @@ int main(int argc, char** argv)
 #   else //NO_FIXED_FUNCTION_PIPELINE
     printf("F2:\t\t\t\tdisplay FPS\n");
 #   endif //NO_FIXED_FUNCTION_PIPELINE
+#	ifndef __EMSCRIPTEN__
+    printf("F3:\t\t\t\tsave frame time telemetry (CSV)\n");
+#	endif //__EMSCRIPTEN__
+    printf("F4:\t\t\t\tnext quality tier\n");
+    printf("F5:\t\t\t\tcycle the scene: built-in, data-driven (texture, animated), data-driven with BVH, with grid, compiled\n");
+    printf("F6:\t\t\t\ttoggle the baked distance field on/off (static scenes only)\n");
     printf("\n");
+    if (benchmark.enabled) fprintf(stderr,"Benchmark: %d warmup frames + %d measured frames (keys are disabled)\n",benchmark.num_warmup_frames,benchmark.num_frames);
 
 
 
@@ -1122,6 +2960,7 @@ int main(int argc, char** argv)
     light_direction = v3_norm(vec3(-0.4, 0.7, -0.6));
 //------------------------------------------------------------------------
 
+    benchmark.last_frame_end_ns = FrameStats_GetTimeNs();
     glutMainLoop();
 
 
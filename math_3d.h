@@ -83,6 +83,18 @@ Ported code back to --std=gnu89 [Basically ansi C with single line comments allo
 #include <math.h>
 #include <stdio.h>
 
+// SIMD instruction sets used by the wide (SoA) vector types (see below)
+#ifndef MATH_3D_NO_SIMD
+#	if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=1)
+#		define MATH_3D_SSE
+#		include <xmmintrin.h>
+#	endif
+#	ifdef __AVX__
+#		define MATH_3D_AVX
+#		include <immintrin.h>
+#	endif
+#endif //MATH_3D_NO_SIMD
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -784,6 +796,177 @@ static __inline mat4_t m4_invert_fast(mat4_t matrix)	{
 	return inv;
 }
 
+//
+// Wide (structure-of-arrays) vectors
+//
+// `floatx4_t` and `floatx8_t` hold 4 and 8 floats (one per lane), `maskx4_t`
+// and `maskx8_t` the result of lane-wise comparisons (all bits set in the
+// lanes where the comparison is true) and `vec3x4_t` and `vec3x8_t` 4 and 8
+// vectors in SoA layout (all the x values, then all the y and all the z). They
+// are meant for code that processes many vectors (or rays) at once, like the
+// camera rays of the CPU renderer (cr_rayDirections() in cpu_renderer.h).
+//
+// Functions start with the `f4_`/`f8_`, `mk4_`/`mk8_` and `v3x4_`/`v3x8_`
+// prefixes and mirror the `v3_` ones. Only the operations that code needs are
+// here so far: add the others (min, max, cross, ...) the same way when needed.
+//
+// The 4 lane types use SSE and the 8 lane types AVX when the compiler targets
+// them (e.g. -msse2 (default on x86_64) or -mavx). Otherwise, or when
+// MATH_3D_NO_SIMD is defined, they fall back to plain loops over the lanes,
+// so the results (and the code using them) are the same everywhere.
+//
+
+#ifdef MATH_3D_SSE
+typedef union {__m128 m;float v[4];} floatx4_t;
+typedef union {__m128 m;unsigned int v[4];} maskx4_t;
+#else
+typedef union {float v[4];} floatx4_t;
+typedef union {unsigned int v[4];} maskx4_t;
+#endif
+#ifdef MATH_3D_AVX
+typedef union {__m256 m;float v[8];} floatx8_t;
+typedef union {__m256 m;unsigned int v[8];} maskx8_t;
+#else
+typedef union {float v[8];} floatx8_t;
+typedef union {unsigned int v[8];} maskx8_t;
+#endif
+typedef struct {floatx4_t x, y, z;} vec3x4_t;
+typedef struct {floatx8_t x, y, z;} vec3x8_t;
+
+//
+// 4 lane floats and masks
+//
+
+#ifdef MATH_3D_SSE
+static __inline floatx4_t f4_splat (float s)                  { floatx4_t r;r.m=_mm_set1_ps(s);return r; }
+static __inline floatx4_t f4_load  (const float* p)           { floatx4_t r;r.m=_mm_loadu_ps(p);return r; }
+static __inline void      f4_store (float* p, floatx4_t a)    { _mm_storeu_ps(p,a.m); }
+static __inline floatx4_t f4_add   (floatx4_t a, floatx4_t b) { floatx4_t r;r.m=_mm_add_ps(a.m,b.m);return r; }
+static __inline floatx4_t f4_sub   (floatx4_t a, floatx4_t b) { floatx4_t r;r.m=_mm_sub_ps(a.m,b.m);return r; }
+static __inline floatx4_t f4_mul   (floatx4_t a, floatx4_t b) { floatx4_t r;r.m=_mm_mul_ps(a.m,b.m);return r; }
+static __inline floatx4_t f4_div   (floatx4_t a, floatx4_t b) { floatx4_t r;r.m=_mm_div_ps(a.m,b.m);return r; }
+static __inline floatx4_t f4_sqrt  (floatx4_t a)              { floatx4_t r;r.m=_mm_sqrt_ps(a.m);return r; }
+static __inline maskx4_t  f4_gt    (floatx4_t a, floatx4_t b) { maskx4_t r;r.m=_mm_cmpgt_ps(a.m,b.m);return r; }
+static __inline maskx4_t  f4_neq   (floatx4_t a, floatx4_t b) { maskx4_t r;r.m=_mm_cmpneq_ps(a.m,b.m);return r; }
+static __inline floatx4_t f4_select(maskx4_t m, floatx4_t a, floatx4_t b) { floatx4_t r;r.m=_mm_or_ps(_mm_and_ps(m.m,a.m),_mm_andnot_ps(m.m,b.m));return r; }
+static __inline maskx4_t  mk4_and  (maskx4_t a, maskx4_t b)   { maskx4_t r;r.m=_mm_and_ps(a.m,b.m);return r; }
+static __inline int       mk4_bits (maskx4_t a)               { return _mm_movemask_ps(a.m); }
+#else //MATH_3D_SSE
+static __inline floatx4_t f4_splat (float s)                  { floatx4_t r;int i;for (i=0;i<4;i++) r.v[i]=s;return r; }
+static __inline floatx4_t f4_load  (const float* p)           { floatx4_t r;int i;for (i=0;i<4;i++) r.v[i]=p[i];return r; }
+static __inline void      f4_store (float* p, floatx4_t a)    { int i;for (i=0;i<4;i++) p[i]=a.v[i]; }
+static __inline floatx4_t f4_add   (floatx4_t a, floatx4_t b) { int i;for (i=0;i<4;i++) a.v[i]+=b.v[i];return a; }
+static __inline floatx4_t f4_sub   (floatx4_t a, floatx4_t b) { int i;for (i=0;i<4;i++) a.v[i]-=b.v[i];return a; }
+static __inline floatx4_t f4_mul   (floatx4_t a, floatx4_t b) { int i;for (i=0;i<4;i++) a.v[i]*=b.v[i];return a; }
+static __inline floatx4_t f4_div   (floatx4_t a, floatx4_t b) { int i;for (i=0;i<4;i++) a.v[i]/=b.v[i];return a; }
+static __inline floatx4_t f4_sqrt  (floatx4_t a)              { int i;for (i=0;i<4;i++) a.v[i]=sqrt(a.v[i]);return a; }
+static __inline maskx4_t  f4_gt    (floatx4_t a, floatx4_t b) { maskx4_t r;int i;for (i=0;i<4;i++) r.v[i]=a.v[i]>b.v[i]?0xFFFFFFFFu:0u;return r; }
+static __inline maskx4_t  f4_neq   (floatx4_t a, floatx4_t b) { maskx4_t r;int i;for (i=0;i<4;i++) r.v[i]=a.v[i]!=b.v[i]?0xFFFFFFFFu:0u;return r; }
+static __inline floatx4_t f4_select(maskx4_t m, floatx4_t a, floatx4_t b) { int i;for (i=0;i<4;i++) if (!m.v[i]) a.v[i]=b.v[i];return a; }
+static __inline maskx4_t  mk4_and  (maskx4_t a, maskx4_t b)   { int i;for (i=0;i<4;i++) a.v[i]&=b.v[i];return a; }
+static __inline int       mk4_bits (maskx4_t a)               { int i,r=0;for (i=0;i<4;i++) if (a.v[i]) r|=(1<<i);return r; }
+#endif //MATH_3D_SSE
+static __inline int       mk4_any  (maskx4_t a)               { return mk4_bits(a)!=0; }
+
+//
+// 8 lane floats and masks
+//
+
+#ifdef MATH_3D_AVX
+static __inline floatx8_t f8_splat (float s)                  { floatx8_t r;r.m=_mm256_set1_ps(s);return r; }
+static __inline floatx8_t f8_load  (const float* p)           { floatx8_t r;r.m=_mm256_loadu_ps(p);return r; }
+static __inline void      f8_store (float* p, floatx8_t a)    { _mm256_storeu_ps(p,a.m); }
+static __inline floatx8_t f8_add   (floatx8_t a, floatx8_t b) { floatx8_t r;r.m=_mm256_add_ps(a.m,b.m);return r; }
+static __inline floatx8_t f8_sub   (floatx8_t a, floatx8_t b) { floatx8_t r;r.m=_mm256_sub_ps(a.m,b.m);return r; }
+static __inline floatx8_t f8_mul   (floatx8_t a, floatx8_t b) { floatx8_t r;r.m=_mm256_mul_ps(a.m,b.m);return r; }
+static __inline floatx8_t f8_div   (floatx8_t a, floatx8_t b) { floatx8_t r;r.m=_mm256_div_ps(a.m,b.m);return r; }
+static __inline floatx8_t f8_sqrt  (floatx8_t a)              { floatx8_t r;r.m=_mm256_sqrt_ps(a.m);return r; }
+static __inline maskx8_t  f8_gt    (floatx8_t a, floatx8_t b) { maskx8_t r;r.m=_mm256_cmp_ps(a.m,b.m,_CMP_GT_OQ);return r; }
+static __inline maskx8_t  f8_neq   (floatx8_t a, floatx8_t b) { maskx8_t r;r.m=_mm256_cmp_ps(a.m,b.m,_CMP_NEQ_UQ);return r; }
+static __inline floatx8_t f8_select(maskx8_t m, floatx8_t a, floatx8_t b) { floatx8_t r;r.m=_mm256_blendv_ps(b.m,a.m,m.m);return r; }
+static __inline maskx8_t  mk8_and  (maskx8_t a, maskx8_t b)   { maskx8_t r;r.m=_mm256_and_ps(a.m,b.m);return r; }
+static __inline int       mk8_bits (maskx8_t a)               { return _mm256_movemask_ps(a.m); }
+#else //MATH_3D_AVX
+static __inline floatx8_t f8_splat (float s)                  { floatx8_t r;int i;for (i=0;i<8;i++) r.v[i]=s;return r; }
+static __inline floatx8_t f8_load  (const float* p)           { floatx8_t r;int i;for (i=0;i<8;i++) r.v[i]=p[i];return r; }
+static __inline void      f8_store (float* p, floatx8_t a)    { int i;for (i=0;i<8;i++) p[i]=a.v[i]; }
+static __inline floatx8_t f8_add   (floatx8_t a, floatx8_t b) { int i;for (i=0;i<8;i++) a.v[i]+=b.v[i];return a; }
+static __inline floatx8_t f8_sub   (floatx8_t a, floatx8_t b) { int i;for (i=0;i<8;i++) a.v[i]-=b.v[i];return a; }
+static __inline floatx8_t f8_mul   (floatx8_t a, floatx8_t b) { int i;for (i=0;i<8;i++) a.v[i]*=b.v[i];return a; }
+static __inline floatx8_t f8_div   (floatx8_t a, floatx8_t b) { int i;for (i=0;i<8;i++) a.v[i]/=b.v[i];return a; }
+static __inline floatx8_t f8_sqrt  (floatx8_t a)              { int i;for (i=0;i<8;i++) a.v[i]=sqrt(a.v[i]);return a; }
+static __inline maskx8_t  f8_gt    (floatx8_t a, floatx8_t b) { maskx8_t r;int i;for (i=0;i<8;i++) r.v[i]=a.v[i]>b.v[i]?0xFFFFFFFFu:0u;return r; }
+static __inline maskx8_t  f8_neq   (floatx8_t a, floatx8_t b) { maskx8_t r;int i;for (i=0;i<8;i++) r.v[i]=a.v[i]!=b.v[i]?0xFFFFFFFFu:0u;return r; }
+static __inline floatx8_t f8_select(maskx8_t m, floatx8_t a, floatx8_t b) { int i;for (i=0;i<8;i++) if (!m.v[i]) a.v[i]=b.v[i];return a; }
+static __inline maskx8_t  mk8_and  (maskx8_t a, maskx8_t b)   { int i;for (i=0;i<8;i++) a.v[i]&=b.v[i];return a; }
+static __inline int       mk8_bits (maskx8_t a)               { int i,r=0;for (i=0;i<8;i++) if (a.v[i]) r|=(1<<i);return r; }
+#endif //MATH_3D_AVX
+static __inline int       mk8_any  (maskx8_t a)               { return mk8_bits(a)!=0; }
+
+//
+// Wide 3D vectors (SoA)
+//
+// `v3x4_norm()` divides by the length (like `v3_norm()`, so the lanes are the
+// same as the `vec3_t` results) and returns a null vector in the lanes where
+// the length is 0.
+//
+
+static __inline vec3x4_t vec3x4(floatx4_t x, floatx4_t y, floatx4_t z) { vec3x4_t v;v.x=x;v.y=y;v.z=z;return v; }
+static __inline vec3x4_t v3x4_select(maskx4_t m, vec3x4_t a, vec3x4_t b) { return vec3x4( f4_select(m,a.x,b.x), f4_select(m,a.y,b.y), f4_select(m,a.z,b.z) ); }
+static __inline floatx4_t v3x4_dot  (vec3x4_t a, vec3x4_t b)    { return f4_add(f4_add(f4_mul(a.x,b.x),f4_mul(a.y,b.y)),f4_mul(a.z,b.z)); }
+static __inline floatx4_t v3x4_length(vec3x4_t v)               { return f4_sqrt(v3x4_dot(v,v)); }
+static __inline vec3x4_t v3x4_norm  (vec3x4_t v) {
+	const floatx4_t len = v3x4_length(v), zero = f4_splat(0.f);
+	const maskx4_t valid = f4_gt(len,zero);
+	const floatx4_t div = f4_select(valid,len,f4_splat(1.f));
+	return vec3x4( f4_select(valid,f4_div(v.x,div),zero), f4_select(valid,f4_div(v.y,div),zero), f4_select(valid,f4_div(v.z,div),zero) );
+}
+
+static __inline vec3x8_t vec3x8(floatx8_t x, floatx8_t y, floatx8_t z) { vec3x8_t v;v.x=x;v.y=y;v.z=z;return v; }
+static __inline vec3x8_t v3x8_select(maskx8_t m, vec3x8_t a, vec3x8_t b) { return vec3x8( f8_select(m,a.x,b.x), f8_select(m,a.y,b.y), f8_select(m,a.z,b.z) ); }
+static __inline floatx8_t v3x8_dot  (vec3x8_t a, vec3x8_t b)    { return f8_add(f8_add(f8_mul(a.x,b.x),f8_mul(a.y,b.y)),f8_mul(a.z,b.z)); }
+static __inline floatx8_t v3x8_length(vec3x8_t v)               { return f8_sqrt(v3x8_dot(v,v)); }
+static __inline vec3x8_t v3x8_norm  (vec3x8_t v) {
+	const floatx8_t len = v3x8_length(v), zero = f8_splat(0.f);
+	const maskx8_t valid = f8_gt(len,zero);
+	const floatx8_t div = f8_select(valid,len,f8_splat(1.f));
+	return vec3x8( f8_select(valid,f8_div(v.x,div),zero), f8_select(valid,f8_div(v.y,div),zero), f8_select(valid,f8_div(v.z,div),zero) );
+}
+
+//
+// Wide matrix-vector multiplications
+//
+// Same as `m4_mul_dir()` (including the division by w when it's not 0 or 1),
+// but for 4 or 8 vectors at once.
+//
+
+static __inline vec3x4_t m4_mul_dir_x4(mat4_t matrix, vec3x4_t d) {
+	const vec3x4_t r = vec3x4(
+		f4_add(f4_add(f4_mul(d.x,f4_splat(matrix.m00)),f4_mul(d.y,f4_splat(matrix.m10))),f4_mul(d.z,f4_splat(matrix.m20))),
+		f4_add(f4_add(f4_mul(d.x,f4_splat(matrix.m01)),f4_mul(d.y,f4_splat(matrix.m11))),f4_mul(d.z,f4_splat(matrix.m21))),
+		f4_add(f4_add(f4_mul(d.x,f4_splat(matrix.m02)),f4_mul(d.y,f4_splat(matrix.m12))),f4_mul(d.z,f4_splat(matrix.m22))));
+	const floatx4_t w = f4_add(f4_add(f4_mul(d.x,f4_splat(matrix.m03)),f4_mul(d.y,f4_splat(matrix.m13))),f4_mul(d.z,f4_splat(matrix.m23)));
+	const maskx4_t divide = mk4_and(f4_neq(w,f4_splat(0.f)),f4_neq(w,f4_splat(1.f)));
+	if (!mk4_any(divide)) return r;
+	{
+		const floatx4_t wd = f4_select(divide,w,f4_splat(1.f));
+		return v3x4_select(divide,vec3x4( f4_div(r.x,wd), f4_div(r.y,wd), f4_div(r.z,wd) ),r);
+	}
+}
+static __inline vec3x8_t m4_mul_dir_x8(mat4_t matrix, vec3x8_t d) {
+	const vec3x8_t r = vec3x8(
+		f8_add(f8_add(f8_mul(d.x,f8_splat(matrix.m00)),f8_mul(d.y,f8_splat(matrix.m10))),f8_mul(d.z,f8_splat(matrix.m20))),
+		f8_add(f8_add(f8_mul(d.x,f8_splat(matrix.m01)),f8_mul(d.y,f8_splat(matrix.m11))),f8_mul(d.z,f8_splat(matrix.m21))),
+		f8_add(f8_add(f8_mul(d.x,f8_splat(matrix.m02)),f8_mul(d.y,f8_splat(matrix.m12))),f8_mul(d.z,f8_splat(matrix.m22))));
+	const floatx8_t w = f8_add(f8_add(f8_mul(d.x,f8_splat(matrix.m03)),f8_mul(d.y,f8_splat(matrix.m13))),f8_mul(d.z,f8_splat(matrix.m23)));
+	const maskx8_t divide = mk8_and(f8_neq(w,f8_splat(0.f)),f8_neq(w,f8_splat(1.f)));
+	if (!mk8_any(divide)) return r;
+	{
+		const floatx8_t wd = f8_select(divide,w,f8_splat(1.f));
+		return v3x8_select(divide,vec3x8( f8_div(r.x,wd), f8_div(r.y,wd), f8_div(r.z,wd) ),r);
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -2030,6 +2213,18 @@ vec3_t m4_mul_dir(mat4_t matrix, vec3_t direction) {
 	return result;
 }
 
+/**
+ * Multiplies a 4x4 matrix with `count` points (`m4_mul_pos()` on every element).
+ * 
+ * The points are processed 8 (with AVX) or 4 at a time using the wide vector
+ * types. `results` can be the same array as `positions`.
+ */
+
+/**
+ * Multiplies a 4x4 matrix with `count` directions (`m4_mul_dir()` on every
+ * element). `results` can be the same array as `directions`.
+ */
+
 void m4_print(mat4_t matrix) {
 	m4_fprintp(stdout, matrix, 6, 2);
 }
@@ -0,0 +1,280 @@
+// Headless offline renderer: it renders camera fly-throughs of the scene with the CPU renderer ("cpu_renderer.h")
+// and writes the frames as PPM/PFM files (or streams them to stdout). No display and no OpenGL needed.
+//
+// Examples:
+// 3D_Signed_Distance_Shapes_Offline -w 1280 -h 720 -n 300 -o frame_%04d.ppm
+// 3D_Signed_Distance_Shapes_Offline -n 300 -p fly.path -q original -o - | ffmpeg -f image2pipe -c:v ppm -i - fly.mp4
+// 3D_Signed_Distance_Shapes_Offline -n 30 -o none     (benchmark only: no output)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#   include <io.h>     // _setmode
+#   include <fcntl.h>  // _O_BINARY
+#endif //_WIN32
+
+#define MATH_3D_IMPLEMENTATION
+#include "math_3d.h"
+
+#define CPU_SCHEDULER_IMPLEMENTATION
+#define CPU_RENDERER_IMPLEMENTATION
+#include "cpu_renderer.h"
+
+#define CAMERA_PATH_IMPLEMENTATION
+#include "camera_path.h"
+
+typedef enum {
+    IMAGE_FORMAT_PPM = 0,   // 8-bit binary RGB (P6)
+    IMAGE_FORMAT_PFM        // 32-bit float RGB (PF): the gamma corrected output without any quantization
+} ImageFormat;
+
+typedef struct {
+    int width,height;
+    int num_frames;
+    float fps;                  // frame i is rendered at time i/fps along the camera path
+    const char* path_file;      // NULL = built-in fly-through (CameraPath_SetDefault(...))
+    const char* output;         // printf-like pattern with the frame number (e.g. "frame_%04d.ppm"), "-" = stdout, "none" = no output
+    int format;                 // ImageFormat (default: from the output extension)
+    int num_threads;            // 0 = all the hardware threads
+    int isa;                    // CpuRendererIsa
+    int tile_size;
+    CpuRendererSettings settings;
+} OfflineArgs;
+
+static void PrintUsage(const char* exe) {
+    printf("Usage: %s [options]\n",exe);
+    printf("  -w <width>              (default: 640)\n");
+    printf("  -h <height>             (default: 360)\n");
+    printf("  -n <frames>             (default: 1)\n");
+    printf("  --fps <fps>             camera path time step = 1/fps (default: 30)\n");
+    printf("  -p <file>               camera path file (see camera_path.h). Default: built-in fly-through\n");
+    printf("  --save-path <file>      writes the camera path in use and continues\n");
+    printf("  -o <pattern>            output file pattern (e.g. frame_%%04d.ppm), '-' = stdout, 'none' = no output (default: frame_%%04d.ppm)\n");
+    printf("                          (one %%d at most, %%%% for '%%'; a pattern without %%d needs -n 1)\n");
+    printf("  -f <ppm|pfm>            image format (default: from the -o extension, ppm for stdout)\n");
+    printf("  -t <threads>            0 = all the hardware threads (default: 0)\n");
+    printf("  -i <isa>                auto, scalar, sse4.1, avx2, avx512 (default: auto)\n");
+    printf("  --tile <size>           tile size in pixels (default: %d)\n",CPU_RENDERER_DEFAULT_TILE_SIZE);
+    printf("Quality settings:\n");
+    printf("  -q <custom|original>    preset: USE_CUSTOM_SETTINGS in the shader or the original one (default: custom)\n");
+    printf("  -a <aa>                 AA (AA*AA rays per pixel)\n");
+    printf("  --iterations <n>        RAYCAST_ITERATIONS\n");
+    printf("  --precision <p>         RAYCAST_PRECISION\n");
+    printf("  --shadows <n>           SHADOW_ITERATIONS (0 = no shadows)\n");
+    printf("  --ao <n>                AMBIENT_OCCLUSION_PRECISION (0 = no AO)\n");
+    printf("  --all-objects <0|1>     !REDUCE_NUM_OBJECTS\n");
+}
+
+// The number of frame numbers in an output pattern (0 or 1), or -1 if it's not a valid one: the pattern is passed to
+// snprintf(...) with the frame number, so it can only have "%%" and at most one %d (with flags and width, e.g. %04d)
+static int GetOutputPatternConversions(const char* pattern) {
+    const char* p;
+    int count = 0;
+    for (p=pattern;*p;p++) {
+        if (*p!='%') continue;
+        if (*++p=='%') continue;
+        while (*p=='0' || *p=='-' || *p=='+' || *p==' ') ++p;
+        while (*p>='0' && *p<='9') ++p;
+        if (*p!='d' && *p!='i') return -1;
+        if (++count>1) return -1;
+    }
+    return count;
+}
+
+static int ParseArgs(OfflineArgs* a,CameraPath* path,int argc,char* argv[]) {
+    const char* savePathFile = NULL;
+    int quality = 0,aa = -1,iterations = -1,shadows = -1,ao = -1,allObjects = -1;
+    float precision = -1.f;
+    int i;
+    a->width = 640;a->height = 360;
+    a->num_frames = 1;
+    a->fps = 30.f;
+    a->path_file = NULL;
+    a->output = "frame_%04d.ppm";
+    a->format = -1;
+    a->num_threads = 0;
+    a->isa = CPU_RENDERER_ISA_AUTO;
+    a->tile_size = CPU_RENDERER_DEFAULT_TILE_SIZE;
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (strcmp(arg,"--help")==0) return 0;
+        if (!val) {fprintf(stderr,"Missing value for: %s\n",arg);return 0;}
+        if      (strcmp(arg,"-w")==0) a->width = atoi(val);
+        else if (strcmp(arg,"-h")==0) a->height = atoi(val);
+        else if (strcmp(arg,"-n")==0) a->num_frames = atoi(val);
+        else if (strcmp(arg,"--fps")==0) a->fps = (float) atof(val);
+        else if (strcmp(arg,"-p")==0) a->path_file = val;
+        else if (strcmp(arg,"--save-path")==0) savePathFile = val;
+        else if (strcmp(arg,"-o")==0) a->output = val;
+        else if (strcmp(arg,"-f")==0) {
+            if (strcmp(val,"ppm")==0) a->format = IMAGE_FORMAT_PPM;
+            else if (strcmp(val,"pfm")==0) a->format = IMAGE_FORMAT_PFM;
+            else {fprintf(stderr,"Unknown image format: %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"-t")==0) a->num_threads = atoi(val);
+        else if (strcmp(arg,"-i")==0) {
+            int isa;
+            for (isa=CPU_RENDERER_ISA_AUTO;isa<CPU_RENDERER_ISA_COUNT;isa++) {
+                if (strcmp(val,CpuRenderer_GetIsaName(isa))==0) break;
+            }
+            if (isa==CPU_RENDERER_ISA_COUNT) {fprintf(stderr,"Unknown instruction set: %s\n",val);return 0;}
+            a->isa = isa;
+        }
+        else if (strcmp(arg,"--tile")==0) a->tile_size = atoi(val);
+        else if (strcmp(arg,"-q")==0) {
+            if (strcmp(val,"custom")==0) quality = 0;
+            else if (strcmp(val,"original")==0) quality = 1;
+            else {fprintf(stderr,"Unknown quality preset: %s\n",val);return 0;}
+        }
+        else if (strcmp(arg,"-a")==0) aa = atoi(val);
+        else if (strcmp(arg,"--iterations")==0) iterations = atoi(val);
+        else if (strcmp(arg,"--precision")==0) precision = (float) atof(val);
+        else if (strcmp(arg,"--shadows")==0) shadows = atoi(val);
+        else if (strcmp(arg,"--ao")==0) ao = atoi(val);
+        else if (strcmp(arg,"--all-objects")==0) allObjects = atoi(val);
+        else {fprintf(stderr,"Invalid argument: %s\n",arg);return 0;}
+        ++i;
+    }
+    if (a->width<=0 || a->height<=0 || a->num_frames<=0 || a->fps<=0.f || a->num_threads<0 || a->tile_size<=0) {
+        fprintf(stderr,"Invalid argument values\n");
+        return 0;
+    }
+    if (strcmp(a->output,"-")!=0 && strcmp(a->output,"none")!=0) {
+        const int conversions = GetOutputPatternConversions(a->output);
+        if (conversions<0) {fprintf(stderr,"Invalid output pattern (at most one %%d, e.g. frame_%%04d.ppm, and %%%% for '%%'): %s\n",a->output);return 0;}
+        if (conversions==0 && a->num_frames>1) {fprintf(stderr,"The output pattern has no %%d: every frame would overwrite %s\n",a->output);return 0;}
+    }
+
+    if (quality) CpuRendererSettings_InitOriginal(&a->settings);
+    else CpuRendererSettings_Init(&a->settings);
+    a->settings.isa = a->isa;
+    if (aa>0) a->settings.aa = aa;
+    if (iterations>0) a->settings.raycast_iterations = iterations;
+    if (precision>0.f) a->settings.raycast_precision = precision;
+    if (shadows>=0) a->settings.shadow_iterations = shadows;
+    if (ao>=0) a->settings.ambient_occlusion_precision = ao;
+    if (allObjects>=0) a->settings.reduce_num_objects = allObjects ? 0 : 1;
+
+    if (a->format<0) {
+        const char* ext = strrchr(a->output,'.');
+        a->format = (ext && strcmp(ext,".pfm")==0) ? IMAGE_FORMAT_PFM : IMAGE_FORMAT_PPM;
+    }
+
+    if (a->path_file) {
+        if (CameraPath_Load(path,a->path_file)!=0) {fprintf(stderr,"Can't load camera path: %s\n",a->path_file);return 0;}
+    }
+    else CameraPath_SetDefault(path);
+    if (savePathFile && CameraPath_Save(path,savePathFile)!=0) fprintf(stderr,"Can't save camera path: %s\n",savePathFile);
+    return 1;
+}
+
+// fb->color is top-down and gamma corrected
+static int WriteImage(FILE* f,const CpuFramebuffer* fb,int format,unsigned char* rowBuffer) {
+    int x,y;
+    if (format==IMAGE_FORMAT_PFM) {
+        // PFM rows are stored bottom-up. The negative scale means little-endian.
+        const int littleEndian = 1;
+        if (fprintf(f,"PF\n%d %d\n%s\n",fb->width,fb->height,(*(const char*)&littleEndian) ? "-1.0" : "1.0")<0) return 0;
+        for (y=fb->height-1;y>=0;y--) {
+            if (fwrite(&fb->color[3*y*fb->width],sizeof(float)*3,fb->width,f)!=(size_t)fb->width) return 0;
+        }
+    }
+    else {
+        if (fprintf(f,"P6\n%d %d\n255\n",fb->width,fb->height)<0) return 0;
+        for (y=0;y<fb->height;y++) {
+            const float* pColor = &fb->color[3*y*fb->width];
+            for (x=0;x<3*fb->width;x++) {
+                const float c = pColor[x];
+                rowBuffer[x] = (unsigned char) (c<=0.f ? 0 : (c>=1.f ? 255 : (int)(c*255.f+0.5f)));
+            }
+            if (fwrite(rowBuffer,3,fb->width,f)!=(size_t)fb->width) return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc,char* argv[]) {
+    OfflineArgs args;
+    CameraPath path;
+    CpuRenderer r;
+    CpuFramebuffer fb;
+    CpuScheduler* scheduler = NULL;
+    unsigned char* rowBuffer = NULL;
+    FILE* report = stdout;  // stderr when the images go to stdout
+    int toStdout,noOutput,frame,ok = 1;
+    long long startNs,renderNs = 0;
+    double totalMs,numRays;
+
+    CameraPath_Init(&path);
+    if (!ParseArgs(&args,&path,argc,argv)) {PrintUsage(argv[0]);CameraPath_Destroy(&path);return 1;}
+    toStdout = strcmp(args.output,"-")==0;
+    noOutput = strcmp(args.output,"none")==0;
+    if (toStdout) {
+        report = stderr;
+#       ifdef _WIN32
+        _setmode(_fileno(stdout),_O_BINARY);
+#       endif //_WIN32
+    }
+
+    if (!CpuFramebuffer_Create(&fb,args.width,args.height) || !(rowBuffer = (unsigned char*) malloc(3*args.width))) {
+        fprintf(stderr,"Out of memory\n");
+        CpuFramebuffer_Destroy(&fb);CameraPath_Destroy(&path);
+        return 1;
+    }
+    scheduler = CpuScheduler_Create(args.num_threads);
+
+    CpuRenderer_Init(&r);
+    r.settings = args.settings;
+    CpuRenderer_SetProjectionUniforms(&r,0.075f,20.f,45.f,(float)args.width/(float)args.height);   // same as main.c
+
+    fprintf(report,"Resolution: %dx%d Frames: %d (%.3f s of camera path at %.2f fps) Threads: %d ISA: %s (%d lanes)\n",
+            args.width,args.height,args.num_frames,(float)args.num_frames/args.fps,args.fps,CpuScheduler_GetNumThreads(scheduler),
+            CpuRenderer_GetIsaName(args.isa==CPU_RENDERER_ISA_AUTO ? CpuRenderer_GetBestIsa() : args.isa),CpuRenderer_GetIsaPacketWidth(args.isa));
+    fprintf(report,"Quality: AA: %d iterations: %d precision: %g shadows: %d AO: %d all objects: %d\n",
+            r.settings.aa,r.settings.raycast_iterations,r.settings.raycast_precision,r.settings.shadow_iterations,
+            r.settings.ambient_occlusion_precision,r.settings.reduce_num_objects ? 0 : 1);
+
+    startNs = CpuScheduler_GetTimeNs();
+    for (frame=0;frame<args.num_frames && ok;frame++) {
+        const float time = (float)frame/args.fps;
+        mat4_t cameraMatrix;
+        vec3_t lightDirection;
+        long long frameStartNs;
+        CameraPath_Evaluate(&path,time,&cameraMatrix,&lightDirection);
+        CpuRenderer_SetUniforms(&r,args.width,args.height,time,&cameraMatrix,&lightDirection);
+
+        frameStartNs = CpuScheduler_GetTimeNs();
+        CpuRenderer_RenderFrameTiled(&r,&fb,scheduler,args.tile_size);
+        renderNs += CpuScheduler_GetTimeNs()-frameStartNs;
+
+        if (toStdout) {
+            ok = WriteImage(stdout,&fb,args.format,rowBuffer);
+            fflush(stdout);
+        }
+        else if (!noOutput) {
+            char filePath[1024];
+            FILE* f;
+            // (a checked pattern: at most one %d, see GetOutputPatternConversions(...))
+            if (snprintf(filePath,sizeof(filePath),args.output,frame)>=(int)sizeof(filePath)) {fprintf(stderr,"Output path too long: %s\n",args.output);ok = 0;break;}
+            f = fopen(filePath,"wb");
+            if (!f) {fprintf(stderr,"Can't write: %s\n",filePath);ok = 0;break;}
+            ok = WriteImage(f,&fb,args.format,rowBuffer);
+            fclose(f);
+        }
+        if (!ok) fprintf(stderr,"Error writing frame %d\n",frame);
+    }
+    totalMs = (double)(CpuScheduler_GetTimeNs()-startNs)*1.0e-6;
+    numRays = (double)args.width*(double)args.height*(double)(r.settings.aa*r.settings.aa)*(double)frame;
+
+    fprintf(report,"Total wall time: %.3f s (%.3f ms/frame including output)\n",totalMs*0.001,frame>0 ? totalMs/(double)frame : 0.0);
+    fprintf(report,"Rendering: %.3f ms/frame %.3f Mrays/s (primary rays)\n",
+            frame>0 ? (double)renderNs*1.0e-6/(double)frame : 0.0,renderNs>0 ? numRays*1.0e3/(double)renderNs : 0.0);
+
+    CpuScheduler_Destroy(scheduler);
+    free(rowBuffer);
+    CpuFramebuffer_Destroy(&fb);
+    CameraPath_Destroy(&path);
+    return ok ? 0 : 1;
+}
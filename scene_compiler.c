@@ -0,0 +1,434 @@
+// Scene compiler: translates a scene file (see the FILE FORMAT of "sdf_scene.h") into straight-line code, with all the
+// primitive parameters, translations and modifiers folded into constants (no loop, no type dispatch, no texture fetch):
+// -> a GLSL map() for "signed_distance_shapes.glsl" (used when USE_COMPILED_SCENE is defined)
+// -> the matching C map() functions of the CPU renderer, scalar and SIMD packets (see CpuRenderer::compiled_scene)
+// So both renderers get the same scene from a single source. No OpenGL needed.
+// The default outputs are the files included by the demo and by "cpu_renderer.h": rebuild the CPU renderer after compiling a scene.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define SDF_SCENE_IMPLEMENTATION
+#include "sdf_scene.h"
+
+typedef enum {
+    SC_GLSL = 0,        // GLSL 1.00/1.10
+    SC_C,               // scalar C (the cr_ functions of "cpu_renderer.h")
+    SC_C_PACKET         // SIMD packets (the CRP(crp_) functions of "cpu_renderer_packet.h")
+} ScLanguage;
+
+typedef enum {
+    SC_ARGS_NONE = 0,   // (p)
+    SC_ARGS_S1,         // (p,params[0])
+    SC_ARGS_S3,         // (p,params[0],params[1],params[2])
+    SC_ARGS_V2,         // (p,vec2)
+    SC_ARGS_V3,         // (p,vec3)
+    SC_ARGS_V3_S,       // (p,vec3,params[3])
+    SC_ARGS_CAPSULE     // (p,vec3 a,vec3 b,params[3])
+} ScArgs;
+
+typedef struct {
+    const char* name;           // GLSL name (the C ones are cr_name and CRP(crp_name))
+    int args;                   // ScArgs
+    int packet_vec3;            // the packet function takes a vec3_t (instead of 3 floats)
+} ScPrimitiveInfo;
+static const ScPrimitiveInfo ScPrimitives[SDF_PRIMITIVE_COUNT] = {
+    {"sdPlane",         SC_ARGS_NONE,       0},
+    {"sdSphere",        SC_ARGS_S1,         0},
+    {"sdBox",           SC_ARGS_V3,         0},
+    {"udRoundBox",      SC_ARGS_V3_S,       0},
+    {"sdTorus",         SC_ARGS_V2,         0},
+    {"sdCapsule",       SC_ARGS_CAPSULE,    1},
+    {"sdTriPrism",      SC_ARGS_V2,         0},
+    {"sdCylinder",      SC_ARGS_V2,         0},
+    {"sdCone",          SC_ARGS_V3,         1},
+    {"sdTorus82",       SC_ARGS_V2,         0},
+    {"sdTorus88",       SC_ARGS_V2,         0},
+    {"sdCylinder6",     SC_ARGS_V2,         0},
+    {"sdHexPrism",      SC_ARGS_V2,         0},
+    {"sdPryamid4",      SC_ARGS_V3,         1},
+    {"sdConeSection",   SC_ARGS_S3,         0},
+    {"sdEllipsoid",     SC_ARGS_V3,         0}
+};
+
+typedef struct {
+    FILE* f;
+    int language;               // ScLanguage
+    const char* indent;
+} ScWriter;
+
+static void Sc_Line(ScWriter* w,const char* format,...) {
+    va_list args;
+    fputs(w->indent,w->f);
+    va_start(args,format);
+    vfprintf(w->f,format,args);
+    va_end(args);
+    fputc('\n',w->f);
+}
+
+// Float literal of the current language (a ring of buffers, so that it can be used many times in the same call)
+static int ScLanguageOfLiterals = SC_GLSL;
+static const char* Sc_F(float v) {
+    static char buffers[32][40];
+    static int next = 0;
+    char* b = buffers[next++%32];
+    sprintf(b,"%.7g",v);
+    if (!strpbrk(b,".eEn")) strcat(b,".0");     // GLSL needs "1.0" (and C needs it with the 'f' suffix)
+    if (ScLanguageOfLiterals!=SC_GLSL) strcat(b,"f");
+    return b;
+}
+static const char* Sc_Vec3(float x,float y,float z) {
+    static char buffers[8][128];
+    static int next = 0;
+    char* b = buffers[next++%8];
+    sprintf(b,"vec3(%s,%s,%s)",Sc_F(x),Sc_F(y),Sc_F(z));     // (vec3(...) is a function of "math_3d.h" in C)
+    return b;
+}
+
+static int Sc_IsZero(const float* v) {return v[0]==0.f && v[1]==0.f && v[2]==0.f;}
+
+// The point a primitive is evaluated at (before its modifier): pos-position
+static void Sc_Point(char* out,int language,const SdfPrimitive* p) {
+    if (Sc_IsZero(p->position)) {strcpy(out,"pos");return;}
+    switch (language) {
+    case SC_GLSL:       sprintf(out,"pos-%s",Sc_Vec3(p->position[0],p->position[1],p->position[2]));break;
+    case SC_C:          sprintf(out,"v3_sub(pos,%s)",Sc_Vec3(p->position[0],p->position[1],p->position[2]));break;
+    default:            sprintf(out,"CRP(crp_v3_subc)(pos,%s,%s,%s)",Sc_F(p->position[0]),Sc_F(p->position[1]),Sc_F(p->position[2]));break;
+    }
+}
+
+// The distance of the primitive at point (without the modifier). hasModifier: point is the local "p" (already translated)
+static void Sc_PrimitiveCall(char* out,int language,const SdfPrimitive* p,const char* point,int hasModifier) {
+    const ScPrimitiveInfo* info = &ScPrimitives[p->type];
+    const float* a = p->params;
+    char args[512],name[64];
+    if (language==SC_GLSL) strcpy(name,info->name);
+    else if (language==SC_C) sprintf(name,"cr_%s",info->name);
+    else sprintf(name,"CRP(crp_%s)",info->name);
+    switch (info->args) {
+    case SC_ARGS_NONE:
+        if (language==SC_C_PACKET) {
+            // sdPlane(p) = p.y
+            if (hasModifier || Sc_IsZero(p->position)) sprintf(out,"%s.y",point);
+            else sprintf(out,"crp_sub(pos.y,crp_set1(%s))",Sc_F(p->position[1]));
+            return;
+        }
+        args[0] = '\0';
+        break;
+    case SC_ARGS_S1:    sprintf(args,"%s",Sc_F(a[0]));break;
+    case SC_ARGS_S3:    sprintf(args,"%s,%s,%s",Sc_F(a[0]),Sc_F(a[1]),Sc_F(a[2]));break;
+    case SC_ARGS_V2:
+        if (language==SC_GLSL) sprintf(args,"vec2(%s,%s)",Sc_F(a[0]),Sc_F(a[1]));
+        else if (language==SC_C) sprintf(args,"cr_vec2(%s,%s)",Sc_F(a[0]),Sc_F(a[1]));
+        else sprintf(args,"%s,%s",Sc_F(a[0]),Sc_F(a[1]));
+        break;
+    case SC_ARGS_V3:
+    case SC_ARGS_V3_S:
+        if (language==SC_C_PACKET && !info->packet_vec3) sprintf(args,"%s,%s,%s",Sc_F(a[0]),Sc_F(a[1]),Sc_F(a[2]));
+        else strcpy(args,Sc_Vec3(a[0],a[1],a[2]));
+        if (info->args==SC_ARGS_V3_S) {strcat(args,",");strcat(args,Sc_F(a[3]));}
+        break;
+    case SC_ARGS_CAPSULE:
+        // Folded: sdCapsule(pos-position,vec3(0),b,r) = sdCapsule(pos,position,position+b,r)
+        if (hasModifier) sprintf(args,"%s,%s,%s",Sc_Vec3(0.f,0.f,0.f),Sc_Vec3(a[0],a[1],a[2]),Sc_F(a[3]));
+        else {
+            const float* o = p->position;
+            sprintf(args,"%s,%s,%s",Sc_Vec3(o[0],o[1],o[2]),Sc_Vec3(o[0]+a[0],o[1]+a[1],o[2]+a[2]),Sc_F(a[3]));
+            point = "pos";
+        }
+        break;
+    }
+    if (language==SC_C_PACKET) sprintf(out,"%s(%s%s%s)",name,point,args[0] ? "," : "",args);
+    else sprintf(out,"%s( %s%s%s )",name,point,args[0] ? ", " : "",args);
+}
+
+// Writes the statements that compute the local point "p" of a primitive with a modifier (if any), and the expression of its distance
+static void Sc_Primitive(ScWriter* w,const SdfPrimitive* p,char* expr) {
+    const int language = w->language;
+    const float* mp = p->modifier_params;
+    char point[256],call[1024];
+    int hasModifier = (p->modifier==SDF_MODIFIER_TWIST || p->modifier==SDF_MODIFIER_POLAR_REPEAT || p->modifier==SDF_MODIFIER_REPEAT);
+    Sc_Point(point,language,p);
+    if (hasModifier) {
+        if (p->modifier==SDF_MODIFIER_REPEAT && language!=SC_C_PACKET) {
+            Sc_Line(w,language==SC_GLSL ? "p = opRep( %s, %s );" : "p = cr_opRep(%s,%s);",point,Sc_Vec3(mp[0],mp[1],mp[2]));
+        }
+        else Sc_Line(w,"p = %s;",point);
+        if (p->modifier==SDF_MODIFIER_TWIST) {
+            // opTwist(...) with the angle mp[0]*p.y+mp[1]
+            if (language==SC_GLSL) {
+                Sc_Line(w,"c = cos( %s*p.y+%s ); s = sin( %s*p.y+%s );",Sc_F(mp[0]),Sc_F(mp[1]),Sc_F(mp[0]),Sc_F(mp[1]));
+                Sc_Line(w,"p = vec3( mat2(c,-s,s,c)*p.xz, p.y );");
+            }
+            else if (language==SC_C) {
+                Sc_Line(w,"c = cosf(%s*p.y+%s);s = sinf(%s*p.y+%s);",Sc_F(mp[0]),Sc_F(mp[1]),Sc_F(mp[0]),Sc_F(mp[1]));
+                Sc_Line(w,"p = vec3(c*p.x+s*p.z,-s*p.x+c*p.z,p.y);");
+            }
+            else {
+                Sc_Line(w,"a = crp_add(crp_mul(crp_set1(%s),p.y),crp_set1(%s));",Sc_F(mp[0]),Sc_F(mp[1]));
+                Sc_Line(w,"c = CRP(crp_lanes1)(a,&cosf);s = CRP(crp_lanes1)(a,&sinf);");
+                Sc_Line(w,"t.x = crp_add(crp_mul(c,p.x),crp_mul(s,p.z));t.y = crp_sub(crp_mul(c,p.z),crp_mul(s,p.x));t.z = p.y;p = t;");
+            }
+        }
+        else if (p->modifier==SDF_MODIFIER_POLAR_REPEAT) {
+            if (language==SC_GLSL) {
+                Sc_Line(w,"q = mod( vec2( atan(p.x,p.z)/6.2831, %s+%s*length(p) ), vec2(%s,%s) ) - vec2(%s,%s);",Sc_F(mp[2]),Sc_F(mp[3]),Sc_F(mp[0]),Sc_F(mp[1]),Sc_F(0.5f*mp[0]),Sc_F(0.5f*mp[1]));
+                Sc_Line(w,"p = vec3( q.x, p.y, q.y );");
+            }
+            else if (language==SC_C) {
+                Sc_Line(w,"p = vec3(cr_mod(atan2f(p.x,p.z)/6.2831f,%s)-%s,p.y,cr_mod(%s+%s*v3_length(p),%s)-%s);",Sc_F(mp[0]),Sc_F(0.5f*mp[0]),Sc_F(mp[2]),Sc_F(mp[3]),Sc_F(mp[1]),Sc_F(0.5f*mp[1]));
+            }
+            else {
+                Sc_Line(w,"a = CRP(crp_v3_length)(p);");
+                Sc_Line(w,"p.x = crp_sub(CRP(crp_mod)(crp_div(CRP(crp_lanes2)(p.x,p.z,&atan2f),crp_set1(6.2831f)),%s),crp_set1(%s));",Sc_F(mp[0]),Sc_F(0.5f*mp[0]));
+                Sc_Line(w,"p.z = crp_sub(CRP(crp_mod)(crp_add(crp_set1(%s),crp_mul(crp_set1(%s),a)),%s),crp_set1(%s));",Sc_F(mp[2]),Sc_F(mp[3]),Sc_F(mp[1]),Sc_F(0.5f*mp[1]));
+            }
+        }
+        else if (p->modifier==SDF_MODIFIER_REPEAT && language==SC_C_PACKET) {
+            Sc_Line(w,"p.x = crp_sub(CRP(crp_mod)(p.x,%s),crp_set1(%s));",Sc_F(mp[0]),Sc_F(0.5f*mp[0]));
+            Sc_Line(w,"p.y = crp_sub(CRP(crp_mod)(p.y,%s),crp_set1(%s));",Sc_F(mp[1]),Sc_F(0.5f*mp[1]));
+            Sc_Line(w,"p.z = crp_sub(CRP(crp_mod)(p.z,%s),crp_set1(%s));",Sc_F(mp[2]),Sc_F(0.5f*mp[2]));
+        }
+        strcpy(point,"p");
+    }
+    Sc_PrimitiveCall(call,language,p,point,hasModifier);
+
+    if (p->modifier==SDF_MODIFIER_TWIST && mp[2]!=1.f) {
+        if (language==SC_C_PACKET) sprintf(expr,"crp_mul(crp_set1(%s),%s)",Sc_F(mp[2]),call);
+        else sprintf(expr,"%s*%s",Sc_F(mp[2]),call);
+    }
+    else if (p->modifier==SDF_MODIFIER_DISPLACE) {
+        const char *s = Sc_F(mp[2]),*amp = Sc_F(mp[0]),*fx = Sc_F(mp[1]);
+        if (language==SC_GLSL) sprintf(expr,"%s*%s + %s*sin(%s*pos.x)*sin(%s*pos.y)*sin(%s*pos.z)",s,call,amp,fx,fx,fx);
+        else if (language==SC_C) sprintf(expr,"%s*%s + %s*sinf(%s*pos.x)*sinf(%s*pos.y)*sinf(%s*pos.z)",s,call,amp,fx,fx,fx);
+        else sprintf(expr,"crp_add(crp_mul(crp_set1(%s),%s),crp_mul(crp_mul(crp_mul(crp_set1(%s),CRP(crp_lanes1)(crp_mul(crp_set1(%s),pos.x),&sinf)),"
+                          "CRP(crp_lanes1)(crp_mul(crp_set1(%s),pos.y),&sinf)),CRP(crp_lanes1)(crp_mul(crp_set1(%s),pos.z),&sinf)))",s,call,amp,fx,fx,fx);
+    }
+    else strcpy(expr,call);
+}
+
+// res = opU(res,vec2(dist,material)) (or the first assignment of res)
+static void Sc_Union(ScWriter* w,const char* dist,float material,int first) {
+    switch (w->language) {
+    case SC_GLSL:
+        if (first) Sc_Line(w,"res = vec2( %s, %s );",dist,Sc_F(material));
+        else Sc_Line(w,"res = opU( res, vec2( %s, %s ) );",dist,Sc_F(material));
+        break;
+    case SC_C:
+        if (first) Sc_Line(w,"res = cr_vec2( %s, %s );",dist,Sc_F(material));
+        else Sc_Line(w,"res = cr_opU( res, cr_vec2( %s, %s ) );",dist,Sc_F(material));
+        break;
+    default:
+        if (first) Sc_Line(w,"d = %s;m = crp_set1(%s);",dist,Sc_F(material));
+        else Sc_Line(w,"CRP(crp_opU)(&d,&m, %s, %s );",dist,Sc_F(material));
+        break;
+    }
+}
+
+// An object is a primitive with SDF_OP_UNION followed by the primitives combined with it (see SdfOp)
+static int Sc_GetObjectEnd(const SdfScene* s,int start,int stop) {
+    int end = start+1;
+    while (end<stop && s->primitives[end].op!=SDF_OP_UNION) ++end;
+    return end;
+}
+static void Sc_Objects(ScWriter* w,const SdfScene* s,int start,int stop,int* first) {
+    int i,k;
+    char expr[2048],combined[2560];
+    for (i=start;i<stop;i=Sc_GetObjectEnd(s,i,stop)) {
+        const int end = Sc_GetObjectEnd(s,i,stop);
+        const SdfPrimitive* head = &s->primitives[i];
+        float material = -1.f;
+        if (end==i+1 && head->op==SDF_OP_UNION) {
+            Sc_Primitive(w,head,expr);
+            Sc_Union(w,expr,head->material,*first);
+            *first = 0;
+            continue;
+        }
+        k = i;
+        if (head->op==SDF_OP_UNION) {
+            Sc_Primitive(w,head,expr);
+            Sc_Line(w,"o = %s;",expr);
+            material = head->material;
+            ++k;
+        }
+        else Sc_Line(w,"o = %s;",w->language==SC_C_PACKET ? "crp_set1(1e10f)" : Sc_F(1e10f));  // (like the interpreter, when the scene doesn't start with SDF_OP_UNION)
+        for (;k<end;k++) {
+            const SdfPrimitive* p = &s->primitives[k];
+            Sc_Primitive(w,p,expr);
+            switch (p->op) {
+            case SDF_OP_SUBTRACT:
+                if (w->language==SC_GLSL) sprintf(combined,"opS( o, %s )",expr);
+                else if (w->language==SC_C) sprintf(combined,"cr_opS( o, %s )",expr);
+                else sprintf(combined,"crp_max(crp_neg(%s),o)",expr);
+                break;
+            case SDF_OP_INTERSECT:
+                if (w->language==SC_GLSL) sprintf(combined,"max( o, %s )",expr);
+                else if (w->language==SC_C) sprintf(combined,"cr_max( o, %s )",expr);
+                else sprintf(combined,"crp_max(o,%s)",expr);
+                break;
+            default:
+                if (w->language==SC_GLSL) sprintf(combined,"smin( o, %s, %s )",expr,Sc_F(p->blend));
+                else if (w->language==SC_C) sprintf(combined,"cr_smin( o, %s, %s )",expr,Sc_F(p->blend));
+                else sprintf(combined,"CRP(crp_smin)(o,%s,%s)",expr,Sc_F(p->blend));
+                break;
+            }
+            Sc_Line(w,"o = %s;",combined);
+        }
+        Sc_Union(w,"o",material,*first);
+        *first = 0;
+    }
+}
+
+typedef struct {
+    int num_objects;
+    int num_reduced;            // first primitive skipped with REDUCE_NUM_OBJECTS (num_primitives = none)
+    int uses_p,uses_twist,uses_polar,uses_object;
+} ScSceneInfo;
+static void Sc_GetSceneInfo(const SdfScene* s,ScSceneInfo* info) {
+    int i;
+    memset(info,0,sizeof(ScSceneInfo));
+    info->num_reduced = (s->num_reduced_primitives>=0 && s->num_reduced_primitives<s->num_primitives) ? s->num_reduced_primitives : s->num_primitives;
+    // The skipped primitives must be whole objects: the marker is moved to the start of the object that contains it
+    while (info->num_reduced>0 && info->num_reduced<s->num_primitives && s->primitives[info->num_reduced].op!=SDF_OP_UNION) --info->num_reduced;
+    for (i=0;i<s->num_primitives;i++) {
+        const SdfPrimitive* p = &s->primitives[i];
+        if (i==0 || p->op==SDF_OP_UNION) ++info->num_objects;
+        if (p->op!=SDF_OP_UNION) info->uses_object = 1;
+        if (p->modifier==SDF_MODIFIER_TWIST) info->uses_twist = 1;
+        else if (p->modifier==SDF_MODIFIER_POLAR_REPEAT) info->uses_polar = 1;
+        if (p->modifier==SDF_MODIFIER_TWIST || p->modifier==SDF_MODIFIER_POLAR_REPEAT || p->modifier==SDF_MODIFIER_REPEAT) info->uses_p = 1;
+    }
+}
+
+static void Sc_WriteMapBody(ScWriter* w,const SdfScene* s,const ScSceneInfo* info) {
+    int first = info->num_reduced>0 ? 1 : 0;
+    if (!first) {
+        // Nothing is always drawn
+        if (w->language==SC_GLSL) Sc_Line(w,"res = vec2( 1e10, -1.0 );");
+        else if (w->language==SC_C) Sc_Line(w,"res = cr_vec2( 1e10f, -1.f );");
+        else Sc_Line(w,"d = crp_set1(1e10f);m = crp_set1(-1.f);");
+    }
+    Sc_Objects(w,s,0,info->num_reduced,&first);
+    if (info->num_reduced<s->num_primitives) {
+        const char* indent = w->indent;
+        if (w->language==SC_GLSL) fprintf(w->f,"#if !REDUCE_NUM_OBJECTS\n");
+        else {Sc_Line(w,"if (!r->settings.reduce_num_objects) {");w->indent = "        ";}
+        Sc_Objects(w,s,info->num_reduced,s->num_primitives,&first);
+        w->indent = indent;
+        if (w->language==SC_GLSL) fprintf(w->f,"#endif\n");
+        else Sc_Line(w,"}");
+    }
+}
+
+static void Sc_WriteHeaderComment(FILE* f,const char* sceneFile,const SdfScene* s,const ScSceneInfo* info) {
+    fprintf(f,"// Generated by the scene compiler (\"scene_compiler.c\") from \"%s\": don't edit it, compile the scene again.\n",sceneFile);
+    fprintf(f,"// %d primitives in %d objects (%d primitives with REDUCE_NUM_OBJECTS).\n",s->num_primitives,info->num_objects,info->num_reduced);
+}
+
+// returns 0 on success, -1 on failure
+static int Sc_WriteGlsl(const char* filePath,const char* sceneFile,const SdfScene* s) {
+    ScSceneInfo info;
+    ScWriter w;
+    w.f = fopen(filePath,"wt");
+    if (!w.f) return -1;
+    w.language = ScLanguageOfLiterals = SC_GLSL;w.indent = "    ";
+    Sc_GetSceneInfo(s,&info);
+    Sc_WriteHeaderComment(w.f,sceneFile,s,&info);
+    fprintf(w.f,"// It replaces the built-in map() of \"signed_distance_shapes.glsl\" when USE_COMPILED_SCENE is defined.\n\n");
+    fprintf(w.f,"vec2 map( in vec3 pos )\n{\n");
+    Sc_Line(&w,"vec2 res;");
+    if (info.uses_p) Sc_Line(&w,"vec3 p;");
+    if (info.uses_polar) Sc_Line(&w,"vec2 q;");
+    if (info.uses_object) Sc_Line(&w,"float o;");
+    if (info.uses_twist) Sc_Line(&w,"float c, s;");
+    Sc_WriteMapBody(&w,s,&info);
+    Sc_Line(&w,"return res;   // res.y just controls the rendering material");
+    fprintf(w.f,"}\n");
+    fclose(w.f);
+    return 0;
+}
+// returns 0 on success, -1 on failure
+static int Sc_WriteC(const char* filePath,const char* sceneFile,const SdfScene* s) {
+    ScSceneInfo info;
+    ScWriter w;
+    w.f = fopen(filePath,"wt");
+    if (!w.f) return -1;
+    w.indent = "    ";
+    Sc_GetSceneInfo(s,&info);
+    Sc_WriteHeaderComment(w.f,sceneFile,s,&info);
+    fprintf(w.f,"// Included by \"cpu_renderer.h\" (scalar map()) and by \"cpu_renderer_packet.h\" (once per SIMD instruction set): no include guard.\n\n");
+
+    fprintf(w.f,"#ifndef CRP_ISA\n");
+    w.language = ScLanguageOfLiterals = SC_C;
+    fprintf(w.f,"static cr_vec2_t cr_mapCompiledScene(const CpuRenderer* r,vec3_t pos) {\n");
+    Sc_Line(&w,"cr_vec2_t res;");
+    if (info.uses_p) Sc_Line(&w,"vec3_t p;");
+    if (info.uses_object || info.uses_twist) Sc_Line(&w,"float %s%s%s;",info.uses_object ? "o" : "",info.uses_object && info.uses_twist ? "," : "",info.uses_twist ? "c,s" : "");
+    Sc_WriteMapBody(&w,s,&info);
+    Sc_Line(&w,"return res;");
+    fprintf(w.f,"}\n");
+
+    fprintf(w.f,"#else //CRP_ISA\n");
+    w.language = ScLanguageOfLiterals = SC_C_PACKET;
+    fprintf(w.f,"static CRP_TARGET void CRP(crp_mapCompiledScene)(const CpuRenderer* r,crp_v3 pos,crp_f* pd,crp_f* pm) {\n");
+    Sc_Line(&w,"crp_f d,m;");
+    if (info.uses_p) Sc_Line(&w,info.uses_twist ? "crp_v3 p,t;" : "crp_v3 p;");
+    if (info.uses_object) Sc_Line(&w,"crp_f o;");
+    if (info.uses_twist) Sc_Line(&w,"crp_f a,c,s;");
+    else if (info.uses_polar) Sc_Line(&w,"crp_f a;");
+    Sc_WriteMapBody(&w,s,&info);
+    Sc_Line(&w,"*pd = d;");
+    Sc_Line(&w,"if (pm) *pm = m;");
+    fprintf(w.f,"}\n");
+    fprintf(w.f,"#endif //CRP_ISA\n");
+    fclose(w.f);
+    return 0;
+}
+
+static void PrintUsage(const char* exe) {
+    printf("Usage: %s <scene file> [options]\n",exe);
+    printf("  -glsl <file>            GLSL map() (default: sdf_scene_compiled.glsl, \"none\" = not written)\n");
+    printf("  -c <file>               C map() functions of the CPU renderer (default: sdf_scene_compiled.h, \"none\" = not written)\n");
+    printf("or:    %s --save-default <scene file>\n",exe);
+    printf("  writes the built-in scene of the demo as a scene file\n");
+}
+
+int main(int argc,char* argv[]) {
+    const char* sceneFile = NULL;
+    const char* glslFile = "sdf_scene_compiled.glsl";
+    const char* cFile = "sdf_scene_compiled.h";
+    SdfScene scene;
+    ScSceneInfo info;
+    int i,ok = 1;
+
+    SdfScene_Init(&scene);
+    if (argc==3 && strcmp(argv[1],"--save-default")==0) {
+        ok = SdfScene_SetDefault(&scene) && SdfScene_Save(&scene,argv[2])==0;
+        if (!ok) fprintf(stderr,"Can't write: %s\n",argv[2]);
+        SdfScene_Destroy(&scene);
+        return ok ? 0 : 1;
+    }
+    for (i=1;i<argc;i++) {
+        const char* arg = argv[i];
+        const char* val = (i+1<argc) ? argv[i+1] : NULL;
+        if (arg[0]!='-' && !sceneFile) {sceneFile = arg;continue;}
+        if (!val || arg[0]!='-') {PrintUsage(argv[0]);return 1;}
+        if (strcmp(arg,"-glsl")==0) glslFile = val;
+        else if (strcmp(arg,"-c")==0) cFile = val;
+        else {fprintf(stderr,"Invalid argument: %s\n",arg);PrintUsage(argv[0]);return 1;}
+        ++i;
+    }
+    if (!sceneFile) {PrintUsage(argv[0]);return 1;}
+    if (SdfScene_Load(&scene,sceneFile)!=0) {fprintf(stderr,"Can't load: %s\n",sceneFile);SdfScene_Destroy(&scene);return 1;}
+    Sc_GetSceneInfo(&scene,&info);
+    if (scene.num_reduced_primitives>=0 && info.num_reduced!=scene.num_reduced_primitives && scene.num_reduced_primitives<scene.num_primitives) {
+        fprintf(stderr,"Warning: the \"reduce\" marker is inside an object: it's moved to the start of the object\n");
+    }
+    if (strcmp(glslFile,"none")!=0 && Sc_WriteGlsl(glslFile,sceneFile,&scene)!=0) {fprintf(stderr,"Can't write: %s\n",glslFile);ok = 0;}
+    if (strcmp(cFile,"none")!=0 && Sc_WriteC(cFile,sceneFile,&scene)!=0) {fprintf(stderr,"Can't write: %s\n",cFile);ok = 0;}
+    if (ok) printf("\"%s\": %d primitives in %d objects compiled.\n",sceneFile,scene.num_primitives,info.num_objects);
+    SdfScene_Destroy(&scene);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+// Baked distance field (included by "signed_distance_shapes.glsl" when USE_BAKED_SDF is defined).
+// The map() of the static scene is sampled on a regular grid by the CPU ("sdf_bake.h"), and stored in a single-channel
+// float texture with the z slices side by side (GLES2/WebGL1 have no 3D textures): the slices are filtered by the
+// texture unit, and blended along z here.
+// The interpolated distance is off by at most iBakedSdfSize.w (half the diagonal of a voxel), so far from the surfaces
+// castRay() steps with it (two texture fetches instead of the whole map()). The step never gets closer than that bound to
+// the surfaces, so the hit itself (and its material) is always found by the exact map(), like before.
+
+uniform sampler2D iBakedSdf;        // single channel float texture, linear filtering
+uniform vec4 iBakedSdfOrigin;       // .xyz = position of sample (0,0,0) .w = distance between samples
+uniform vec4 iBakedSdfSize;         // .xyz = number of samples per axis .w = max error of the interpolated distance
+uniform vec4 iBakedSdfAtlas;        // .x = z slices per row of the texture .yz = 1/texture size (texels)
+
+#ifndef BAKED_SDF_RELATIVE_ERROR
+#define BAKED_SDF_RELATIVE_ERROR (0.001)   // rounding of the 16-bit floats
+#endif
+
+// Bilinear sample of slice z (an integer), g.xy in [0,resolution-1]: it never reads the texels of the other slices
+float bakedSdfSlice( in vec2 g, in float z )
+{
+    float row = floor( (z+0.5)/iBakedSdfAtlas.x );
+    vec2 tile = vec2( z-row*iBakedSdfAtlas.x, row )*iBakedSdfSize.xy;
+    return texture2D( iBakedSdf, (tile+g+0.5)*iBakedSdfAtlas.yz ).x;
+}
+
+// A safe step from pos far from the surfaces, or 0.0 near them (the exact map() is needed). Outside the baked box, the
+// distance at the closest point of the box minus the distance to it is still a lower bound
+float bakedSdfStep( in vec3 pos )
+{
+    vec3 g = (pos-iBakedSdfOrigin.xyz)/iBakedSdfOrigin.w;
+    vec3 c = clamp( g, vec3(0.0), iBakedSdfSize.xyz-1.0 );
+    float z = min( floor(c.z), iBakedSdfSize.z-2.0 );
+    float d = mix( bakedSdfSlice( c.xy, z ), bakedSdfSlice( c.xy, z+1.0 ), c.z-z );
+    float e = iBakedSdfSize.w + abs(d)*BAKED_SDF_RELATIVE_ERROR;
+    d -= length( g-c )*iBakedSdfOrigin.w;
+    return d>3.0*e ? d-2.0*e : 0.0;     // (the true distance is >=d-e: after the step it's still >=e)
+}
@@ -0,0 +1,240 @@
+#ifndef SDF_BAKE_H_
+#define SDF_BAKE_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only baked distance field: map() sampled on a regular grid over a box (usually the
+ * bounds of the static objects of the scene, see SdfBake_GetSceneBounds(...)), one z slice per task of a CpuScheduler.
+ * The samples are the exact distances of map(), so the field is only as stale as the scene it was baked from.
+ * -> Interpolating a distance field with slope <=1 between the samples is off by at most half the diagonal of a voxel
+ *    (SdfBake_GetErrorBound(...)), so the baked distance minus that bound is a safe sphere tracing step anywhere in the box.
+ * -> Far from the surfaces it's much cheaper than map() (two texture fetches): castRay() in "signed_distance_shapes.glsl"
+ *    uses it there (USE_BAKED_SDF, see "sdf_bake.glsl"), and the exact map() near the surfaces and outside the box.
+ *
+ * The GPU reads it from a 2D texture with the z slices side by side (GLES2/WebGL1 have no 3D textures): a single channel
+ * of 16-bit floats (GL_R16F) is enough, since the error bound is much bigger than their rounding.
+*/
+
+/* USAGE:
+ * Define SDF_BAKE_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file
+ * (and SDF_BVH_IMPLEMENTATION, SDF_SCENE_IMPLEMENTATION and CPU_SCHEDULER_IMPLEMENTATION in one of your .c files too).
+ *
+ * static float MyMap(const float* pos,void* userData) {...}   // the distance at pos (it's called by many threads at once)
+ *
+ * SdfBake bake;
+ * SdfBake_Init(&bake);
+ * SdfBake_GetSceneBounds(&scene,0.5f,bmin,bmax);                       // or any other box
+ * SdfBake_Bake(&bake,bmin,bmax,128,&MyMap,userData,scheduler);         // 128 samples along the longest axis (scheduler can be NULL)
+ * // texture upload:
+ * SdfBake_GetTextureSize(&bake,&w,&h);                                 // (single channel texels)
+ * SdfBake_GetTexels(&bake,texels);                                     // texels = w*h floats; uniforms: see SdfBake_GetUniforms(...)
+ * SdfBake_Destroy(&bake);
+*/
+
+#include "sdf_scene.h"
+#include "cpu_scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SDF_BAKE_MAX_TEXTURE_WIDTH
+#define SDF_BAKE_MAX_TEXTURE_WIDTH (4096)   // the z slices wrap to the next row of the texture after this
+#endif
+
+typedef float (*SdfBakeMapFunc)(const float* pos,void* userData);  // the distance at pos (3 floats): it must be thread-safe
+
+typedef struct {
+    float origin[3];                    // position of sample (0,0,0)
+    float voxel_size;                   // distance between two samples (along every axis)
+    int resolution[3];                  // number of samples per axis (at least 2)
+    float* distances;                   // resolution[0]*resolution[1]*resolution[2] samples: x first, then y, then z
+    int capacity;                       // of distances
+} SdfBake;
+
+void SdfBake_Init(SdfBake* b);
+void SdfBake_Destroy(SdfBake* b);
+// Samples map() on a grid over [bmin,bmax] (grown to a whole number of voxels), with maxResolution samples along its
+// longest axis. scheduler can be NULL (single-threaded). Returns 0 on failure (out of memory)
+int  SdfBake_Bake(SdfBake* b,const float* bmin,const float* bmax,int maxResolution,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler);
+// The bounds of the objects of s grown by margin (the unbounded ones, like planes, are ignored). Returns 0 if there's none
+int  SdfBake_GetSceneBounds(const SdfScene* s,float margin,float* bmin,float* bmax);
+float SdfBake_GetErrorBound(const SdfBake* b);                  // max error of the interpolated distances (half the diagonal of a voxel)
+float SdfBake_Sample(const SdfBake* b,const float* pos);        // trilinear interpolation (pos is clamped to the box), like the shader
+size_t SdfBake_GetMemoryUsage(const SdfBake* b);                // bytes of the texture (16-bit floats)
+void SdfBake_GetTextureSize(const SdfBake* b,int* width,int* height);
+void SdfBake_GetTexels(const SdfBake* b,float* texels);        // width*height floats (see SdfBake_GetTextureSize(...))
+// The uniforms of "sdf_bake.glsl" (USE_BAKED_SDF): iBakedSdfOrigin = (origin, voxel size),
+// iBakedSdfSize = (resolution, error bound), iBakedSdfAtlas = (z slices per row of the texture, 1/texture size, 0)
+void SdfBake_GetUniforms(const SdfBake* b,float* origin4,float* size4,float* atlas4);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BAKE_H_
+
+#ifdef SDF_BAKE_IMPLEMENTATION
+#ifndef SDF_BAKE_IMPLEMENTATION_GUARD
+#define SDF_BAKE_IMPLEMENTATION_GUARD
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sdf_bvh.h"    // SdfBvh_GetObjectBounds(...)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void SdfBake_Init(SdfBake* b) {memset(b,0,sizeof(SdfBake));}
+void SdfBake_Destroy(SdfBake* b) {
+    if (b->distances) free(b->distances);
+    SdfBake_Init(b);
+}
+
+typedef struct {
+    SdfBake* bake;
+    SdfBakeMapFunc map;
+    void* user_data;
+} SdfBakeJob;
+// One z slice per task
+static void SdfBake_BakeSlice(int z,int workerIndex,void* userData) {
+    const SdfBakeJob* job = (const SdfBakeJob*) userData;
+    const SdfBake* b = job->bake;
+    float* d = &b->distances[z*b->resolution[0]*b->resolution[1]];
+    float pos[3];int x,y;
+    (void)workerIndex;
+    pos[2] = b->origin[2]+z*b->voxel_size;
+    for (y=0;y<b->resolution[1];y++) {
+        pos[1] = b->origin[1]+y*b->voxel_size;
+        for (x=0;x<b->resolution[0];x++) {
+            pos[0] = b->origin[0]+x*b->voxel_size;
+            *d++ = job->map(pos,job->user_data);
+        }
+    }
+}
+
+int SdfBake_Bake(SdfBake* b,const float* bmin,const float* bmax,int maxResolution,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler) {
+    SdfBakeJob job;
+    float extent = 0.f;
+    int j,count;
+    if (maxResolution<2) maxResolution = 2;
+    for (j=0;j<3;j++) {if (extent<bmax[j]-bmin[j]) extent = bmax[j]-bmin[j];}
+    b->voxel_size = extent>0.f ? extent/(maxResolution-1) : 1.f;
+    for (j=0;j<3;j++) {
+        // Whole number of voxels, centered on [bmin,bmax]
+        b->resolution[j] = (int) ceilf((bmax[j]-bmin[j])/b->voxel_size)+1;
+        if (b->resolution[j]<2) b->resolution[j] = 2;
+        b->origin[j] = 0.5f*(bmin[j]+bmax[j])-0.5f*(b->resolution[j]-1)*b->voxel_size;
+    }
+    count = b->resolution[0]*b->resolution[1]*b->resolution[2];
+    if (count>b->capacity) {
+        float* d = (float*) realloc(b->distances,count*sizeof(float));
+        if (!d) {b->resolution[0] = b->resolution[1] = b->resolution[2] = 0;return 0;}
+        b->distances = d;b->capacity = count;
+    }
+    job.bake = b;job.map = map;job.user_data = userData;
+    if (scheduler) CpuScheduler_Run(scheduler,b->resolution[2],&SdfBake_BakeSlice,&job);
+    else {
+        int z;
+        for (z=0;z<b->resolution[2];z++) SdfBake_BakeSlice(z,0,&job);
+    }
+    return 1;
+}
+
+int SdfBake_GetSceneBounds(const SdfScene* s,float margin,float* bmin,float* bmax) {
+    float ob[6];
+    int i = 0,j,found = 0;
+    for (j=0;j<3;j++) {bmin[j] = SDF_BVH_INFINITY;bmax[j] = -SDF_BVH_INFINITY;}
+    while (i<s->num_primitives) {
+        int objEnd = i+1;
+        while (objEnd<s->num_primitives && s->primitives[objEnd].op!=SDF_OP_UNION) ++objEnd;
+        if (SdfBvh_GetObjectBounds(s,i,objEnd,ob,ob+3)) {
+            for (j=0;j<3;j++) {
+                if (bmin[j]>ob[j]) bmin[j] = ob[j];
+                if (bmax[j]<ob[3+j]) bmax[j] = ob[3+j];
+            }
+            found = 1;
+        }
+        i = objEnd;
+    }
+    if (!found) return 0;
+    for (j=0;j<3;j++) {bmin[j]-=margin;bmax[j]+=margin;}
+    return 1;
+}
+
+float SdfBake_GetErrorBound(const SdfBake* b) {return 0.8660254f*b->voxel_size;}   // sqrt(3)/2
+
+float SdfBake_Sample(const SdfBake* b,const float* pos) {
+    float g[3],f[3],c[2][2];
+    int i[3],j,y,z;
+    for (j=0;j<3;j++) {
+        g[j] = (pos[j]-b->origin[j])/b->voxel_size;
+        if (g[j]<0.f) g[j] = 0.f;
+        else if (g[j]>(float)(b->resolution[j]-1)) g[j] = (float)(b->resolution[j]-1);
+        i[j] = (int) g[j];
+        if (i[j]>b->resolution[j]-2) i[j] = b->resolution[j]-2;
+        f[j] = g[j]-i[j];
+    }
+    for (z=0;z<2;z++) {
+        for (y=0;y<2;y++) {
+            const float* d = &b->distances[((i[2]+z)*b->resolution[1]+i[1]+y)*b->resolution[0]+i[0]];
+            c[z][y] = d[0]+(d[1]-d[0])*f[0];
+        }
+    }
+    c[0][0]+=(c[0][1]-c[0][0])*f[1];
+    c[1][0]+=(c[1][1]-c[1][0])*f[1];
+    return c[0][0]+(c[1][0]-c[0][0])*f[2];
+}
+
+// Number of z slices per row of the texture: as square as possible, within SDF_BAKE_MAX_TEXTURE_WIDTH
+static int SdfBake_GetSlicesPerRow(const SdfBake* b) {
+    int columns;
+    if (b->resolution[0]<=0) return 1;
+    columns = (int) ceil(sqrt((double)b->resolution[2]*b->resolution[1]/b->resolution[0]));
+    if (columns>b->resolution[2]) columns = b->resolution[2];
+    if (columns*b->resolution[0]>SDF_BAKE_MAX_TEXTURE_WIDTH) columns = SDF_BAKE_MAX_TEXTURE_WIDTH/b->resolution[0];
+    return columns>0 ? columns : 1;
+}
+size_t SdfBake_GetMemoryUsage(const SdfBake* b) {
+    int w,h;
+    SdfBake_GetTextureSize(b,&w,&h);
+    return (size_t)w*h*2;
+}
+void SdfBake_GetTextureSize(const SdfBake* b,int* width,int* height) {
+    const int columns = SdfBake_GetSlicesPerRow(b);
+    const int rows = (b->resolution[2]+columns-1)/columns;
+    *width = columns*b->resolution[0];*height = rows*b->resolution[1];
+    if (*width<1) *width = 1;
+    if (*height<1) *height = 1;
+}
+void SdfBake_GetTexels(const SdfBake* b,float* texels) {
+    const int columns = SdfBake_GetSlicesPerRow(b);
+    int width,height,y,z;
+    SdfBake_GetTextureSize(b,&width,&height);
+    memset(texels,0,width*height*sizeof(float));
+    for (z=0;z<b->resolution[2];z++) {
+        const int x0 = (z%columns)*b->resolution[0],y0 = (z/columns)*b->resolution[1];
+        for (y=0;y<b->resolution[1];y++) {
+            memcpy(&texels[(y0+y)*width+x0],&b->distances[(z*b->resolution[1]+y)*b->resolution[0]],b->resolution[0]*sizeof(float));
+        }
+    }
+}
+void SdfBake_GetUniforms(const SdfBake* b,float* origin4,float* size4,float* atlas4) {
+    int j,width,height;
+    SdfBake_GetTextureSize(b,&width,&height);
+    for (j=0;j<3;j++) {origin4[j] = b->origin[j];size4[j] = (float)b->resolution[j];}
+    origin4[3] = b->voxel_size;
+    size4[3] = SdfBake_GetErrorBound(b);
+    atlas4[0] = (float)SdfBake_GetSlicesPerRow(b);atlas4[1] = 1.f/width;atlas4[2] = 1.f/height;atlas4[3] = 0.f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BAKE_IMPLEMENTATION_GUARD
+#endif //SDF_BAKE_IMPLEMENTATION
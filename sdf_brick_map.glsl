@@ -0,0 +1,47 @@
+// Sparse baked distance field (included by "signed_distance_shapes.glsl" when USE_BAKED_SDF and USE_SDF_BRICK_MAP are
+// defined): the same bakedSdfStep(...) as "sdf_bake.glsl", but the field is stored as bricks of 8x8x8 samples near the
+// surfaces only ("sdf_brick_map.h"). The indirection texture has one texel per brick (the bricks in order, x first):
+// its atlas slot (-1 when it's not resident) and the distance at its center. Every slot of the atlas is a tile of 64x8
+// texels with the 8 z slices side by side: the slices are filtered by the texture unit, and blended along z here.
+// Far from the surfaces, and in the bricks that are not resident, the distance at the center of the brick minus the
+// distance from it is a safe step too.
+
+uniform sampler2D iBrickMapIndirection;     // RGBA float texture, nearest filtering (.x = slot .y = center distance)
+uniform sampler2D iBrickMapAtlas;           // single channel float texture, linear filtering
+uniform vec4 iBrickMapOrigin;               // .xyz = min corner of brick (0,0,0) .w = brick size
+uniform vec4 iBrickMapSize;                 // .xyz = number of bricks per axis .w = max error of the interpolated distance
+uniform vec4 iBrickMapTextures;             // .x = width of the indirection texture .yz = 1/its size .w = slots per row of the atlas
+uniform vec4 iBrickMapAtlasTexel;           // .xy = 1/size of the atlas (texels)
+
+#ifndef BAKED_SDF_RELATIVE_ERROR
+#define BAKED_SDF_RELATIVE_ERROR (0.001)   // rounding of the 16-bit floats
+#endif
+
+// Bilinear sample of slice z (an integer) of the slot at tile, l.xy in [0,7]: it never reads the texels of the other slices
+float brickMapSlice( in vec2 tile, in vec2 l, in float z )
+{
+    return texture2D( iBrickMapAtlas, (tile+vec2(z*8.0,0.0)+l+0.5)*iBrickMapAtlasTexel.xy ).x;
+}
+
+// A safe step from pos far from the surfaces, or 0.0 near them (the exact map() is needed)
+float bakedSdfStep( in vec3 pos )
+{
+    vec3 g = (pos-iBrickMapOrigin.xyz)/iBrickMapOrigin.w;
+    vec3 b = clamp( floor(g), vec3(0.0), iBrickMapSize.xyz-1.0 );
+    float index = (b.z*iBrickMapSize.y+b.y)*iBrickMapSize.x+b.x;
+    float row = floor( (index+0.5)/iBrickMapTextures.x );
+    vec2 brick = texture2D( iBrickMapIndirection, (vec2(index-row*iBrickMapTextures.x,row)+0.5)*iBrickMapTextures.yz ).xy;
+    vec3 l = g-b;
+    float e = iBrickMapSize.w;
+    float d = brick.y-length( l-0.5 )*iBrickMapOrigin.w;
+    if( brick.x>=0.0 && l==clamp( l, 0.0, 1.0 ) )
+    {
+        vec3 s = l*7.0;
+        float slotRow = floor( (brick.x+0.5)/iBrickMapTextures.w );
+        vec2 tile = vec2( brick.x-slotRow*iBrickMapTextures.w, slotRow )*vec2( 64.0, 8.0 );
+        float z = min( floor(s.z), 6.0 );
+        float v = mix( brickMapSlice( tile, s.xy, z ), brickMapSlice( tile, s.xy, z+1.0 ), s.z-z );
+        d = max( d, v-e-abs(v)*BAKED_SDF_RELATIVE_ERROR );
+    }
+    return d>2.0*e ? d-e : 0.0;     // (the true distance is >=d: after the step it's still >=e)
+}
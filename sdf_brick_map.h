@@ -0,0 +1,679 @@
+#ifndef SDF_BRICK_MAP_H_
+#define SDF_BRICK_MAP_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only sparse baked distance field: the box is split into bricks of SDF_BRICK_SIZE^3
+ * samples, and only the bricks near the surfaces are baked (SdfBake of "sdf_bake.h" samples the whole box, empty space
+ * included). An indirection grid stores the distance at the center of every brick and the atlas slot of the baked ones.
+ * -> The atlas has a fixed number of slots (the memory budget): SdfBrickMap_Update(...) bakes the surface bricks around
+ *    the camera (closest first, one brick per task of a CpuScheduler) and recycles the least recently used slots, so a
+ *    world much bigger than the budget is streamed in while the camera moves.
+ * -> Every brick has a safe step even when it's not resident: the distance at its center minus the distance from it.
+ *    In the resident ones, the interpolated distance minus its error bound (half the diagonal between two samples) is
+ *    better near the surfaces. Like with SdfBake, the steps stay that far from the surfaces, so the hits are always found
+ *    by the exact map().
+ * -> The CPU renderer ("brick_map" field of CpuRenderer) and castRay() in "signed_distance_shapes.glsl" (USE_BAKED_SDF
+ *    and USE_SDF_BRICK_MAP, see "sdf_brick_map.glsl") step the same way.
+ * -> Edits of the scene don't need a new bake: SdfBrickMap_Invalidate(...) evaluates again only the bricks whose distances
+ *    can have changed, and bakes again the resident ones (in parallel), so that they can be uploaded by the same frame.
+ *    A point farther from the edited box than its distance to the surfaces keeps its distance (the surfaces within that
+ *    distance are unchanged): near the surfaces only the bricks around the edit are dirty, in empty space farther ones
+ *    too (an object added in the middle of nowhere shortens the distances all around it).
+ *
+ * The border samples of neighbor bricks are at the same positions (SDF_BRICK_SIZE samples span a brick, ends included),
+ * so every brick is interpolated without reading the others. The GPU reads the indirection grid from a float texture
+ * (one texel per brick: slot, center distance), and the atlas from a single channel 16-bit float texture (every slot is a
+ * tile of SDF_BRICK_SIZE*SDF_BRICK_SIZE x SDF_BRICK_SIZE texels with the z slices side by side): the slots changed by an
+ * update are uploaded with glTexSubImage2D(...) (see SdfBrickMap_GetChanges(...)).
+*/
+
+/* USAGE:
+ * Define SDF_BRICK_MAP_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file
+ * (and CPU_SCHEDULER_IMPLEMENTATION in one of your .c files too).
+ *
+ * static float MyMap(const float* pos,void* userData) {...}   // the distance at pos (it's called by many threads at once)
+ *
+ * SdfBrickMap bm;
+ * SdfBrickMap_Init(&bm);
+ * SdfBake_GetSceneBounds(&scene,0.5f,bmin,bmax);                       // or any other box
+ * SdfBrickMap_Create(&bm,bmin,bmax,0.35f,4<<20,&MyMap,userData,scheduler);    // 0.35 units per brick, 4 MB of atlas
+ * // every frame:
+ * SdfBrickMap_Update(&bm,cameraPos,8.f,256,&MyMap,userData,scheduler); // the surface bricks within 8 units (at most 256 bakes)
+ * float step = SdfBrickMap_GetStep(&bm,pos);                           // 0 = near a surface (use map())
+ * // after an edit of the scene (map() returns the new distances):
+ * SdfBrickMap_Invalidate(&bm,editBox,1,&MyMap,userData,scheduler);     // editBox = the bounds before and after the edit (min, max)
+ * // or, with the scene before the edit (a copy, see SdfScene_Copy(...)):
+ * if (SdfBrickMap_InvalidateSceneChanges(&bm,&before,&scene,&MyMap,userData,scheduler)<0) SdfBrickMap_Create(...);   // (e.g. the plane has moved)
+ * // texture uploads: see SdfBrickMap_GetIndirectionTexels(...), SdfBrickMap_GetSlotTexels(...) and SdfBrickMap_GetChanges(...)
+ * SdfBrickMap_Destroy(&bm);
+*/
+
+#include <math.h>
+#include "sdf_bake.h"   // SdfBakeMapFunc
+#include "cpu_scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SDF_BRICK_SIZE (8)                  // samples per axis of a brick ("sdf_brick_map.glsl" assumes 8)
+#define SDF_BRICK_SAMPLES (SDF_BRICK_SIZE*SDF_BRICK_SIZE*SDF_BRICK_SIZE)
+#ifndef SDF_BRICK_MAP_INDIRECTION_WIDTH
+#define SDF_BRICK_MAP_INDIRECTION_WIDTH (1024)  // width of the indirection texture (bricks)
+#endif
+#ifndef SDF_BRICK_MAP_ATLAS_WIDTH
+#define SDF_BRICK_MAP_ATLAS_WIDTH (4096)        // width of the atlas texture (texels)
+#endif
+#define SDF_BRICK_MAP_RELATIVE_ERROR (0.001f)  // rounding of the 16-bit floats of the atlas
+
+typedef struct {
+    int requested;      // surface bricks within the radius
+    int hits;           // ... that were resident already
+    int baked;          // ... that have been baked
+    int evicted;        // least recently used bricks that left their slot to them
+    int missed;         // ... that are still not resident (budget full, or maxBakes reached)
+    double bake_ms;     // time spent baking
+} SdfBrickMapStats;
+
+typedef struct {
+    int checked;        // bricks within reach of the edited boxes
+    int dirty;          // ... whose center distance has been evaluated again
+    int rebaked;        // ... that were resident, and near a surface (baked again)
+    int freed;          // ... that were resident, and not near a surface anymore (their slot is free)
+    double ms;          // time spent (evaluations and bakes)
+} SdfBrickMapEditStats;
+
+typedef struct {
+    float origin[3];            // min corner of brick (0,0,0)
+    float brick_size;           // world size of a brick (SDF_BRICK_SIZE-1 times the distance between two samples)
+    int resolution[3];          // bricks per axis
+    int num_bricks;
+    int num_surface_bricks;     // the ones that can be baked
+    float* center_distances;    // num_bricks: map() at the center of every brick (x first, then y, then z)
+    float max_center_distance;  // max |center_distances| (or more): how far an edit can change the distances
+    int* brick_slots;           // num_bricks: atlas slot of every brick (-1 = not resident)
+    unsigned char* brick_flags; // num_bricks: SDF_BRICK_FLAG_*
+
+    int num_slots;              // the budget
+    int num_resident;
+    float* atlas;               // num_slots*SDF_BRICK_SAMPLES samples (x first, then y, then z in every slot)
+    int* slot_bricks;           // num_slots: brick of every slot (-1 = free)
+    unsigned* slot_frames;      // num_slots: the update that used it last
+    int* slot_prev,*slot_next;  // num_slots: least recently used list (-1 = none)
+    int lru_first,lru_last;     // most and least recently used slots
+    unsigned frame;             // number of updates
+
+    // Changes since the last SdfBrickMap_ClearChanges(...) (to upload them)
+    int* changed_slots;int num_changed_slots;   // slots baked again
+    int* changed_bricks;int num_changed_bricks; // bricks whose slot changed
+    unsigned char* slot_changed;                // num_slots
+
+    // Scratch space of SdfBrickMap_Update(...)
+    void* requests;int requests_capacity;
+    int* bakes;
+
+    SdfBrickMapStats stats;     // of the last update
+    SdfBrickMapEditStats edit_stats;    // of the last SdfBrickMap_Invalidate(...)
+} SdfBrickMap;
+
+#define SDF_BRICK_FLAG_SURFACE  (1)     // near a surface: it's baked when it's requested
+#define SDF_BRICK_FLAG_CHANGED  (2)     // in changed_bricks
+#define SDF_BRICK_FLAG_DIRTY    (4)     // evaluated again by SdfBrickMap_Invalidate(...)
+#ifndef SDF_BRICK_MAP_MAX_EDIT_BOXES
+#define SDF_BRICK_MAP_MAX_EDIT_BOXES (64)   // SdfBrickMap_InvalidateSceneChanges(...) merges the boxes of more changed objects into the last one
+#endif
+
+void SdfBrickMap_Init(SdfBrickMap* m);
+void SdfBrickMap_Destroy(SdfBrickMap* m);
+// Splits [bmin,bmax] (grown to a whole number of bricks) into bricks of brickSize, evaluates map() at their centers to find
+// the surface bricks, and allocates an atlas of budgetBytes (2 bytes per sample, like the texture). No brick is resident.
+// scheduler can be NULL (single-threaded). Returns 0 on failure (out of memory)
+int  SdfBrickMap_Create(SdfBrickMap* m,const float* bmin,const float* bmax,float brickSize,size_t budgetBytes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler);
+// Makes the surface bricks within radius of pos resident, closest first: when the atlas is full, the least recently used
+// bricks (not requested by this update) are evicted. At most maxBakes bricks are baked (<=0 = no limit), the rest are
+// requested again by the next updates. Returns the number of bricks baked (see m->stats too)
+int  SdfBrickMap_Update(SdfBrickMap* m,const float* pos,float radius,int maxBakes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler);
+// The distances inside the numBoxes boxes (6 floats each: min, max) have changed, and map() returns the new ones: evaluates
+// again the center distances of the bricks that can be affected (and their surface flags), and bakes again the resident
+// ones (the ones not near a surface anymore leave their slot). Everything changed is listed by SdfBrickMap_GetChanges(...)
+// Returns the number of bricks baked again (see m->edit_stats too)
+int  SdfBrickMap_Invalidate(SdfBrickMap* m,const float* boxes,int numBoxes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler);
+// SdfBrickMap_Invalidate(...) with the bounds (before and after) of the objects that differ between two versions of a scene.
+// Returns -1 if a changed object can't be bounded (e.g. a plane, or a repetition): the whole map must be created again
+int  SdfBrickMap_InvalidateSceneChanges(SdfBrickMap* m,const SdfScene* before,const SdfScene* after,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler);
+static __inline float SdfBrickMap_GetErrorBound(const SdfBrickMap* m);  // max error of the interpolated distances (half the diagonal between two samples)
+// A safe step from pos far from the surfaces, or 0 near them (the exact map() is needed), like bakedSdfStep(...) in "sdf_brick_map.glsl".
+// It's inline (the CPU renderer calls it at every step, and it doesn't need SDF_BRICK_MAP_IMPLEMENTATION)
+static __inline float SdfBrickMap_GetStep(const SdfBrickMap* m,const float* pos);
+// Bytes of the textures: the atlas (16-bit floats) and the indirection grid (4 floats per brick)
+void SdfBrickMap_GetMemoryUsage(const SdfBrickMap* m,size_t* atlasBytes,size_t* indirectionBytes);
+size_t SdfBrickMap_GetDenseMemoryUsage(const SdfBrickMap* m);   // bytes of an SdfBake texture of the same box and sample spacing
+
+void SdfBrickMap_GetIndirectionTextureSize(const SdfBrickMap* m,int* width,int* height);
+void SdfBrickMap_GetIndirectionTexel(const SdfBrickMap* m,int brick,float* texel4);     // (slot or -1, center distance, 0, 0)
+void SdfBrickMap_GetIndirectionTexels(const SdfBrickMap* m,float* texels);             // width*height*4 floats, bricks in order
+void SdfBrickMap_GetAtlasTextureSize(const SdfBrickMap* m,int* width,int* height);
+void SdfBrickMap_GetSlotRect(const SdfBrickMap* m,int slot,int* x,int* y);              // of size SDF_BRICK_SIZE*SDF_BRICK_SIZE x SDF_BRICK_SIZE
+void SdfBrickMap_GetSlotTexels(const SdfBrickMap* m,int slot,float* texels);            // SDF_BRICK_SAMPLES floats (rows of the rect)
+// The changes since the last SdfBrickMap_ClearChanges(...): the slots to upload again, and the indirection texels
+void SdfBrickMap_GetChanges(const SdfBrickMap* m,const int** slots,int* numSlots,const int** bricks,int* numBricks);
+void SdfBrickMap_ClearChanges(SdfBrickMap* m);
+// The uniforms of "sdf_brick_map.glsl": iBrickMapOrigin = (origin, brick size), iBrickMapSize = (bricks per axis, error bound),
+// iBrickMapTextures = (width of the indirection texture, 1/its size, slots per row of the atlas), iBrickMapAtlasTexel = (1/atlas size, 0, 0)
+void SdfBrickMap_GetUniforms(const SdfBrickMap* m,float* origin4,float* size4,float* textures4,float* atlasTexel4);
+
+static __inline float SdfBrickMap_GetVoxelSize(const SdfBrickMap* m) {return m->brick_size/(SDF_BRICK_SIZE-1);}
+static __inline float SdfBrickMap_GetErrorBound(const SdfBrickMap* m) {return 0.8660254f*SdfBrickMap_GetVoxelSize(m);}  // sqrt(3)/2
+static __inline float SdfBrickMap_GetStep(const SdfBrickMap* m,const float* pos) {
+    const float e = SdfBrickMap_GetErrorBound(m);
+    float g[3],l[3],dd = 0.f,d;
+    int b[3],j,brick,slot,inside = 1;
+    if (m->num_bricks==0) return 0.f;
+    for (j=0;j<3;j++) {
+        float c;
+        g[j] = (pos[j]-m->origin[j])/m->brick_size;
+        b[j] = (int) floorf(g[j]);
+        if (b[j]<0) b[j] = 0;
+        else if (b[j]>m->resolution[j]-1) b[j] = m->resolution[j]-1;
+        l[j] = g[j]-b[j];
+        if (l[j]<0.f || l[j]>1.f) inside = 0;
+        c = l[j]-0.5f;dd+=c*c;
+    }
+    brick = (b[2]*m->resolution[1]+b[1])*m->resolution[0]+b[0];
+    // The distance at the center of the brick minus the distance from it is a lower bound anywhere
+    d = m->center_distances[brick]-sqrtf(dd)*m->brick_size;
+    slot = m->brick_slots[brick];
+    if (slot>=0 && inside) {
+        // Trilinear interpolation of the brick, minus its error bound
+        const float* s = &m->atlas[(size_t)slot*SDF_BRICK_SAMPLES];
+        float f[3],c[2][2],v;
+        int i[3],y,z;
+        for (j=0;j<3;j++) {
+            const float x = l[j]*(SDF_BRICK_SIZE-1);
+            i[j] = (int) x;
+            if (i[j]>SDF_BRICK_SIZE-2) i[j] = SDF_BRICK_SIZE-2;
+            f[j] = x-i[j];
+        }
+        for (z=0;z<2;z++) {
+            for (y=0;y<2;y++) {
+                const float* v0 = &s[((i[2]+z)*SDF_BRICK_SIZE+i[1]+y)*SDF_BRICK_SIZE+i[0]];
+                c[z][y] = v0[0]+(v0[1]-v0[0])*f[0];
+            }
+        }
+        c[0][0]+=(c[0][1]-c[0][0])*f[1];
+        c[1][0]+=(c[1][1]-c[1][0])*f[1];
+        v = c[0][0]+(c[1][0]-c[0][0])*f[2];
+        v-=e+fabsf(v)*SDF_BRICK_MAP_RELATIVE_ERROR;
+        if (d<v) d = v;
+    }
+    return d>2.f*e ? d-e : 0.f;     // (the true distance is >=d: after the step it's still >=e)
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BRICK_MAP_H_
+
+#ifdef SDF_BRICK_MAP_IMPLEMENTATION
+#ifndef SDF_BRICK_MAP_IMPLEMENTATION_GUARD
+#define SDF_BRICK_MAP_IMPLEMENTATION_GUARD
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sdf_bvh.h"    // SdfBvh_GetObjectBounds(...)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void SdfBrickMap_Init(SdfBrickMap* m) {memset(m,0,sizeof(SdfBrickMap));m->lru_first = m->lru_last = -1;}
+void SdfBrickMap_Destroy(SdfBrickMap* m) {
+    if (m->center_distances) free(m->center_distances);
+    if (m->brick_slots) free(m->brick_slots);
+    if (m->brick_flags) free(m->brick_flags);
+    if (m->changed_bricks) free(m->changed_bricks);
+    if (m->atlas) free(m->atlas);
+    if (m->slot_bricks) free(m->slot_bricks);
+    if (m->slot_frames) free(m->slot_frames);
+    if (m->slot_prev) free(m->slot_prev);
+    if (m->slot_next) free(m->slot_next);
+    if (m->changed_slots) free(m->changed_slots);
+    if (m->slot_changed) free(m->slot_changed);
+    if (m->requests) free(m->requests);
+    if (m->bakes) free(m->bakes);
+    SdfBrickMap_Init(m);
+}
+
+typedef struct {
+    SdfBrickMap* map;
+    SdfBakeMapFunc func;
+    void* user_data;
+    const float* boxes;int num_boxes;   // SdfBrickMap_Invalidate(...) only
+    int b0[3],b1[3];                    // (the bricks within reach of the boxes)
+} SdfBrickMapJob;
+// A brick is baked only if a surface can be closer to it than 2 voxels (the steps in the others are never smaller than
+// that, so baking them wouldn't make the steps any longer)
+static __inline float SdfBrickMap_GetSurfaceRadius(const SdfBrickMap* m) {return 0.8660254f*m->brick_size+2.f*SdfBrickMap_GetVoxelSize(m);}
+// One z layer of bricks per task
+static void SdfBrickMap_ClassifyLayer(int z,int workerIndex,void* userData) {
+    const SdfBrickMapJob* job = (const SdfBrickMapJob*) userData;
+    SdfBrickMap* m = job->map;
+    const float radius = SdfBrickMap_GetSurfaceRadius(m);
+    int x,y,brick = z*m->resolution[0]*m->resolution[1];
+    float pos[3];
+    (void)workerIndex;
+    pos[2] = m->origin[2]+(z+0.5f)*m->brick_size;
+    for (y=0;y<m->resolution[1];y++) {
+        pos[1] = m->origin[1]+(y+0.5f)*m->brick_size;
+        for (x=0;x<m->resolution[0];x++,brick++) {
+            pos[0] = m->origin[0]+(x+0.5f)*m->brick_size;
+            m->center_distances[brick] = job->func(pos,job->user_data);
+            m->brick_flags[brick] = fabsf(m->center_distances[brick])<radius ? SDF_BRICK_FLAG_SURFACE : 0;
+        }
+    }
+}
+
+int SdfBrickMap_Create(SdfBrickMap* m,const float* bmin,const float* bmax,float brickSize,size_t budgetBytes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler) {
+    SdfBrickMapJob job;
+    int i,j;
+    SdfBrickMap_Destroy(m);
+    if (!(brickSize>0.f)) return 0;
+    m->brick_size = brickSize;
+    for (j=0;j<3;j++) {
+        // Whole number of bricks, centered on [bmin,bmax]
+        m->resolution[j] = (int) ceilf((bmax[j]-bmin[j])/brickSize);
+        if (m->resolution[j]<1) m->resolution[j] = 1;
+        m->origin[j] = 0.5f*(bmin[j]+bmax[j])-0.5f*m->resolution[j]*brickSize;
+    }
+    m->num_bricks = m->resolution[0]*m->resolution[1]*m->resolution[2];
+    m->num_slots = (int) (budgetBytes/(SDF_BRICK_SAMPLES*2));
+    if (m->num_slots<1) m->num_slots = 1;
+    m->center_distances = (float*) malloc(m->num_bricks*sizeof(float));
+    m->brick_slots = (int*) malloc(m->num_bricks*sizeof(int));
+    m->brick_flags = (unsigned char*) malloc(m->num_bricks);
+    m->changed_bricks = (int*) malloc(m->num_bricks*sizeof(int));
+    m->atlas = (float*) malloc((size_t)m->num_slots*SDF_BRICK_SAMPLES*sizeof(float));
+    m->slot_bricks = (int*) malloc(m->num_slots*sizeof(int));
+    m->slot_frames = (unsigned*) malloc(m->num_slots*sizeof(unsigned));
+    m->slot_prev = (int*) malloc(m->num_slots*sizeof(int));
+    m->slot_next = (int*) malloc(m->num_slots*sizeof(int));
+    m->changed_slots = (int*) malloc(m->num_slots*sizeof(int));
+    m->slot_changed = (unsigned char*) malloc(m->num_slots);
+    m->bakes = (int*) malloc(m->num_slots*sizeof(int));
+    if (!m->center_distances || !m->brick_slots || !m->brick_flags || !m->changed_bricks || !m->atlas || !m->slot_bricks ||
+        !m->slot_frames || !m->slot_prev || !m->slot_next || !m->changed_slots || !m->slot_changed || !m->bakes) {
+        SdfBrickMap_Destroy(m);return 0;
+    }
+    for (i=0;i<m->num_bricks;i++) m->brick_slots[i] = -1;
+    for (i=0;i<m->num_slots;i++) {
+        // Every slot is free, in the least recently used list
+        m->slot_bricks[i] = -1;m->slot_frames[i] = 0;
+        m->slot_prev[i] = i-1;m->slot_next[i] = i+1<m->num_slots ? i+1 : -1;
+    }
+    m->lru_first = 0;m->lru_last = m->num_slots-1;
+    memset(m->slot_changed,0,m->num_slots);
+
+    job.map = m;job.func = map;job.user_data = userData;
+    if (scheduler) CpuScheduler_Run(scheduler,m->resolution[2],&SdfBrickMap_ClassifyLayer,&job);
+    else {
+        int z;
+        for (z=0;z<m->resolution[2];z++) SdfBrickMap_ClassifyLayer(z,0,&job);
+    }
+    for (i=0;i<m->num_bricks;i++) {
+        if (m->brick_flags[i]&SDF_BRICK_FLAG_SURFACE) ++m->num_surface_bricks;
+        if (m->max_center_distance<fabsf(m->center_distances[i])) m->max_center_distance = fabsf(m->center_distances[i]);
+    }
+    // The whole indirection grid is new
+    for (i=0;i<m->num_bricks;i++) {m->changed_bricks[i] = i;m->brick_flags[i]|=SDF_BRICK_FLAG_CHANGED;}
+    m->num_changed_bricks = m->num_bricks;
+    return 1;
+}
+
+static void SdfBrickMap_MarkBrickChanged(SdfBrickMap* m,int brick) {
+    if (m->brick_flags[brick]&SDF_BRICK_FLAG_CHANGED) return;
+    m->brick_flags[brick]|=SDF_BRICK_FLAG_CHANGED;
+    m->changed_bricks[m->num_changed_bricks++] = brick;
+}
+// Moves slot to the front of the least recently used list
+static void SdfBrickMap_TouchSlot(SdfBrickMap* m,int slot) {
+    m->slot_frames[slot] = m->frame;
+    if (m->lru_first==slot) return;
+    // unlink
+    m->slot_next[m->slot_prev[slot]] = m->slot_next[slot];
+    if (m->slot_next[slot]>=0) m->slot_prev[m->slot_next[slot]] = m->slot_prev[slot];
+    else m->lru_last = m->slot_prev[slot];
+    // link first
+    m->slot_prev[slot] = -1;m->slot_next[slot] = m->lru_first;
+    m->slot_prev[m->lru_first] = slot;
+    m->lru_first = slot;
+}
+
+// Moves slot to the back of the least recently used list, free (the next one to be used)
+static void SdfBrickMap_FreeSlot(SdfBrickMap* m,int slot) {
+    m->brick_slots[m->slot_bricks[slot]] = -1;
+    m->slot_bricks[slot] = -1;m->slot_frames[slot] = 0;
+    --m->num_resident;
+    if (m->lru_last==slot) return;
+    // unlink
+    if (m->slot_prev[slot]>=0) m->slot_next[m->slot_prev[slot]] = m->slot_next[slot];
+    else m->lru_first = m->slot_next[slot];
+    m->slot_prev[m->slot_next[slot]] = m->slot_prev[slot];
+    // link last
+    m->slot_next[slot] = -1;m->slot_prev[slot] = m->lru_last;
+    m->slot_next[m->lru_last] = slot;
+    m->lru_last = slot;
+}
+
+static void SdfBrickMap_BakeBrick(int taskIndex,int workerIndex,void* userData) {
+    const SdfBrickMapJob* job = (const SdfBrickMapJob*) userData;
+    const SdfBrickMap* m = job->map;
+    const int slot = m->bakes[taskIndex],brick = m->slot_bricks[slot];
+    const int bx = brick%m->resolution[0],by = (brick/m->resolution[0])%m->resolution[1],bz = brick/(m->resolution[0]*m->resolution[1]);
+    const float h = SdfBrickMap_GetVoxelSize(m);
+    float* d = &m->atlas[(size_t)slot*SDF_BRICK_SAMPLES];
+    float pos[3];int x,y,z;
+    (void)workerIndex;
+    for (z=0;z<SDF_BRICK_SIZE;z++) {
+        pos[2] = m->origin[2]+bz*m->brick_size+z*h;
+        for (y=0;y<SDF_BRICK_SIZE;y++) {
+            pos[1] = m->origin[1]+by*m->brick_size+y*h;
+            for (x=0;x<SDF_BRICK_SIZE;x++) {
+                pos[0] = m->origin[0]+bx*m->brick_size+x*h;
+                *d++ = job->func(pos,job->user_data);
+            }
+        }
+    }
+}
+
+typedef struct {float distance;int brick;} SdfBrickMapRequest;
+static int SdfBrickMap_CompareRequests(const void* a,const void* b) {
+    const float da = ((const SdfBrickMapRequest*)a)->distance,db = ((const SdfBrickMapRequest*)b)->distance;
+    return da<db ? -1 : (da>db ? 1 : 0);
+}
+
+int SdfBrickMap_Update(SdfBrickMap* m,const float* pos,float radius,int maxBakes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler) {
+    const float halfDiagonal = 0.8660254f*m->brick_size;
+    SdfBrickMapRequest* requests;
+    int b0[3],b1[3],x,y,z,j,i,numRequests = 0,numBakes = 0;
+    memset(&m->stats,0,sizeof(SdfBrickMapStats));
+    if (m->num_bricks==0) return 0;
+    ++m->frame;
+    for (j=0;j<3;j++) {
+        b0[j] = (int) floorf((pos[j]-radius-m->origin[j])/m->brick_size);
+        b1[j] = (int) floorf((pos[j]+radius-m->origin[j])/m->brick_size);
+        if (b0[j]<0) b0[j] = 0;
+        if (b1[j]>m->resolution[j]-1) b1[j] = m->resolution[j]-1;
+        if (b0[j]>b1[j]) return 0;
+    }
+    // The surface bricks within radius
+    {
+        const int count = (b1[0]-b0[0]+1)*(b1[1]-b0[1]+1)*(b1[2]-b0[2]+1);
+        if (count>m->requests_capacity) {
+            void* p = realloc(m->requests,count*sizeof(SdfBrickMapRequest));
+            if (!p) return 0;
+            m->requests = p;m->requests_capacity = count;
+        }
+    }
+    requests = (SdfBrickMapRequest*) m->requests;
+    for (z=b0[2];z<=b1[2];z++) {
+        const float dz = m->origin[2]+(z+0.5f)*m->brick_size-pos[2];
+        for (y=b0[1];y<=b1[1];y++) {
+            const float dy = m->origin[1]+(y+0.5f)*m->brick_size-pos[1];
+            int brick = (z*m->resolution[1]+y)*m->resolution[0]+b0[0];
+            for (x=b0[0];x<=b1[0];x++,brick++) {
+                const float dx = m->origin[0]+(x+0.5f)*m->brick_size-pos[0];
+                const float distance = sqrtf(dx*dx+dy*dy+dz*dz);
+                if (!(m->brick_flags[brick]&SDF_BRICK_FLAG_SURFACE) || distance>radius+halfDiagonal) continue;
+                requests[numRequests].distance = distance;requests[numRequests].brick = brick;
+                ++numRequests;
+            }
+        }
+    }
+    qsort(requests,numRequests,sizeof(SdfBrickMapRequest),&SdfBrickMap_CompareRequests);
+    m->stats.requested = numRequests;
+    // The resident ones first, so that they can't be evicted by this update
+    for (i=numRequests-1;i>=0;i--) {
+        const int slot = m->brick_slots[requests[i].brick];
+        if (slot>=0) {SdfBrickMap_TouchSlot(m,slot);++m->stats.hits;}
+    }
+    for (i=0;i<numRequests;i++) {
+        const int brick = requests[i].brick;
+        int slot;
+        if (m->brick_slots[brick]>=0) continue;
+        slot = m->lru_last;
+        if ((maxBakes>0 && numBakes>=maxBakes) || m->slot_frames[slot]==m->frame) {++m->stats.missed;continue;}
+        if (m->slot_bricks[slot]>=0) {
+            m->brick_slots[m->slot_bricks[slot]] = -1;
+            SdfBrickMap_MarkBrickChanged(m,m->slot_bricks[slot]);
+            ++m->stats.evicted;
+        }
+        else ++m->num_resident;
+        m->slot_bricks[slot] = brick;m->brick_slots[brick] = slot;
+        SdfBrickMap_MarkBrickChanged(m,brick);
+        if (!m->slot_changed[slot]) {m->slot_changed[slot] = 1;m->changed_slots[m->num_changed_slots++] = slot;}
+        SdfBrickMap_TouchSlot(m,slot);
+        m->bakes[numBakes++] = slot;
+    }
+    m->stats.baked = numBakes;
+    if (numBakes>0) {
+        SdfBrickMapJob job;
+        const unsigned long long startTime = CpuScheduler_GetTimeNs();
+        job.map = m;job.func = map;job.user_data = userData;
+        if (scheduler) CpuScheduler_Run(scheduler,numBakes,&SdfBrickMap_BakeBrick,&job);
+        else {for (i=0;i<numBakes;i++) SdfBrickMap_BakeBrick(i,0,&job);}
+        m->stats.bake_ms = (CpuScheduler_GetTimeNs()-startTime)*1e-6;
+    }
+    return numBakes;
+}
+
+// One z layer of the bricks within reach per task: the ones closer to a box than their distance to the surfaces (plus
+// the half diagonal of the brick twice: their samples are that far from the center, and the distances there can be that
+// much bigger) are evaluated again
+static void SdfBrickMap_InvalidateLayer(int taskIndex,int workerIndex,void* userData) {
+    const SdfBrickMapJob* job = (const SdfBrickMapJob*) userData;
+    SdfBrickMap* m = job->map;
+    const float margin = 1.7320508f*m->brick_size+SdfBrickMap_GetVoxelSize(m);    // (plus a voxel: map() is not exact)
+    const int z = job->b0[2]+taskIndex;
+    float pos[3];
+    int x,y,i,j;
+    (void)workerIndex;
+    pos[2] = m->origin[2]+(z+0.5f)*m->brick_size;
+    for (y=job->b0[1];y<=job->b1[1];y++) {
+        int brick = (z*m->resolution[1]+y)*m->resolution[0]+job->b0[0];
+        pos[1] = m->origin[1]+(y+0.5f)*m->brick_size;
+        for (x=job->b0[0];x<=job->b1[0];x++,brick++) {
+            const float reach = fabsf(m->center_distances[brick])+margin;
+            pos[0] = m->origin[0]+(x+0.5f)*m->brick_size;
+            for (i=0;i<job->num_boxes;i++) {
+                const float* box = &job->boxes[i*6];
+                float dd = 0.f;
+                for (j=0;j<3;j++) {
+                    const float d = pos[j]<box[j] ? box[j]-pos[j] : (pos[j]>box[3+j] ? pos[j]-box[3+j] : 0.f);
+                    dd+=d*d;
+                }
+                if (dd<reach*reach) break;
+            }
+            if (i==job->num_boxes) continue;
+            m->center_distances[brick] = job->func(pos,job->user_data);
+            m->brick_flags[brick]|=SDF_BRICK_FLAG_DIRTY;
+        }
+    }
+}
+
+int SdfBrickMap_Invalidate(SdfBrickMap* m,const float* boxes,int numBoxes,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler) {
+    const unsigned long long startTime = CpuScheduler_GetTimeNs();
+    const float radius = SdfBrickMap_GetSurfaceRadius(m);
+    const float reach = m->max_center_distance+1.7320508f*m->brick_size+SdfBrickMap_GetVoxelSize(m);
+    SdfBrickMapJob job;
+    int i,j,x,y,z,numBakes = 0;
+    memset(&m->edit_stats,0,sizeof(SdfBrickMapEditStats));
+    if (m->num_bricks==0 || numBoxes<=0) return 0;
+    // The bricks within reach of any box (no distance can change farther than the max distance to the surfaces)
+    for (j=0;j<3;j++) {
+        float lo = boxes[j],hi = boxes[3+j];
+        for (i=1;i<numBoxes;i++) {
+            if (lo>boxes[i*6+j]) lo = boxes[i*6+j];
+            if (hi<boxes[i*6+3+j]) hi = boxes[i*6+3+j];
+        }
+        job.b0[j] = (int) floorf((lo-reach-m->origin[j])/m->brick_size);
+        job.b1[j] = (int) floorf((hi+reach-m->origin[j])/m->brick_size);
+        if (job.b0[j]<0) job.b0[j] = 0;
+        if (job.b1[j]>m->resolution[j]-1) job.b1[j] = m->resolution[j]-1;
+        if (job.b0[j]>job.b1[j]) return 0;
+    }
+    job.map = m;job.func = map;job.user_data = userData;
+    job.boxes = boxes;job.num_boxes = numBoxes;
+    if (scheduler) CpuScheduler_Run(scheduler,job.b1[2]-job.b0[2]+1,&SdfBrickMap_InvalidateLayer,&job);
+    else {for (i=0;i<=job.b1[2]-job.b0[2];i++) SdfBrickMap_InvalidateLayer(i,0,&job);}
+    m->edit_stats.checked = (job.b1[0]-job.b0[0]+1)*(job.b1[1]-job.b0[1]+1)*(job.b1[2]-job.b0[2]+1);
+    // New surface flags, and the resident bricks to bake again
+    for (z=job.b0[2];z<=job.b1[2];z++) {
+        for (y=job.b0[1];y<=job.b1[1];y++) {
+            int brick = (z*m->resolution[1]+y)*m->resolution[0]+job.b0[0];
+            for (x=job.b0[0];x<=job.b1[0];x++,brick++) {
+                const float d = fabsf(m->center_distances[brick]);
+                const int slot = m->brick_slots[brick];
+                if (!(m->brick_flags[brick]&SDF_BRICK_FLAG_DIRTY)) continue;
+                m->brick_flags[brick]&=~SDF_BRICK_FLAG_DIRTY;
+                ++m->edit_stats.dirty;
+                if (m->max_center_distance<d) m->max_center_distance = d;
+                if (m->brick_flags[brick]&SDF_BRICK_FLAG_SURFACE) --m->num_surface_bricks;
+                if (d<radius) {m->brick_flags[brick]|=SDF_BRICK_FLAG_SURFACE;++m->num_surface_bricks;}
+                else m->brick_flags[brick]&=~SDF_BRICK_FLAG_SURFACE;
+                SdfBrickMap_MarkBrickChanged(m,brick);
+                if (slot<0) continue;
+                if (!(m->brick_flags[brick]&SDF_BRICK_FLAG_SURFACE)) {SdfBrickMap_FreeSlot(m,slot);++m->edit_stats.freed;continue;}
+                if (!m->slot_changed[slot]) {m->slot_changed[slot] = 1;m->changed_slots[m->num_changed_slots++] = slot;}
+                m->bakes[numBakes++] = slot;
+            }
+        }
+    }
+    if (numBakes>0) {
+        if (scheduler) CpuScheduler_Run(scheduler,numBakes,&SdfBrickMap_BakeBrick,&job);
+        else {for (i=0;i<numBakes;i++) SdfBrickMap_BakeBrick(i,0,&job);}
+    }
+    m->edit_stats.rebaked = numBakes;
+    m->edit_stats.ms = (CpuScheduler_GetTimeNs()-startTime)*1e-6;
+    return numBakes;
+}
+
+// The bounds of the object of primitive i (the objects start with a union, like in SdfBake_GetSceneBounds(...))
+static int SdfBrickMap_GetObjectBox(const SdfScene* s,int i,float* box) {
+    int first = i,end = i+1;
+    while (first>0 && s->primitives[first].op!=SDF_OP_UNION) --first;
+    while (end<s->num_primitives && s->primitives[end].op!=SDF_OP_UNION) ++end;
+    return SdfBvh_GetObjectBounds(s,first,end,box,box+3);
+}
+int SdfBrickMap_InvalidateSceneChanges(SdfBrickMap* m,const SdfScene* before,const SdfScene* after,SdfBakeMapFunc map,void* userData,CpuScheduler* scheduler) {
+    float boxes[SDF_BRICK_MAP_MAX_EDIT_BOXES*6],box[6];
+    const int n = before->num_primitives>after->num_primitives ? before->num_primitives : after->num_primitives;
+    int i,j,k,numBoxes = 0;
+    for (i=0;i<n;i++) {
+        if (i<before->num_primitives && i<after->num_primitives &&
+            memcmp(&before->primitives[i],&after->primitives[i],sizeof(SdfPrimitive))==0) continue;
+        // The object of the primitive before and after (an added or removed primitive changes the last object)
+        for (k=0;k<2;k++) {
+            const SdfScene* s = k==0 ? before : after;
+            if (s->num_primitives==0) continue;
+            if (!SdfBrickMap_GetObjectBox(s,i<s->num_primitives ? i : s->num_primitives-1,box)) return -1;
+            if (numBoxes>0 && memcmp(box,&boxes[(numBoxes-1)*6],sizeof(box))==0) continue;
+            if (numBoxes==SDF_BRICK_MAP_MAX_EDIT_BOXES) {
+                // Too many: the new ones grow the last one
+                float* last = &boxes[(numBoxes-1)*6];
+                for (j=0;j<3;j++) {
+                    if (last[j]>box[j]) last[j] = box[j];
+                    if (last[3+j]<box[3+j]) last[3+j] = box[3+j];
+                }
+                continue;
+            }
+            memcpy(&boxes[numBoxes*6],box,sizeof(box));
+            ++numBoxes;
+        }
+    }
+    return SdfBrickMap_Invalidate(m,boxes,numBoxes,map,userData,scheduler);
+}
+
+void SdfBrickMap_GetMemoryUsage(const SdfBrickMap* m,size_t* atlasBytes,size_t* indirectionBytes) {
+    int w,h;
+    SdfBrickMap_GetAtlasTextureSize(m,&w,&h);
+    if (atlasBytes) *atlasBytes = (size_t)w*h*2;
+    SdfBrickMap_GetIndirectionTextureSize(m,&w,&h);
+    if (indirectionBytes) *indirectionBytes = (size_t)w*h*4*sizeof(float);
+}
+size_t SdfBrickMap_GetDenseMemoryUsage(const SdfBrickMap* m) {
+    size_t samples = 1;
+    int j;
+    for (j=0;j<3;j++) samples*=(size_t)m->resolution[j]*(SDF_BRICK_SIZE-1)+1;
+    return samples*2;
+}
+
+void SdfBrickMap_GetIndirectionTextureSize(const SdfBrickMap* m,int* width,int* height) {
+    *width = m->num_bricks<SDF_BRICK_MAP_INDIRECTION_WIDTH ? m->num_bricks : SDF_BRICK_MAP_INDIRECTION_WIDTH;
+    *height = (m->num_bricks+SDF_BRICK_MAP_INDIRECTION_WIDTH-1)/SDF_BRICK_MAP_INDIRECTION_WIDTH;
+    if (*width<1) *width = 1;
+    if (*height<1) *height = 1;
+}
+void SdfBrickMap_GetIndirectionTexel(const SdfBrickMap* m,int brick,float* texel4) {
+    texel4[0] = (float)m->brick_slots[brick];texel4[1] = m->center_distances[brick];
+    texel4[2] = texel4[3] = 0.f;
+}
+void SdfBrickMap_GetIndirectionTexels(const SdfBrickMap* m,float* texels) {
+    int width,height,i;
+    SdfBrickMap_GetIndirectionTextureSize(m,&width,&height);
+    memset(texels,0,width*height*4*sizeof(float));
+    for (i=0;i<m->num_bricks;i++) SdfBrickMap_GetIndirectionTexel(m,i,&texels[i*4]);
+}
+static __inline int SdfBrickMap_GetSlotsPerRow(void) {return SDF_BRICK_MAP_ATLAS_WIDTH/(SDF_BRICK_SIZE*SDF_BRICK_SIZE);}
+void SdfBrickMap_GetAtlasTextureSize(const SdfBrickMap* m,int* width,int* height) {
+    const int columns = SdfBrickMap_GetSlotsPerRow();
+    *width = (m->num_slots<columns ? m->num_slots : columns)*SDF_BRICK_SIZE*SDF_BRICK_SIZE;
+    *height = (m->num_slots+columns-1)/columns*SDF_BRICK_SIZE;
+    if (*width<1) *width = 1;
+    if (*height<1) *height = 1;
+}
+void SdfBrickMap_GetSlotRect(const SdfBrickMap* m,int slot,int* x,int* y) {
+    const int columns = SdfBrickMap_GetSlotsPerRow();
+    (void)m;
+    *x = (slot%columns)*SDF_BRICK_SIZE*SDF_BRICK_SIZE;*y = (slot/columns)*SDF_BRICK_SIZE;
+}
+void SdfBrickMap_GetSlotTexels(const SdfBrickMap* m,int slot,float* texels) {
+    const float* s = &m->atlas[(size_t)slot*SDF_BRICK_SAMPLES];
+    int y,z;
+    for (z=0;z<SDF_BRICK_SIZE;z++) {
+        for (y=0;y<SDF_BRICK_SIZE;y++) {
+            memcpy(&texels[(y*SDF_BRICK_SIZE+z)*SDF_BRICK_SIZE],&s[(z*SDF_BRICK_SIZE+y)*SDF_BRICK_SIZE],SDF_BRICK_SIZE*sizeof(float));
+        }
+    }
+}
+void SdfBrickMap_GetChanges(const SdfBrickMap* m,const int** slots,int* numSlots,const int** bricks,int* numBricks) {
+    *slots = m->changed_slots;*numSlots = m->num_changed_slots;
+    *bricks = m->changed_bricks;*numBricks = m->num_changed_bricks;
+}
+void SdfBrickMap_ClearChanges(SdfBrickMap* m) {
+    int i;
+    for (i=0;i<m->num_changed_slots;i++) m->slot_changed[m->changed_slots[i]] = 0;
+    for (i=0;i<m->num_changed_bricks;i++) m->brick_flags[m->changed_bricks[i]]&=~SDF_BRICK_FLAG_CHANGED;
+    m->num_changed_slots = m->num_changed_bricks = 0;
+}
+void SdfBrickMap_GetUniforms(const SdfBrickMap* m,float* origin4,float* size4,float* textures4,float* atlasTexel4) {
+    int j,width,height;
+    for (j=0;j<3;j++) {origin4[j] = m->origin[j];size4[j] = (float)m->resolution[j];}
+    origin4[3] = m->brick_size;
+    size4[3] = SdfBrickMap_GetErrorBound(m);
+    SdfBrickMap_GetIndirectionTextureSize(m,&width,&height);
+    textures4[0] = (float)width;textures4[1] = 1.f/width;textures4[2] = 1.f/height;
+    textures4[3] = (float)SdfBrickMap_GetSlotsPerRow();
+    SdfBrickMap_GetAtlasTextureSize(m,&width,&height);
+    atlasTexel4[0] = 1.f/width;atlasTexel4[1] = 1.f/height;atlasTexel4[2] = atlasTexel4[3] = 0.f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BRICK_MAP_IMPLEMENTATION_GUARD
+#endif //SDF_BRICK_MAP_IMPLEMENTATION
@@ -0,0 +1,325 @@
+#ifndef SDF_BVH_H_
+#define SDF_BVH_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only bounding volume hierarchy over the objects of an SdfScene ("sdf_scene.h"),
+ * so that map() evaluates only the objects whose bounds are closer than the distance found so far, instead of all of them.
+ * -> Every object (a SDF_OP_UNION primitive and the primitives combined with it) gets an axis aligned bounding box.
+ *    Objects that can't be bounded (planes, infinite repetitions) get infinite bounds: they are always evaluated (first).
+ * -> The tree is built on the CPU (median split of the longest axis) and flattened depth-first: every internal node stores
+ *    the index of the node that follows its subtree, so that it can be walked without a stack (GLSL ES 1.00 has none):
+ *        node = 0;
+ *        while (node<numNodes) {
+ *            if (distance(pos,bounds)>=res.x) node = skip;              // (leaves: node+1)
+ *            else {if (leaf) res = opU(res,objects of the leaf);++node;}
+ *        }
+ *    This is conservative: the distance to the bounds of an object is a lower bound of the distance to its surface.
+ * -> The objects used with REDUCE_NUM_OBJECTS have their own tree, stored first (num_reduced_nodes).
+ * -> The primitives are reordered, so that the ones of every leaf are contiguous (SdfBvh::primitives).
+ *
+ * The GPU walks it in the map() of "sdf_scene.glsl" (USE_SCENE_BVH): SdfBvh_GetTexels(...) writes the reordered primitives
+ * (same 4 texels per primitive as SdfScene_GetTexels(...)) followed by the nodes (2 texels per node), in a single texture.
+ * The CPU renderer walks the same tree (see CpuRenderer::scene_bvh in "cpu_renderer.h").
+*/
+
+/* USAGE:
+ * Define SDF_BVH_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file
+ * (and SDF_SCENE_IMPLEMENTATION in one of your .c files too).
+ *
+ * SdfBvh bvh;
+ * SdfBvh_Init(&bvh);
+ * SdfBvh_Build(&bvh,&scene);               // again after every change of the scene (e.g. when scene.revision changes)
+ * // texture upload:
+ * SdfBvh_GetTextureSize(&bvh,&w,&h);       // (RGBA texels)
+ * SdfBvh_GetTexels(&bvh,texels);           // texels = w*h*4 floats; uniform iBvhInfo = (SdfBvh_GetFirstNodeTexel(&bvh),num_reduced_nodes,num_nodes,0)
+ * SdfBvh_Destroy(&bvh);
+*/
+
+#include "sdf_scene.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SDF_BVH_MAX_LEAF_OBJECTS
+#define SDF_BVH_MAX_LEAF_OBJECTS (2)
+#endif
+#define SDF_BVH_TEXELS_PER_NODE (2)
+#define SDF_BVH_INFINITY (1e30f)        // bounds of the objects that can't be bounded
+
+typedef struct {
+    float min[3],max[3];                // bounds
+    int skip;                           // index of the node after this subtree (leaves: the next node)
+    int first_primitive;                // leaves: the first primitive in SdfBvh::primitives (<0 for internal nodes)
+    int num_primitives;                 // leaves: the number of primitives (whole objects)
+} SdfBvhNode;
+
+typedef struct {
+    SdfBvhNode* nodes;                  // depth-first order: the tree of the REDUCE_NUM_OBJECTS objects, then the tree of the others
+    int num_nodes,num_reduced_nodes;
+    SdfPrimitive* primitives;           // the primitives of the scene in leaf order
+    int num_primitives,num_reduced_primitives;
+    int num_objects,num_unbounded_objects;
+    int nodes_capacity,primitives_capacity;
+} SdfBvh;
+
+void SdfBvh_Init(SdfBvh* b);
+void SdfBvh_Destroy(SdfBvh* b);
+int  SdfBvh_Build(SdfBvh* b,const SdfScene* s);     // returns 0 on failure (out of memory)
+int  SdfBvh_GetPrimitiveBounds(const SdfPrimitive* p,float* bmin,float* bmax);     // world space; returns 0 if it can't be bounded
+int  SdfBvh_GetObjectBounds(const SdfScene* s,int first,int end,float* bmin,float* bmax);  // the object of primitives [first,end) (same)
+int  SdfBvh_GetFirstNodeTexel(const SdfBvh* b);     // index of the first texel of the nodes (after the primitives)
+void SdfBvh_GetTextureSize(const SdfBvh* b,int* width,int* height);    // at least 1x1
+void SdfBvh_GetTexels(const SdfBvh* b,float* texels);                  // width*height*4 floats (see SdfBvh_GetTextureSize(...))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BVH_H_
+
+#ifdef SDF_BVH_IMPLEMENTATION
+#ifndef SDF_BVH_IMPLEMENTATION_GUARD
+#define SDF_BVH_IMPLEMENTATION_GUARD
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float min[3],max[3],center[3];
+    int first_primitive,num_primitives;     // in the scene
+} SdfBvhObject;
+
+void SdfBvh_Init(SdfBvh* b) {memset(b,0,sizeof(SdfBvh));}
+void SdfBvh_Destroy(SdfBvh* b) {
+    if (b->nodes) free(b->nodes);
+    if (b->primitives) free(b->primitives);
+    SdfBvh_Init(b);
+}
+
+static float SdfBvh_Max(float a,float b) {return a>b ? a : b;}
+static float SdfBvh_Min(float a,float b) {return a<b ? a : b;}
+int SdfBvh_GetPrimitiveBounds(const SdfPrimitive* p,float* bmin,float* bmax) {
+    // Half extents of the primitive around p = pos-position, before the modifier (see SdfPrimitiveType)
+    const float* a = p->params;
+    float lo[3] = {0.f,0.f,0.f},hi[3] = {0.f,0.f,0.f},margin = 0.f;
+    int i;
+    switch (p->type) {
+    case SDF_PRIMITIVE_SPHERE:          hi[0] = hi[1] = hi[2] = a[0];break;
+    case SDF_PRIMITIVE_BOX:             hi[0] = a[0];hi[1] = a[1];hi[2] = a[2];break;
+    case SDF_PRIMITIVE_ROUND_BOX:       hi[0] = a[0]+a[3];hi[1] = a[1]+a[3];hi[2] = a[2]+a[3];break;
+    case SDF_PRIMITIVE_TORUS:
+    case SDF_PRIMITIVE_TORUS82:
+    case SDF_PRIMITIVE_TORUS88:         hi[0] = hi[2] = a[0]+a[1];hi[1] = a[1];break;
+    case SDF_PRIMITIVE_CAPSULE:
+        for (i=0;i<3;i++) {lo[i] = SdfBvh_Min(0.f,a[i])-a[3];hi[i] = SdfBvh_Max(0.f,a[i])+a[3];}
+        break;
+    case SDF_PRIMITIVE_TRI_PRISM:       hi[0] = hi[1] = a[0];hi[2] = a[1];break;
+    case SDF_PRIMITIVE_CYLINDER:
+    case SDF_PRIMITIVE_CYLINDER6:       hi[0] = hi[2] = a[0];hi[1] = a[1];break;
+    case SDF_PRIMITIVE_CONE:            // apex at the origin, base at y = -params[2]
+        if (a[0]<=0.f) return 0;
+        hi[0] = hi[2] = a[2]*a[1]/a[0];lo[1] = -a[2];
+        break;
+    case SDF_PRIMITIVE_HEX_PRISM:       hi[0] = a[0]*1.1548f;hi[1] = a[0];hi[2] = a[1];break;
+    case SDF_PRIMITIVE_PYRAMID4:        // octahedron of half widths params[2]/params[0] (x,z) and params[2]/params[1] (y)
+        if (a[0]<=0.f || a[1]<=0.f) return 0;
+        hi[0] = hi[2] = a[2]/a[0];hi[1] = a[2]/a[1];
+        break;
+    case SDF_PRIMITIVE_CONE_SECTION: {  // (the radii are measured orthogonally to the side)
+        const float si = a[0]!=0.f ? 0.5f*(a[1]-a[2])/a[0] : 1.f;
+        if (si*si>=1.f) return 0;
+        hi[0] = hi[2] = SdfBvh_Max(a[1],a[2])/sqrtf(1.f-si*si);hi[1] = a[0];
+        }
+        break;
+    case SDF_PRIMITIVE_ELLIPSOID:       hi[0] = a[0];hi[1] = a[1];hi[2] = a[2];break;
+    default:                            return 0;   // SDF_PRIMITIVE_PLANE
+    }
+    for (i=0;i<3;i++) {if (lo[i]==0.f) lo[i] = -hi[i];}     // (symmetric shapes)
+    switch (p->modifier) {
+    case SDF_MODIFIER_TWIST: {
+        // p.xz is rotated around y, and the primitive is evaluated at (rotated xz,p.y): its z extent is along y
+        const float r = sqrtf(SdfBvh_Max(lo[0]*lo[0],hi[0]*hi[0])+SdfBvh_Max(lo[1]*lo[1],hi[1]*hi[1]));
+        const float y0 = lo[2],y1 = hi[2];
+        lo[0] = lo[2] = -r;hi[0] = hi[2] = r;lo[1] = y0;hi[1] = y1;
+        }
+        break;
+    case SDF_MODIFIER_DISPLACE:         // |displacement| <= params[0], then divided by the distance scale
+        if (p->modifier_params[2]==0.f) return 0;
+        margin = fabsf(p->modifier_params[0]/p->modifier_params[2]);
+        break;
+    case SDF_MODIFIER_POLAR_REPEAT:
+    case SDF_MODIFIER_REPEAT:           return 0;
+    default:                            break;
+    }
+    for (i=0;i<3;i++) {bmin[i] = p->position[i]+lo[i]-margin;bmax[i] = p->position[i]+hi[i]+margin;}
+    return 1;
+}
+
+int SdfBvh_GetObjectBounds(const SdfScene* s,int first,int end,float* bmin,float* bmax) {
+    float pmin[3],pmax[3],margin = 0.f;
+    int i,j;
+    if (!SdfBvh_GetPrimitiveBounds(&s->primitives[first],bmin,bmax)) return 0;
+    for (i=first+1;i<end;i++) {
+        const SdfPrimitive* p = &s->primitives[i];
+        if (p->op!=SDF_OP_SMOOTH_UNION) continue;  // (subtractions and intersections can only shrink the object)
+        if (!SdfBvh_GetPrimitiveBounds(p,pmin,pmax)) return 0;
+        for (j=0;j<3;j++) {bmin[j] = SdfBvh_Min(bmin[j],pmin[j]);bmax[j] = SdfBvh_Max(bmax[j],pmax[j]);}
+        margin+=0.25f*fabsf(p->blend);             // smin(a,b,k) >= min(a,b)-k/4
+    }
+    for (j=0;j<3;j++) {bmin[j]-=margin;bmax[j]+=margin;}
+    return 1;
+}
+static int SdfBvh_GetObject(const SdfScene* s,int first,int end,SdfBvhObject* o) {
+    int j;
+    o->first_primitive = first;o->num_primitives = end-first;
+    if (!SdfBvh_GetObjectBounds(s,first,end,o->min,o->max)) return 0;
+    for (j=0;j<3;j++) o->center[j] = 0.5f*(o->min[j]+o->max[j]);
+    return 1;
+}
+
+static SdfBvhNode* SdfBvh_AddNode(SdfBvh* b) {
+    SdfBvhNode* n;
+    if (b->num_nodes==b->nodes_capacity) {
+        const int capacity = b->nodes_capacity>0 ? b->nodes_capacity*2 : 64;
+        SdfBvhNode* nodes = (SdfBvhNode*) realloc(b->nodes,capacity*sizeof(SdfBvhNode));
+        if (!nodes) return NULL;
+        b->nodes = nodes;b->nodes_capacity = capacity;
+    }
+    n = &b->nodes[b->num_nodes++];
+    memset(n,0,sizeof(SdfBvhNode));
+    n->first_primitive = -1;
+    return n;
+}
+// Appends a leaf with the objects [objects,objects+numObjects) (it copies their primitives)
+static int SdfBvh_AddLeaf(SdfBvh* b,const SdfScene* s,const SdfBvhObject* objects,int numObjects,const float* bmin,const float* bmax) {
+    SdfBvhNode* n = SdfBvh_AddNode(b);
+    int i;
+    if (!n) return 0;
+    memcpy(n->min,bmin,3*sizeof(float));memcpy(n->max,bmax,3*sizeof(float));
+    n->skip = b->num_nodes;
+    n->first_primitive = b->num_primitives;
+    for (i=0;i<numObjects;i++) {
+        memcpy(&b->primitives[b->num_primitives],&s->primitives[objects[i].first_primitive],objects[i].num_primitives*sizeof(SdfPrimitive));
+        b->num_primitives+=objects[i].num_primitives;
+    }
+    n->num_primitives = b->num_primitives-n->first_primitive;
+    return 1;
+}
+// Reorders objects so that objects[k] has the k-th center along axis (the smaller ones come before it)
+static void SdfBvh_SelectNth(SdfBvhObject* objects,int count,int k,int axis) {
+    int lo = 0,hi = count-1;
+    while (lo<hi) {
+        const float pivot = objects[(lo+hi)/2].center[axis];
+        int i = lo,j = hi;
+        while (i<=j) {
+            while (objects[i].center[axis]<pivot) ++i;
+            while (objects[j].center[axis]>pivot) --j;
+            if (i<=j) {const SdfBvhObject tmp = objects[i];objects[i] = objects[j];objects[j] = tmp;++i;--j;}
+        }
+        if (k<=j) hi = j;
+        else if (k>=i) lo = i;
+        else break;
+    }
+}
+static int SdfBvh_BuildNode(SdfBvh* b,const SdfScene* s,SdfBvhObject* objects,int count) {
+    float bmin[3],bmax[3],cmin[3],cmax[3];
+    int i,j,axis,nodeIndex;
+    for (j=0;j<3;j++) {bmin[j] = cmin[j] = SDF_BVH_INFINITY;bmax[j] = cmax[j] = -SDF_BVH_INFINITY;}
+    for (i=0;i<count;i++) {
+        for (j=0;j<3;j++) {
+            bmin[j] = SdfBvh_Min(bmin[j],objects[i].min[j]);bmax[j] = SdfBvh_Max(bmax[j],objects[i].max[j]);
+            cmin[j] = SdfBvh_Min(cmin[j],objects[i].center[j]);cmax[j] = SdfBvh_Max(cmax[j],objects[i].center[j]);
+        }
+    }
+    if (count<=SDF_BVH_MAX_LEAF_OBJECTS) return SdfBvh_AddLeaf(b,s,objects,count,bmin,bmax);
+    axis = 0;
+    for (j=1;j<3;j++) {if (cmax[j]-cmin[j]>cmax[axis]-cmin[axis]) axis = j;}
+    nodeIndex = b->num_nodes;
+    if (!SdfBvh_AddNode(b)) return 0;
+    memcpy(b->nodes[nodeIndex].min,bmin,3*sizeof(float));memcpy(b->nodes[nodeIndex].max,bmax,3*sizeof(float));
+    SdfBvh_SelectNth(objects,count,count/2,axis);
+    if (!SdfBvh_BuildNode(b,s,objects,count/2) || !SdfBvh_BuildNode(b,s,objects+count/2,count-count/2)) return 0;
+    b->nodes[nodeIndex].skip = b->num_nodes;   // (b->nodes can have been reallocated)
+    return 1;
+}
+// Adds the tree of the objects of primitives [first,end) (end must be the start of an object, or the end of the scene)
+static int SdfBvh_BuildTree(SdfBvh* b,const SdfScene* s,SdfBvhObject* objects,int first,int end) {
+    const float infMin[3] = {-SDF_BVH_INFINITY,-SDF_BVH_INFINITY,-SDF_BVH_INFINITY};
+    const float infMax[3] = {SDF_BVH_INFINITY,SDF_BVH_INFINITY,SDF_BVH_INFINITY};
+    int numObjects = 0,i = first;
+    while (i<end) {
+        int objEnd = i+1;
+        while (objEnd<end && s->primitives[objEnd].op!=SDF_OP_UNION) ++objEnd;
+        if (SdfBvh_GetObject(s,i,objEnd,&objects[numObjects])) ++numObjects;
+        else {
+            // unbounded: a leaf of its own, before the tree (the ground plane is a good first distance estimate)
+            if (!SdfBvh_AddLeaf(b,s,&objects[numObjects],1,infMin,infMax)) return 0;
+            ++b->num_unbounded_objects;
+        }
+        ++b->num_objects;
+        i = objEnd;
+    }
+    return numObjects>0 ? SdfBvh_BuildNode(b,s,objects,numObjects) : 1;
+}
+int SdfBvh_Build(SdfBvh* b,const SdfScene* s) {
+    int numReduced = SdfScene_GetNumPrimitives(s,1);
+    SdfBvhObject* objects;
+    int ok;
+    while (numReduced<s->num_primitives && s->primitives[numReduced].op!=SDF_OP_UNION) ++numReduced;    // (whole objects)
+    b->num_nodes = b->num_reduced_nodes = 0;
+    b->num_primitives = b->num_reduced_primitives = 0;
+    b->num_objects = b->num_unbounded_objects = 0;
+    if (b->primitives_capacity<s->num_primitives) {
+        SdfPrimitive* primitives = (SdfPrimitive*) realloc(b->primitives,s->num_primitives*sizeof(SdfPrimitive));
+        if (!primitives) return 0;
+        b->primitives = primitives;b->primitives_capacity = s->num_primitives;
+    }
+    if (s->num_primitives==0) return 1;
+    objects = (SdfBvhObject*) malloc(s->num_primitives*sizeof(SdfBvhObject));
+    if (!objects) return 0;
+    ok = SdfBvh_BuildTree(b,s,objects,0,numReduced);
+    b->num_reduced_nodes = b->num_nodes;
+    b->num_reduced_primitives = b->num_primitives;
+    if (ok) ok = SdfBvh_BuildTree(b,s,objects,numReduced,s->num_primitives);
+    free(objects);
+    return ok;
+}
+
+int SdfBvh_GetFirstNodeTexel(const SdfBvh* b) {return b->num_primitives*SDF_SCENE_TEXELS_PER_PRIMITIVE;}
+void SdfBvh_GetTextureSize(const SdfBvh* b,int* width,int* height) {
+    const int numTexels = SdfBvh_GetFirstNodeTexel(b)+b->num_nodes*SDF_BVH_TEXELS_PER_NODE;
+    const int w = numTexels<SDF_SCENE_MAX_TEXTURE_WIDTH ? numTexels : SDF_SCENE_MAX_TEXTURE_WIDTH;
+    *width = w>0 ? w : 1;
+    *height = w>0 ? (numTexels+w-1)/w : 1;
+}
+void SdfBvh_GetTexels(const SdfBvh* b,float* texels) {
+    // Node texels: (min, internal nodes: skip, leaves: number of primitives); (max, leaves: first primitive, internal nodes: -1)
+    int width,height,i;
+    float* t;
+    SdfBvh_GetTextureSize(b,&width,&height);
+    memset(texels,0,width*height*4*sizeof(float));
+    for (i=0;i<b->num_primitives;i++) SdfPrimitive_GetTexels(&b->primitives[i],&texels[i*SDF_SCENE_TEXELS_PER_PRIMITIVE*4]);
+    t = &texels[SdfBvh_GetFirstNodeTexel(b)*4];
+    for (i=0;i<b->num_nodes;i++,t+=SDF_BVH_TEXELS_PER_NODE*4) {
+        const SdfBvhNode* n = &b->nodes[i];
+        memcpy(&t[0],n->min,3*sizeof(float));
+        memcpy(&t[4],n->max,3*sizeof(float));
+        t[3] = (float) (n->first_primitive>=0 ? n->num_primitives : n->skip);
+        t[7] = (float) n->first_primitive;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_BVH_IMPLEMENTATION_GUARD
+#endif //SDF_BVH_IMPLEMENTATION
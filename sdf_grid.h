@@ -0,0 +1,287 @@
+#ifndef SDF_GRID_H_
+#define SDF_GRID_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only uniform grid over the objects of an SdfScene ("sdf_scene.h"): every cell lists the
+ * objects whose bounds (see SdfBvh_GetObjectBounds(...) in "sdf_bvh.h") overlap it, grown by a margin.
+ * It's an alternative to SdfBvh for scenes with very many small objects: finding the objects near a point costs a single
+ * lookup instead of a tree walk.
+ * -> map(pos) only evaluates the objects of the cell of pos (and the unbounded ones, like planes, that are always evaluated).
+ *    Any other object is at least margin+(distance from pos to the faces of the cell) away, so the result is clamped to that:
+ *    it's never smaller than margin in empty space, so marching never stalls at the faces of the cells.
+ * -> castRay() knows the direction of the ray, so it steps cell by cell (like a 3D DDA): no other object can be hit before
+ *    the ray exits the cell (grown by margin), and the steps through empty cells jump straight to the next one.
+ * -> The REDUCE_NUM_OBJECTS objects come first in every cell list, so that the walk of a cell can stop at the first other one.
+ * -> The distances that map() reports are exact only up to the margin: softshadow() uses them for its penumbrae, so the
+ *    margin should be bigger than the widest penumbra distance (that's why it defaults to a whole cell).
+ *
+ * The GPU uses it in the map() of "sdf_scene.glsl" (USE_SCENE_GRID): SdfGrid_GetTexels(...) writes the reordered primitives
+ * (same 4 texels per primitive as SdfScene_GetTexels(...)), then 1 texel per cell, then 1 texel per entry of the cell lists,
+ * in a single 2D float texture (GLES2/WebGL1 have no 3D textures nor texture buffers).
+ * The CPU renderer uses the same grid (see CpuRenderer::scene_grid in "cpu_renderer.h").
+*/
+
+/* USAGE:
+ * Define SDF_GRID_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file
+ * (and SDF_BVH_IMPLEMENTATION and SDF_SCENE_IMPLEMENTATION in one of your .c files too).
+ *
+ * SdfGrid grid;
+ * SdfGrid_Init(&grid);
+ * SdfGrid_Build(&grid,&scene,0.f,0.f);     // cell size and margin (<=0 means automatic); again after every change of the scene
+ * // texture upload:
+ * SdfGrid_GetTextureSize(&grid,&w,&h);     // (RGBA texels)
+ * SdfGrid_GetTexels(&grid,texels);         // texels = w*h*4 floats; uniforms: see SdfGrid_GetUniforms(...)
+ * SdfGrid_Destroy(&grid);
+*/
+
+#include "sdf_scene.h"
+#include "sdf_bvh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SDF_GRID_MAX_RESOLUTION
+#define SDF_GRID_MAX_RESOLUTION (256)   // max number of cells per axis
+#endif
+#ifndef SDF_GRID_CELLS_PER_OBJECT
+#define SDF_GRID_CELLS_PER_OBJECT (1.f) // automatic cell size: number of cells per bounded object
+#endif
+
+typedef struct {
+    int first_primitive;                // in SdfGrid::primitives
+    int num_primitives;
+} SdfGridObject;
+
+typedef struct {
+    float origin[3];                    // min corner of cell (0,0,0)
+    float cell_size;
+    float margin;                       // the bounds of the objects are grown by margin before they are assigned to the cells
+    int resolution[3];                  // number of cells per axis
+    int* cell_offsets;                  // num_cells+1 entries: the list of cell i is cell_objects[cell_offsets[i]..cell_offsets[i+1])
+    int* cell_objects;                  // indices in objects (in increasing order inside every cell)
+    int num_cells,num_cell_objects;
+    int max_cell_objects;               // the length of the longest list (see MAX_GRID_CELL_OBJECTS in "sdf_scene.glsl")
+    SdfGridObject* objects;             // the bounded objects: the REDUCE_NUM_OBJECTS ones first
+    int num_objects,num_reduced_objects;
+    SdfPrimitive* primitives;           // the unbounded objects (the REDUCE_NUM_OBJECTS ones first), then the bounded ones
+    int num_primitives;
+    int num_unbounded_primitives,num_reduced_unbounded_primitives;
+    int num_unbounded_objects;
+    int cell_offsets_capacity,cell_objects_capacity,objects_capacity,primitives_capacity;
+} SdfGrid;
+
+void SdfGrid_Init(SdfGrid* g);
+void SdfGrid_Destroy(SdfGrid* g);
+int  SdfGrid_Build(SdfGrid* g,const SdfScene* s,float cellSize,float margin);  // <=0 means automatic; returns 0 on failure (out of memory)
+size_t SdfGrid_GetMemoryUsage(const SdfGrid* g);    // bytes of the cell lists (cell_offsets and cell_objects)
+int  SdfGrid_GetFirstCellTexel(const SdfGrid* g);   // index of the first texel of the cells (after the primitives)
+void SdfGrid_GetTextureSize(const SdfGrid* g,int* width,int* height);  // at least 1x1
+void SdfGrid_GetTexels(const SdfGrid* g,float* texels);                // width*height*4 floats (see SdfGrid_GetTextureSize(...))
+// The uniforms of "sdf_scene.glsl" (USE_SCENE_GRID): iGridInfo = (first cell texel, number of unbounded primitives,
+// number of unbounded primitives with REDUCE_NUM_OBJECTS, index of the first primitive not used by REDUCE_NUM_OBJECTS),
+// iGridOrigin = (origin, cell size), iGridSize = (resolution, margin)
+void SdfGrid_GetUniforms(const SdfGrid* g,float* info4,float* origin4,float* size4);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_GRID_H_
+
+#ifdef SDF_GRID_IMPLEMENTATION
+#ifndef SDF_GRID_IMPLEMENTATION_GUARD
+#define SDF_GRID_IMPLEMENTATION_GUARD
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void SdfGrid_Init(SdfGrid* g) {memset(g,0,sizeof(SdfGrid));}
+void SdfGrid_Destroy(SdfGrid* g) {
+    if (g->cell_offsets) free(g->cell_offsets);
+    if (g->cell_objects) free(g->cell_objects);
+    if (g->objects) free(g->objects);
+    if (g->primitives) free(g->primitives);
+    SdfGrid_Init(g);
+}
+
+// Grows *pArray (of elementSize bytes per element) to at least count elements
+static int SdfGrid_Reserve(void** pArray,int* capacity,int count,size_t elementSize) {
+    void* a;
+    if (count<=*capacity) return 1;
+    a = realloc(*pArray,count*elementSize);
+    if (!a) return 0;
+    *pArray = a;*capacity = count;
+    return 1;
+}
+// Appends the primitives [first,end) of s to g->primitives
+static void SdfGrid_AddPrimitives(SdfGrid* g,const SdfScene* s,int first,int end) {
+    memcpy(&g->primitives[g->num_primitives],&s->primitives[first],(end-first)*sizeof(SdfPrimitive));
+    g->num_primitives+=end-first;
+}
+// The cells overlapped by [bmin,bmax] grown by the margin
+static void SdfGrid_GetCellRange(const SdfGrid* g,const float* bmin,const float* bmax,int* c0,int* c1) {
+    int j;
+    for (j=0;j<3;j++) {
+        c0[j] = (int) floorf((bmin[j]-g->margin-g->origin[j])/g->cell_size);
+        c1[j] = (int) floorf((bmax[j]+g->margin-g->origin[j])/g->cell_size);
+        if (c0[j]<0) c0[j] = 0;
+        if (c1[j]>g->resolution[j]-1) c1[j] = g->resolution[j]-1;
+    }
+}
+
+int SdfGrid_Build(SdfGrid* g,const SdfScene* s,float cellSize,float margin) {
+    int numReduced = SdfScene_GetNumPrimitives(s,1);
+    float* bounds = NULL;           // 6 floats per bounded object
+    float bmin[3],bmax[3],size = 0.f;
+    int pass,i,j,x,y,z;
+    while (numReduced<s->num_primitives && s->primitives[numReduced].op!=SDF_OP_UNION) ++numReduced;    // (whole objects)
+    g->num_cells = g->num_cell_objects = g->max_cell_objects = 0;
+    g->num_objects = g->num_reduced_objects = 0;
+    g->num_primitives = g->num_unbounded_primitives = g->num_reduced_unbounded_primitives = 0;
+    g->num_unbounded_objects = 0;
+    for (j=0;j<3;j++) {g->origin[j] = 0.f;g->resolution[j] = 0;}
+    if (!SdfGrid_Reserve((void**)&g->primitives,&g->primitives_capacity,s->num_primitives,sizeof(SdfPrimitive)) ||
+        !SdfGrid_Reserve((void**)&g->objects,&g->objects_capacity,s->num_primitives,sizeof(SdfGridObject))) return 0;
+    if (s->num_primitives>0) {
+        bounds = (float*) malloc(s->num_primitives*6*sizeof(float));
+        if (!bounds) return 0;
+    }
+
+    // The unbounded objects go first (pass 0), then the bounded ones (pass 1). Both in scene order: the reduced ones first
+    for (j=0;j<3;j++) {bmin[j] = SDF_BVH_INFINITY;bmax[j] = -SDF_BVH_INFINITY;}
+    for (pass=0;pass<2;pass++) {
+        i = 0;
+        while (i<s->num_primitives) {
+            int objEnd = i+1;
+            float* ob = &bounds[6*g->num_objects];
+            while (objEnd<s->num_primitives && s->primitives[objEnd].op!=SDF_OP_UNION) ++objEnd;
+            if (!SdfBvh_GetObjectBounds(s,i,objEnd,ob,ob+3)) {
+                if (pass==0) {
+                    SdfGrid_AddPrimitives(g,s,i,objEnd);
+                    if (i<numReduced) g->num_reduced_unbounded_primitives = g->num_primitives;
+                    ++g->num_unbounded_objects;
+                }
+            }
+            else if (pass==1) {
+                SdfGridObject* o = &g->objects[g->num_objects++];
+                o->first_primitive = g->num_primitives;o->num_primitives = objEnd-i;
+                SdfGrid_AddPrimitives(g,s,i,objEnd);
+                if (i<numReduced) g->num_reduced_objects = g->num_objects;
+                for (j=0;j<3;j++) {
+                    if (bmin[j]>ob[j]) bmin[j] = ob[j];
+                    if (bmax[j]<ob[3+j]) bmax[j] = ob[3+j];
+                    size+=ob[3+j]-ob[j];
+                }
+            }
+            i = objEnd;
+        }
+        if (pass==0) g->num_unbounded_primitives = g->num_primitives;
+    }
+
+    if (g->num_objects>0) {
+        // Automatic cell size: about SDF_GRID_CELLS_PER_OBJECT cells per object (flat extents count as the average object size)
+        size/=3*g->num_objects;
+        if (cellSize<=0.f) {
+            float volume = 1.f;
+            for (j=0;j<3;j++) volume*=(bmax[j]-bmin[j]>size ? bmax[j]-bmin[j] : size);
+            cellSize = powf(volume/(g->num_objects*SDF_GRID_CELLS_PER_OBJECT),1.f/3.f);
+        }
+        if (margin<=0.f) margin = cellSize;
+        for (j=0;j<3;j++) {
+            const float extent = bmax[j]-bmin[j]+2.f*margin;
+            if (extent>cellSize*SDF_GRID_MAX_RESOLUTION) cellSize = extent/(SDF_GRID_MAX_RESOLUTION-1);   // (rounding)
+        }
+        g->cell_size = cellSize;g->margin = margin;
+        g->num_cells = 1;
+        for (j=0;j<3;j++) {
+            // the objects are at least margin away from the faces of the grid, so marching never stalls at them
+            g->origin[j] = bmin[j]-margin;
+            g->resolution[j] = (int) ceilf((bmax[j]-bmin[j]+2.f*margin)/cellSize);
+            if (g->resolution[j]<1) g->resolution[j] = 1;
+            g->num_cells*=g->resolution[j];
+        }
+    }
+
+    // Cell lists: count, prefix sum, fill (in object order, so the reduced objects come first in every list)
+    if (!SdfGrid_Reserve((void**)&g->cell_offsets,&g->cell_offsets_capacity,g->num_cells+1,sizeof(int))) {free(bounds);return 0;}
+    memset(g->cell_offsets,0,(g->num_cells+1)*sizeof(int));
+    for (i=0;i<g->num_objects;i++) {
+        int c0[3],c1[3];
+        SdfGrid_GetCellRange(g,&bounds[6*i],&bounds[6*i+3],c0,c1);
+        for (z=c0[2];z<=c1[2];z++) for (y=c0[1];y<=c1[1];y++) for (x=c0[0];x<=c1[0];x++)
+            ++g->cell_offsets[1+x+g->resolution[0]*(y+g->resolution[1]*z)];
+    }
+    for (i=0;i<g->num_cells;i++) {
+        const int count = g->cell_offsets[i+1];
+        if (g->max_cell_objects<count) g->max_cell_objects = count;
+        g->cell_offsets[i+1]+=g->cell_offsets[i];
+    }
+    g->num_cell_objects = g->cell_offsets[g->num_cells];
+    if (!SdfGrid_Reserve((void**)&g->cell_objects,&g->cell_objects_capacity,g->num_cell_objects,sizeof(int))) {free(bounds);return 0;}
+    for (i=0;i<g->num_objects;i++) {
+        int c0[3],c1[3];
+        SdfGrid_GetCellRange(g,&bounds[6*i],&bounds[6*i+3],c0,c1);
+        for (z=c0[2];z<=c1[2];z++) for (y=c0[1];y<=c1[1];y++) for (x=c0[0];x<=c1[0];x++)
+            g->cell_objects[g->cell_offsets[x+g->resolution[0]*(y+g->resolution[1]*z)]++] = i;
+    }
+    for (i=g->num_cells;i>0;i--) g->cell_offsets[i] = g->cell_offsets[i-1];    // (the fill shifted every offset to the next cell)
+    g->cell_offsets[0] = 0;
+    if (bounds) free(bounds);
+    return 1;
+}
+
+size_t SdfGrid_GetMemoryUsage(const SdfGrid* g) {
+    return (g->num_cells>0 ? (g->num_cells+1)*sizeof(int) : 0)+g->num_cell_objects*sizeof(int);
+}
+
+int SdfGrid_GetFirstCellTexel(const SdfGrid* g) {return g->num_primitives*SDF_SCENE_TEXELS_PER_PRIMITIVE;}
+void SdfGrid_GetTextureSize(const SdfGrid* g,int* width,int* height) {
+    const int numTexels = SdfGrid_GetFirstCellTexel(g)+g->num_cells+g->num_cell_objects;
+    const int w = numTexels<SDF_SCENE_MAX_TEXTURE_WIDTH ? numTexels : SDF_SCENE_MAX_TEXTURE_WIDTH;
+    *width = w>0 ? w : 1;
+    *height = w>0 ? (numTexels+w-1)/w : 1;
+}
+void SdfGrid_GetTexels(const SdfGrid* g,float* texels) {
+    // Cell texels: (first entry texel, number of entries); entry texels: (first primitive, number of primitives) of an object
+    const int firstEntryTexel = SdfGrid_GetFirstCellTexel(g)+g->num_cells;
+    int width,height,i;
+    float* t;
+    SdfGrid_GetTextureSize(g,&width,&height);
+    memset(texels,0,width*height*4*sizeof(float));
+    for (i=0;i<g->num_primitives;i++) SdfPrimitive_GetTexels(&g->primitives[i],&texels[i*SDF_SCENE_TEXELS_PER_PRIMITIVE*4]);
+    t = &texels[SdfGrid_GetFirstCellTexel(g)*4];
+    for (i=0;i<g->num_cells;i++,t+=4) {
+        t[0] = (float) (firstEntryTexel+g->cell_offsets[i]);
+        t[1] = (float) (g->cell_offsets[i+1]-g->cell_offsets[i]);
+    }
+    for (i=0;i<g->num_cell_objects;i++,t+=4) {
+        const SdfGridObject* o = &g->objects[g->cell_objects[i]];
+        t[0] = (float) o->first_primitive;
+        t[1] = (float) o->num_primitives;
+    }
+}
+void SdfGrid_GetUniforms(const SdfGrid* g,float* info4,float* origin4,float* size4) {
+    int j;
+    info4[0] = (float) SdfGrid_GetFirstCellTexel(g);
+    info4[1] = (float) g->num_unbounded_primitives;
+    info4[2] = (float) g->num_reduced_unbounded_primitives;
+    info4[3] = (float) (g->num_reduced_objects<g->num_objects ? g->objects[g->num_reduced_objects].first_primitive : g->num_primitives);
+    for (j=0;j<3;j++) {origin4[j] = g->origin[j];size4[j] = (float) g->resolution[j];}
+    origin4[3] = g->cell_size;
+    size4[3] = g->margin;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_GRID_IMPLEMENTATION_GUARD
+#endif //SDF_GRID_IMPLEMENTATION
@@ -0,0 +1,230 @@
+// Generic map() of a scene stored as data in iSceneTexture (see SdfScene in "sdf_scene.h": it explains the format, and
+// its ids must match the ones below). It replaces the built-in map() of "signed_distance_shapes.glsl" when USE_SCENE_TEXTURE
+// is defined: every primitive is read from the texture and evaluated in a loop, so changing the scene needs no compilation.
+// With USE_SCENE_BVH too, the texture is the one of SdfBvh ("sdf_bvh.h"): the primitives in leaf order, then the nodes of
+// the bounding volume hierarchy, that map() walks to evaluate only the objects closer than the distance found so far.
+// With USE_SCENE_GRID instead, the texture is the one of SdfGrid ("sdf_grid.h"): the primitives, then the cells of a uniform
+// grid and their object lists: map() only evaluates the objects of the cell of pos, and mapRay() (used by castRay()) also
+// clamps the step to the exit of the cell, so that rays walk the grid cell by cell.
+// It needs the functions of "sdf_primitives.glsl".
+
+#define SDF_PRIMITIVE_PLANE         0
+#define SDF_PRIMITIVE_SPHERE        1
+#define SDF_PRIMITIVE_BOX           2
+#define SDF_PRIMITIVE_ROUND_BOX     3
+#define SDF_PRIMITIVE_TORUS         4
+#define SDF_PRIMITIVE_CAPSULE       5
+#define SDF_PRIMITIVE_TRI_PRISM     6
+#define SDF_PRIMITIVE_CYLINDER      7
+#define SDF_PRIMITIVE_CONE          8
+#define SDF_PRIMITIVE_TORUS82       9
+#define SDF_PRIMITIVE_TORUS88       10
+#define SDF_PRIMITIVE_CYLINDER6     11
+#define SDF_PRIMITIVE_HEX_PRISM     12
+#define SDF_PRIMITIVE_PYRAMID4      13
+#define SDF_PRIMITIVE_CONE_SECTION  14
+#define SDF_PRIMITIVE_ELLIPSOID     15
+
+#define SDF_OP_UNION                0
+#define SDF_OP_SUBTRACT             1
+#define SDF_OP_INTERSECT            2
+#define SDF_OP_SMOOTH_UNION         3
+
+#define SDF_MODIFIER_NONE           0
+#define SDF_MODIFIER_TWIST          1
+#define SDF_MODIFIER_DISPLACE       2
+#define SDF_MODIFIER_POLAR_REPEAT   3
+#define SDF_MODIFIER_REPEAT         4
+
+#ifndef MAX_SCENE_PRIMITIVES
+#define MAX_SCENE_PRIMITIVES 1024   // (loops need a constant bound in GLSL ES 1.00)
+#endif
+#ifndef MAX_BVH_NODE_VISITS
+#define MAX_BVH_NODE_VISITS 4096    // per map() call (USE_SCENE_BVH)
+#endif
+#ifndef MAX_GRID_CELL_OBJECTS
+#define MAX_GRID_CELL_OBJECTS 64    // the longer cell lists are truncated (USE_SCENE_GRID: see SdfGrid::max_cell_objects)
+#endif
+
+uniform sampler2D iSceneTexture;    // RGBA float texture, nearest filtering: 4 texels per primitive
+uniform vec4 iSceneInfo;            // .x = number of primitives .y = number of primitives with REDUCE_NUM_OBJECTS .zw = texture size (texels)
+
+vec4 sceneTexel( float index )
+{
+    float y = floor( (index+0.5)/iSceneInfo.z );
+    float x = index - y*iSceneInfo.z;
+    return texture2D( iSceneTexture, (vec2(x,y)+0.5)/iSceneInfo.zw );
+}
+
+float sdScenePrimitive( int type, vec3 p, vec4 a )
+{
+    if( type==SDF_PRIMITIVE_PLANE )         return sdPlane( p );
+    if( type==SDF_PRIMITIVE_SPHERE )        return sdSphere( p, a.x );
+    if( type==SDF_PRIMITIVE_BOX )           return sdBox( p, a.xyz );
+    if( type==SDF_PRIMITIVE_ROUND_BOX )     return udRoundBox( p, a.xyz, a.w );
+    if( type==SDF_PRIMITIVE_TORUS )         return sdTorus( p, a.xy );
+    if( type==SDF_PRIMITIVE_CAPSULE )       return sdCapsule( p, vec3(0.0), a.xyz, a.w );
+    if( type==SDF_PRIMITIVE_TRI_PRISM )     return sdTriPrism( p, a.xy );
+    if( type==SDF_PRIMITIVE_CYLINDER )      return sdCylinder( p, a.xy );
+    if( type==SDF_PRIMITIVE_CONE )          return sdCone( p, a.xyz );
+    if( type==SDF_PRIMITIVE_TORUS82 )       return sdTorus82( p, a.xy );
+    if( type==SDF_PRIMITIVE_TORUS88 )       return sdTorus88( p, a.xy );
+    if( type==SDF_PRIMITIVE_CYLINDER6 )     return sdCylinder6( p, a.xy );
+    if( type==SDF_PRIMITIVE_HEX_PRISM )     return sdHexPrism( p, a.xy );
+    if( type==SDF_PRIMITIVE_PYRAMID4 )      return sdPryamid4( p, a.xyz );
+    if( type==SDF_PRIMITIVE_CONE_SECTION )  return sdConeSection( p, a.x, a.y, a.z );
+    if( type==SDF_PRIMITIVE_ELLIPSOID )     return sdEllipsoid( p, a.xyz );
+    return 1e10;
+}
+
+// The objects of primitives [first,first+count)
+vec2 mapScenePrimitives( in vec3 pos, float first, float count )
+{
+    vec2 res = vec2( 1e10, -1.0 );
+    float objDist = 1e10;           // current object (see SdfOp)
+    float objMat = -1.0;
+    for( int i=0; i<MAX_SCENE_PRIMITIVES; i++ )
+    {
+        float base = 4.0*(first+float(i));
+        vec4 t0, t1, mp;
+        vec3 p;
+        float d;
+        int op, modifier;
+        if( float(i)>=count ) break;
+        t0 = sceneTexel( base );          // type, op, material, modifier
+        t1 = sceneTexel( base+1.0 );      // position, blend
+        op = int( t0.y+0.5 );
+        modifier = int( t0.w+0.5 );
+        mp = modifier!=SDF_MODIFIER_NONE ? sceneTexel( base+3.0 ) : vec4(0.0);
+        p = pos-t1.xyz;
+        if( modifier==SDF_MODIFIER_TWIST )
+        {
+            float c = cos( mp.x*p.y+mp.y );
+            float s = sin( mp.x*p.y+mp.y );
+            p = vec3( mat2(c,-s,s,c)*p.xz, p.y );
+        }
+        else if( modifier==SDF_MODIFIER_POLAR_REPEAT )
+        {
+            vec2 c = mod( vec2( atan(p.x,p.z)/6.2831, mp.z+mp.w*length(p) ), mp.xy ) - 0.5*mp.xy;
+            p = vec3( c.x, p.y, c.y );
+        }
+        else if( modifier==SDF_MODIFIER_REPEAT ) p = opRep( p, mp.xyz );
+        d = sdScenePrimitive( int( t0.x+0.5 ), p, sceneTexel( base+2.0 ) );
+        if( modifier==SDF_MODIFIER_TWIST ) d *= mp.z;
+        else if( modifier==SDF_MODIFIER_DISPLACE ) d = d*mp.z + mp.x*sin(mp.y*pos.x)*sin(mp.y*pos.y)*sin(mp.y*pos.z);
+
+        if( op==SDF_OP_UNION )
+        {
+            res = opU( res, vec2( objDist, objMat ) );
+            objDist = d;
+            objMat = t0.z;
+        }
+        else if( op==SDF_OP_SUBTRACT )      objDist = opS( objDist, d );
+        else if( op==SDF_OP_INTERSECT )     objDist = max( objDist, d );
+        else                                objDist = smin( objDist, d, t1.w );
+    }
+    return opU( res, vec2( objDist, objMat ) );
+}
+
+#ifdef USE_SCENE_BVH
+uniform vec4 iBvhInfo;              // .x = first node texel .y = number of nodes with REDUCE_NUM_OBJECTS .z = number of nodes
+
+vec2 map( in vec3 pos )
+{
+    vec2 res = vec2( 1e10, -1.0 );
+#if REDUCE_NUM_OBJECTS
+    float numNodes = iBvhInfo.y;
+#else
+    float numNodes = iBvhInfo.z;
+#endif
+    float node = 0.0;
+    for( int i=0; i<MAX_BVH_NODE_VISITS; i++ )
+    {
+        // t0 = (min, skip or number of primitives), t1 = (max, first primitive or -1)
+        vec4 t0, t1;
+        if( node>=numNodes ) break;
+        t0 = sceneTexel( iBvhInfo.x+2.0*node );
+        t1 = sceneTexel( iBvhInfo.x+2.0*node+1.0 );
+        if( length( max( max( t0.xyz-pos, pos-t1.xyz ), 0.0 ) )>=res.x )
+            node = t1.w<0.0 ? t0.w : node+1.0;  // the whole subtree is farther than res.x
+        else
+        {
+            if( t1.w>=0.0 ) res = opU( res, mapScenePrimitives( pos, t1.w, t0.w ) );
+            node += 1.0;
+        }
+    }
+    return res;   // res.y just controls the rendering material
+}
+#elif defined(USE_SCENE_GRID)
+uniform vec4 iGridInfo;             // .x = first cell texel .y = number of unbounded primitives (.z with REDUCE_NUM_OBJECTS) .w = end of the REDUCE_NUM_OBJECTS primitives
+uniform vec4 iGridOrigin;           // .xyz = min corner of the grid .w = cell size
+uniform vec4 iGridSize;             // .xyz = number of cells per axis .w = margin
+
+// The objects of the cell of pos, clamped to the distance up to which no other object can be: from pos, or along rd
+vec2 mapGrid( in vec3 pos, in vec3 rd, in bool alongRay )
+{
+#if REDUCE_NUM_OBJECTS
+    vec2 res = mapScenePrimitives( pos, 0.0, iGridInfo.z );
+#else
+    vec2 res = mapScenePrimitives( pos, 0.0, iGridInfo.y );
+#endif
+    vec3 c = (pos-iGridOrigin.xyz)/iGridOrigin.w;
+    vec3 ird = (2.0*step( 0.0, rd )-1.0)/max( abs(rd), vec3(1e-8) );
+    vec3 lo, hi;
+    float free;
+    if( all( greaterThanEqual( c, vec3(0.0) ) ) && all( lessThan( c, iGridSize.xyz ) ) )
+    {
+        vec3 cell = floor( c );
+        vec4 ct = sceneTexel( iGridInfo.x+cell.x+iGridSize.x*(cell.y+iGridSize.y*cell.z) );    // (first entry texel, number of entries)
+        for( int i=0; i<MAX_GRID_CELL_OBJECTS; i++ )
+        {
+            vec4 e;
+            if( float(i)>=ct.y ) break;
+            e = sceneTexel( ct.x+float(i) );      // (first primitive, number of primitives) of an object
+#if REDUCE_NUM_OBJECTS
+            if( e.x>=iGridInfo.w ) break;
+#endif
+            res = opU( res, mapScenePrimitives( pos, e.x, e.y ) );
+        }
+        lo = iGridOrigin.xyz+cell*iGridOrigin.w;
+        hi = lo+iGridOrigin.w;
+        if( alongRay )
+        {
+            vec3 te = (mix( lo, hi, step( 0.0, rd ) )-pos)*ird;    // exit of the cell
+            free = min( min( te.x, te.y ), te.z );
+        }
+        else
+        {
+            vec3 q = min( pos-lo, hi-pos );
+            free = min( min( q.x, q.y ), q.z );
+        }
+    }
+    else
+    {
+        // outside the grid: its bounded objects are at least margin inside it
+        lo = iGridOrigin.xyz;
+        hi = lo+iGridOrigin.w*iGridSize.xyz;
+        if( alongRay )
+        {
+            vec3 t0 = (lo-pos)*ird, t1 = (hi-pos)*ird;
+            vec3 tn = min( t0, t1 ), tf = max( t0, t1 );
+            float tNear = max( max( tn.x, tn.y ), tn.z ), tFar = min( min( tf.x, tf.y ), tf.z );
+            free = (tNear<=tFar && tFar>0.0) ? max( tNear, 0.0 ) : 1e10;
+        }
+        else free = length( max( max( lo-pos, pos-hi ), 0.0 ) );
+    }
+    res.x = min( res.x, max( free, 0.0 )+iGridSize.w );
+    return res;   // res.y just controls the rendering material
+}
+vec2 map( in vec3 pos )                 { return mapGrid( pos, vec3(0.0), false ); }
+vec2 mapRay( in vec3 pos, in vec3 rd )  { return mapGrid( pos, rd, true ); }
+#else //USE_SCENE_BVH
+vec2 map( in vec3 pos )
+{
+#if REDUCE_NUM_OBJECTS
+    return mapScenePrimitives( pos, 0.0, iSceneInfo.y );
+#else
+    return mapScenePrimitives( pos, 0.0, iSceneInfo.x );
+#endif
+}
+#endif //USE_SCENE_BVH
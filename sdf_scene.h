@@ -0,0 +1,415 @@
+#ifndef SDF_SCENE_H_
+#define SDF_SCENE_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only description of a signed distance scene as data (no OpenGL inside):
+ * a list of primitives (type, translation, shape parameters, material, and how each one is combined with the previous ones),
+ * instead of a map() function with hard-coded calls.
+ * -> The GPU interprets it with the generic map() of "sdf_scene.glsl", reading it from a float texture filled by
+ *    SdfScene_GetTexels(...) (4 RGBA texels per primitive): changing the layout is just a texture upload (no shader compilation).
+ * -> The CPU renderer interprets it with the same rules (see CpuRenderer::scene in "cpu_renderer.h").
+ *
+ * Primitives are grouped into objects: every primitive with SDF_OP_UNION starts a new object, and the following ones
+ * (with SDF_OP_SUBTRACT, SDF_OP_INTERSECT or SDF_OP_SMOOTH_UNION) are combined with it: e.g. {box UNION, sphere SUBTRACT}
+ * is opS(box,sphere). Objects are merged with opU(...), and the material of an object is the one of its first primitive.
+ *
+ * The type, op and modifier ids are used by "sdf_scene.glsl" too: keep them in sync.
+ * The same scene can also be compiled into straight-line code with the scene compiler (see "scene_compiler.c").
+*/
+
+/* FILE FORMAT (SdfScene_Load(...)):
+ * One primitive per line:
+ * op type material   x y z   [param0 .. param3]   [blend k] [twist|displace|polar_repeat|repeat modifier_params...]
+ * op: union, subtract, intersect, smooth_union (see SdfOp)
+ * type: plane, sphere, box, round_box, torus, capsule, tri_prism, cylinder, cone, torus82, torus88, cylinder6,
+ *       hex_prism, pyramid4, cone_section, ellipsoid (see SdfPrimitiveType: missing params are 0)
+ * modifiers: twist rate phase scale, displace amplitude frequency scale, polar_repeat angle_cell radius_cell offset scale,
+ *            repeat cx cy cz (see SdfModifier)
+ * A line with just "reduce" marks the first primitive skipped with REDUCE_NUM_OBJECTS.
+ * Empty lines and lines starting with '#' or "//" are skipped. E.g.:
+ * union    round_box 13   -2 0.2 1   0.15 0.15 0.15 0.05
+ * subtract sphere    13   -2 0.2 1   0.25
+*/
+
+/* USAGE:
+ * Define SDF_SCENE_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * SdfScene scene;
+ * SdfScene_Init(&scene);
+ * SdfScene_SetDefault(&scene);             // the scene of "signed_distance_shapes.glsl"
+ * // or:
+ * SdfScene_Add(&scene,SdfPrimitive_Make(SDF_PRIMITIVE_SPHERE,46.9f, 0.f,0.25f,0.f, 0.25f,0.f,0.f,0.f));
+ * // texture upload:
+ * SdfScene_GetTextureSize(&scene,&w,&h);   // (RGBA texels)
+ * SdfScene_GetTexels(&scene,texels);       // texels = w*h*4 floats
+ * // after editing scene.primitives[i] directly: ++scene.revision (so that the texture is uploaded again)
+ * SdfScene_SetRandom(&scene,100000,seed);  // a ground plane and many small random primitives (to measure big scenes)
+ * SdfScene_Destroy(&scene);
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SDF_SCENE_MAX_TEXTURE_WIDTH
+#define SDF_SCENE_MAX_TEXTURE_WIDTH (1024)     // (texels) must be a multiple of SDF_SCENE_TEXELS_PER_PRIMITIVE
+#endif
+#define SDF_SCENE_TEXELS_PER_PRIMITIVE (4)
+
+typedef enum {
+    SDF_PRIMITIVE_PLANE = 0,        // sdPlane(p) (no params: the plane y = position.y)
+    SDF_PRIMITIVE_SPHERE,           // sdSphere(p,params[0])
+    SDF_PRIMITIVE_BOX,              // sdBox(p,params.xyz)
+    SDF_PRIMITIVE_ROUND_BOX,        // udRoundBox(p,params.xyz,params[3])
+    SDF_PRIMITIVE_TORUS,            // sdTorus(p,params.xy)
+    SDF_PRIMITIVE_CAPSULE,          // sdCapsule(p,vec3(0),params.xyz,params[3]): from position to position+params.xyz
+    SDF_PRIMITIVE_TRI_PRISM,        // sdTriPrism(p,params.xy)
+    SDF_PRIMITIVE_CYLINDER,         // sdCylinder(p,params.xy)
+    SDF_PRIMITIVE_CONE,             // sdCone(p,params.xyz)
+    SDF_PRIMITIVE_TORUS82,          // sdTorus82(p,params.xy)
+    SDF_PRIMITIVE_TORUS88,          // sdTorus88(p,params.xy)
+    SDF_PRIMITIVE_CYLINDER6,        // sdCylinder6(p,params.xy)
+    SDF_PRIMITIVE_HEX_PRISM,        // sdHexPrism(p,params.xy)
+    SDF_PRIMITIVE_PYRAMID4,         // sdPryamid4(p,params.xyz)
+    SDF_PRIMITIVE_CONE_SECTION,     // sdConeSection(p,params[0],params[1],params[2])
+    SDF_PRIMITIVE_ELLIPSOID,        // sdEllipsoid(p,params.xyz)
+    SDF_PRIMITIVE_COUNT
+} SdfPrimitiveType;
+
+typedef enum {
+    SDF_OP_UNION = 0,               // starts a new object
+    SDF_OP_SUBTRACT,                // object = opS(object,primitive)
+    SDF_OP_INTERSECT,               // object = max(object,primitive)
+    SDF_OP_SMOOTH_UNION,            // object = smin(object,primitive,blend)
+    SDF_OP_COUNT
+} SdfOp;
+
+typedef enum {
+    SDF_MODIFIER_NONE = 0,
+    SDF_MODIFIER_TWIST,             // opTwist(p) with angle = modifier_params[0]*p.y+modifier_params[1]; the distance is scaled by modifier_params[2]
+    SDF_MODIFIER_DISPLACE,          // distance*modifier_params[2] + modifier_params[0]*sin(f*pos.x)*sin(f*pos.y)*sin(f*pos.z), f = modifier_params[1] (world space pos)
+    SDF_MODIFIER_POLAR_REPEAT,      // opRep(vec3(atan(p.x,p.z)/6.2831, p.y, modifier_params[2]+modifier_params[3]*length(p)), vec3(modifier_params[0],-,modifier_params[1])) (p.y is not repeated)
+    SDF_MODIFIER_REPEAT,            // opRep(p,modifier_params.xyz): infinite repetition with cell size modifier_params.xyz
+    SDF_MODIFIER_COUNT
+} SdfModifier;
+
+typedef struct {
+    int type;                       // SdfPrimitiveType
+    int op;                         // SdfOp (how it's combined with the previous primitives)
+    float material;                 // material id (used only by the first primitive of an object)
+    int modifier;                   // SdfModifier
+    float position[3];              // the primitive is evaluated at p = pos-position (before the modifier)
+    float blend;                    // SDF_OP_SMOOTH_UNION only
+    float params[4];                // see SdfPrimitiveType
+    float modifier_params[4];       // see SdfModifier
+} SdfPrimitive;
+
+typedef struct {
+    SdfPrimitive* primitives;
+    int num_primitives,capacity;
+    int num_reduced_primitives;     // with REDUCE_NUM_OBJECTS only the first num_reduced_primitives are used (<0 = all)
+    unsigned revision;              // incremented by every change (increment it after editing the primitives directly)
+} SdfScene;
+
+SdfPrimitive SdfPrimitive_Make(int type,float material,float x,float y,float z,float p0,float p1,float p2,float p3);   // SDF_OP_UNION, SDF_MODIFIER_NONE
+
+void SdfScene_Init(SdfScene* s);
+void SdfScene_Destroy(SdfScene* s);
+void SdfScene_Clear(SdfScene* s);
+int  SdfScene_Add(SdfScene* s,SdfPrimitive p);  // returns 0 on failure (out of memory)
+int  SdfScene_Copy(SdfScene* dst,const SdfScene* src);  // the primitives and the revision of src; returns 0 on failure (out of memory)
+int  SdfScene_SetDefault(SdfScene* s);          // replaces the content with the scene of "signed_distance_shapes.glsl"; returns 0 on failure
+int  SdfScene_SetRandom(SdfScene* s,int numPrimitives,unsigned seed);  // replaces the content with a ground plane and numPrimitives-1 small primitives
+                                                                        // on a jittered grid around the origin (same density for any count); returns 0 on failure
+int  SdfScene_GetNumPrimitives(const SdfScene* s,int reduceNumObjects);
+void SdfScene_GetTextureSize(const SdfScene* s,int* width,int* height);    // at least 1x1 (even if the scene is empty)
+void SdfScene_GetTexels(const SdfScene* s,float* texels);                  // width*height*4 floats (see SdfScene_GetTextureSize(...))
+void SdfPrimitive_GetTexels(const SdfPrimitive* p,float* texels);           // the SDF_SCENE_TEXELS_PER_PRIMITIVE texels of a primitive (16 floats)
+int  SdfScene_Load(SdfScene* s,const char* filePath);          // returns 0 on success, -1 on failure (the scene is cleared first)
+int  SdfScene_Save(const SdfScene* s,const char* filePath);    // returns 0 on success, -1 on failure
+
+const char* SdfScene_GetTypeName(int type);            // the names of the file format (NULL if out of range)
+const char* SdfScene_GetOpName(int op);
+const char* SdfScene_GetModifierName(int modifier);
+int SdfScene_GetNumModifierParams(int modifier);        // the number of modifier_params used by a modifier
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_SCENE_H_
+
+#ifdef SDF_SCENE_IMPLEMENTATION
+#ifndef SDF_SCENE_IMPLEMENTATION_GUARD
+#define SDF_SCENE_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const char* const SdfScene_TypeNames[SDF_PRIMITIVE_COUNT] = {
+    "plane","sphere","box","round_box","torus","capsule","tri_prism","cylinder",
+    "cone","torus82","torus88","cylinder6","hex_prism","pyramid4","cone_section","ellipsoid"
+};
+static const char* const SdfScene_OpNames[SDF_OP_COUNT] = {"union","subtract","intersect","smooth_union"};
+static const char* const SdfScene_ModifierNames[SDF_MODIFIER_COUNT] = {"none","twist","displace","polar_repeat","repeat"};
+static const int SdfScene_ModifierNumParams[SDF_MODIFIER_COUNT] = {0,3,3,4,3};
+
+const char* SdfScene_GetTypeName(int type) {return (type>=0 && type<SDF_PRIMITIVE_COUNT) ? SdfScene_TypeNames[type] : NULL;}
+const char* SdfScene_GetOpName(int op) {return (op>=0 && op<SDF_OP_COUNT) ? SdfScene_OpNames[op] : NULL;}
+const char* SdfScene_GetModifierName(int modifier) {return (modifier>=0 && modifier<SDF_MODIFIER_COUNT) ? SdfScene_ModifierNames[modifier] : NULL;}
+int SdfScene_GetNumModifierParams(int modifier) {return (modifier>=0 && modifier<SDF_MODIFIER_COUNT) ? SdfScene_ModifierNumParams[modifier] : 0;}
+
+SdfPrimitive SdfPrimitive_Make(int type,float material,float x,float y,float z,float p0,float p1,float p2,float p3) {
+    SdfPrimitive p;
+    memset(&p,0,sizeof(SdfPrimitive));
+    p.type = type;p.op = SDF_OP_UNION;p.material = material;p.modifier = SDF_MODIFIER_NONE;
+    p.position[0] = x;p.position[1] = y;p.position[2] = z;
+    p.params[0] = p0;p.params[1] = p1;p.params[2] = p2;p.params[3] = p3;
+    return p;
+}
+
+void SdfScene_Init(SdfScene* s) {memset(s,0,sizeof(SdfScene));s->num_reduced_primitives = -1;}
+void SdfScene_Destroy(SdfScene* s) {
+    const unsigned revision = s->revision;
+    if (s->primitives) free(s->primitives);
+    SdfScene_Init(s);
+    s->revision = revision+1;
+}
+void SdfScene_Clear(SdfScene* s) {s->num_primitives = 0;s->num_reduced_primitives = -1;++s->revision;}
+int SdfScene_Add(SdfScene* s,SdfPrimitive p) {
+    if (s->num_primitives==s->capacity) {
+        const int capacity = s->capacity>0 ? s->capacity*2 : 32;
+        SdfPrimitive* primitives = (SdfPrimitive*) realloc(s->primitives,capacity*sizeof(SdfPrimitive));
+        if (!primitives) return 0;
+        s->primitives = primitives;s->capacity = capacity;
+    }
+    s->primitives[s->num_primitives++] = p;
+    ++s->revision;
+    return 1;
+}
+int SdfScene_Copy(SdfScene* dst,const SdfScene* src) {
+    if (dst->capacity<src->num_primitives) {
+        SdfPrimitive* primitives = (SdfPrimitive*) realloc(dst->primitives,src->num_primitives*sizeof(SdfPrimitive));
+        if (!primitives) return 0;
+        dst->primitives = primitives;dst->capacity = src->num_primitives;
+    }
+    if (src->num_primitives>0) memcpy(dst->primitives,src->primitives,src->num_primitives*sizeof(SdfPrimitive));
+    dst->num_primitives = src->num_primitives;
+    dst->num_reduced_primitives = src->num_reduced_primitives;
+    dst->revision = src->revision;
+    return 1;
+}
+int SdfScene_SetDefault(SdfScene* s) {
+    // Same objects as the built-in map() of "signed_distance_shapes.glsl" (the ones skipped with REDUCE_NUM_OBJECTS are the last ones)
+    SdfPrimitive p;
+    int ok = 1;
+    SdfScene_Clear(s);
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_PLANE,        1.0f,    0.0f,0.0f, 0.0f,    0.f,0.f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_SPHERE,      46.9f,    0.0f,0.25f, 0.0f,   0.25f,0.f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_BOX,          3.0f,    1.0f,0.25f, 0.0f,   0.25f,0.25f,0.25f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_ROUND_BOX,   41.0f,    1.0f,0.25f, 1.0f,   0.15f,0.15f,0.15f,0.1f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_TORUS,       25.0f,    0.0f,0.25f, 1.0f,   0.20f,0.05f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_CAPSULE,     31.9f,   -1.3f,0.10f,-0.1f,   0.5f,0.4f,0.3f,0.1f));   // from (-1.3,0.1,-0.1) to (-0.8,0.5,0.2)
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_TRI_PRISM,   43.5f,   -1.0f,0.25f,-1.0f,   0.25f,0.05f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_CYLINDER,     8.0f,    1.0f,0.30f,-1.0f,   0.1f,0.2f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_CONE,        55.0f,    0.0f,0.50f,-1.0f,   0.8f,0.6f,0.3f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_TORUS82,     50.0f,    0.0f,0.25f, 2.0f,   0.20f,0.05f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_TORUS88,     43.0f,   -1.0f,0.25f, 2.0f,   0.20f,0.05f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_CYLINDER6,   12.0f,    1.0f,0.30f, 2.0f,   0.1f,0.2f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_HEX_PRISM,   17.0f,   -1.0f,0.20f, 1.0f,   0.25f,0.05f,0.f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_PYRAMID4,    37.0f,   -1.0f,0.15f,-2.0f,   0.8f,0.6f,0.25f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_CONE_SECTION,13.67f,   0.0f,0.35f,-2.0f,   0.15f,0.2f,0.1f,0.f));
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_ELLIPSOID,   43.17f,   1.0f,0.35f,-2.0f,   0.15f,0.2f,0.05f,0.f));
+    s->num_reduced_primitives = s->num_primitives;
+    // opS(udRoundBox,sdSphere)
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_ROUND_BOX,   13.0f,   -2.0f,0.2f, 1.0f,    0.15f,0.15f,0.15f,0.05f));
+    p = SdfPrimitive_Make(SDF_PRIMITIVE_SPHERE,                     13.0f,   -2.0f,0.2f, 1.0f,    0.25f,0.f,0.f,0.f);
+    p.op = SDF_OP_SUBTRACT;
+    ok&=SdfScene_Add(s,p);
+    // opS(sdTorus82,sdCylinder(opRep(...)))
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_TORUS82,     51.0f,   -2.0f,0.2f, 0.0f,    0.20f,0.1f,0.f,0.f));
+    p = SdfPrimitive_Make(SDF_PRIMITIVE_CYLINDER,                   51.0f,   -2.0f,0.2f, 0.0f,    0.02f,0.6f,0.f,0.f);
+    p.op = SDF_OP_SUBTRACT;
+    p.modifier = SDF_MODIFIER_POLAR_REPEAT;
+    p.modifier_params[0] = 0.05f;p.modifier_params[1] = 0.05f;p.modifier_params[2] = 0.02f;p.modifier_params[3] = 0.5f;
+    ok&=SdfScene_Add(s,p);
+    // displaced sphere
+    p = SdfPrimitive_Make(SDF_PRIMITIVE_SPHERE,                     65.0f,   -2.0f,0.25f,-1.0f,   0.2f,0.f,0.f,0.f);
+    p.modifier = SDF_MODIFIER_DISPLACE;
+    p.modifier_params[0] = 0.03f;p.modifier_params[1] = 50.0f;p.modifier_params[2] = 0.5f;
+    ok&=SdfScene_Add(s,p);
+    // twisted torus
+    p = SdfPrimitive_Make(SDF_PRIMITIVE_TORUS,                      46.7f,   -2.0f,0.25f, 2.0f,   0.20f,0.05f,0.f,0.f);
+    p.modifier = SDF_MODIFIER_TWIST;
+    p.modifier_params[0] = 10.0f;p.modifier_params[1] = 10.0f;p.modifier_params[2] = 0.5f;
+    ok&=SdfScene_Add(s,p);
+    // smooth union [added by @Flix]
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_SPHERE,      43.17f,   0.0f,0.35f, 3.0f,   0.1f,0.f,0.f,0.f));
+    p = SdfPrimitive_Make(SDF_PRIMITIVE_BOX,                        43.17f,   0.0f,0.15f, 3.0f,   0.1f,0.1f,0.1f,0.f);
+    p.op = SDF_OP_SMOOTH_UNION;p.blend = 0.1f;
+    ok&=SdfScene_Add(s,p);
+    return ok;
+}
+int SdfScene_SetRandom(SdfScene* s,int numPrimitives,unsigned seed) {
+    // The cells are 0.35 wide (about the density of the default scene), and the primitives rest on the plane
+    // (below y = 1.6, the top of the bounding volume of castRay()). The first half of them is used with REDUCE_NUM_OBJECTS.
+    static const int types[] = {SDF_PRIMITIVE_SPHERE,SDF_PRIMITIVE_BOX,SDF_PRIMITIVE_ROUND_BOX,SDF_PRIMITIVE_TORUS,SDF_PRIMITIVE_CYLINDER,SDF_PRIMITIVE_ELLIPSOID};
+    const int numTypes = (int)(sizeof(types)/sizeof(types[0]));
+    const int gridSize = (int) ceil(sqrt((double)(numPrimitives>1 ? numPrimitives-1 : 1)));
+    const float spacing = 0.35f;
+    unsigned state = seed*2654435761u+1u;
+    int i,ok = 1;
+#   define SDF_SCENE_RANDOM() (state = state*1664525u+1013904223u,(float)(state>>8)*(1.f/16777216.f))    // in [0,1)
+    SdfScene_Clear(s);
+    ok&=SdfScene_Add(s,SdfPrimitive_Make(SDF_PRIMITIVE_PLANE,1.0f,0.f,0.f,0.f,0.f,0.f,0.f,0.f));
+    for (i=0;i<numPrimitives-1 && ok;i++) {
+        const int type = types[(int)(SDF_SCENE_RANDOM()*numTypes)%numTypes];
+        const float size = 0.04f+0.08f*SDF_SCENE_RANDOM();
+        const float material = 2.f+60.f*SDF_SCENE_RANDOM();
+        const float x = ((float)(i%gridSize)-0.5f*(float)(gridSize-1)+0.5f*(SDF_SCENE_RANDOM()-0.5f))*spacing;
+        const float z = ((float)(i/gridSize)-0.5f*(float)(gridSize-1)+0.5f*(SDF_SCENE_RANDOM()-0.5f))*spacing;
+        SdfPrimitive p;
+        switch (type) {
+        case SDF_PRIMITIVE_TORUS:       p = SdfPrimitive_Make(type,material,x,0.3f*size,z,size,0.3f*size,0.f,0.f);break;
+        case SDF_PRIMITIVE_CYLINDER:    p = SdfPrimitive_Make(type,material,x,1.5f*size,z,0.7f*size,1.5f*size,0.f,0.f);break;
+        case SDF_PRIMITIVE_ROUND_BOX:   p = SdfPrimitive_Make(type,material,x,size,z,0.7f*size,0.7f*size,0.7f*size,0.3f*size);break;
+        case SDF_PRIMITIVE_ELLIPSOID:   p = SdfPrimitive_Make(type,material,x,1.2f*size,z,0.8f*size,1.2f*size,0.6f*size,0.f);break;
+        default:                        p = SdfPrimitive_Make(type,material,x,size,z,size,size,size,0.f);break;
+        }
+        ok&=SdfScene_Add(s,p);
+        if (i+1==numPrimitives/2) s->num_reduced_primitives = s->num_primitives;
+    }
+#   undef SDF_SCENE_RANDOM
+    return ok;
+}
+int SdfScene_GetNumPrimitives(const SdfScene* s,int reduceNumObjects) {
+    return (reduceNumObjects && s->num_reduced_primitives>=0 && s->num_reduced_primitives<s->num_primitives) ? s->num_reduced_primitives : s->num_primitives;
+}
+void SdfScene_GetTextureSize(const SdfScene* s,int* width,int* height) {
+    const int numTexels = s->num_primitives*SDF_SCENE_TEXELS_PER_PRIMITIVE;
+    const int w = numTexels<SDF_SCENE_MAX_TEXTURE_WIDTH ? numTexels : SDF_SCENE_MAX_TEXTURE_WIDTH;
+    *width = w>0 ? w : 1;
+    *height = w>0 ? (numTexels+w-1)/w : 1;
+}
+void SdfPrimitive_GetTexels(const SdfPrimitive* p,float* t) {
+    // Texel 0: (type, op, material, modifier); 1: (position, blend); 2: params; 3: modifier_params
+    t[0] = (float) p->type;t[1] = (float) p->op;t[2] = p->material;t[3] = (float) p->modifier;
+    memcpy(&t[4],p->position,3*sizeof(float));t[7] = p->blend;
+    memcpy(&t[8],p->params,4*sizeof(float));
+    memcpy(&t[12],p->modifier_params,4*sizeof(float));
+}
+void SdfScene_GetTexels(const SdfScene* s,float* texels) {
+    int width,height,i;
+    SdfScene_GetTextureSize(s,&width,&height);
+    memset(texels,0,width*height*4*sizeof(float));
+    for (i=0;i<s->num_primitives;i++) SdfPrimitive_GetTexels(&s->primitives[i],&texels[i*SDF_SCENE_TEXELS_PER_PRIMITIVE*4]);
+}
+
+static int SdfScene_FindName(const char* const* names,int count,const char* name) {
+    int i;
+    for (i=0;i<count;i++) {
+        if (strcmp(names[i],name)==0) return i;
+    }
+    return -1;
+}
+// Reads the next whitespace separated token of *line (returns 0 at the end of the line)
+static int SdfScene_NextToken(const char** line,char* token,int tokenSize) {
+    const char* c = *line;
+    int n = 0;
+    while (*c==' ' || *c=='\t' || *c=='\r' || *c=='\n') ++c;
+    while (*c!='\0' && *c!=' ' && *c!='\t' && *c!='\r' && *c!='\n') {
+        if (n<tokenSize-1) token[n++] = *c;
+        ++c;
+    }
+    token[n] = '\0';
+    *line = c;
+    return n>0;
+}
+static int SdfScene_ParseFloat(const char* token,float* value) {
+    char* end;
+    const double v = strtod(token,&end);
+    if (end==token || *end!='\0') return 0;
+    *value = (float) v;
+    return 1;
+}
+// returns 0 on failure
+static int SdfScene_ParsePrimitive(const char* line,SdfPrimitive* p) {
+    char token[64];
+    int i,n,hasToken;
+    memset(p,0,sizeof(SdfPrimitive));
+    if (!SdfScene_NextToken(&line,token,sizeof(token)) || (p->op = SdfScene_FindName(SdfScene_OpNames,SDF_OP_COUNT,token))<0) return 0;
+    if (!SdfScene_NextToken(&line,token,sizeof(token)) || (p->type = SdfScene_FindName(SdfScene_TypeNames,SDF_PRIMITIVE_COUNT,token))<0) return 0;
+    if (!SdfScene_NextToken(&line,token,sizeof(token)) || !SdfScene_ParseFloat(token,&p->material)) return 0;
+    for (i=0;i<3;i++) {
+        if (!SdfScene_NextToken(&line,token,sizeof(token)) || !SdfScene_ParseFloat(token,&p->position[i])) return 0;
+    }
+    n = 0;
+    while ((hasToken = SdfScene_NextToken(&line,token,sizeof(token))) && n<4 && SdfScene_ParseFloat(token,&p->params[n])) ++n;
+    while (hasToken) {
+        if (strcmp(token,"blend")==0) {
+            if (!SdfScene_NextToken(&line,token,sizeof(token)) || !SdfScene_ParseFloat(token,&p->blend)) return 0;
+        }
+        else {
+            p->modifier = SdfScene_FindName(SdfScene_ModifierNames,SDF_MODIFIER_COUNT,token);
+            if (p->modifier<=SDF_MODIFIER_NONE) return 0;
+            for (i=0;i<SdfScene_ModifierNumParams[p->modifier];i++) {
+                if (!SdfScene_NextToken(&line,token,sizeof(token)) || !SdfScene_ParseFloat(token,&p->modifier_params[i])) return 0;
+            }
+        }
+        hasToken = SdfScene_NextToken(&line,token,sizeof(token));
+    }
+    return 1;
+}
+int SdfScene_Load(SdfScene* s,const char* filePath) {
+    FILE* f = fopen(filePath, "rt");
+    char buf[512],token[64];
+    int lineNumber = 0;
+    if (!f) return -1;
+    SdfScene_Clear(s);
+    while (fgets(buf,sizeof(buf),f)) {
+        const char* line = buf;
+        SdfPrimitive p;
+        ++lineNumber;
+        if (buf[0]=='#' || (buf[0]=='/' && buf[1]=='/') || !SdfScene_NextToken(&line,token,sizeof(token))) continue;
+        if (strcmp(token,"reduce")==0) {s->num_reduced_primitives = s->num_primitives;continue;}
+        if (!SdfScene_ParsePrimitive(buf,&p)) {fprintf(stderr,"SdfScene_Load(\"%s\"): invalid line %d: %s",filePath,lineNumber,buf);fclose(f);SdfScene_Clear(s);return -1;}
+        if (!SdfScene_Add(s,p)) {fclose(f);SdfScene_Clear(s);return -1;}
+    }
+    fclose(f);
+    return s->num_primitives>0 ? 0 : -1;
+}
+int SdfScene_Save(const SdfScene* s,const char* filePath) {
+    FILE* f = fopen(filePath, "wt");
+    int i,j;
+    if (!f) return -1;
+    fprintf(f,"# op type material   x y z   params   [blend k] [modifier params]\n");
+    for (i=0;i<s->num_primitives;i++) {
+        const SdfPrimitive* p = &s->primitives[i];
+        if (i==s->num_reduced_primitives) fprintf(f,"reduce\n");
+        fprintf(f,"%-12s %-12s %g   %g %g %g  ",SdfScene_GetOpName(p->op),SdfScene_GetTypeName(p->type),p->material,p->position[0],p->position[1],p->position[2]);
+        for (j=0;j<4;j++) fprintf(f," %g",p->params[j]);
+        if (p->op==SDF_OP_SMOOTH_UNION) fprintf(f,"   blend %g",p->blend);
+        if (p->modifier>SDF_MODIFIER_NONE && p->modifier<SDF_MODIFIER_COUNT) {
+            fprintf(f,"   %s",SdfScene_GetModifierName(p->modifier));
+            for (j=0;j<SdfScene_ModifierNumParams[p->modifier];j++) fprintf(f," %g",p->modifier_params[j]);
+        }
+        fprintf(f,"\n");
+    }
+    fclose(f);
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDF_SCENE_IMPLEMENTATION_GUARD
+#endif //SDF_SCENE_IMPLEMENTATION
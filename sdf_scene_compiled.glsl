@@ -0,0 +1,48 @@
+// Generated by the scene compiler ("scene_compiler.c") from "default.scene": don't edit it, compile the scene again.
+// 24 primitives in 21 objects (16 primitives with REDUCE_NUM_OBJECTS).
+// It replaces the built-in map() of "signed_distance_shapes.glsl" when USE_COMPILED_SCENE is defined.
+
+vec2 map( in vec3 pos )
+{
+    vec2 res;
+    vec3 p;
+    vec2 q;
+    float o;
+    float c, s;
+    res = vec2( sdPlane( pos ), 1.0 );
+    res = opU( res, vec2( sdSphere( pos-vec3(0.0,0.25,0.0), 0.25 ), 46.9 ) );
+    res = opU( res, vec2( sdBox( pos-vec3(1.0,0.25,0.0), vec3(0.25,0.25,0.25) ), 3.0 ) );
+    res = opU( res, vec2( udRoundBox( pos-vec3(1.0,0.25,1.0), vec3(0.15,0.15,0.15),0.1 ), 41.0 ) );
+    res = opU( res, vec2( sdTorus( pos-vec3(0.0,0.25,1.0), vec2(0.2,0.05) ), 25.0 ) );
+    res = opU( res, vec2( sdCapsule( pos, vec3(-1.3,0.1,-0.1),vec3(-0.8,0.5,0.2),0.1 ), 31.9 ) );
+    res = opU( res, vec2( sdTriPrism( pos-vec3(-1.0,0.25,-1.0), vec2(0.25,0.05) ), 43.5 ) );
+    res = opU( res, vec2( sdCylinder( pos-vec3(1.0,0.3,-1.0), vec2(0.1,0.2) ), 8.0 ) );
+    res = opU( res, vec2( sdCone( pos-vec3(0.0,0.5,-1.0), vec3(0.8,0.6,0.3) ), 55.0 ) );
+    res = opU( res, vec2( sdTorus82( pos-vec3(0.0,0.25,2.0), vec2(0.2,0.05) ), 50.0 ) );
+    res = opU( res, vec2( sdTorus88( pos-vec3(-1.0,0.25,2.0), vec2(0.2,0.05) ), 43.0 ) );
+    res = opU( res, vec2( sdCylinder6( pos-vec3(1.0,0.3,2.0), vec2(0.1,0.2) ), 12.0 ) );
+    res = opU( res, vec2( sdHexPrism( pos-vec3(-1.0,0.2,1.0), vec2(0.25,0.05) ), 17.0 ) );
+    res = opU( res, vec2( sdPryamid4( pos-vec3(-1.0,0.15,-2.0), vec3(0.8,0.6,0.25) ), 37.0 ) );
+    res = opU( res, vec2( sdConeSection( pos-vec3(0.0,0.35,-2.0), 0.15,0.2,0.1 ), 13.67 ) );
+    res = opU( res, vec2( sdEllipsoid( pos-vec3(1.0,0.35,-2.0), vec3(0.15,0.2,0.05) ), 43.17 ) );
+#if !REDUCE_NUM_OBJECTS
+    o = udRoundBox( pos-vec3(-2.0,0.2,1.0), vec3(0.15,0.15,0.15),0.05 );
+    o = opS( o, sdSphere( pos-vec3(-2.0,0.2,1.0), 0.25 ) );
+    res = opU( res, vec2( o, 13.0 ) );
+    o = sdTorus82( pos-vec3(-2.0,0.2,0.0), vec2(0.2,0.1) );
+    p = pos-vec3(-2.0,0.2,0.0);
+    q = mod( vec2( atan(p.x,p.z)/6.2831, 0.02+0.5*length(p) ), vec2(0.05,0.05) ) - vec2(0.025,0.025);
+    p = vec3( q.x, p.y, q.y );
+    o = opS( o, sdCylinder( p, vec2(0.02,0.6) ) );
+    res = opU( res, vec2( o, 51.0 ) );
+    res = opU( res, vec2( 0.5*sdSphere( pos-vec3(-2.0,0.25,-1.0), 0.2 ) + 0.03*sin(50.0*pos.x)*sin(50.0*pos.y)*sin(50.0*pos.z), 65.0 ) );
+    p = pos-vec3(-2.0,0.25,2.0);
+    c = cos( 10.0*p.y+10.0 ); s = sin( 10.0*p.y+10.0 );
+    p = vec3( mat2(c,-s,s,c)*p.xz, p.y );
+    res = opU( res, vec2( 0.5*sdTorus( p, vec2(0.2,0.05) ), 46.7 ) );
+    o = sdSphere( pos-vec3(0.0,0.35,3.0), 0.1 );
+    o = smin( o, sdBox( pos-vec3(0.0,0.15,3.0), vec3(0.1,0.1,0.1) ), 0.1 );
+    res = opU( res, vec2( o, 43.17 ) );
+#endif
+    return res;   // res.y just controls the rendering material
+}
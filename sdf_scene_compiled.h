@@ -0,0 +1,92 @@
+// Generated by the scene compiler ("scene_compiler.c") from "default.scene": don't edit it, compile the scene again.
+// 24 primitives in 21 objects (16 primitives with REDUCE_NUM_OBJECTS).
+// Included by "cpu_renderer.h" (scalar map()) and by "cpu_renderer_packet.h" (once per SIMD instruction set): no include guard.
+
+#ifndef CRP_ISA
+static cr_vec2_t cr_mapCompiledScene(const CpuRenderer* r,vec3_t pos) {
+    cr_vec2_t res;
+    vec3_t p;
+    float o,c,s;
+    res = cr_vec2( cr_sdPlane( pos ), 1.0f );
+    res = cr_opU( res, cr_vec2( cr_sdSphere( v3_sub(pos,vec3(0.0f,0.25f,0.0f)), 0.25f ), 46.9f ) );
+    res = cr_opU( res, cr_vec2( cr_sdBox( v3_sub(pos,vec3(1.0f,0.25f,0.0f)), vec3(0.25f,0.25f,0.25f) ), 3.0f ) );
+    res = cr_opU( res, cr_vec2( cr_udRoundBox( v3_sub(pos,vec3(1.0f,0.25f,1.0f)), vec3(0.15f,0.15f,0.15f),0.1f ), 41.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus( v3_sub(pos,vec3(0.0f,0.25f,1.0f)), cr_vec2(0.2f,0.05f) ), 25.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCapsule( pos, vec3(-1.3f,0.1f,-0.1f),vec3(-0.8f,0.5f,0.2f),0.1f ), 31.9f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTriPrism( v3_sub(pos,vec3(-1.0f,0.25f,-1.0f)), cr_vec2(0.25f,0.05f) ), 43.5f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCylinder( v3_sub(pos,vec3(1.0f,0.3f,-1.0f)), cr_vec2(0.1f,0.2f) ), 8.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCone( v3_sub(pos,vec3(0.0f,0.5f,-1.0f)), vec3(0.8f,0.6f,0.3f) ), 55.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus82( v3_sub(pos,vec3(0.0f,0.25f,2.0f)), cr_vec2(0.2f,0.05f) ), 50.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdTorus88( v3_sub(pos,vec3(-1.0f,0.25f,2.0f)), cr_vec2(0.2f,0.05f) ), 43.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdCylinder6( v3_sub(pos,vec3(1.0f,0.3f,2.0f)), cr_vec2(0.1f,0.2f) ), 12.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdHexPrism( v3_sub(pos,vec3(-1.0f,0.2f,1.0f)), cr_vec2(0.25f,0.05f) ), 17.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdPryamid4( v3_sub(pos,vec3(-1.0f,0.15f,-2.0f)), vec3(0.8f,0.6f,0.25f) ), 37.0f ) );
+    res = cr_opU( res, cr_vec2( cr_sdConeSection( v3_sub(pos,vec3(0.0f,0.35f,-2.0f)), 0.15f,0.2f,0.1f ), 13.67f ) );
+    res = cr_opU( res, cr_vec2( cr_sdEllipsoid( v3_sub(pos,vec3(1.0f,0.35f,-2.0f)), vec3(0.15f,0.2f,0.05f) ), 43.17f ) );
+    if (!r->settings.reduce_num_objects) {
+        o = cr_udRoundBox( v3_sub(pos,vec3(-2.0f,0.2f,1.0f)), vec3(0.15f,0.15f,0.15f),0.05f );
+        o = cr_opS( o, cr_sdSphere( v3_sub(pos,vec3(-2.0f,0.2f,1.0f)), 0.25f ) );
+        res = cr_opU( res, cr_vec2( o, 13.0f ) );
+        o = cr_sdTorus82( v3_sub(pos,vec3(-2.0f,0.2f,0.0f)), cr_vec2(0.2f,0.1f) );
+        p = v3_sub(pos,vec3(-2.0f,0.2f,0.0f));
+        p = vec3(cr_mod(atan2f(p.x,p.z)/6.2831f,0.05f)-0.025f,p.y,cr_mod(0.02f+0.5f*v3_length(p),0.05f)-0.025f);
+        o = cr_opS( o, cr_sdCylinder( p, cr_vec2(0.02f,0.6f) ) );
+        res = cr_opU( res, cr_vec2( o, 51.0f ) );
+        res = cr_opU( res, cr_vec2( 0.5f*cr_sdSphere( v3_sub(pos,vec3(-2.0f,0.25f,-1.0f)), 0.2f ) + 0.03f*sinf(50.0f*pos.x)*sinf(50.0f*pos.y)*sinf(50.0f*pos.z), 65.0f ) );
+        p = v3_sub(pos,vec3(-2.0f,0.25f,2.0f));
+        c = cosf(10.0f*p.y+10.0f);s = sinf(10.0f*p.y+10.0f);
+        p = vec3(c*p.x+s*p.z,-s*p.x+c*p.z,p.y);
+        res = cr_opU( res, cr_vec2( 0.5f*cr_sdTorus( p, cr_vec2(0.2f,0.05f) ), 46.7f ) );
+        o = cr_sdSphere( v3_sub(pos,vec3(0.0f,0.35f,3.0f)), 0.1f );
+        o = cr_smin( o, cr_sdBox( v3_sub(pos,vec3(0.0f,0.15f,3.0f)), vec3(0.1f,0.1f,0.1f) ), 0.1f );
+        res = cr_opU( res, cr_vec2( o, 43.17f ) );
+    }
+    return res;
+}
+#else //CRP_ISA
+static CRP_TARGET void CRP(crp_mapCompiledScene)(const CpuRenderer* r,crp_v3 pos,crp_f* pd,crp_f* pm) {
+    crp_f d,m;
+    crp_v3 p,t;
+    crp_f o;
+    crp_f a,c,s;
+    d = pos.y;m = crp_set1(1.0f);
+    CRP(crp_opU)(&d,&m, CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,0.0f,0.25f,0.0f),0.25f), 46.9f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdBox)(CRP(crp_v3_subc)(pos,1.0f,0.25f,0.0f),0.25f,0.25f,0.25f), 3.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_udRoundBox)(CRP(crp_v3_subc)(pos,1.0f,0.25f,1.0f),0.15f,0.15f,0.15f,0.1f), 41.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus)(CRP(crp_v3_subc)(pos,0.0f,0.25f,1.0f),0.2f,0.05f), 25.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCapsule)(pos,vec3(-1.3f,0.1f,-0.1f),vec3(-0.8f,0.5f,0.2f),0.1f), 31.9f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTriPrism)(CRP(crp_v3_subc)(pos,-1.0f,0.25f,-1.0f),0.25f,0.05f), 43.5f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCylinder)(CRP(crp_v3_subc)(pos,1.0f,0.3f,-1.0f),0.1f,0.2f), 8.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCone)(CRP(crp_v3_subc)(pos,0.0f,0.5f,-1.0f),vec3(0.8f,0.6f,0.3f)), 55.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus82)(CRP(crp_v3_subc)(pos,0.0f,0.25f,2.0f),0.2f,0.05f), 50.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdTorus88)(CRP(crp_v3_subc)(pos,-1.0f,0.25f,2.0f),0.2f,0.05f), 43.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdCylinder6)(CRP(crp_v3_subc)(pos,1.0f,0.3f,2.0f),0.1f,0.2f), 12.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdHexPrism)(CRP(crp_v3_subc)(pos,-1.0f,0.2f,1.0f),0.25f,0.05f), 17.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdPryamid4)(CRP(crp_v3_subc)(pos,-1.0f,0.15f,-2.0f),vec3(0.8f,0.6f,0.25f)), 37.0f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdConeSection)(CRP(crp_v3_subc)(pos,0.0f,0.35f,-2.0f),0.15f,0.2f,0.1f), 13.67f );
+    CRP(crp_opU)(&d,&m, CRP(crp_sdEllipsoid)(CRP(crp_v3_subc)(pos,1.0f,0.35f,-2.0f),0.15f,0.2f,0.05f), 43.17f );
+    if (!r->settings.reduce_num_objects) {
+        o = CRP(crp_udRoundBox)(CRP(crp_v3_subc)(pos,-2.0f,0.2f,1.0f),0.15f,0.15f,0.15f,0.05f);
+        o = crp_max(crp_neg(CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,-2.0f,0.2f,1.0f),0.25f)),o);
+        CRP(crp_opU)(&d,&m, o, 13.0f );
+        o = CRP(crp_sdTorus82)(CRP(crp_v3_subc)(pos,-2.0f,0.2f,0.0f),0.2f,0.1f);
+        p = CRP(crp_v3_subc)(pos,-2.0f,0.2f,0.0f);
+        a = CRP(crp_v3_length)(p);
+        p.x = crp_sub(CRP(crp_mod)(crp_div(CRP(crp_lanes2)(p.x,p.z,&atan2f),crp_set1(6.2831f)),0.05f),crp_set1(0.025f));
+        p.z = crp_sub(CRP(crp_mod)(crp_add(crp_set1(0.02f),crp_mul(crp_set1(0.5f),a)),0.05f),crp_set1(0.025f));
+        o = crp_max(crp_neg(CRP(crp_sdCylinder)(p,0.02f,0.6f)),o);
+        CRP(crp_opU)(&d,&m, o, 51.0f );
+        CRP(crp_opU)(&d,&m, crp_add(crp_mul(crp_set1(0.5f),CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,-2.0f,0.25f,-1.0f),0.2f)),crp_mul(crp_mul(crp_mul(crp_set1(0.03f),CRP(crp_lanes1)(crp_mul(crp_set1(50.0f),pos.x),&sinf)),CRP(crp_lanes1)(crp_mul(crp_set1(50.0f),pos.y),&sinf)),CRP(crp_lanes1)(crp_mul(crp_set1(50.0f),pos.z),&sinf))), 65.0f );
+        p = CRP(crp_v3_subc)(pos,-2.0f,0.25f,2.0f);
+        a = crp_add(crp_mul(crp_set1(10.0f),p.y),crp_set1(10.0f));
+        c = CRP(crp_lanes1)(a,&cosf);s = CRP(crp_lanes1)(a,&sinf);
+        t.x = crp_add(crp_mul(c,p.x),crp_mul(s,p.z));t.y = crp_sub(crp_mul(c,p.z),crp_mul(s,p.x));t.z = p.y;p = t;
+        CRP(crp_opU)(&d,&m, crp_mul(crp_set1(0.5f),CRP(crp_sdTorus)(p,0.2f,0.05f)), 46.7f );
+        o = CRP(crp_sdSphere)(CRP(crp_v3_subc)(pos,0.0f,0.35f,3.0f),0.1f);
+        o = CRP(crp_smin)(o,CRP(crp_sdBox)(CRP(crp_v3_subc)(pos,0.0f,0.15f,3.0f),0.1f,0.1f,0.1f),0.1f);
+        CRP(crp_opU)(&d,&m, o, 43.17f );
+    }
+    *pd = d;
+    if (pm) *pm = m;
+}
+#endif //CRP_ISA
@@ -0,0 +1,752 @@
+#ifndef SHADER_PERMUTATIONS_H_
+#define SHADER_PERMUTATIONS_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only file to build many variants (permutations) of the same shader program,
+ * that differ only in their #define values (e.g. the quality knobs of "signed_distance_shapes.glsl").
+ * -> ShaderPermutation: a set of #defines (kept sorted by name, so that the same set always gives the same header and hash).
+ * -> ShaderProgramCache: owns a vertex and a fragment shader source and compiles/links one program per permutation on demand:
+ *    every program is built once and reused every time the same permutation is requested again.
+ * The define header is passed to glShaderSource(...) as a separate string (after the #version line, if any, and followed by
+ * a #line directive, so that the line numbers in the compiler logs are the ones of the sources): the sources are never modified.
+ *
+ * Optionally ShaderProgramCache keeps an on-disk cache of the linked programs (glGetProgramBinary(...)/glProgramBinary(...),
+ * GL 4.1 or GL_ARB_get_program_binary), so that the next launches don't need to compile them again.
+ * Every file is keyed by a hash of the sources, the define header and the GL_VENDOR/GL_RENDERER/GL_VERSION strings,
+ * and it's validated (header, size, checksum, link status) before use: on any failure the file is deleted
+ * and the program is compiled from the sources (and saved again).
+*/
+
+/* USAGE:
+ * Include your OpenGL headers (e.g. GL/glew.h or GL/glut.h) before this file (like "teapot.h"),
+ * and define SHADER_PERMUTATIONS_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * ShaderProgramCache cache;ShaderPermutation perm;GLuint program;
+ * ShaderProgramCache_Init(&cache);
+ * ShaderProgramCache_SetSources(&cache,vertexShaderSource,fragmentShaderSource);
+ * ShaderPermutation_Init(&perm);
+ * ShaderPermutation_SetInt(&perm,"RAYCAST_ITERATIONS",64);
+ * ShaderPermutation_Set(&perm,"WRITE_DEPTH_VALUE",NULL);
+ * ShaderProgramCache_SetBinaryDirectory(&cache,"shader_cache");   // optional: on-disk cache (the directory is created if needed)
+ * program = ShaderProgramCache_Get(&cache,&perm);  // compiled and linked only the first time (0 on failure)
+ * // or, without blocking:
+ * program = ShaderProgramCache_Request(&cache,&perm);  // 0 while it's pending: call ShaderProgramCache_Poll(&cache,0) every frame
+ * // In your DestroyGL() method:
+ * ShaderProgramCache_Clear(&cache);                // deletes all the programs (the sources are kept)
+ * ShaderProgramCache_Destroy(&cache);
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SHADER_PERMUTATION_MAX_DEFINES
+#define SHADER_PERMUTATION_MAX_DEFINES (32)
+#endif
+#define SHADER_PERMUTATION_MAX_NAME_LENGTH (48)
+#define SHADER_PERMUTATION_MAX_VALUE_LENGTH (32)
+
+typedef struct {
+    char name[SHADER_PERMUTATION_MAX_NAME_LENGTH];
+    char value[SHADER_PERMUTATION_MAX_VALUE_LENGTH];   // can be empty (#define NAME)
+} ShaderDefine;
+
+typedef struct {
+    ShaderDefine defines[SHADER_PERMUTATION_MAX_DEFINES];  // sorted by name
+    int num_defines;
+} ShaderPermutation;
+
+void ShaderPermutation_Init(ShaderPermutation* p);                                  // no defines
+int  ShaderPermutation_Set(ShaderPermutation* p,const char* name,const char* value);   // value can be NULL; replaces the old value; returns 0 on failure (too many defines, or name/value too long)
+int  ShaderPermutation_SetInt(ShaderPermutation* p,const char* name,int value);
+void ShaderPermutation_Remove(ShaderPermutation* p,const char* name);
+const char* ShaderPermutation_Get(const ShaderPermutation* p,const char* name);     // NULL if not defined
+int  ShaderPermutation_Equals(const ShaderPermutation* a,const ShaderPermutation* b);
+int  ShaderPermutation_GetHeader(const ShaderPermutation* p,char* buf,int bufSize);  // writes "#define NAME VALUE\n" lines; returns the length of the full header (it can be >= bufSize: then it's truncated)
+unsigned long long ShaderPermutation_GetHash(const ShaderPermutation* p);           // 64-bit FNV-1a of the header
+
+#if (defined(GL_PROGRAM_BINARY_RETRIEVABLE_HINT) && !defined(__EMSCRIPTEN__))
+#define SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY  // (WebGL has no program binaries)
+#endif
+
+typedef struct {
+    ShaderPermutation permutation;
+    unsigned long long hash;
+    GLuint program;
+    int from_binary;                // 1 if the program has been loaded from the on-disk cache
+    // pending build (see ShaderProgramCache_Request(...)):
+    int pending;
+    GLuint pending_vs,pending_fs;
+    char* pending_header;
+    int save_binary;
+    unsigned long long binary_key;
+} ShaderProgramCacheEntry;
+
+typedef struct {
+    char* vertex_source;
+    char* fragment_source;
+    ShaderProgramCacheEntry* entries;
+    int num_entries,capacity;
+    char* binary_directory;         // on-disk cache of program binaries (NULL = disabled)
+    int num_binary_hits,num_binary_misses,num_binary_rejected;  // rejected = invalid or stale files (they're deleted)
+    int parallel_compile;           // GL_KHR_parallel_shader_compile (or ARB): <0 = not checked yet
+} ShaderProgramCache;
+
+void ShaderProgramCache_Init(ShaderProgramCache* c);
+void ShaderProgramCache_Destroy(ShaderProgramCache* c);   // the GL context must be current if there are programs (see ShaderProgramCache_Clear(...))
+int  ShaderProgramCache_SetSources(ShaderProgramCache* c,const char* vertexSource,const char* fragmentSource);  // copies them and clears the cache; returns 0 on failure (out of memory)
+GLuint ShaderProgramCache_Get(ShaderProgramCache* c,const ShaderPermutation* p);   // builds the program on the first request; returns 0 on failure (errors are printed to stderr)
+GLuint ShaderProgramCache_Find(const ShaderProgramCache* c,const ShaderPermutation* p);    // never builds: returns 0 if not cached (or still pending)
+// Asynchronous builds: ShaderProgramCache_Request(...) is like ShaderProgramCache_Get(...), but it never waits for the driver:
+// it returns 0 while the program is being built (see ShaderProgramCache_IsPending(...)), and ShaderProgramCache_Poll(...)
+// (e.g. once per frame) collects the builds that have completed (with GL_KHR_parallel_shader_compile the driver compiles in
+// background threads and the completed ones are known without waiting; without it, a poll waits for all of them,
+// but at least the current frame has been drawn with another program).
+GLuint ShaderProgramCache_Request(ShaderProgramCache* c,const ShaderPermutation* p);
+GLuint ShaderProgramCache_Load(ShaderProgramCache* c,const ShaderPermutation* p);     // never compiles: returns the program if it's cached in memory or on disk, 0 otherwise
+int  ShaderProgramCache_Poll(ShaderProgramCache* c,int wait);  // returns the number of builds that are still pending (wait=1: none)
+int  ShaderProgramCache_IsPending(const ShaderProgramCache* c,const ShaderPermutation* p);
+int  ShaderProgramCache_HasParallelCompile(void);        // needs a current GL context
+void ShaderProgramCache_Clear(ShaderProgramCache* c);     // deletes all the programs
+int  ShaderProgramCache_SetBinaryDirectory(ShaderProgramCache* c,const char* directory);  // NULL disables the on-disk cache; returns 0 on failure (out of memory)
+int  ShaderProgramCache_HasProgramBinarySupport(void);    // needs a current GL context: 1 if the driver can save and load program binaries
+int  ShaderProgramCache_IsFromBinary(const ShaderProgramCache* c,const ShaderPermutation* p); // 1 if the cached program has been loaded from disk
+
+// Helper: compiles and links a program made of "vertexSource" and "fragmentSource" with "defineHeader" injected after their #version lines. Returns 0 on failure
+GLuint ShaderPermutation_BuildProgram(const char* vertexSource,const char* fragmentSource,const char* defineHeader);
+// Helpers for the on-disk cache: "key" is stored in the file and must match when it's loaded.
+// LoadProgramBinary(...) returns 0 on failure (missing, invalid or rejected by the driver); SaveProgramBinary(...) returns 0 on success, -1 on failure
+GLuint ShaderPermutation_LoadProgramBinary(const char* filePath,unsigned long long key);
+int ShaderPermutation_SaveProgramBinary(const char* filePath,unsigned long long key,GLuint program);
+// Compile and link errors are printed to stderr, unless a callback is set (e.g. to translate the line numbers of the log, see "shader_source.h").
+// "shaderType" is GL_VERTEX_SHADER or GL_FRAGMENT_SHADER, or 0 for link errors
+typedef void (*ShaderPermutationLogCallback)(GLenum shaderType,const char* defineHeader,const char* log,void* userData);
+void ShaderPermutation_SetLogCallback(ShaderPermutationLogCallback callback,void* userData);    // NULL restores the default
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHADER_PERMUTATIONS_H_
+
+#ifdef SHADER_PERMUTATIONS_IMPLEMENTATION
+#ifndef SHADER_PERMUTATIONS_IMPLEMENTATION_GUARD
+#define SHADER_PERMUTATIONS_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+#   ifdef _WIN32
+#       include <direct.h>  // _mkdir
+#   else
+#       include <sys/stat.h>    // mkdir
+#   endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ShaderPermutation_Init(ShaderPermutation* p) {p->num_defines = 0;}
+int ShaderPermutation_Set(ShaderPermutation* p,const char* name,const char* value) {
+    int i,cmp = 1;
+    if (!value) value = "";
+    if (strlen(name)>=SHADER_PERMUTATION_MAX_NAME_LENGTH || strlen(value)>=SHADER_PERMUTATION_MAX_VALUE_LENGTH || name[0]=='\0') return 0;
+    for (i=0;i<p->num_defines;i++) {
+        cmp = strcmp(p->defines[i].name,name);
+        if (cmp>=0) break;
+    }
+    if (i==p->num_defines || cmp!=0) {
+        // insert at i
+        if (p->num_defines==SHADER_PERMUTATION_MAX_DEFINES) return 0;
+        memmove(&p->defines[i+1],&p->defines[i],(p->num_defines-i)*sizeof(ShaderDefine));
+        ++p->num_defines;
+        strcpy(p->defines[i].name,name);
+    }
+    strcpy(p->defines[i].value,value);
+    return 1;
+}
+int ShaderPermutation_SetInt(ShaderPermutation* p,const char* name,int value) {
+    char tmp[SHADER_PERMUTATION_MAX_VALUE_LENGTH];
+    sprintf(tmp,"%d",value);
+    return ShaderPermutation_Set(p,name,tmp);
+}
+void ShaderPermutation_Remove(ShaderPermutation* p,const char* name) {
+    int i;
+    for (i=0;i<p->num_defines;i++) {
+        if (strcmp(p->defines[i].name,name)==0) {
+            memmove(&p->defines[i],&p->defines[i+1],(p->num_defines-i-1)*sizeof(ShaderDefine));
+            --p->num_defines;
+            return;
+        }
+    }
+}
+const char* ShaderPermutation_Get(const ShaderPermutation* p,const char* name) {
+    int i;
+    for (i=0;i<p->num_defines;i++) {
+        if (strcmp(p->defines[i].name,name)==0) return p->defines[i].value;
+    }
+    return NULL;
+}
+int ShaderPermutation_Equals(const ShaderPermutation* a,const ShaderPermutation* b) {
+    int i;
+    if (a->num_defines!=b->num_defines) return 0;
+    for (i=0;i<a->num_defines;i++) {
+        if (strcmp(a->defines[i].name,b->defines[i].name)!=0 || strcmp(a->defines[i].value,b->defines[i].value)!=0) return 0;
+    }
+    return 1;
+}
+int ShaderPermutation_GetHeader(const ShaderPermutation* p,char* buf,int bufSize) {
+    int i,len = 0;
+    if (buf && bufSize>0) buf[0] = '\0';
+    for (i=0;i<p->num_defines;i++) {
+        const ShaderDefine* d = &p->defines[i];
+        char line[SHADER_PERMUTATION_MAX_NAME_LENGTH+SHADER_PERMUTATION_MAX_VALUE_LENGTH+16];
+        const int lineLen = sprintf(line,d->value[0]!='\0' ? "#define %s %s\n" : "#define %s%s\n",d->name,d->value);
+        if (buf && len+lineLen<bufSize) memcpy(&buf[len],line,lineLen+1);
+        else if (buf && len<bufSize) buf[len] = '\0';
+        len+=lineLen;
+    }
+    return len;
+}
+static unsigned long long ShaderPermutation_Fnv1a(unsigned long long h,const void* data,size_t size) {
+    const unsigned char* p = (const unsigned char*) data;
+    size_t i;
+    for (i=0;i<size;i++) {h^=p[i];h*=1099511628211ULL;}
+    return h;
+}
+#define SHADER_PERMUTATION_FNV1A_SEED (14695981039346656037ULL)
+unsigned long long ShaderPermutation_GetHash(const ShaderPermutation* p) {
+    char buf[SHADER_PERMUTATION_MAX_DEFINES*(SHADER_PERMUTATION_MAX_NAME_LENGTH+SHADER_PERMUTATION_MAX_VALUE_LENGTH+16)];
+    const int len = ShaderPermutation_GetHeader(p,buf,sizeof(buf));
+    return ShaderPermutation_Fnv1a(SHADER_PERMUTATION_FNV1A_SEED,buf,len);
+}
+
+// "#line N": the next line is N with GLSL >= 3.30 and GLSL ES >= 3.00, N+1 with older GLSL versions and GLSL ES 1.00.
+// Some drivers don't follow the spec (e.g. Mesa uses N with GLSL ES 1.00 too), so the first time a version is used
+// we compile a probe shader with an undeclared identifier after a #line directive and look at the line of the error
+// (a compiler error: Mesa numbers the lines of its preprocessor errors in another way).
+// Returns 1 if the next line is N+1 (the result is cached per version: drivers don't change while the program runs).
+static int ShaderPermutation_IsLineDirectiveOffByOne(const char* versionLine,int versionLineLength,int version,int es) {
+    static struct {int version,es,offByOne;} cache[16];
+    static int numCached = 0;
+    int i,offByOne = es ? version<300 : version<330;  // (the spec, when the probe is not conclusive)
+    char probe[128];
+    GLuint shader;
+    for (i=0;i<numCached;i++) {if (cache[i].version==version && cache[i].es==es) return cache[i].offByOne;}
+    if (versionLineLength>=(int)sizeof(probe)-32) return offByOne;
+    memcpy(probe,versionLine,versionLineLength);    // (with its '\n', if any)
+    strcpy(&probe[versionLineLength],"\n#line 9000\nvoid main() {line_probe = 1;}\n");
+    shader = glCreateShader(GL_FRAGMENT_SHADER);
+    if (shader) {
+        const char* strings[1];
+        char log[1024];
+        strings[0] = probe;
+        log[0] = '\0';
+        glShaderSource(shader,1,strings,NULL);
+        glCompileShader(shader);
+        glGetShaderInfoLog(shader,sizeof(log),NULL,log);
+        glDeleteShader(shader);
+        if (strstr(log,"9001")) offByOne = 1;
+        else if (strstr(log,"9000")) offByOne = 0;
+    }
+    if (numCached<(int)(sizeof(cache)/sizeof(cache[0]))) {
+        cache[numCached].version = version;cache[numCached].es = es;cache[numCached].offByOne = offByOne;
+        ++numCached;
+    }
+    return offByOne;
+}
+static GLuint ShaderPermutation_StartShader(GLenum type,const char* source,const char* defineHeader) {
+    // The define header must follow the #version line (that must be the first line of the shader),
+    // and it's followed by a #line directive, so that the line numbers in the compiler logs are the ones of "source"
+    const char* strings[4];
+    const char* body = source;
+    const char* versionLine = "";
+    char lineDirective[32];
+    int version = 110,es = 0,bodyLine = 1,versionLineLength = 0;
+    GLuint shader;
+    while (*body==' ' || *body=='\t' || *body=='\r' || *body=='\n') ++body;
+    if (strncmp(body,"#version",8)==0) {
+        const char* eol = strchr(body,'\n');
+        const char* p;
+        version = atoi(body+8);
+        versionLine = body;
+        body = eol ? eol+1 : body+strlen(body);
+        versionLineLength = (int)(body-versionLine);
+        for (p=source;p+1<body;p++) {if (p[0]=='e' && p[1]=='s') es = 1;}
+        if (version==100) es = 1;
+        for (p=source;p<body;p++) {if (*p=='\n') ++bodyLine;}
+    }
+    else body = source;
+    if (defineHeader && defineHeader[0]!='\0') {
+        const int offByOne = ShaderPermutation_IsLineDirectiveOffByOne(versionLine,versionLineLength,version,es);
+        sprintf(lineDirective,"\n#line %d\n",offByOne ? bodyLine-1 : bodyLine);
+    }
+    strings[0] = source;
+    strings[1] = defineHeader ? defineHeader : "";
+    strings[2] = strings[1][0]!='\0' ? lineDirective : "";
+    strings[3] = body;
+    shader = glCreateShader(type);
+    if (!shader) {fprintf(stderr,"ShaderPermutation: glCreateShader(...) failed.\n");return 0;}
+    if (body!=source) {
+        const GLint lengths[4] = {(GLint)(body-source),-1,-1,-1};
+        glShaderSource(shader,4,strings,lengths);
+    }
+    else glShaderSource(shader,3,&strings[1],NULL);
+    glCompileShader(shader);
+    return shader;
+}
+static ShaderPermutationLogCallback ShaderPermutation_LogCallback = NULL;
+static void* ShaderPermutation_LogCallbackUserData = NULL;
+void ShaderPermutation_SetLogCallback(ShaderPermutationLogCallback callback,void* userData) {
+    ShaderPermutation_LogCallback = callback;
+    ShaderPermutation_LogCallbackUserData = userData;
+}
+static void ShaderPermutation_Log(GLenum shaderType,const char* defineHeader,const char* log) {
+    if (!defineHeader) defineHeader = "";
+    if (ShaderPermutation_LogCallback) ShaderPermutation_LogCallback(shaderType,defineHeader,log,ShaderPermutation_LogCallbackUserData);
+    else if (shaderType==0) fprintf(stderr,"Program failed to link (defines:\n%s):\n%s\n",defineHeader,log);
+    else fprintf(stderr,"%s shader failed compilation (defines:\n%s):\n%s\n",shaderType==GL_VERTEX_SHADER?"Vertex":"Fragment",defineHeader,log);
+}
+// returns 0 (and prints the log) if the compilation failed
+static int ShaderPermutation_CheckShader(GLuint shader,GLenum type,const char* defineHeader) {
+    GLint result = 0;
+    glGetShaderiv(shader,GL_COMPILE_STATUS,&result);
+    if (!result) {
+        GLint logLength = 0;
+        char* log;
+        glGetShaderiv(shader,GL_INFO_LOG_LENGTH,&logLength);
+        log = (char*) malloc(logLength>0 ? logLength : 1);
+        if (log) {
+            log[0] = '\0';
+            glGetShaderInfoLog(shader,logLength,NULL,log);
+            ShaderPermutation_Log(type,defineHeader,log);
+            free(log);
+        }
+        return 0;
+    }
+    return 1;
+}
+// Issues the compilation and the link of a program, without asking for their results (so that drivers can do them in the background).
+// Returns 0 on failure, otherwise the program must be passed to ShaderPermutation_FinishProgram(...)
+static GLuint ShaderPermutation_StartProgram(const char* vertexSource,const char* fragmentSource,const char* defineHeader,int retrievableBinary,GLuint* vsOut,GLuint* fsOut) {
+    GLuint vs,fs,program;
+    vs = ShaderPermutation_StartShader(GL_VERTEX_SHADER,vertexSource,defineHeader);
+    if (!vs) return 0;
+    fs = ShaderPermutation_StartShader(GL_FRAGMENT_SHADER,fragmentSource,defineHeader);
+    if (!fs) {glDeleteShader(vs);return 0;}
+    program = glCreateProgram();
+    glAttachShader(program,vs);
+    glAttachShader(program,fs);
+#   ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+    if (retrievableBinary) glProgramParameteri(program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+#   else
+    (void)retrievableBinary;
+#   endif
+    glLinkProgram(program);
+    *vsOut = vs;*fsOut = fs;
+    return program;
+}
+// Waits for the results of ShaderPermutation_StartProgram(...) and deletes the shaders. Returns 0 on failure (and "program" is deleted)
+static int ShaderPermutation_FinishProgram(GLuint program,GLuint vs,GLuint fs,const char* defineHeader) {
+    GLint result = 0;
+    if (ShaderPermutation_CheckShader(vs,GL_VERTEX_SHADER,defineHeader) && ShaderPermutation_CheckShader(fs,GL_FRAGMENT_SHADER,defineHeader)) {
+        glGetProgramiv(program,GL_LINK_STATUS,&result);
+        if (!result) {
+            GLint logLength = 0;
+            char* log;
+            glGetProgramiv(program,GL_INFO_LOG_LENGTH,&logLength);
+            log = (char*) malloc(logLength>0 ? logLength : 1);
+            if (log) {
+                log[0] = '\0';
+                glGetProgramInfoLog(program,logLength,NULL,log);
+                ShaderPermutation_Log(0,defineHeader,log);
+                free(log);
+            }
+        }
+    }
+    glDetachShader(program,vs);
+    glDetachShader(program,fs);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    if (!result) {glDeleteProgram(program);return 0;}
+    return 1;
+}
+// 1 if the results of ShaderPermutation_StartProgram(...) are available (without GL_KHR_parallel_shader_compile
+// there's no way to know it: then it always returns 1, and ShaderPermutation_FinishProgram(...) can block)
+static int ShaderPermutation_IsProgramCompleted(GLuint program,int parallelCompile) {
+#   ifdef GL_COMPLETION_STATUS_KHR
+    if (parallelCompile) {
+        GLint completed = GL_TRUE;
+        glGetProgramiv(program,GL_COMPLETION_STATUS_KHR,&completed);
+        return completed!=GL_FALSE;
+    }
+#   else
+    (void)program;(void)parallelCompile;
+#   endif
+    return 1;
+}
+static GLuint ShaderPermutation_BuildProgramEx(const char* vertexSource,const char* fragmentSource,const char* defineHeader,int retrievableBinary) {
+    GLuint vs,fs;
+    const GLuint program = ShaderPermutation_StartProgram(vertexSource,fragmentSource,defineHeader,retrievableBinary,&vs,&fs);
+    if (!program || !ShaderPermutation_FinishProgram(program,vs,fs,defineHeader)) return 0;
+    return program;
+}
+GLuint ShaderPermutation_BuildProgram(const char* vertexSource,const char* fragmentSource,const char* defineHeader) {
+    return ShaderPermutation_BuildProgramEx(vertexSource,fragmentSource,defineHeader,0);
+}
+
+// File format of the on-disk cache: this header (native endianness: the files are never shared between machines) followed by the binary
+typedef struct {
+    char magic[8];                  // "SDSPBIN"
+    unsigned version;               // SHADER_PROGRAM_BINARY_FILE_VERSION
+    unsigned binary_format;         // from glGetProgramBinary(...)
+    unsigned long long key;         // see ShaderProgramCache_GetBinaryKey(...)
+    unsigned long long checksum;    // FNV-1a of the binary
+    unsigned length;                // of the binary
+    unsigned reserved;
+} ShaderProgramBinaryFileHeader;
+#define SHADER_PROGRAM_BINARY_FILE_VERSION (1)
+#define SHADER_PROGRAM_BINARY_MAX_LENGTH (64*1024*1024)
+
+GLuint ShaderPermutation_LoadProgramBinary(const char* filePath,unsigned long long key) {
+#   ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+    ShaderProgramBinaryFileHeader h;
+    FILE* f = fopen(filePath,"rb");
+    void* binary;
+    GLuint program;
+    GLint result = 0;
+    if (!f) return 0;
+    if (fread(&h,sizeof(h),1,f)!=1 || memcmp(h.magic,"SDSPBIN",8)!=0 || h.version!=SHADER_PROGRAM_BINARY_FILE_VERSION ||
+        h.key!=key || h.length==0 || h.length>SHADER_PROGRAM_BINARY_MAX_LENGTH) {fclose(f);return 0;}
+    binary = malloc(h.length);
+    if (!binary) {fclose(f);return 0;}
+    if (fread(binary,1,h.length,f)!=h.length || fgetc(f)!=EOF || ShaderPermutation_Fnv1a(SHADER_PERMUTATION_FNV1A_SEED,binary,h.length)!=h.checksum) {
+        free(binary);fclose(f);return 0;
+    }
+    fclose(f);
+    while (glGetError()!=GL_NO_ERROR) {}
+    program = glCreateProgram();
+    glProgramBinary(program,(GLenum)h.binary_format,binary,(GLsizei)h.length);
+    free(binary);
+    // The driver can reject a binary (e.g. after a driver update that doesn't change the version strings)
+    glGetProgramiv(program,GL_LINK_STATUS,&result);
+    if (glGetError()!=GL_NO_ERROR || !result) {glDeleteProgram(program);return 0;}
+    return program;
+#   else
+    (void)filePath;(void)key;
+    return 0;
+#   endif
+}
+int ShaderPermutation_SaveProgramBinary(const char* filePath,unsigned long long key,GLuint program) {
+#   ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+    ShaderProgramBinaryFileHeader h;
+    GLint length = 0;
+    GLenum binaryFormat = 0;
+    void* binary;
+    char* tmpPath;
+    FILE* f;
+    int ok;
+    glGetProgramiv(program,GL_PROGRAM_BINARY_LENGTH,&length);
+    if (length<=0 || length>SHADER_PROGRAM_BINARY_MAX_LENGTH) return -1;
+    binary = malloc(length);
+    if (!binary) return -1;
+    glGetProgramBinary(program,length,&length,&binaryFormat,binary);
+    if (length<=0) {free(binary);return -1;}
+    memset(&h,0,sizeof(h));
+    memcpy(h.magic,"SDSPBIN",8);
+    h.version = SHADER_PROGRAM_BINARY_FILE_VERSION;
+    h.binary_format = (unsigned) binaryFormat;
+    h.key = key;
+    h.checksum = ShaderPermutation_Fnv1a(SHADER_PERMUTATION_FNV1A_SEED,binary,length);
+    h.length = (unsigned) length;
+    // Written to a temporary file and then renamed, so that a crash (or another instance) never leaves a truncated file
+    tmpPath = (char*) malloc(strlen(filePath)+5);
+    if (!tmpPath) {free(binary);return -1;}
+    sprintf(tmpPath,"%s.tmp",filePath);
+    f = fopen(tmpPath,"wb");
+    if (!f) {free(tmpPath);free(binary);return -1;}
+    ok = fwrite(&h,sizeof(h),1,f)==1 && fwrite(binary,1,length,f)==(size_t)length;
+    ok = (fclose(f)==0) && ok;
+    free(binary);
+    if (ok) {
+        remove(filePath);   // (rename(...) doesn't overwrite on Windows)
+        ok = rename(tmpPath,filePath)==0;
+    }
+    if (!ok) remove(tmpPath);
+    free(tmpPath);
+    return ok ? 0 : -1;
+#   else
+    (void)filePath;(void)key;(void)program;
+    return -1;
+#   endif
+}
+
+void ShaderProgramCache_Init(ShaderProgramCache* c) {memset(c,0,sizeof(ShaderProgramCache));c->parallel_compile = -1;}
+void ShaderProgramCache_Clear(ShaderProgramCache* c) {
+    int i;
+    for (i=0;i<c->num_entries;i++) {
+        ShaderProgramCacheEntry* e = &c->entries[i];
+        if (e->pending) {
+            glDeleteShader(e->pending_vs);glDeleteShader(e->pending_fs);
+            free(e->pending_header);
+        }
+        if (e->program) glDeleteProgram(e->program);
+    }
+    c->num_entries = 0;
+    c->parallel_compile = -1;   // (the next context might be different)
+}
+void ShaderProgramCache_Destroy(ShaderProgramCache* c) {
+    ShaderProgramCache_Clear(c);
+    if (c->entries) free(c->entries);
+    if (c->vertex_source) free(c->vertex_source);
+    if (c->fragment_source) free(c->fragment_source);
+    if (c->binary_directory) free(c->binary_directory);
+    ShaderProgramCache_Init(c);
+}
+static char* ShaderProgramCache_StrDup(const char* s) {
+    const size_t len = strlen(s);
+    char* d = (char*) malloc(len+1);
+    if (d) memcpy(d,s,len+1);
+    return d;
+}
+int ShaderProgramCache_SetSources(ShaderProgramCache* c,const char* vertexSource,const char* fragmentSource) {
+    char* vs = ShaderProgramCache_StrDup(vertexSource);
+    char* fs = ShaderProgramCache_StrDup(fragmentSource);
+    if (!vs || !fs) {if (vs) free(vs);if (fs) free(fs);return 0;}
+    ShaderProgramCache_Clear(c);
+    if (c->vertex_source) free(c->vertex_source);
+    if (c->fragment_source) free(c->fragment_source);
+    c->vertex_source = vs;
+    c->fragment_source = fs;
+    return 1;
+}
+int ShaderProgramCache_SetBinaryDirectory(ShaderProgramCache* c,const char* directory) {
+    char* dir = NULL;
+    if (directory) {
+        dir = ShaderProgramCache_StrDup(directory);
+        if (!dir) return 0;
+    }
+    if (c->binary_directory) free(c->binary_directory);
+    c->binary_directory = dir;
+    return 1;
+}
+int ShaderProgramCache_HasProgramBinarySupport(void) {
+#   ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&numFormats);   // GL_INVALID_ENUM (and 0) without GL 4.1 or GL_ARB_get_program_binary
+    while (glGetError()!=GL_NO_ERROR) {}
+    return numFormats>0;
+#   else
+    return 0;
+#   endif
+}
+static const ShaderProgramCacheEntry* ShaderProgramCache_FindEntry(const ShaderProgramCache* c,const ShaderPermutation* p) {
+    const unsigned long long hash = ShaderPermutation_GetHash(p);
+    int i;
+    for (i=0;i<c->num_entries;i++) {
+        const ShaderProgramCacheEntry* e = &c->entries[i];
+        if (e->hash==hash && ShaderPermutation_Equals(&e->permutation,p)) return e;
+    }
+    return NULL;
+}
+GLuint ShaderProgramCache_Find(const ShaderProgramCache* c,const ShaderPermutation* p) {
+    const ShaderProgramCacheEntry* e = ShaderProgramCache_FindEntry(c,p);
+    return (e && !e->pending) ? e->program : 0;
+}
+int ShaderProgramCache_IsPending(const ShaderProgramCache* c,const ShaderPermutation* p) {
+    const ShaderProgramCacheEntry* e = ShaderProgramCache_FindEntry(c,p);
+    return e ? e->pending : 0;
+}
+int ShaderProgramCache_IsFromBinary(const ShaderProgramCache* c,const ShaderPermutation* p) {
+    const ShaderProgramCacheEntry* e = ShaderProgramCache_FindEntry(c,p);
+    return e ? e->from_binary : 0;
+}
+// Everything that can make a program binary different: a different key means a different file
+static unsigned long long ShaderProgramCache_GetBinaryKey(const ShaderProgramCache* c,const char* defineHeader) {
+    const char* strings[6];
+    unsigned long long h = SHADER_PERMUTATION_FNV1A_SEED;
+    int i;
+    strings[0] = (const char*) glGetString(GL_VENDOR);
+    strings[1] = (const char*) glGetString(GL_RENDERER);
+    strings[2] = (const char*) glGetString(GL_VERSION);
+    strings[3] = c->vertex_source;
+    strings[4] = c->fragment_source;
+    strings[5] = defineHeader;
+    for (i=0;i<6;i++) {
+        const char* s = strings[i] ? strings[i] : "";
+        h = ShaderPermutation_Fnv1a(h,s,strlen(s)+1);   // (the terminator too, so that moving chars between strings changes the key)
+    }
+    return h;
+}
+static char* ShaderProgramCache_GetBinaryPath(const ShaderProgramCache* c,unsigned long long key) {
+    char* path = (char*) malloc(strlen(c->binary_directory)+32);
+    if (path) sprintf(path,"%s/%016llx.bin",c->binary_directory,key);
+    return path;
+}
+static void ShaderProgramCache_MakeBinaryDirectory(const ShaderProgramCache* c) {
+    // failures (e.g. it already exists) are ignored: saving the file will fail if it's really missing
+#   ifdef SHADER_PERMUTATIONS_HAS_PROGRAM_BINARY
+#   ifdef _WIN32
+    _mkdir(c->binary_directory);
+#   else
+    mkdir(c->binary_directory,0755);
+#   endif
+#   else
+    (void)c;
+#   endif
+}
+// Adds an entry (the program is not set). Returns NULL on failure (out of memory)
+static ShaderProgramCacheEntry* ShaderProgramCache_AddEntry(ShaderProgramCache* c,const ShaderPermutation* p) {
+    ShaderProgramCacheEntry* e;
+    if (c->num_entries==c->capacity) {
+        const int capacity = c->capacity>0 ? c->capacity*2 : 8;
+        ShaderProgramCacheEntry* entries = (ShaderProgramCacheEntry*) realloc(c->entries,capacity*sizeof(ShaderProgramCacheEntry));
+        if (!entries) return NULL;
+        c->entries = entries;c->capacity = capacity;
+    }
+    e = &c->entries[c->num_entries++];
+    memset(e,0,sizeof(ShaderProgramCacheEntry));
+    e->permutation = *p;
+    e->hash = ShaderPermutation_GetHash(p);
+    return e;
+}
+static void ShaderProgramCache_RemoveEntry(ShaderProgramCache* c,int index) {
+    memmove(&c->entries[index],&c->entries[index+1],(c->num_entries-index-1)*sizeof(ShaderProgramCacheEntry));
+    --c->num_entries;
+}
+// Waits for a pending build. Returns the program (0 on failure: then the entry is removed)
+static GLuint ShaderProgramCache_FinishEntry(ShaderProgramCache* c,int index) {
+    ShaderProgramCacheEntry* e = &c->entries[index];
+    GLuint program = e->program;
+    if (!ShaderPermutation_FinishProgram(e->program,e->pending_vs,e->pending_fs,e->pending_header)) program = 0;
+    else if (e->save_binary && c->binary_directory) {
+        char* binaryPath = ShaderProgramCache_GetBinaryPath(c,e->binary_key);
+        if (binaryPath) {
+            ShaderProgramCache_MakeBinaryDirectory(c);
+            if (ShaderPermutation_SaveProgramBinary(binaryPath,e->binary_key,program)!=0) fprintf(stderr,"ShaderProgramCache: can't save \"%s\".\n",binaryPath);
+            free(binaryPath);
+        }
+    }
+    free(e->pending_header);
+    e->pending_header = NULL;
+    e->pending = 0;
+    if (!program) ShaderProgramCache_RemoveEntry(c,index);    // failures are not cached: the sources might be fixed later
+    return program;
+}
+int ShaderProgramCache_HasParallelCompile(void) {
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+    while (glGetError()!=GL_NO_ERROR) {}    // (core profiles need glGetStringi(...))
+    return extensions && (strstr(extensions,"GL_KHR_parallel_shader_compile") || strstr(extensions,"GL_ARB_parallel_shader_compile"));
+}
+// Returns the define header of "p" (to be freed), and the key of its program binary (*binaryKey is 0 if the on-disk cache can't be used)
+static char* ShaderProgramCache_GetHeaderAndKey(const ShaderProgramCache* c,const ShaderPermutation* p,unsigned long long* binaryKey) {
+    const int headerLength = ShaderPermutation_GetHeader(p,NULL,0);
+    char* header = (char*) malloc(headerLength+1);
+    *binaryKey = 0;
+    if (!header) return NULL;
+    ShaderPermutation_GetHeader(p,header,headerLength+1);
+    if (c->binary_directory && ShaderProgramCache_HasProgramBinarySupport()) *binaryKey = ShaderProgramCache_GetBinaryKey(c,header);
+    return header;
+}
+// Loads the program of "p" from the on-disk cache and adds it. Returns 0 on failure
+static GLuint ShaderProgramCache_LoadEntry(ShaderProgramCache* c,const ShaderPermutation* p,unsigned long long binaryKey) {
+    char* binaryPath = ShaderProgramCache_GetBinaryPath(c,binaryKey);
+    GLuint program = 0;
+    ShaderProgramCacheEntry* e;
+    FILE* f;
+    if (!binaryPath) return 0;
+    f = fopen(binaryPath,"rb");
+    if (f) {
+        fclose(f);
+        program = ShaderPermutation_LoadProgramBinary(binaryPath,binaryKey);
+        if (program) ++c->num_binary_hits;
+        else {
+            fprintf(stderr,"ShaderProgramCache: invalid program binary \"%s\" (deleted: the program is compiled again).\n",binaryPath);
+            remove(binaryPath);
+            ++c->num_binary_rejected;
+        }
+    }
+    free(binaryPath);
+    if (!program) return 0;
+    e = ShaderProgramCache_AddEntry(c,p);
+    if (!e) {glDeleteProgram(program);return 0;}
+    e->program = program;
+    e->from_binary = 1;
+    return program;
+}
+GLuint ShaderProgramCache_Load(ShaderProgramCache* c,const ShaderPermutation* p) {
+    const ShaderProgramCacheEntry* found = ShaderProgramCache_FindEntry(c,p);
+    GLuint program = 0;
+    unsigned long long binaryKey;
+    char* header;
+    if (found) return found->pending ? 0 : found->program;
+    if (!c->vertex_source || !c->fragment_source) return 0;
+    header = ShaderProgramCache_GetHeaderAndKey(c,p,&binaryKey);
+    if (header && binaryKey) program = ShaderProgramCache_LoadEntry(c,p,binaryKey);
+    if (header) free(header);
+    return program;
+}
+GLuint ShaderProgramCache_Request(ShaderProgramCache* c,const ShaderPermutation* p) {
+    const ShaderProgramCacheEntry* found = ShaderProgramCache_FindEntry(c,p);
+    ShaderProgramCacheEntry* e;
+    GLuint program = 0,vs = 0,fs = 0;
+    char* header;
+    unsigned long long binaryKey;
+    if (found) return found->pending ? 0 : found->program;
+    if (!c->vertex_source || !c->fragment_source) return 0;
+    if (c->parallel_compile<0) c->parallel_compile = ShaderProgramCache_HasParallelCompile();
+    header = ShaderProgramCache_GetHeaderAndKey(c,p,&binaryKey);
+    if (!header) return 0;
+    if (binaryKey) {
+        // Loading a binary is fast: it's never deferred
+        program = ShaderProgramCache_LoadEntry(c,p,binaryKey);
+        if (program) {free(header);return program;}
+        ++c->num_binary_misses;
+    }
+    program = ShaderPermutation_StartProgram(c->vertex_source,c->fragment_source,header,binaryKey!=0,&vs,&fs);
+    if (!program) {free(header);return 0;}
+    e = ShaderProgramCache_AddEntry(c,p);
+    if (!e) {
+        if (ShaderPermutation_FinishProgram(program,vs,fs,header)) glDeleteProgram(program);
+        free(header);
+        return 0;
+    }
+    e->program = program;
+    e->pending = 1;
+    e->pending_vs = vs;e->pending_fs = fs;
+    e->pending_header = header;
+    e->binary_key = binaryKey;
+    e->save_binary = binaryKey!=0;
+    return 0;
+}
+int ShaderProgramCache_Poll(ShaderProgramCache* c,int wait) {
+    int i,numPending = 0;
+    for (i=0;i<c->num_entries;i++) {
+        const ShaderProgramCacheEntry* e = &c->entries[i];
+        if (!e->pending) continue;
+        if (wait || ShaderPermutation_IsProgramCompleted(e->program,c->parallel_compile>0)) {
+            if (!ShaderProgramCache_FinishEntry(c,i)) --i;    // (removed)
+        }
+        else ++numPending;
+    }
+    return numPending;
+}
+GLuint ShaderProgramCache_Get(ShaderProgramCache* c,const ShaderPermutation* p) {
+    GLuint program = ShaderProgramCache_Request(c,p);
+    const ShaderProgramCacheEntry* e;
+    if (program) return program;
+    e = ShaderProgramCache_FindEntry(c,p);
+    if (!e || !e->pending) return 0;
+    return ShaderProgramCache_FinishEntry(c,(int)(e-c->entries));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHADER_PERMUTATIONS_IMPLEMENTATION_GUARD
+#endif //SHADER_PERMUTATIONS_IMPLEMENTATION
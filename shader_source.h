@@ -0,0 +1,321 @@
+#ifndef SHADER_SOURCE_H_
+#define SHADER_SOURCE_H_
+
+/* LICENSE: MIT license */
+
+/* WHAT'S THIS?
+ * A plain C (--std=gnu89) header-only loader of shader source files (no OpenGL inside).
+ * -> Files are mapped in memory (mmap(...) on POSIX systems, a single fread(...) elsewhere): no fixed-size buffers, no truncation.
+ * -> #include "file" lines (paths relative to the including file) are replaced by the content of the file, recursively,
+ *    into a single heap-allocated source (include cycles and missing files are errors).
+ * -> Every line of the result is mapped back to its file and line, so that compiler logs (that refer to the lines of the
+ *    whole source) can be translated (see ShaderSource_TranslateLog(...)).
+*/
+
+/* USAGE:
+ * Define SHADER_SOURCE_IMPLEMENTATION in one of your .c (or .cpp) files before the inclusion of this file.
+ *
+ * ShaderSource src;
+ * ShaderSource_Init(&src);
+ * if (ShaderSource_Load(&src,"signed_distance_shapes.glsl")==0) {
+ *     // src.text is the whole source (with the included files)
+ *     char* log = ShaderSource_TranslateLog(&src,compilerLog);   // "0:123(4): error..." -> "file.glsl:45(4): error..."
+ *     ...
+ *     free(log);
+ * }
+ * ShaderSource_Destroy(&src);
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SHADER_SOURCE_MAX_INCLUDE_DEPTH
+#define SHADER_SOURCE_MAX_INCLUDE_DEPTH (16)
+#endif
+
+typedef struct {
+    int file;                       // index in ShaderSource::files
+    int line;                       // 1-based line in that file
+} ShaderSourceLine;
+
+typedef struct {
+    char* text;                     // the whole source ('\0' terminated)
+    int length;
+    ShaderSourceLine* lines;        // [num_lines]: lines[i] is the origin of line i+1 of text
+    int num_lines,lines_capacity;
+    char** files;                   // [num_files]: paths of the loaded files (files[0] is the main one)
+    int num_files;
+    int text_capacity;
+} ShaderSource;
+
+void ShaderSource_Init(ShaderSource* s);
+void ShaderSource_Destroy(ShaderSource* s);
+int  ShaderSource_Load(ShaderSource* s,const char* filePath);  // returns 0 on success, -1 on failure (errors are printed to stderr)
+int  ShaderSource_GetFileLine(const ShaderSource* s,int line,const char** file,int* fileLine);    // "line" is 1-based; returns 0 if it's out of range
+char* ShaderSource_TranslateLog(const ShaderSource* s,const char* log);   // returns a copy of "log" (to be freed) with "0:line"/"0(line)" references replaced by "file:line" (NULL if out of memory)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHADER_SOURCE_H_
+
+#ifdef SHADER_SOURCE_IMPLEMENTATION
+#ifndef SHADER_SOURCE_IMPLEMENTATION_GUARD
+#define SHADER_SOURCE_IMPLEMENTATION_GUARD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#   define SHADER_SOURCE_USE_MMAP
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ShaderSource_Init(ShaderSource* s) {memset(s,0,sizeof(ShaderSource));}
+void ShaderSource_Destroy(ShaderSource* s) {
+    int i;
+    for (i=0;i<s->num_files;i++) free(s->files[i]);
+    if (s->files) free(s->files);
+    if (s->lines) free(s->lines);
+    if (s->text) free(s->text);
+    ShaderSource_Init(s);
+}
+
+// A file mapped in memory (or read into the heap)
+typedef struct {
+    const char* data;
+    size_t size;
+#   ifdef SHADER_SOURCE_USE_MMAP
+    void* map;
+#   else
+    char* buf;
+#   endif
+} ShaderSourceFile;
+static int ShaderSourceFile_Open(ShaderSourceFile* f,const char* filePath) {
+#   ifdef SHADER_SOURCE_USE_MMAP
+    struct stat st;
+    const int fd = open(filePath,O_RDONLY);
+    memset(f,0,sizeof(ShaderSourceFile));
+    if (fd<0) return 0;
+    if (fstat(fd,&st)!=0) {close(fd);return 0;}
+    f->size = (size_t) st.st_size;
+    if (f->size>0) {
+        f->map = mmap(NULL,f->size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (f->map==MAP_FAILED) {f->map = NULL;close(fd);return 0;}
+        f->data = (const char*) f->map;
+    }
+    else f->data = "";
+    close(fd);  // (the mapping stays valid)
+    return 1;
+#   else
+    FILE* fp = fopen(filePath,"rb");
+    long size;
+    memset(f,0,sizeof(ShaderSourceFile));
+    if (!fp) return 0;
+    if (fseek(fp,0,SEEK_END)!=0 || (size=ftell(fp))<0 || fseek(fp,0,SEEK_SET)!=0) {fclose(fp);return 0;}
+    f->buf = (char*) malloc(size+1);
+    if (!f->buf || fread(f->buf,1,size,fp)!=(size_t)size) {if (f->buf) free(f->buf);f->buf = NULL;fclose(fp);return 0;}
+    fclose(fp);
+    f->data = f->buf;f->size = (size_t) size;
+    return 1;
+#   endif
+}
+static void ShaderSourceFile_Close(ShaderSourceFile* f) {
+#   ifdef SHADER_SOURCE_USE_MMAP
+    if (f->map) munmap(f->map,f->size);
+#   else
+    if (f->buf) free(f->buf);
+#   endif
+    memset(f,0,sizeof(ShaderSourceFile));
+}
+
+// Appends a single line ("text" without its '\n', that is always added)
+static int ShaderSource_AppendLine(ShaderSource* s,const char* text,int length,int file,int line) {
+    if (s->length+length+2>s->text_capacity) {
+        int capacity = s->text_capacity>0 ? s->text_capacity : 65536;
+        char* t;
+        while (s->length+length+2>capacity) capacity*=2;
+        t = (char*) realloc(s->text,capacity);
+        if (!t) return 0;
+        s->text = t;s->text_capacity = capacity;
+    }
+    if (s->num_lines==s->lines_capacity) {
+        const int capacity = s->lines_capacity>0 ? s->lines_capacity*2 : 4096;
+        ShaderSourceLine* l = (ShaderSourceLine*) realloc(s->lines,capacity*sizeof(ShaderSourceLine));
+        if (!l) return 0;
+        s->lines = l;s->lines_capacity = capacity;
+    }
+    memcpy(&s->text[s->length],text,length);
+    s->length+=length;
+    s->text[s->length++] = '\n';
+    s->text[s->length] = '\0';
+    s->lines[s->num_lines].file = file;
+    s->lines[s->num_lines].line = line;
+    ++s->num_lines;
+    return 1;
+}
+// If "line" (not '\0' terminated) is an #include directive, copies the included path (not resolved) into "name" and returns 1
+static int ShaderSource_ParseInclude(const char* line,const char* end,char* name,int nameSize) {
+    const char* p = line;
+    const char* q;
+    char close;
+    while (p<end && (*p==' ' || *p=='\t')) ++p;
+    if (p==end || *p!='#') return 0;
+    ++p;
+    while (p<end && (*p==' ' || *p=='\t')) ++p;
+    if (end-p<7 || strncmp(p,"include",7)!=0) return 0;
+    p+=7;
+    while (p<end && (*p==' ' || *p=='\t')) ++p;
+    if (p==end || (*p!='"' && *p!='<')) return 0;
+    close = *p=='"' ? '"' : '>';
+    q = ++p;
+    while (q<end && *q!=close) ++q;
+    if (q==end || q==p || q-p>=nameSize) return 0;
+    memcpy(name,p,q-p);name[q-p] = '\0';
+    return 1;
+}
+static char* ShaderSource_ResolvePath(const char* includer,const char* name) {
+    const char* slash = strrchr(includer,'/');
+    const char* backslash = strrchr(includer,'\\');
+    size_t dirLength;
+    char* path;
+    if (backslash && (!slash || backslash>slash)) slash = backslash;
+    dirLength = (slash && name[0]!='/') ? (size_t)(slash-includer+1) : 0;
+    path = (char*) malloc(dirLength+strlen(name)+1);
+    if (!path) return NULL;
+    memcpy(path,includer,dirLength);
+    strcpy(&path[dirLength],name);
+    return path;
+}
+static int ShaderSource_AddFile(ShaderSource* s,char* path) {
+    char** files = (char**) realloc(s->files,(s->num_files+1)*sizeof(char*));
+    if (!files) return -1;
+    s->files = files;
+    s->files[s->num_files] = path;
+    return s->num_files++;
+}
+// "stack" contains the files being loaded (to detect cycles)
+static int ShaderSource_LoadFile(ShaderSource* s,char* path,int* stack,int depth) {
+    ShaderSourceFile f;
+    const char* p;
+    const char* end;
+    int file,line = 0,i,ok = 1;
+    file = ShaderSource_AddFile(s,path);
+    if (file<0) {free(path);fprintf(stderr,"Out of memory\n");return 0;}
+    for (i=0;i<depth;i++) {
+        if (strcmp(s->files[stack[i]],path)==0) {fprintf(stderr,"Error: include cycle: \"%s\"\n",path);return 0;}
+    }
+    if (!ShaderSourceFile_Open(&f,path)) {fprintf(stderr,"Error: can't load \"%s\"\n",path);return 0;}
+    stack[depth] = file;
+    p = f.data;end = f.data+f.size;
+    while (ok && p<end) {
+        const char* eol = (const char*) memchr(p,'\n',end-p);
+        const char* next = eol ? eol+1 : end;
+        char name[512];
+        ++line;
+        if (ShaderSource_ParseInclude(p,eol ? eol : end,name,sizeof(name))) {
+            char* includePath = ShaderSource_ResolvePath(path,name);
+            if (!includePath) {fprintf(stderr,"Out of memory\n");ok = 0;}
+            else if (depth+1>=SHADER_SOURCE_MAX_INCLUDE_DEPTH) {
+                fprintf(stderr,"%s:%d: error: too many nested #include directives\n",path,line);
+                free(includePath);ok = 0;
+            }
+            else if (!ShaderSource_LoadFile(s,includePath,stack,depth+1)) {
+                fprintf(stderr,"%s:%d: error: included from here\n",path,line);
+                ok = 0;
+            }
+        }
+        else ok = ShaderSource_AppendLine(s,p,(int)((eol ? eol : end)-p),file,line);  // (a last line without '\n' gets one, so that the next file starts on a new line)
+        p = next;
+    }
+    ShaderSourceFile_Close(&f);
+    return ok;
+}
+int ShaderSource_Load(ShaderSource* s,const char* filePath) {
+    int stack[SHADER_SOURCE_MAX_INCLUDE_DEPTH];
+    const size_t len = strlen(filePath);
+    char* path = (char*) malloc(len+1);
+    ShaderSource_Destroy(s);
+    if (!path) return -1;
+    memcpy(path,filePath,len+1);
+    if (!ShaderSource_LoadFile(s,path,stack,0)) {ShaderSource_Destroy(s);return -1;}
+    if (!s->text) {
+        // empty file
+        s->text = (char*) malloc(1);
+        if (!s->text) {ShaderSource_Destroy(s);return -1;}
+        s->text[0] = '\0';s->text_capacity = 1;
+    }
+    return 0;
+}
+int ShaderSource_GetFileLine(const ShaderSource* s,int line,const char** file,int* fileLine) {
+    if (line<1 || line>s->num_lines) return 0;
+    if (file) *file = s->files[s->lines[line-1].file];
+    if (fileLine) *fileLine = s->lines[line-1].line;
+    return 1;
+}
+char* ShaderSource_TranslateLog(const ShaderSource* s,const char* log) {
+    // Common formats: "0:12(3): error" (Mesa), "0(12) : error" (NVIDIA), "ERROR: 0:12: ..." (AMD, Intel, ANGLE)
+    size_t capacity = strlen(log)*2+256,length = 0;
+    char* out = (char*) malloc(capacity);
+    const char* p = log;
+    if (!out) return NULL;
+    while (*p) {
+        const char* eol = strchr(p,'\n');
+        const char* next = eol ? eol+1 : p+strlen(p);
+        const char* q = p;
+        const char* file = NULL;
+        int line = 0,fileLine = 0;
+        const char* afterNumber = NULL;
+        char open = '\0';
+        size_t need;
+        if (strncmp(q,"ERROR: ",7)==0) q+=7;
+        else if (strncmp(q,"WARNING: ",9)==0) q+=9;
+        if (q[0]>='0' && q[0]<='9') {
+            while (*q>='0' && *q<='9') ++q;     // source string number
+            if (*q==':' || *q=='(') {
+                const char* numberStart;
+                open = *q;
+                numberStart = ++q;
+                while (*q>='0' && *q<='9' && line<100000000) {line = line*10+(*q-'0');++q;}
+                if (q>numberStart && ShaderSource_GetFileLine(s,line,&file,&fileLine)) afterNumber = q;
+            }
+        }
+        need = length+(next-p)+(file ? strlen(file)+32 : 0)+1;
+        if (need>capacity) {
+            char* o;
+            while (need>capacity) capacity*=2;
+            o = (char*) realloc(out,capacity);
+            if (!o) {free(out);return NULL;}
+            out = o;
+        }
+        if (afterNumber) {
+            // "ERROR: 0:12: ..." -> "ERROR: file:45: ...", "0:12(3): ..." -> "file:45(3): ...", "0(12) : ..." -> "file:45 : ..."
+            const char* prefixEnd = p;
+            while (*prefixEnd<'0' || *prefixEnd>'9') ++prefixEnd;
+            memcpy(&out[length],p,prefixEnd-p);length+=prefixEnd-p;
+            length+=sprintf(&out[length],"%s:%d",file,fileLine);
+            if (open=='(' && *afterNumber==')') ++afterNumber;
+            memcpy(&out[length],afterNumber,next-afterNumber);length+=next-afterNumber;
+        }
+        else {memcpy(&out[length],p,next-p);length+=next-p;}
+        p = next;
+    }
+    out[length] = '\0';
+    return out;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHADER_SOURCE_IMPLEMENTATION_GUARD
+#endif //SHADER_SOURCE_IMPLEMENTATION
@@ -1,8 +1,6 @@
 //#version 100	#version 300 es
-//
-//
-//
-// Please leave the lines above empty and full of spaces
+// main.c passes the #defines of the selected quality tier (and WRITE_DEPTH_VALUE) before this file
+// (after the #version line, if there's one): see "shader_permutations.h"
 
 
 // The MIT License
@@ -17,52 +15,112 @@
 
 #ifdef GL_ES
 #extension GL_EXT_frag_depth : enable	// require  // NOTE: From WebGL2 this extension is always missing, but gl_FragDepth is present in shaders with  #version 300 es
+#if defined(USE_TEMPORAL_DEPTH) || defined(DEFERRED_GBUFFER)
+#extension GL_EXT_draw_buffers : require	// gl_FragData[1] (main.c checks it before defining USE_TEMPORAL_DEPTH or DEFERRED_GBUFFER)
+#endif
+#if (defined(DEFERRED_GBUFFER) || defined(DEFERRED_OCCLUSION) || defined(DEFERRED_SHADING)) && defined(GL_FRAGMENT_PRECISION_HIGH)
+precision highp float;	// (the hit distances of the G-buffer have 24 bits: see "deferred.glsl")
+#else
 precision mediump float;
 #endif
+#endif
 
 // Sligthly modified by Flix01 to accept a camera matrix and to tune
-// behaviour with the following definitions:
+// behaviour with the following definitions
+// (the quality knobs below are only defaults: the application can define them before this file,
+// see ShaderPermutation in "shader_permutations.h" and the quality tiers in main.c):
 
 #define USE_CUSTOM_SETTINGS // Comment this out for the original code by Inigo Quilez (= good stuff)
 
 #ifdef USE_CUSTOM_SETTINGS
+#ifndef AMBIENT_OCCLUSION_PRECISION
 #define AMBIENT_OCCLUSION_PRECISION 0
+#endif
+#ifndef SHADOW_ITERATIONS
 #define SHADOW_ITERATIONS	  		6		// 0 = No shadows
+#endif
+#ifndef SHADOW_HARDNESS
 #define SHADOW_HARDNESS				(5.0)
+#endif
+#ifndef RAYCAST_ITERATIONS
 #define RAYCAST_ITERATIONS			28
+#endif
+#ifndef RAYCAST_PRECISION
 #define RAYCAST_PRECISION 			(0.001)	// Bigger is a bit faster, but produces artifacts
-//#define RAYCAST_OVER_RELAXED		// Use it at your own risk! NOT IN THE ORIGINAL CODE (and does not improve FPS much)! 
+#endif
+//#define RAYCAST_OVER_RELAXED		// Over-relaxed sphere tracing (fewer steps per ray, see castRay()). NOT IN THE ORIGINAL CODE
+#ifndef RAYCAST_OVER_RELAXATION
+#define RAYCAST_OVER_RELAXATION		(1.2)	// omega in (1,2): the steps are omega times the distance (RAYCAST_OVER_RELAXED only)
+#endif
+//#define RAYCAST_BEST_CANDIDATE	// RAYCAST_OVER_RELAXED only: the rays out of iterations end at their best point (see castRay())
+#if defined(RAYCAST_OVER_RELAXED) && defined(USE_SCENE_TEXTURE) && defined(USE_SCENE_GRID)
+#undef RAYCAST_OVER_RELAXED			// (the grid steps are clamped to the cells: they're not distances)
+#endif
 //#define GAMMA_CORRECTION_USING_SQRT	// col = pow(col,vec3(0.4545)); is replaced by col = sqrt(col); // which is pow(col,vec3(0.5)); AFAIK
 
+#ifndef ENABLE_SPE_LIGHTING_COMPONENT
 #define ENABLE_SPE_LIGHTING_COMPONENT 0
+#endif
+#ifndef ENABLE_DOM_LIGHTING_COMPONENT
 #define ENABLE_DOM_LIGHTING_COMPONENT 0	
+#endif
+#ifndef ENABLE_BAC_LIGHTING_COMPONENT
 #define ENABLE_BAC_LIGHTING_COMPONENT 1	
+#endif
+#ifndef ENABLE_FRE_LIGHTING_COMPONENT
 #define ENABLE_FRE_LIGHTING_COMPONENT 1	
+#endif
+#ifndef REDUCE_NUM_OBJECTS
 #define REDUCE_NUM_OBJECTS 1
+#endif
 
 #define USE_UNIFORM_CAMERA_MATRIX	// Mandatory for input camera mode		(arrows keys + pageup/pagedown)
 #define USE_UNIFORM_LIGHT_DIRECTION	// Mandatory for input light direction	(arrows keys + shift)
 
+#ifndef AA
 #define AA 1   // make this 1 is your machine is too slow
+#endif
 
 #else //USE_CUSTOM_SETTINGS
 // DEFAULT VALUES:
+#ifndef AMBIENT_OCCLUSION_PRECISION
 #define AMBIENT_OCCLUSION_PRECISION 5
+#endif
+#ifndef SHADOW_ITERATIONS
 #define SHADOW_ITERATIONS	  		16
+#endif
+#ifndef SHADOW_HARDNESS
 #define SHADOW_HARDNESS				(8.0)
+#endif
+#ifndef RAYCAST_ITERATIONS
 #define RAYCAST_ITERATIONS			64
+#endif
+#ifndef RAYCAST_PRECISION
 #define RAYCAST_PRECISION 			(0.0005)
+#endif
 
+#ifndef ENABLE_SPE_LIGHTING_COMPONENT
 #define ENABLE_SPE_LIGHTING_COMPONENT 1
+#endif
+#ifndef ENABLE_DOM_LIGHTING_COMPONENT
 #define ENABLE_DOM_LIGHTING_COMPONENT 1	
+#endif
+#ifndef ENABLE_BAC_LIGHTING_COMPONENT
 #define ENABLE_BAC_LIGHTING_COMPONENT 1	
+#endif
+#ifndef ENABLE_FRE_LIGHTING_COMPONENT
 #define ENABLE_FRE_LIGHTING_COMPONENT 1	
+#endif
+#ifndef REDUCE_NUM_OBJECTS
 #define REDUCE_NUM_OBJECTS 			  0
+#endif
 
 //#define USE_UNIFORM_CAMERA_MATRIX	// Mandatory for input camera mode		(arrows keys + pageup/pagedown)
 //#define USE_UNIFORM_LIGHT_DIRECTION	// Mandatory for input light direction	(arrows keys + shift)
 
+#ifndef AA
 #define AA 1   // make this 1 is your machine is too slow
+#endif
 #endif //USE_CUSTOM_SETTINGS
 
 
@@ -70,6 +128,11 @@ precision mediump float;
 
 #ifndef USE_UNIFORM_CAMERA_MATRIX
 #undef WRITE_DEPTH_VALUE
+#undef USE_CONE_PREPASS
+#undef USE_TEMPORAL_DEPTH
+#undef DEFERRED_GBUFFER
+#undef DEFERRED_OCCLUSION
+#undef DEFERRED_SHADING
 #endif //USE_UNIFORM_CAMERA_MATRIX
 #ifndef GL_EXT_frag_depth
 #undef WRITE_DEPTH_VALUE
@@ -104,193 +167,15 @@ mat3 mat3_cast(mat4 m4) {
 return m;
 }
 
-//------------------------------------------------------------------
-
-float sdPlane( vec3 p )
-{
-	return p.y;
-}
-
-float sdSphere( vec3 p, float s )
-{
-	return length(p)-s;							// correct
-	//return (p.x*p.x+p.y*p.y+p.z*p.z-s*s);    	// @Flix: this should be faster, but it returns a squared distance.... Looks OK to me... (I wonder if by always using squared distance fields we can get a better FPS: we can always use a single sqrt on the min or max returned value if we like (even if mix and other stuff won't be correct))
-}
-
-float sdBox( vec3 p, vec3 b )
-{
-    vec3 d = abs(p) - b;
-    return min(max(d.x,max(d.y,d.z)),0.0) + length(max(d,0.0));
-}
-
-float sdEllipsoid( in vec3 p, in vec3 r )
-{
-    return (length( p/r ) - 1.0) * min(min(r.x,r.y),r.z);
-}
-
-float udRoundBox( vec3 p, vec3 b, float r )
-{
-    return length(max(abs(p)-b,0.0))-r;
-}
-
-float sdTorus( vec3 p, vec2 t )
-{
-    return length( vec2(length(p.xz)-t.x,p.y) )-t.y;
-}
-
-float sdHexPrism( vec3 p, vec2 h )
-{
-    vec3 q = abs(p);
-#if 0
-    return max(q.z-h.y,max((q.x*0.866025+q.y*0.5),q.y)-h.x);
-#else
-    float d1 = q.z-h.y;
-    float d2 = max((q.x*0.866025+q.y*0.5),q.y)-h.x;
-    return length(max(vec2(d1,d2),0.0)) + min(max(d1,d2), 0.);
-#endif
-}
-
-float sdCapsule( vec3 p, vec3 a, vec3 b, float r )
-{
-	vec3 pa = p-a, ba = b-a;
-	float h = clamp( dot(pa,ba)/dot(ba,ba), 0.0, 1.0 );
-	return length( pa - ba*h ) - r;
-}
-
-float sdTriPrism( vec3 p, vec2 h )
-{
-    vec3 q = abs(p);
-#if 0
-    return max(q.z-h.y,max(q.x*0.866025+p.y*0.5,-p.y)-h.x*0.5);
-#else
-    float d1 = q.z-h.y;
-    float d2 = max(q.x*0.866025+p.y*0.5,-p.y)-h.x*0.5;
-    return length(max(vec2(d1,d2),0.0)) + min(max(d1,d2), 0.);
-#endif
-}
-
-float sdCylinder( vec3 p, vec2 h )
-{
-  vec2 d = abs(vec2(length(p.xz),p.y)) - h;
-  return min(max(d.x,d.y),0.0) + length(max(d,0.0));
-}
-
-float sdCone( in vec3 p, in vec3 c )
-{
-    vec2 q = vec2( length(p.xz), p.y );
-    float d1 = -q.y-c.z;
-    float d2 = max( dot(q,c.xy), q.y);
-    return length(max(vec2(d1,d2),0.0)) + min(max(d1,d2), 0.);
-}
-
-float sdConeSection( in vec3 p, in float h, in float r1, in float r2 )
-{
-    float d1 = -p.y - h;
-    float q = p.y - h;
-    float si = 0.5*(r1-r2)/h;
-    float d2 = max( sqrt( dot(p.xz,p.xz)*(1.0-si*si)) + q*si - r2, q );
-    return length(max(vec2(d1,d2),0.0)) + min(max(d1,d2), 0.);
-}
-
-float sdPryamid4(vec3 p, vec3 h ) // h = { cos a, sin a, height }
-{
-    // Tetrahedron = Octahedron - Cube
-    float box = sdBox( p - vec3(0,-2.0*h.z,0), vec3(2.0*h.z) );
- 
-    float d = 0.0;
-    d = max( d, abs( dot(p, vec3( -h.x, h.y, 0 )) ));
-    d = max( d, abs( dot(p, vec3(  h.x, h.y, 0 )) ));
-    d = max( d, abs( dot(p, vec3(  0, h.y, h.x )) ));
-    d = max( d, abs( dot(p, vec3(  0, h.y,-h.x )) ));
-    float octa = d - h.z;
-    return max(-box,octa); // Subtraction
- }
-
-float length2( vec2 p )
-{
-	return sqrt( p.x*p.x + p.y*p.y );
-}
-
-float length6( vec2 p )
-{
-	p = p*p*p; p = p*p;
-	return pow( p.x + p.y, 1.0/6.0 );
-}
-
-float length8( vec2 p )
-{
-	p = p*p; p = p*p; p = p*p;
-	return pow( p.x + p.y, 1.0/8.0 );
-}
-
-float sdTorus82( vec3 p, vec2 t )
-{
-    vec2 q = vec2(length2(p.xz)-t.x,p.y);
-    return length8(q)-t.y;
-}
-
-float sdTorus88( vec3 p, vec2 t )
-{
-    vec2 q = vec2(length8(p.xz)-t.x,p.y);
-    return length8(q)-t.y;
-}
-
-float sdCylinder6( vec3 p, vec2 h )
-{
-    return max( length6(p.xz)-h.x, abs(p.y)-h.y );
-}
-
-//------------------------------------------------------------------
-
-float opS( float d1, float d2 )
-{
-    return max(-d2,d1);
-}
-
-vec2 opU( vec2 d1, vec2 d2 )
-{
-	return (d1.x<d2.x) ? d1 : d2;				// Faster
-}
-
-vec3 opRep( vec3 p, vec3 c )
-{
-    return mod(p,c)-0.5*c;
-}
-
-vec3 opTwist( vec3 p )
-{
-    float  c = cos(10.0*p.y+10.0);
-    float  s = sin(10.0*p.y+10.0);
-    mat2   m = mat2(c,-s,s,c);
-    return vec3(m*p.xz,p.y);
-}
-
-
- 	
-// polynomial smooth min (k = 0.1); k that controls the radious/distance of the smoothness. 
-float smin( float a, float b, float k )
-{
-	// @Flix From: http://www.iquilezles.org/www/articles/smin/smin.htm
-    float h = clamp( 0.5+0.5*(b-a)/k, 0.0, 1.0 );
-    return mix( b, a, h ) - k*h*(1.0-h);
-}
-
-
-float opMix(vec3 p, float d1, float d2) {
-    // @Flix From: "Rendering Worlds with Two Triangles with raytracing on the GPU" by Iñigo Quilez
-    float bfact = smoothstep( length(p), 0.0, 1.0 );
-    return mix( d1, d2, bfact );
-}
-
-
-/*float opUMix(vec3 p, float d1, float d2)	{
-	// @Flix: Not sure what's this... just playing around...
-    float bfact = smoothstep( length(p), 0.0, 1.0 );
-    return smin( d1, d2, bfact );	
-}*/
+#include "sdf_primitives.glsl"
 
 //------------------------------------------------------------------
 
+#ifdef USE_SCENE_TEXTURE
+#include "sdf_scene.glsl"
+#elif defined(USE_COMPILED_SCENE)
+#include "sdf_scene_compiled.glsl"
+#else //USE_SCENE_TEXTURE
 vec2 map( in vec3 pos )
 {
     float sinValue = 0.0;
@@ -330,6 +215,35 @@ vec2 map( in vec3 pos )
        
     return res;	// res.y just controls the rendering material
 }
+#endif //USE_SCENE_TEXTURE
+
+#ifdef USE_BAKED_SDF
+#ifdef USE_SDF_BRICK_MAP
+#include "sdf_brick_map.glsl"
+#else
+#include "sdf_bake.glsl"
+#endif
+#endif //USE_BAKED_SDF
+
+#if defined(CONE_PREPASS) || defined(USE_CONE_PREPASS) || defined(TEMPORAL_DEPTH_REDUCE) || defined(USE_TEMPORAL_DEPTH)
+// Distances in [0,far] packed in two 8-bit channels (GLES2/WebGL1 can't render to float textures), always rounded down
+// (0.99: the margin of the mediump rounding)
+vec4 packDistance( in float t )
+{
+    float v = clamp( 0.99*t/iProjectionData.y, 0.0, 1.0 )*255.0;
+    return vec4( floor( v )/255.0, floor( fract( v )*255.0 )/255.0, 0.0, 1.0 );
+}
+float unpackDistance( in vec2 texel )
+{
+    return (texel.x + texel.y*(1.0/255.0))*iProjectionData.y;
+}
+#endif
+#if defined(CONE_PREPASS) || defined(USE_CONE_PREPASS)
+#include "cone_prepass.glsl"
+#endif
+#if defined(TEMPORAL_DEPTH_REDUCE) || defined(USE_TEMPORAL_DEPTH)
+#include "temporal_depth.glsl"
+#endif
 
 vec2 castRay( in vec3 ro, in vec3 rd )
 {
@@ -347,107 +261,93 @@ vec2 castRay( in vec3 ro, in vec3 rd )
     float tp2 = (1.6-ro.y)/rd.y; if( tp2>0.0 ) { if( ro.y>1.6 ) tmin = max( tmin, tp2 );
                                                  else           tmax = min( tmax, tp2 ); }
 #endif
+#ifdef USE_CONE_PREPASS
+    tmin = max( tmin, coneStart );	// (empty up to there: see "cone_prepass.glsl")
+#endif
   
-#ifndef RAYCAST_OVER_RELAXED
     float t = tmin;
     float m = -1.0;
+#ifdef USE_TEMPORAL_DEPTH
+    if( temporalGuess>t )
+    {
+	// only if it's outside the shapes there (see "temporal_depth.glsl"): the first step is taken from there
+	vec2 res = map( ro+rd*temporalGuess );
+	if( res.x>=0.0 )
+	{
+	    if( res.x<RAYCAST_PRECISION*temporalGuess || temporalGuess>tmax ) return vec2( temporalGuess, temporalGuess>tmax ? -1.0 : res.y );
+	    t = temporalGuess+res.x;
+	    m = res.y;
+	}
+    }
+#endif
+#ifdef USE_BAKED_SDF
+    // far from the surfaces: cheap steps through the baked distance field first
+    for( int i=0; i<RAYCAST_ITERATIONS; i++ )
+    {
+	float far = bakedSdfStep( ro+rd*t );
+	if( far<=0.0 || t>tmax ) break;
+	t += far;
+    }
+#endif
+#ifndef RAYCAST_OVER_RELAXED
     for( int i=0; i<RAYCAST_ITERATIONS; i++ )
     {
 	float precis = RAYCAST_PRECISION*t;
+#if defined(USE_SCENE_TEXTURE) && defined(USE_SCENE_GRID)
+	vec2 res = mapRay( ro+rd*t, rd );	// (steps cell by cell)
+#else
 	vec2 res = map( ro+rd*t );
+#endif
 	if( res.x<precis || t>tmax ) break;
 	t += res.x;
 	m = res.y;
     }
-
-    if( t>tmax ) m=-1.0;
-    return vec2( t, m );
 #else
-	// Not sure this is correct at all!
-	// I'm just guessing here
-	// Use it at your own risk
-	float omega = 1.2;	// default: 1.2
-	float t = tmin;
-	float m = -1.0;
-	float previousRadius = 0.0;
-	float stepLength = 0.0;
-	float functionSign = map(ro).x < 0.0 ? -1.0 : +1.0;
-	for (int i = 0; i < RAYCAST_ITERATIONS; ++i) {
-	    float precis = RAYCAST_PRECISION*t;
-	    vec2 res = map( ro+rd*t );
-	    float signedRadius = functionSign * res.x;
-	    float radius = abs(signedRadius);
-	    bool sorFail = omega > 1.0 && (radius + previousRadius) < stepLength;
-	    if (sorFail) {
-		stepLength -= omega * stepLength;
-		omega = 1.0;
-	    } else {
-		stepLength = signedRadius * omega;
-	    }
-	    previousRadius = radius;
-	    if(!sorFail && (res.x<precis || t>tmax)) break;
-	    t += stepLength;
-	    m = res.y;
-	}
-	if (t>tmax) m=-1.0;
-	return vec2( t, m );
+    // Over-relaxed sphere tracing ("Enhanced Sphere Tracing", Keinert et al. 2014): the steps are omega times the
+    // distance as long as the unbounding spheres of two consecutive points overlap (the segment between them is empty).
+    // When they don't, the ray goes back to the previous point plus its distance, and carries on with omega = 1 (the
+    // paper steps back by omega times the step instead, which is safe but shorter). The camera is outside the shapes
+    // (functionSign = +1 in the paper), and the hit (and its material) is the same as the one above.
+    // With RAYCAST_BEST_CANDIDATE the rays out of iterations end at the point with the smallest error (distance/t,
+    // RAYCAST_PRECISION is the radius of the cone of the pixel at t = 1), like forceHit in the paper, instead of the last one
+    float omega = RAYCAST_OVER_RELAXATION;
+    float previousRadius = 0.0;
+    float stepLength = 0.0;
+#ifdef RAYCAST_BEST_CANDIDATE
+    vec3 candidate = vec3( t, m, 1e10 );	// t, material, error
+    bool outOfIterations = true;
 #endif
-
-/* // From enhanced_sphere_tracing.pdf
-	
-	// BASE VERSION:
-	// o, d : ray origin, direction (normalized)
-	// t_min, t_max: minimum, maximum t values
-	// tau: radius threshold
-
-	float t = t_min;
-	int i = 0;
-	while (i < MAX_ITERATIONS && t < t_max) {
-		float radius = f(d*t + o);
-		if (radius < tau)	break;
-		t += radius;
-		i++;
+    for( int i=0; i<RAYCAST_ITERATIONS; i++ )
+    {
+	vec2 res = map( ro+rd*t );
+	float radius = abs( res.x );
+	if( omega>1.0 && radius+previousRadius<stepLength )
+	{
+	    t -= stepLength;
+	    stepLength = previousRadius;
+	    omega = 1.0;
 	}
-	if (i == MAX_ITERATIONS || t > t_max) return INFINITY;
-	return t;
-
-	// OVER-RELAXED VERSION
-	// o, d : ray origin, direction (normalized)
-	// t_min, t_max: minimum, maximum t values
-	// pixelRadius: radius of a pixel at t = 1
-	// forceHit: boolean enforcing to use the
-	// candidate_t value as result
-
-	float omega = 1.2;
-	float t = t_min;
-	float candidate_error = INFINITY;
-	float candidate_t = t_min;
-	float previousRadius = 0;
-	float stepLength = 0;
-	float functionSign = f(o) < 0 ? -1 : +1;
-	for (int i = 0; i < MAX_ITERATIONS; ++i) {
-		float signedRadius = functionSign * f(d*t + o);
-		float radius = abs(signedRadius);
-		bool sorFail = omega > 1 && (radius + previousRadius) < stepLength;
-		if (sorFail) {
-			stepLength -= omega * stepLength;
-			omega = 1;
-		} else {
-			stepLength = signedRadius * omega;
-		}
-		previousRadius = radius;
-		float error = radius / t;
-		if (!sorFail && error < candidate_error) {
-			candidate_t = t;
-			candidate_error = error;
-		}
-		if (!sorFail && error < pixelRadius || t > t_max) break;
-		t += stepLength;
+	else
+	{
+#ifdef RAYCAST_BEST_CANDIDATE
+	    if( res.x<RAYCAST_PRECISION*t || t>tmax ) { outOfIterations = false; break; }
+	    if( radius/t<candidate.z ) candidate = vec3( t, res.y, radius/t );
+#else
+	    if( res.x<RAYCAST_PRECISION*t || t>tmax ) break;
+#endif
+	    m = res.y;
+	    stepLength = res.x*omega;
+	    previousRadius = radius;
 	}
-	if ((t > t_max || candidate_error > pixelRadius) && !forceHit) return INFINITY;
-	return candidate_t;
+	t += stepLength;
+    }
+#ifdef RAYCAST_BEST_CANDIDATE
+    if( outOfIterations && t<=tmax ) { t = candidate.x; m = candidate.y; }
+#endif
+#endif
 
-*/
+    if( t>tmax ) m=-1.0;
+    return vec2( t, m );
 }
 
 
@@ -497,22 +397,46 @@ float calcAO( in vec3 pos, in vec3 nor )
     return clamp( 1.0 - 3.0*occ, 0.0, 1.0 );    
 }
 
-vec3 render( in vec3 ro, in vec3 rd )
-{ 
-    vec3 col = vec3(0.7, 0.9, 1.0) +rd.y*0.8;
-    vec2 res = castRay(ro,rd);
-    float t = res.x;
-    float m = res.y;
-    if( m>-0.5 )
-    {
-        vec3 pos = ro + t*rd;
-        vec3 nor = calcNormal( pos );
+vec3 lightDirection()
+{
+#ifndef USE_UNIFORM_LIGHT_DIRECTION
+	return normalize( vec3(-0.4, 0.7, -0.6) );
+#else
+	return iLightDirection;
+#endif
+}
+
+vec3 sky( in vec3 rd )
+{
+    return vec3(0.7, 0.9, 1.0) +rd.y*0.8;
+}
+
+// The occlusion terms of the lighting at pos: .x = ambient occlusion, .y = soft shadow of the light, .z = soft shadow of
+// the reflection (the dome light component). 1.0 when they're disabled
+vec3 occlusionTerms( in vec3 rd, in vec3 pos, in vec3 nor )
+{
+    vec3 o = vec3(1.0);
+#	if AMBIENT_OCCLUSION_PRECISION>0
+	o.x = calcAO( pos, nor );
+#	endif
+#if 	SHADOW_ITERATIONS>0
+    o.y = softshadow( pos, lightDirection(), 0.02, 2.5 );
+#if 	ENABLE_DOM_LIGHTING_COMPONENT>0
+    o.z = softshadow( pos, reflect( rd, nor ), 0.02, 2.5 );
+#		endif
+#		endif
+    return o;
+}
+
+// The color of the hit of rd at distance t (material m, position pos, normal nor)
+vec3 shade( in vec3 rd, in float t, in float m, in vec3 pos, in vec3 nor, in vec3 occlusion )
+{
 #if (ENABLE_SPE_LIGHTING_COMPONENT>0 || ENABLE_DOM_LIGHTING_COMPONENT>0)
         vec3 ref = reflect( rd, nor );
 #endif
                
 		// material        
-		col = 0.45 + 0.35*sin( vec3(0.05,0.08,0.10)*(m-1.0) );
+		vec3 col = 0.45 + 0.35*sin( vec3(0.05,0.08,0.10)*(m-1.0) );
 		// checker:
 	    if( m<1.5 )	
 		{   // checker on ground plane         
@@ -524,15 +448,8 @@ vec3 render( in vec3 ro, in vec3 rd )
 			col = mix(col,0.3 + 0.1*f*vec3(1.0),0.5);		
 		}*/
         // lighitng        
-        float occ = 1.0;
-#		if AMBIENT_OCCLUSION_PRECISION>0
-		occ = calcAO( pos, nor );
-#		endif
-#		ifndef USE_UNIFORM_LIGHT_DIRECTION
-		vec3  lig = normalize( vec3(-0.4, 0.7, -0.6) );
-#		else
-		vec3 lig = iLightDirection;
-#		endif
+        float occ = occlusion.x;
+		vec3 lig = lightDirection();
 		float amb = clamp( 0.5+0.5*nor.y, 0.0, 1.0 );
         float dif = clamp( dot( nor, lig ), 0.0, 1.0 );
 #if 	ENABLE_BAC_LIGHTING_COMPONENT>0
@@ -548,11 +465,9 @@ vec3 render( in vec3 ro, in vec3 rd )
 		float spe = pow(clamp( dot( ref, lig ), 0.0, 1.0 ),16.0);
 #		endif
 
-#if 	SHADOW_ITERATIONS>0        
-        dif *= softshadow( pos, lig, 0.02, 2.5 );
+        dif *= occlusion.y;
 #if 	ENABLE_DOM_LIGHTING_COMPONENT>0
-        dom *= softshadow( pos, ref, 0.02, 2.5 );
-#		endif
+        dom *= occlusion.z;
 #		endif
 
 		vec3 lin = vec3(0.0);
@@ -572,8 +487,12 @@ vec3 render( in vec3 ro, in vec3 rd )
 #		endif
 		col = col*lin;
 
-    	col = mix( col, vec3(0.8,0.9,1.0), 1.0-exp( -0.0002*t*t*t ) );
-    }
+    	return mix( col, vec3(0.8,0.9,1.0), 1.0-exp( -0.0002*t*t*t ) );
+}
+
+// The depth of the hit of rd at distance t (WRITE_DEPTH_VALUE only)
+void writeDepth( in float t, in vec3 rd )
+{
 #   ifdef WRITE_DEPTH_VALUE		// This gets automatically defined through main.c when necessary
 #	ifdef USE_UNIFORM_CAMERA_MATRIX	// But this is necessary as well
 	float zDot = dot(vec3(iCameraMatrix[2][0],iCameraMatrix[2][1],iCameraMatrix[2][2]),rd);
@@ -587,9 +506,40 @@ vec3 render( in vec3 ro, in vec3 rd )
 #	endif //GL_ES
 #	endif //USE_UNIFORM_CAMERA_MATRIX
 #   endif //WRITE_DEPTH_VALUE
+}
+
+vec3 render( in vec3 ro, in vec3 rd )
+{ 
+    vec3 col = sky( rd );
+    vec2 res = castRay(ro,rd);
+    float t = res.x;
+    float m = res.y;
+#ifdef USE_TEMPORAL_DEPTH
+    hitT = min( hitT, m>-0.5 ? t : iProjectionData.y );
+#endif
+    if( m>-0.5 )
+    {
+        vec3 pos = ro + t*rd;
+        vec3 nor = calcNormal( pos );
+        col = shade( rd, t, m, pos, nor, occlusionTerms( rd, pos, nor ) );
+    }
+    writeDepth( t, rd );
 	return vec3( clamp(col,0.0,1.0) );
 }
 
+vec3 gammaCorrection( in vec3 col )
+{
+#	ifndef GAMMA_CORRECTION_USING_SQRT
+	return pow( col, vec3(0.4545) );
+#	else
+	return sqrt(col);    // = pow(col,vec3(0.5)); but it's probably faster than the line above
+#	endif
+}
+
+#if defined(DEFERRED_GBUFFER) || defined(DEFERRED_OCCLUSION) || defined(DEFERRED_SHADING)
+#include "deferred.glsl"
+#endif
+
 #ifndef USE_UNIFORM_CAMERA_MATRIX
 mat3 setCamera( in vec3 ro, in vec3 ta, float cr )
 {
@@ -601,6 +551,7 @@ mat3 setCamera( in vec3 ro, in vec3 ta, float cr )
 }
 #endif
 
+#if !defined(CONE_PREPASS) && !defined(TEMPORAL_DEPTH_REDUCE) && !defined(DEFERRED_GBUFFER) && !defined(DEFERRED_OCCLUSION) && !defined(DEFERRED_SHADING)
 void main()
 {
 /*
@@ -611,6 +562,13 @@ void main()
     for the fragment's depth if no shader contained any writes to gl_FragDepth.
 */
 	vec2 fragCoord = gl_FragCoord.xy;
+#ifdef USE_CONE_PREPASS
+	coneStart = conePrepassStart( fragCoord );
+#endif
+#ifdef USE_TEMPORAL_DEPTH
+	temporalGuess = temporalStart( fragCoord );
+	hitT = iProjectionData.y;
+#endif
 
 #ifndef USE_UNIFORM_CAMERA_MATRIX
     vec2 mo = vec2(0.0,0.0);
@@ -705,11 +663,7 @@ void main()
 
        
 	// gamma
-#	ifndef GAMMA_CORRECTION_USING_SQRT
-	col = pow( col, vec3(0.4545) );
-#	else
-	col = sqrt(col);    // = pow(col,vec3(0.5)); but it's probably faster than the line above
-#	endif
+	col = gammaCorrection( col );
 
         tot += col;
 #if AA>1
@@ -717,6 +671,12 @@ void main()
     tot /= float(AA*AA);
 #endif
 
+#ifdef USE_TEMPORAL_DEPTH
+    gl_FragData[0] = vec4( tot, 1.0 );
+    gl_FragData[1] = packDistance( hitT );
+#else
     gl_FragColor = vec4( tot, 1.0 );
+#endif
 }
+#endif //!CONE_PREPASS && !TEMPORAL_DEPTH_REDUCE && !DEFERRED_GBUFFER && !DEFERRED_OCCLUSION && !DEFERRED_SHADING
 
@@ -0,0 +1,95 @@
+// Temporal depth reuse (included by "signed_distance_shapes.glsl" when USE_TEMPORAL_DEPTH or TEMPORAL_DEPTH_REDUCE is defined).
+// USE_TEMPORAL_DEPTH: main() writes the hit distance of its pixel (the smallest of its AA samples, the far plane when
+// nothing is hit) to a second render target, and castRay() starts from a distance reprojected from the previous frame
+// (temporalGuess) instead of the near plane: the previous frame saw empty space in front of its hit distances, so a point
+// of the ray is empty (if the scene is static) when it's closer to the previous camera than the hit distance there.
+// The guess is the hit distance of the same pixel in the previous frame, moved to the surface it reprojects to, times
+// iTemporalDepthInfo.x. Then TEMPORAL_DEPTH_SAMPLES points of the ray up to the guess are reprojected: the ray starts from
+// the last one in front of the previous hit distances. A point out of the previous frame (or behind its near plane) is a
+// disocclusion: the ray starts before it. The points are sparse, and a point just behind a silhouette can reproject next to
+// it: the previous hit distances are the smallest of the 2x2 tiles of TEMPORAL_DEPTH_TILE^2 pixels around the points.
+// castRay() still evaluates map() at the guess, and starts from the near plane if it's inside a shape.
+// TEMPORAL_DEPTH_REDUCE: main() writes the smallest hit distance of a tile of the previous frame (one fragment per tile).
+// The same as CpuTemporalDepth in "cpu_renderer.h" (the distances are packed in two 8-bit channels, see packDistance(...)).
+
+#define TEMPORAL_DEPTH_TILE 4           // the same as TEMPORAL_DEPTH_TILE in main.c
+#define TEMPORAL_DEPTH_SAMPLES 8
+
+uniform sampler2D iTemporalDepth;       // RGBA8 texture, the hit distances of the previous frame (nearest filtering)
+uniform vec4 iTemporalDepthInfo;        // .x = fraction (0.0 = no previous frame) .yz = resolution of the previous frame (pixels)
+uniform vec4 iTemporalDepthTexel;       // .xy = 1/iTemporalDepth size .zw = 1/iTemporalDepthTiles size (texels)
+
+#ifdef USE_TEMPORAL_DEPTH
+uniform sampler2D iTemporalDepthTiles;  // RGBA8 texture, the smallest distance of iTemporalDepth per tile (nearest filtering)
+uniform mat4 iTemporalDepthCamera;      // camera matrix of the previous frame
+
+float temporalGuess = 0.0;              // set by main() before render(...)
+float hitT = 0.0;                       // the smallest hit distance of the pixel (written by render(...))
+
+// The previous hit distance at l (in the space of the previous camera), or -1.0 out of the previous frame
+float temporalTileDepth( in vec3 l )
+{
+    if( l.z<=iProjectionData.x ) return -1.0;
+    // window coordinates of the previous frame
+    vec2 w = ( l.xy*iProjectionData.x/(l.z*iProjectionData2.xy) + 1.0 )*0.5*iTemporalDepthInfo.yz;
+    if( w.x<0.0 || w.y<0.0 || w.x>iTemporalDepthInfo.y || w.y>iTemporalDepthInfo.z ) return -1.0;
+    // the 2x2 tiles around w
+    vec2 tiles = ceil( iTemporalDepthInfo.yz/float(TEMPORAL_DEPTH_TILE) );
+    vec2 uv = ( clamp( floor( w/float(TEMPORAL_DEPTH_TILE)-0.5 ), vec2(0.0), tiles-2.0 )+0.5 )*iTemporalDepthTexel.zw;
+    return min( min( unpackDistance( texture2D( iTemporalDepthTiles, uv ).xy ),
+                     unpackDistance( texture2D( iTemporalDepthTiles, uv+vec2(iTemporalDepthTexel.z,0.0) ).xy ) ),
+                min( unpackDistance( texture2D( iTemporalDepthTiles, uv+vec2(0.0,iTemporalDepthTexel.w) ).xy ),
+                     unpackDistance( texture2D( iTemporalDepthTiles, uv+iTemporalDepthTexel.zw ).xy ) ) );
+}
+
+// The start distance of the rays of fragCoord (0.0 = the near plane)
+float temporalStart( in vec2 fragCoord )
+{
+    if( iTemporalDepthInfo.x<=0.0 ) return 0.0;
+    // the ray of the center of the pixel (the same as main())
+    vec2 p = iProjectionData2.xy * (2.0 * fragCoord / iResolution.xy - 1.0);
+    vec3 rdu = normalize( vec3(p.xy,iProjectionData.x));
+    vec3 rd = vec3(
+        iCameraMatrix[0][0]*rdu.x + iCameraMatrix[1][0]*rdu.y + iCameraMatrix[2][0]*rdu.z,
+        iCameraMatrix[0][1]*rdu.x + iCameraMatrix[1][1]*rdu.y + iCameraMatrix[2][1]*rdu.z,
+        iCameraMatrix[0][2]*rdu.x + iCameraMatrix[1][2]*rdu.y + iCameraMatrix[2][2]*rdu.z
+        );
+    // the ray in the space of the previous camera: l0+ld*t
+    vec3 d0 = vec3(iCameraMatrix[3][0],iCameraMatrix[3][1],iCameraMatrix[3][2]) - iTemporalDepthCamera[3].xyz;
+    vec3 l0 = vec3( dot( iTemporalDepthCamera[0].xyz, d0 ), dot( iTemporalDepthCamera[1].xyz, d0 ), dot( iTemporalDepthCamera[2].xyz, d0 ) );
+    vec3 ld = vec3( dot( iTemporalDepthCamera[0].xyz, rd ), dot( iTemporalDepthCamera[1].xyz, rd ), dot( iTemporalDepthCamera[2].xyz, rd ) );
+
+    // the same pixel of the previous frame (the same position in its viewport)
+    vec2 pixel = floor( fragCoord/iResolution.xy*iTemporalDepthInfo.yz )+0.5;
+    float t = unpackDistance( texture2D( iTemporalDepth, pixel*iTemporalDepthTexel.xy ).xy );
+    vec3 l = l0+ld*t;
+    float hit = temporalTileDepth( l );
+    if( hit<0.0 ) return 0.0;
+    float guess = ( t+hit-length( l ) )*iTemporalDepthInfo.x;
+    float start = guess;
+    for( int k=1; k<=TEMPORAL_DEPTH_SAMPLES; k++ )
+    {
+        t = guess*float(k)/float(TEMPORAL_DEPTH_SAMPLES);
+        l = l0+ld*t;
+        hit = temporalTileDepth( l );
+        if( hit<0.0 || length( l )>hit ) { start = guess*float(k-1)/float(TEMPORAL_DEPTH_SAMPLES); break; }
+    }
+    return start;
+}
+#endif //USE_TEMPORAL_DEPTH
+
+#ifdef TEMPORAL_DEPTH_REDUCE
+void main()
+{
+    vec2 first = floor( gl_FragCoord.xy )*float(TEMPORAL_DEPTH_TILE);
+    float t = iProjectionData.y;
+    for( int y=0; y<TEMPORAL_DEPTH_TILE; y++ )
+    for( int x=0; x<TEMPORAL_DEPTH_TILE; x++ )
+    {
+        // (the tiles at the borders are clamped to the previous frame)
+        vec2 pixel = min( first+vec2(float(x),float(y)), iTemporalDepthInfo.yz-1.0 )+0.5;
+        t = min( t, unpackDistance( texture2D( iTemporalDepth, pixel*iTemporalDepthTexel.xy ).xy ) );
+    }
+    gl_FragColor = packDistance( t );
+}
+#endif //TEMPORAL_DEPTH_REDUCE